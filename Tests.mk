@@ -35,19 +35,22 @@ CFLAGS=-fblocks -fcommon -O3 $(INCLUDE) \
 	-DUSE_LIBMPG123 \
 	-DXCTEST \
 	-DGOOGLETEST_STATIC
-LIBRARIES=-lmad -lmpg123 -lcurl -ldispatch -lpthread -lBlocksRuntime -lm -ljansson -ldl
+LIBRARIES=-lmad -lmpg123 -lcurl -ldispatch -lpthread -lBlocksRuntime -lm -ljansson -ldl -lzip -lz
 LDFLAGS=-L$(STATIC_ROOT)/lib -L$(STATIC_ROOT)/lib/x86_64-linux-gnu
 
 
 TEST_C_SOURCES=$(wildcard \
 	external/mp4p/src/*.c \
 	external/wcwidth/*.c \
+	plugins/ffap/dsputil.c \
+	plugins/ffap/ffap.c \
 	plugins/libparser/*.c \
 	plugins/m3u/*.c \
 	plugins/mp3/*.c \
 	plugins/nullout/*.c \
 	plugins/shellexec/*.c \
 	plugins/vfs_curl/*.c \
+	plugins/vfs_zip/*.c \
 	shared/*.c \
 	shared/scriptable/*.c \
 	shared/undo/*.c \
@@ -78,7 +81,7 @@ GOOGLE_TEST_OBJS:=$(addprefix $(BUILD)/,$(notdir $(patsubst %.cc,%.o,$(GOOGLE_TE
 
 VPATH=src \
 	$(addprefix src/,scriptable ConvertUTF md5 metadata undo) \
-	$(addprefix plugins/,libparser m3u mp3 nullout shellexec vfs_curl) \
+	$(addprefix plugins/,ffap libparser m3u mp3 nullout shellexec vfs_curl vfs_zip) \
 	$(addprefix external/,mp4p/src wcwidth googletest/googletest/src) \
 	shared \
 	shared/scriptable \
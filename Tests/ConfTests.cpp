@@ -0,0 +1,146 @@
+//
+//  ConfTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include <deadbeef/common.h>
+#include "conf.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+class ConfTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        ddb_logger_init ();
+        conf_init ();
+        conf_enable_saving (0);
+    }
+    void TearDown() override {
+        conf_free();
+        ddb_logger_free();
+    }
+
+    static void keyChanged (const char *key, void *user_data) {
+        ((std::vector<std::string> *)user_data)->push_back (key);
+    }
+};
+
+TEST_F(ConfTests, test_GetInt_ValueChanged_ReturnsNewValue) {
+    conf_set_int ("test.value", 5);
+    EXPECT_EQ(conf_get_int ("test.value", 0), 5);
+    EXPECT_EQ(conf_get_int64 ("test.value", 0), 5);
+    EXPECT_EQ(conf_get_float ("test.value", 0), 5.f);
+
+    conf_set_str ("test.value", "7.5");
+    EXPECT_EQ(conf_get_int ("test.value", 0), 7);
+    EXPECT_EQ(conf_get_int64 ("test.value", 0), 7);
+    EXPECT_EQ(conf_get_float ("test.value", 0), 7.5f);
+}
+
+TEST_F(ConfTests, test_GetInt_KeyDifferentCase_ReturnsValue) {
+    conf_set_int ("Test.Value", 5);
+    EXPECT_EQ(conf_get_int ("test.value", 0), 5);
+
+    conf_set_int ("TEST.VALUE", 6);
+    EXPECT_EQ(conf_get_int ("test.value", 0), 6);
+    EXPECT_EQ(conf_find ("test.", NULL)->next, nullptr);
+}
+
+TEST_F(ConfTests, test_SetStr_NullValue_RemovesItem) {
+    conf_set_int ("test.value", 5);
+    conf_set_str ("test.value", NULL);
+    EXPECT_EQ(conf_get_int ("test.value", -1), -1);
+    EXPECT_EQ(conf_find ("test.", NULL), nullptr);
+}
+
+TEST_F(ConfTests, test_Find_ManyItems_ReturnsSortedItems) {
+    char key[100];
+    for (int i = 0; i < 3000; i++) {
+        snprintf (key, sizeof (key), "test.%d", (i * 7919) % 3000);
+        conf_set_int (key, i);
+    }
+
+    int count = 0;
+    DB_conf_item_t *prev = NULL;
+    for (DB_conf_item_t *it = conf_find ("test.", NULL); it; it = conf_find ("test.", it)) {
+        if (prev) {
+            EXPECT_LT(strcasecmp (prev->key, it->key), 0);
+        }
+        prev = it;
+        count++;
+    }
+    EXPECT_EQ(count, 3000);
+}
+
+TEST_F(ConfTests, test_RemoveItems_Prefix_RemovesOnlyMatchingItems) {
+    conf_set_int ("a.value", 1);
+    conf_set_int ("test.1", 1);
+    conf_set_int ("test.2", 2);
+    conf_set_int ("z.value", 3);
+
+    conf_remove_items ("test.");
+
+    EXPECT_EQ(conf_get_int ("test.1", -1), -1);
+    EXPECT_EQ(conf_get_int ("test.2", -1), -1);
+    EXPECT_EQ(conf_get_int ("a.value", -1), 1);
+    EXPECT_EQ(conf_get_int ("z.value", -1), 3);
+
+    // the removed items can be added again
+    conf_set_int ("test.2", 4);
+    EXPECT_EQ(conf_get_int ("test.2", -1), 4);
+    EXPECT_STREQ(conf_find ("a.", NULL)->next->key, "test.2");
+}
+
+TEST_F(ConfTests, test_Subscribe_Prefix_NotifiesOnlyMatchingChanges) {
+    std::vector<std::string> keys;
+    intptr_t subscription = conf_subscribe ("test.", keyChanged, &keys);
+
+    conf_set_int ("test.value", 1);
+    conf_set_int ("test.value", 1); // no change
+    conf_set_int ("other.value", 1);
+    conf_set_int ("test.other", 2);
+    conf_remove_items ("test.value");
+
+    // waits for the notifications
+    conf_unsubscribe (subscription);
+
+    conf_set_int ("test.value", 3);
+
+    std::vector<std::string> expected = { "test.value", "test.other", "test.value" };
+    EXPECT_EQ(keys, expected);
+}
+
+TEST_F(ConfTests, test_SaveDeferred_FreeBeforeDelay_SavesOnFree) {
+    char savedConfDir[PATH_MAX];
+    char savedStateDir[PATH_MAX];
+    strcpy (savedConfDir, dbconfdir);
+    strcpy (savedStateDir, dbstatedir);
+    char tmpl[] = "/tmp/ddb_conf_XXXXXX";
+    ASSERT_NE(mkdtemp (tmpl), nullptr);
+    strcpy (dbconfdir, tmpl);
+    strcpy (dbstatedir, tmpl);
+
+    conf_enable_saving (1);
+    conf_set_int ("test.deferred", 1);
+    conf_save_deferred ();
+    conf_free ();
+
+    // longer than the save delay: the canceled save must not run after conf_free
+    usleep (1500000);
+
+    conf_init ();
+    conf_enable_saving (0);
+    conf_load ();
+    EXPECT_EQ(conf_get_int ("test.deferred", 0), 1);
+
+    std::string cmd = std::string ("rm -rf ") + tmpl;
+    (void)system (cmd.c_str ());
+    strcpy (dbconfdir, savedConfDir);
+    strcpy (dbstatedir, savedStateDir);
+}
@@ -0,0 +1,111 @@
+//
+//  DecoderProfileTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include <deadbeef/deadbeef.h>
+#include "decoderprofile.h"
+#include <string.h>
+#include <gtest/gtest.h>
+
+static DB_fileinfo_t _fileinfo;
+static int _insertCount;
+
+static DB_playItem_t *
+_fake_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
+    _insertCount++;
+    decoder_profile_count_read (1000);
+    decoder_profile_count_seek ();
+    decoder_profile_count_syscall ();
+    return NULL;
+}
+
+static DB_fileinfo_t *
+_fake_open (uint32_t hints) {
+    return &_fileinfo;
+}
+
+static int
+_fake_read_metadata (DB_playItem_t *it) {
+    return 0;
+}
+
+class DecoderProfileTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        _insertCount = 0;
+        memset (&_decoder, 0, sizeof (_decoder));
+        _decoder.plugin.api_vmajor = 1;
+        _decoder.plugin.api_vminor = 0;
+        _decoder.plugin.type = DB_PLUGIN_DECODER;
+        _decoder.plugin.id = "fake";
+        _decoder.insert = _fake_insert;
+        _decoder.open = _fake_open;
+        _decoder.read_metadata = _fake_read_metadata;
+    }
+    void TearDown() override {
+        decoder_profile_free ();
+    }
+
+    DB_decoder_t _decoder;
+};
+
+TEST_F(DecoderProfileTests, test_Wrap_Disabled_MethodsUnchanged) {
+    decoder_profile_init (0);
+    decoder_profile_wrap (&_decoder);
+
+    EXPECT_EQ(_decoder.insert, _fake_insert);
+    EXPECT_EQ(_decoder.open, _fake_open);
+    decoder_profile_stats_t stats;
+    EXPECT_EQ(decoder_profile_get_stats ("fake", &stats), -1);
+}
+
+TEST_F(DecoderProfileTests, test_Wrap_Enabled_CountsCallsAndIO) {
+    decoder_profile_init (1);
+    decoder_profile_wrap (&_decoder);
+    // wrapping twice must not wrap the wrappers
+    decoder_profile_wrap (&_decoder);
+
+    EXPECT_NE(_decoder.insert, _fake_insert);
+    EXPECT_EQ(_decoder.init, nullptr);
+
+    _decoder.insert (NULL, NULL, "test.fake");
+    _decoder.insert (NULL, NULL, "test.fake");
+    EXPECT_EQ(_decoder.open (0), &_fileinfo);
+    _decoder.read_metadata (NULL);
+    // outside of the measured calls
+    decoder_profile_count_read (1000);
+
+    EXPECT_EQ(_insertCount, 2);
+    decoder_profile_stats_t stats;
+    ASSERT_EQ(decoder_profile_get_stats ("fake", &stats), 0);
+    EXPECT_EQ(stats.calls[DECODER_PROFILE_INSERT], 2);
+    EXPECT_EQ(stats.calls[DECODER_PROFILE_OPEN], 1);
+    EXPECT_EQ(stats.calls[DECODER_PROFILE_READ_METADATA], 1);
+    EXPECT_EQ(stats.calls[DECODER_PROFILE_INIT], 0);
+    EXPECT_EQ(stats.bytes_read, 2000);
+    EXPECT_EQ(stats.read_calls, 2);
+    EXPECT_EQ(stats.seek_calls, 2);
+    EXPECT_EQ(stats.syscalls, 2);
+}
+
+TEST_F(DecoderProfileTests, test_Format_AfterCalls_ListsPluginAndResetClears) {
+    decoder_profile_init (1);
+    decoder_profile_wrap (&_decoder);
+    _decoder.insert (NULL, NULL, "test.fake");
+
+    decoder_profile_call_t call;
+    decoder_profile_begin (&call, "cue");
+    decoder_profile_end (&call, DECODER_PROFILE_CUE);
+
+    char buffer[4096];
+    EXPECT_EQ(decoder_profile_format (buffer, sizeof (buffer)), 2);
+    EXPECT_NE(strstr (buffer, "fake"), nullptr);
+    EXPECT_NE(strstr (buffer, "insert"), nullptr);
+    EXPECT_NE(strstr (buffer, "cue"), nullptr);
+
+    decoder_profile_reset ();
+    EXPECT_EQ(decoder_profile_format (buffer, sizeof (buffer)), 0);
+}
@@ -0,0 +1,110 @@
+//
+//  FfapDSPTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include "../plugins/ffap/dsputil.h"
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+typedef int32_t (*scalarproduct_and_madd_int16_t)(int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul);
+
+struct Kernel {
+    const char *name;
+    scalarproduct_and_madd_int16_t func;
+};
+
+class FfapDSPTests: public ::testing::Test {
+protected:
+    std::vector<Kernel> _kernels;
+
+    void SetUp() override {
+#if APE_DSP_X86
+        _kernels.push_back ({ "sse2", ape_scalarproduct_and_madd_int16_sse2 });
+        if (__builtin_cpu_supports ("avx2")) {
+            _kernels.push_back ({ "avx2", ape_scalarproduct_and_madd_int16_avx2 });
+        }
+#endif
+#if APE_DSP_NEON
+        _kernels.push_back ({ "neon", ape_scalarproduct_and_madd_int16_neon });
+#endif
+    }
+
+    // v1 is 16-byte aligned, like the filter coeffs, v2 and v3 are intentionally unaligned
+    static void fill (int16_t *v1, int16_t *v2, int16_t *v3, int order, unsigned seed, int extremes) {
+        srand (seed);
+        for (int i = 0; i < order; i++) {
+            if (extremes) {
+                v1[i] = (i & 1) ? 32767 : -32768;
+                v2[i] = -32768;
+                v3[i] = (i & 2) ? 32767 : -32768;
+            }
+            else {
+                v1[i] = (int16_t)(rand () & 0xffff);
+                v2[i] = (int16_t)(rand () & 0xffff);
+                v3[i] = (int16_t)(rand () & 0xffff);
+            }
+        }
+    }
+};
+
+TEST_F(FfapDSPTests, test_ScalarProductAndMadd_AllOrders_MatchesC) {
+    const int orders[] = { 16, 32, 48, 64, 256, 1024, 2048 };
+    const int muls[] = { -1, 0, 1 };
+
+    for (const Kernel &kernel : _kernels) {
+        for (int order : orders) {
+            for (int mul : muls) {
+                for (int extremes = 0; extremes < 2; extremes++) {
+                    alignas(16) int16_t v1_ref[2048];
+                    alignas(16) int16_t v1[2048];
+                    int16_t v2[2048 + 1];
+                    int16_t v3[2048 + 3];
+
+                    fill (v1_ref, v2 + 1, v3 + 3, order, order * 3 + mul, extremes);
+                    memcpy (v1, v1_ref, order * sizeof (int16_t));
+
+                    int32_t expected = ape_scalarproduct_and_madd_int16_c (v1_ref, v2 + 1, v3 + 3, order, mul);
+                    int32_t res = kernel.func (v1, v2 + 1, v3 + 3, order, mul);
+
+                    EXPECT_EQ(res, expected) << kernel.name << " order " << order << " mul " << mul;
+                    EXPECT_EQ(memcmp (v1, v1_ref, order * sizeof (int16_t)), 0) << kernel.name << " order " << order << " mul " << mul;
+                }
+            }
+        }
+    }
+}
+
+// Benchmark: the time per sample of each kernel, over the filter orders used by the APE compression levels.
+// Disabled by default, run with --gtest_also_run_disabled_tests --gtest_filter=*Benchmark
+TEST_F(FfapDSPTests, DISABLED_test_ScalarProductAndMadd_Benchmark) {
+    const int orders[] = { 16, 32, 256, 1024, 2048 };
+    const int iterations = 200000;
+
+    std::vector<Kernel> kernels = _kernels;
+    kernels.insert (kernels.begin (), { "c", ape_scalarproduct_and_madd_int16_c });
+
+    alignas(16) int16_t v1[2048];
+    int16_t v2[2048 + 1];
+    int16_t v3[2048 + 1];
+
+    for (int order : orders) {
+        for (const Kernel &kernel : kernels) {
+            fill (v1, v2 + 1, v3 + 1, order, 1, 0);
+            int32_t res = 0;
+
+            auto start = std::chrono::steady_clock::now ();
+            for (int i = 0; i < iterations; i++) {
+                res += kernel.func (v1, v2 + 1, v3 + 1, order, (i & 1) ? 1 : -1);
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now () - start).count ();
+
+            printf ("ffap %s order %d: %.2f ns/sample (%d)\n", kernel.name, order, (double)elapsed / iterations, res);
+        }
+    }
+}
@@ -0,0 +1,94 @@
+//
+//  FfapDecoderTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include "conf.h"
+#include "logger.h"
+#include <deadbeef/deadbeef.h>
+#include <deadbeef/common.h>
+#include "playlist.h"
+#include <string>
+#include <gtest/gtest.h>
+
+extern DB_functions_t *deadbeef;
+
+// 63000 stereo 16-bit samples in 7 frames, one of them silent
+#define FIXTURE_SAMPLES 63000
+#define FIXTURE_SAMPLE_SIZE 4
+
+class FfapDecoderTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        ddb_logger_init ();
+        conf_init ();
+        conf_enable_saving (0);
+
+        char path[PATH_MAX];
+        snprintf (path, sizeof (path), "%s/TestData/synthetic_noise.ape", dbplugindir);
+        _plt = plt_alloc ("testplt");
+        _it = deadbeef->plt_insert_file2 (0, (ddb_playlist_t *)_plt, NULL, path, NULL, NULL, NULL);
+    }
+    void TearDown() override {
+        deadbeef->plt_unref ((ddb_playlist_t *)_plt);
+        conf_free();
+        ddb_logger_free();
+    }
+
+    // Decodes until the end, starting at seekSample if it's not negative
+    std::string decode (int threads, int64_t seekSample) {
+        deadbeef->conf_set_int ("ffap.decode_threads", threads);
+        DB_decoder_t *dec = (DB_decoder_t *)deadbeef->plug_get_for_id ("ffap");
+        DB_fileinfo_t *fi = dec->open (0);
+        EXPECT_EQ(dec->init (fi, _it), 0);
+
+        std::string pcm;
+        char buffer[4096];
+        if (seekSample >= 0) {
+            // the frames are already being decoded ahead when seeking
+            dec->read (fi, buffer, sizeof (buffer));
+            dec->seek_sample (fi, (int)seekSample);
+        }
+        // uneven read sizes, to cross the frame boundaries at different offsets
+        for (;;) {
+            int size = (1 + (int)(pcm.size () / FIXTURE_SAMPLE_SIZE) % 997) * FIXTURE_SAMPLE_SIZE;
+            int res = dec->read (fi, buffer, size);
+            if (res <= 0) {
+                break;
+            }
+            pcm.append (buffer, res);
+        }
+        dec->free (fi);
+        return pcm;
+    }
+
+    playlist_t *_plt;
+    DB_playItem_t *_it;
+};
+
+TEST_F(FfapDecoderTests, test_DecodeThreads_WholeFile_SameAsSerial) {
+    ASSERT_NE(_it, nullptr);
+    std::string serial = decode (0, -1);
+    EXPECT_EQ(serial.size (), FIXTURE_SAMPLES * FIXTURE_SAMPLE_SIZE);
+
+    std::string single = decode (1, -1);
+    std::string multi = decode (4, -1);
+    EXPECT_TRUE(single == serial);
+    EXPECT_TRUE(multi == serial);
+}
+
+TEST_F(FfapDecoderTests, test_DecodeThreads_AfterSeek_SameAsSerial) {
+    ASSERT_NE(_it, nullptr);
+    const int64_t seeks[] = { 0, 9999, 10000, 25000, 62999 };
+    for (int64_t seek : seeks) {
+        std::string serial = decode (0, seek);
+        EXPECT_EQ(serial.size (), (FIXTURE_SAMPLES - seek) * FIXTURE_SAMPLE_SIZE) << "seek " << seek;
+
+        std::string single = decode (1, seek);
+        std::string multi = decode (4, seek);
+        EXPECT_TRUE(single == serial) << "seek " << seek;
+        EXPECT_TRUE(multi == serial) << "seek " << seek;
+    }
+}
@@ -23,6 +23,9 @@
 
 #include <deadbeef/deadbeef.h>
 #include "premix.h"
+#include <chrono>
+#include <math.h>
+#include <vector>
 #include <gtest/gtest.h>
 
 TEST(FormatConversionTests, testConvertFromStereoToBackLeftBackRight_AllSamplesDiscarded) {
@@ -76,3 +79,182 @@ TEST(FormatConversionTests, testConvertFromStereoToBackLeftFrontRight_LeftChanne
     EXPECT_TRUE(outsamples[2] == 0);
     EXPECT_TRUE(outsamples[3] == 0x4000);
 }
+
+// Reference implementation of pcm_interleave for integer formats
+static std::vector<uint8_t>
+interleaveReference (int bps, int channels, const int32_t * const *input, int stride, int shift, int nframes) {
+    std::vector<uint8_t> out;
+    for (int i = 0; i < nframes; i++) {
+        for (int c = 0; c < channels; c++) {
+            uint32_t sample = (uint32_t)input[c][i * stride] << shift;
+            for (int b = 0; b < bps / 8; b++) {
+                out.push_back ((uint8_t)(sample >> (b * 8)));
+            }
+        }
+    }
+    return out;
+}
+
+TEST(FormatConversionTests, testInterleave_IntegerFormats_MatchesReference) {
+    // odd frame count, to cover both the vectorized part and the remainder
+    const int nframes = 37;
+    const int bpsList[] = { 8, 16, 24, 32 };
+    const int channelsList[] = { 1, 2, 3, 6 };
+
+    for (int bps : bpsList) {
+        for (int channels : channelsList) {
+            for (int shift = 0; shift < 8; shift += 4) {
+                // planar input, with values using more than bps-shift bits to check truncation
+                std::vector<std::vector<int32_t>> planar (channels, std::vector<int32_t> (nframes));
+                for (int c = 0; c < channels; c++) {
+                    for (int i = 0; i < nframes; i++) {
+                        planar[c][i] = (int32_t)((i * 2654435761u) ^ (c * 0x9e3779b9u));
+                    }
+                }
+
+                // reversed channel order, to check remapping
+                std::vector<const int32_t *> input;
+                for (int c = channels - 1; c >= 0; c--) {
+                    input.push_back (planar[c].data ());
+                }
+
+                ddb_waveformat_t fmt = {
+                    .bps = bps,
+                    .channels = channels,
+                    .samplerate = 44100,
+                };
+
+                std::vector<uint8_t> expected = interleaveReference (bps, channels, input.data (), 1, shift, nframes);
+                std::vector<uint8_t> output (expected.size ());
+                int res = pcm_interleave (&fmt, (const void * const *)input.data (), 1, shift, (char *)output.data (), nframes);
+                EXPECT_EQ(res, (int)expected.size ());
+                EXPECT_EQ(output, expected) << "bps " << bps << " channels " << channels << " shift " << shift;
+
+                // the same from an interleaved int32 buffer
+                std::vector<int32_t> interleaved (nframes * channels);
+                for (int i = 0; i < nframes; i++) {
+                    for (int c = 0; c < channels; c++) {
+                        interleaved[i * channels + c] = input[c][i];
+                    }
+                }
+                std::vector<const int32_t *> strided;
+                for (int c = 0; c < channels; c++) {
+                    strided.push_back (interleaved.data () + c);
+                }
+                std::fill (output.begin (), output.end (), 0);
+                res = pcm_interleave (&fmt, (const void * const *)strided.data (), channels, shift, (char *)output.data (), nframes);
+                EXPECT_EQ(res, (int)expected.size ());
+                EXPECT_EQ(output, expected) << "strided bps " << bps << " channels " << channels << " shift " << shift;
+            }
+        }
+    }
+}
+
+TEST(FormatConversionTests, testInterleave_FloatStereoRemapped_MatchesReference) {
+    const int nframes = 21;
+    float left[nframes];
+    float right[nframes];
+    for (int i = 0; i < nframes; i++) {
+        left[i] = i * 0.01f;
+        right[i] = -i * 0.02f;
+    }
+
+    ddb_waveformat_t fmt = {
+        .bps = 32,
+        .channels = 2,
+        .samplerate = 48000,
+        .channelmask = DDB_SPEAKER_FRONT_LEFT|DDB_SPEAKER_FRONT_RIGHT,
+        .is_float = 1,
+    };
+
+    const float *input[2] = { right, left };
+    float output[nframes * 2];
+    int res = pcm_interleave (&fmt, (const void * const *)input, 1, 0, (char *)output, nframes);
+    EXPECT_EQ(res, (int)sizeof (output));
+    for (int i = 0; i < nframes; i++) {
+        EXPECT_EQ(output[i * 2], right[i]);
+        EXPECT_EQ(output[i * 2 + 1], left[i]);
+    }
+}
+
+TEST(FormatConversionTests, testInterleave_UnsupportedFormat_ReturnsError) {
+    int32_t samples[4] = { 0 };
+    const int32_t *input[1] = { samples };
+    char output[16];
+
+    ddb_waveformat_t fmt = {
+        .bps = 12,
+        .channels = 1,
+        .samplerate = 44100,
+    };
+    EXPECT_EQ(pcm_interleave (&fmt, (const void * const *)input, 1, 0, output, 4), -1);
+
+    fmt.bps = 16;
+    fmt.is_float = 1;
+    EXPECT_EQ(pcm_interleave (&fmt, (const void * const *)input, 1, 0, output, 4), -1);
+}
+
+// Benchmark: the output side of the vorbis and opus decoders, for stereo blocks decoded as planar float.
+// The old path packs the samples into 16-bit integers the way ov_read does, and the streamer converts them back to float.
+// The new path interleaves the float samples straight into the output buffer.
+// Disabled by default, run with --gtest_also_run_disabled_tests --gtest_filter=*Benchmark
+TEST(FormatConversionTests, DISABLED_testInterleave_Int16VersusFloat_Benchmark) {
+    const int nframes = 4096;
+    const int iterations = 20000;
+
+    std::vector<float> left (nframes);
+    std::vector<float> right (nframes);
+    for (int i = 0; i < nframes; i++) {
+        left[i] = sinf (i * 0.01f) * 0.9f;
+        right[i] = cosf (i * 0.013f) * 0.9f;
+    }
+    const float *input[2] = { left.data (), right.data () };
+
+    ddb_waveformat_t int16fmt = {
+        .bps = 16,
+        .channels = 2,
+        .samplerate = 48000,
+        .channelmask = DDB_SPEAKER_FRONT_LEFT|DDB_SPEAKER_FRONT_RIGHT,
+    };
+    ddb_waveformat_t floatfmt = int16fmt;
+    floatfmt.bps = 32;
+    floatfmt.is_float = 1;
+
+    std::vector<int16_t> int16output (nframes * 2);
+    std::vector<float> oldoutput (nframes * 2);
+    std::vector<float> newoutput (nframes * 2);
+
+    auto start = std::chrono::steady_clock::now ();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < nframes; i++) {
+            for (int channel = 0; channel < 2; channel++) {
+                int val = (int)lrintf (input[channel][i] * 32768.f);
+                if (val > 32767) {
+                    val = 32767;
+                }
+                else if (val < -32768) {
+                    val = -32768;
+                }
+                int16output[i * 2 + channel] = (int16_t)val;
+            }
+        }
+        pcm_convert (&int16fmt, (const char *)int16output.data (), &floatfmt, (char *)oldoutput.data (), nframes * 2 * sizeof (int16_t));
+    }
+    auto oldElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now () - start).count ();
+
+    start = std::chrono::steady_clock::now ();
+    for (int it = 0; it < iterations; it++) {
+        pcm_interleave (&floatfmt, (const void * const *)input, 1, 0, (char *)newoutput.data (), nframes);
+    }
+    auto newElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now () - start).count ();
+
+    printf ("%d stereo frames: int16 + pcm_convert %.2f us, float pcm_interleave %.2f us, %.1fx\n",
+            nframes,
+            oldElapsed / 1000.0 / iterations,
+            newElapsed / 1000.0 / iterations,
+            (double)oldElapsed / (double)newElapsed);
+
+    for (int i = 0; i < nframes * 2; i++) {
+        EXPECT_NEAR(oldoutput[i], newoutput[i], 1.f / 32768.f);
+    }
+}
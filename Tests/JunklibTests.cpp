@@ -288,3 +288,26 @@ TEST(JunklibTests, test_junkMakeTdrcString_bufferTooSmallForDate_outputEmpty) {
 
     EXPECT_TRUE(!strcmp(buffer, ""));
 }
+
+TEST(JunklibTests, test_detectCharset_longAsciiString_noRecoding) {
+    const char *cs = junk_detect_charset ("An ASCII string longer than a single vector chunk");
+
+    EXPECT_EQ(cs, nullptr);
+}
+
+TEST(JunklibTests, test_detectCharset_cp1251AfterAsciiPrefix_cp1251) {
+    const char *cs = junk_detect_charset ("An ASCII prefix longer than a vector \xcf\xf0\xe8\xe2\xe5\xf2 \xec\xe8\xf0 suffix");
+
+    EXPECT_STREQ(cs, "cp1251");
+}
+
+TEST(JunklibTests, test_iconv_repeatedAfterFailure_sameOutput) {
+    char output[100];
+    for (int i = 0; i < 3; i++) {
+        EXPECT_GE(junk_iconv ("\xcf\xf0\xe8", 3, output, sizeof (output), "cp1251", "utf-8"), 0);
+        EXPECT_STREQ(output, "При");
+        EXPECT_EQ(junk_iconv ("ab\xff", 3, output, sizeof (output), "utf-8", "utf-8"), -1);
+        EXPECT_GE(junk_iconv ("abc", 3, output, sizeof (output), "utf-8", "utf-8"), 0);
+        EXPECT_STREQ(output, "abc");
+    }
+}
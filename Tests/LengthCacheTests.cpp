@@ -0,0 +1,173 @@
+//
+//  LengthCacheTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include <deadbeef/deadbeef.h>
+#include <deadbeef/common.h>
+#include "lengthcache.h"
+#include <atomic>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+extern "C" DB_functions_t *deadbeef;
+
+static std::atomic<int> _probeCount;
+
+static float
+_probe (const char *fname, int subsong, const int *terminate, void *user_data) {
+    _probeCount++;
+    return subsong * 10 + 1;
+}
+
+// never finds the end of the song, until interrupted
+static float
+_endlessProbe (const char *fname, int subsong, const int *terminate, void *user_data) {
+    _probeCount++;
+    while (!__atomic_load_n (terminate, __ATOMIC_RELAXED)) {
+        usleep (1000);
+    }
+    return -1;
+}
+
+class LengthCacheTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        _probeCount = 0;
+        strcpy (_savedCacheDir, dbcachedir);
+        char tmpl[] = "/tmp/ddb_lengthcache_XXXXXX";
+        ASSERT_NE(mkdtemp (tmpl), nullptr);
+        _dir = tmpl;
+        snprintf (dbcachedir, sizeof (dbcachedir), "%s/cache", _dir.c_str ());
+        _fname = _dir + "/song.mod";
+        writeFile ("module");
+    }
+    void TearDown() override {
+        std::string cmd = "rm -rf " + _dir;
+        (void)system (cmd.c_str ());
+        strcpy (dbcachedir, _savedCacheDir);
+    }
+
+    void writeFile (const char *data) {
+        FILE *fp = fopen (_fname.c_str (), "wb");
+        fputs (data, fp);
+        fclose (fp);
+    }
+
+    float waitForDuration (DB_playItem_t *it) {
+        for (int i = 0; i < 500 && deadbeef->pl_get_item_duration (it) <= 0; i++) {
+            usleep (10000);
+        }
+        return deadbeef->pl_get_item_duration (it);
+    }
+
+    char _savedCacheDir[PATH_MAX];
+    std::string _dir;
+    std::string _fname;
+};
+
+TEST_F(LengthCacheTests, test_Get_StoredDuration_ReturnsDurationAfterReload) {
+    lengthcache_t *cache = lengthcache_alloc (deadbeef, "test", _probe, NULL);
+    float duration = 0;
+    EXPECT_EQ(lengthcache_get (cache, _fname.c_str (), 1, &duration), -1);
+    lengthcache_set (cache, _fname.c_str (), 1, 42.5f);
+    lengthcache_set (cache, _fname.c_str (), 2, -1);
+    lengthcache_free (cache);
+
+    cache = lengthcache_alloc (deadbeef, "test", _probe, NULL);
+    EXPECT_EQ(lengthcache_get (cache, _fname.c_str (), 1, &duration), 0);
+    EXPECT_EQ(duration, 42.5f);
+    EXPECT_EQ(lengthcache_get (cache, _fname.c_str (), 2, &duration), 0);
+    EXPECT_EQ(duration, -1);
+    EXPECT_EQ(lengthcache_get (cache, _fname.c_str (), 3, &duration), -1);
+    lengthcache_free (cache);
+}
+
+TEST_F(LengthCacheTests, test_Set_FileLayout_LittleEndianRecords) {
+    lengthcache_t *cache = lengthcache_alloc (deadbeef, "test", _probe, NULL);
+    lengthcache_set (cache, _fname.c_str (), 3, 42.5f);
+    lengthcache_free (cache);
+
+    std::string path = std::string (dbcachedir) + "/lengthcache/test";
+    FILE *fp = fopen (path.c_str (), "rb");
+    ASSERT_TRUE(fp);
+    unsigned char data[PATH_MAX + 100];
+    size_t size = fread (data, 1, sizeof (data), fp);
+    fclose (fp);
+
+    size_t path_len = _fname.length ();
+    ASSERT_EQ(size, 8 + 4 + path_len + 24);
+    EXPECT_EQ(memcmp (data, "DDBL\x02\0\0\0", 8), 0);
+    EXPECT_EQ(data[8], path_len);
+    EXPECT_EQ(memcmp (data + 9, "\0\0\0", 3), 0);
+    EXPECT_EQ(memcmp (data + 12, _fname.c_str (), path_len), 0);
+
+    const unsigned char *record = data + 12 + path_len;
+    EXPECT_EQ(record[0], 6); // size of "module"
+    EXPECT_EQ(memcmp (record + 16, "\x03\0\0\0", 4), 0); // subsong
+    EXPECT_EQ(memcmp (record + 20, "\0\0\x2a\x42", 4), 0); // 42.5f
+}
+
+TEST_F(LengthCacheTests, test_Get_FileModified_ReturnsNotFound) {
+    lengthcache_t *cache = lengthcache_alloc (deadbeef, "test", _probe, NULL);
+    lengthcache_set (cache, _fname.c_str (), 0, 42.5f);
+    writeFile ("modified module");
+
+    float duration = 0;
+    EXPECT_EQ(lengthcache_get (cache, _fname.c_str (), 0, &duration), -1);
+    lengthcache_free (cache);
+}
+
+TEST_F(LengthCacheTests, test_Get_RemoteFile_ReturnsNotFound) {
+    lengthcache_t *cache = lengthcache_alloc (deadbeef, "test", _probe, NULL);
+    lengthcache_set (cache, "http://example.com/song.mod", 0, 42.5f);
+
+    float duration = 0;
+    EXPECT_EQ(lengthcache_get (cache, "http://example.com/song.mod", 0, &duration), -1);
+    lengthcache_free (cache);
+}
+
+TEST_F(LengthCacheTests, test_Probe_SameSubsongTwice_ProbedOnceAndDurationsSet) {
+    lengthcache_t *cache = lengthcache_alloc (deadbeef, "test", _probe, NULL);
+    DB_playItem_t *it1 = deadbeef->pl_item_alloc ();
+    DB_playItem_t *it2 = deadbeef->pl_item_alloc ();
+
+    lengthcache_probe (cache, it1, _fname.c_str (), 2);
+    lengthcache_probe (cache, it2, _fname.c_str (), 2);
+
+    EXPECT_EQ(waitForDuration (it1), 21);
+    EXPECT_EQ(waitForDuration (it2), 21);
+    EXPECT_EQ(_probeCount, 1);
+
+    float duration = 0;
+    EXPECT_EQ(lengthcache_get (cache, _fname.c_str (), 2, &duration), 0);
+    EXPECT_EQ(duration, 21);
+
+    deadbeef->pl_item_unref (it1);
+    deadbeef->pl_item_unref (it2);
+    lengthcache_free (cache);
+}
+
+TEST_F(LengthCacheTests, test_Free_ProbeRunning_InterruptsProbeAndDropsResult) {
+    lengthcache_t *cache = lengthcache_alloc (deadbeef, "test", _endlessProbe, NULL);
+    DB_playItem_t *it = deadbeef->pl_item_alloc ();
+
+    lengthcache_probe (cache, it, _fname.c_str (), 0);
+    for (int i = 0; i < 500 && _probeCount == 0; i++) {
+        usleep (10000);
+    }
+    EXPECT_EQ(_probeCount, 1);
+    lengthcache_free (cache);
+
+    cache = lengthcache_alloc (deadbeef, "test", _probe, NULL);
+    float duration = 0;
+    EXPECT_EQ(lengthcache_get (cache, _fname.c_str (), 0, &duration), -1);
+    lengthcache_free (cache);
+
+    deadbeef->pl_item_unref (it);
+}
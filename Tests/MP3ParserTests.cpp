@@ -188,3 +188,45 @@ TEST(MP3ParserTests, test_FiniteVBRLameHdrNetworkStream_ReportsAccurateDuration)
     EXPECT_EQ_WITH_ACCURACY(info.npackets, 890, 10);
     EXPECT_LT(info.valid_packets, info.npackets);
 }
+
+static void
+_verifyIndexedSeeksMatchFullScan (const char *fname, uint32_t flags) {
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData/mp3parser/%s", dbplugindir, fname);
+    DB_FILE *fp = vfs_fopen (path);
+    int64_t fsize = vfs_fgetlength(fp);
+
+    mp3info_t info;
+    mp3_seekindex_t index = {0};
+    int res = mp3_parse_file_indexed (&info, flags, fp, fsize, 0, 0, -1, &index);
+    EXPECT_TRUE(!res);
+    int64_t totalsamples = info.totalsamples;
+
+    // seek backwards, forwards, and past the indexed part
+    const int64_t positions[] = { totalsamples/2, 576+44100, totalsamples-2000, 20000, totalsamples/3 };
+    for (int64_t sample : positions) {
+        mp3info_t expected;
+        res = mp3_parse_file (&expected, flags, fp, fsize, 0, 0, sample);
+        EXPECT_TRUE(!res);
+        res = mp3_parse_file_indexed (&info, flags, fp, fsize, 0, 0, sample, &index);
+        EXPECT_TRUE(!res);
+        EXPECT_EQ(info.packet_offs, expected.packet_offs);
+        EXPECT_EQ(info.pcmsample, expected.pcmsample);
+    }
+    EXPECT_GT(index.count, 0);
+
+    mp3_seekindex_free (&index);
+    vfs_fclose (fp);
+}
+
+TEST(MP3ParserTests, test_VBRNoXingIndexedSeek_MatchesFullScanSeek) {
+    _verifyIndexedSeeksMatchFullScan ("vbr_rhytm_30sec.mp3", 0);
+}
+
+TEST(MP3ParserTests, test_2secSquareWithGarbageIndexedSeek_MatchesFullScanSeek) {
+    _verifyIndexedSeeksMatchFullScan ("2sec-square-nolamehdr-garbage.mp3", 0);
+}
+
+TEST(MP3ParserTests, test_VBRLameHdrIndexedSeek_MatchesFullScanSeek) {
+    _verifyIndexedSeeksMatchFullScan ("vbr_rhytm_30sec_lamehdr.mp3", 0);
+}
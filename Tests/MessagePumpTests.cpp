@@ -0,0 +1,113 @@
+//
+//  MessagePumpTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include "messagepump.h"
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+class MessagePumpTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        messagepump_init ();
+    }
+    void TearDown() override {
+        messagepump_free ();
+    }
+};
+
+TEST_F(MessagePumpTests, test_PushPop_MessagesReturnedInOrder) {
+    messagepump_push (DB_EV_NEXT, 0, 1, 0);
+    messagepump_push (DB_EV_PREV, 0, 2, 0);
+    messagepump_push (DB_EV_STOP, 0, 3, 0);
+
+    uint32_t ids[] = { DB_EV_NEXT, DB_EV_PREV, DB_EV_STOP };
+    uint32_t id, p1, p2;
+    uintptr_t ctx;
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(messagepump_pop (&id, &ctx, &p1, &p2), 0);
+        EXPECT_EQ(id, ids[i]);
+        EXPECT_EQ(p1, i + 1);
+    }
+    EXPECT_EQ(messagepump_pop (&id, &ctx, &p1, &p2), -1);
+}
+
+TEST_F(MessagePumpTests, test_Push_MoreThanPoolSize_NoMessagesLost) {
+    for (uint32_t i = 0; i < 10000; i++) {
+        EXPECT_EQ(messagepump_push (DB_EV_SEEK, 0, i, 0), 0);
+    }
+
+    uint32_t id, p1, p2;
+    uintptr_t ctx;
+    uint32_t count = 0;
+    while (messagepump_pop (&id, &ctx, &p1, &p2) != -1) {
+        EXPECT_EQ(p1, count);
+        count++;
+    }
+    EXPECT_EQ(count, 10000);
+}
+
+TEST_F(MessagePumpTests, test_Push_IdenticalPlaylistChanges_Coalesced) {
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+    messagepump_push (DB_EV_SEEK, 0, 0, 0);
+    for (int i = 0; i < 1000; i++) {
+        messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+        messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_TITLE, 0);
+    }
+
+    uint32_t id, p1, p2;
+    uintptr_t ctx;
+    EXPECT_EQ(messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ(id, DB_EV_PLAYLISTCHANGED);
+    EXPECT_EQ(p1, DDB_PLAYLIST_CHANGE_CONTENT);
+    EXPECT_EQ(messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ(id, DB_EV_SEEK);
+    EXPECT_EQ(messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ(id, DB_EV_PLAYLISTCHANGED);
+    EXPECT_EQ(p1, DDB_PLAYLIST_CHANGE_TITLE);
+    EXPECT_EQ(messagepump_pop (&id, &ctx, &p1, &p2), -1);
+
+    // delivered messages don't suppress the new ones
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+    EXPECT_EQ(messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ(id, DB_EV_PLAYLISTCHANGED);
+}
+
+TEST_F(MessagePumpTests, test_PushFromManyThreads_AllMessagesDelivered) {
+    const int threadCount = 8;
+    const uint32_t messageCount = 20000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back ([t, messageCount] {
+            for (uint32_t i = 0; i < messageCount; i++) {
+                messagepump_push (DB_EV_SEEK, 0, t, i);
+            }
+        });
+    }
+
+    std::vector<uint32_t> next (threadCount, 0);
+    uint32_t total = 0;
+    while (total < threadCount * messageCount) {
+        uint32_t id, p1, p2;
+        uintptr_t ctx;
+        while (messagepump_pop (&id, &ctx, &p1, &p2) != -1) {
+            // the messages from each thread arrive in order
+            EXPECT_EQ(p2, next[p1]);
+            next[p1] = p2 + 1;
+            total++;
+        }
+        if (total < threadCount * messageCount) {
+            messagepump_wait ();
+        }
+    }
+
+    for (auto &thread : threads) {
+        thread.join ();
+    }
+    EXPECT_EQ(total, threadCount * messageCount);
+}
@@ -0,0 +1,101 @@
+//
+//  PluginManifestTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include "pluginmanifest.h"
+#include <deadbeef/common.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+class PluginManifestTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        snprintf (_path, sizeof (_path), "%s/plugins-manifest-test-%d", P_tmpdir, (int)getpid ());
+    }
+    void TearDown() override {
+        unlink (_path);
+    }
+
+    char _path[PATH_MAX];
+};
+
+TEST_F(PluginManifestTests, test_SaveLoad_PreservesLazyEntry) {
+    const char *exts[] = { "flac", "oga", NULL };
+    plugin_manifest_t *manifest = plugin_manifest_alloc ();
+    plugin_manifest_append (manifest, "/usr/lib/deadbeef/gtkui.so", 100, 2000, 0);
+    plugin_manifest_entry_t *entry = plugin_manifest_append (manifest, "/usr/lib/deadbeef/flac.so", 123, 4567, 1);
+    entry->type = 1;
+    entry->api_vmajor = 1;
+    entry->api_vminor = 18;
+    entry->version_major = 1;
+    entry->version_minor = 2;
+    entry->flags = 4;
+    entry->methods = PLUGIN_MANIFEST_HAS_OPEN | PLUGIN_MANIFEST_HAS_INSERT;
+    entry->id = strdup ("stdflac");
+    entry->name = strdup ("FLAC decoder");
+    entry->copyright = strdup ("Line 1\n\"Quoted\" \\ backslash\nLine 3");
+    entry->exts = plugin_manifest_copy_list (exts);
+
+    EXPECT_EQ(plugin_manifest_save (manifest, _path), 0);
+    plugin_manifest_free (manifest);
+
+    manifest = plugin_manifest_load (_path);
+    ASSERT_TRUE(manifest);
+
+    plugin_manifest_entry_t *gui = plugin_manifest_find (manifest, "/usr/lib/deadbeef/gtkui.so", 100, 2000);
+    ASSERT_TRUE(gui);
+    EXPECT_FALSE(gui->lazy);
+
+    entry = plugin_manifest_find (manifest, "/usr/lib/deadbeef/flac.so", 123, 4567);
+    ASSERT_TRUE(entry);
+    EXPECT_TRUE(entry->lazy);
+    EXPECT_EQ(entry->type, 1);
+    EXPECT_EQ(entry->api_vminor, 18);
+    EXPECT_EQ(entry->version_minor, 2);
+    EXPECT_EQ(entry->flags, 4);
+    EXPECT_EQ(entry->methods, PLUGIN_MANIFEST_HAS_OPEN | PLUGIN_MANIFEST_HAS_INSERT);
+    EXPECT_STREQ(entry->id, "stdflac");
+    EXPECT_STREQ(entry->name, "FLAC decoder");
+    EXPECT_STREQ(entry->copyright, "Line 1\n\"Quoted\" \\ backslash\nLine 3");
+    EXPECT_EQ(entry->descr, nullptr);
+    ASSERT_TRUE(entry->exts);
+    EXPECT_STREQ(entry->exts[0], "flac");
+    EXPECT_STREQ(entry->exts[1], "oga");
+    EXPECT_EQ(entry->exts[2], nullptr);
+    EXPECT_EQ(entry->prefixes, nullptr);
+
+    plugin_manifest_free (manifest);
+}
+
+TEST_F(PluginManifestTests, test_Find_ChangedFile_ReturnsNull) {
+    plugin_manifest_t *manifest = plugin_manifest_alloc ();
+    plugin_manifest_append (manifest, "/usr/lib/deadbeef/flac.so", 123, 4567, 0);
+
+    EXPECT_TRUE(plugin_manifest_find (manifest, "/usr/lib/deadbeef/flac.so", 123, 4567));
+    EXPECT_FALSE(plugin_manifest_find (manifest, "/usr/lib/deadbeef/flac.so", 124, 4567));
+    EXPECT_FALSE(plugin_manifest_find (manifest, "/usr/lib/deadbeef/flac.so", 123, 4568));
+    EXPECT_FALSE(plugin_manifest_find (manifest, "/usr/lib/deadbeef/mp3.so", 123, 4567));
+
+    plugin_manifest_free (manifest);
+}
+
+TEST_F(PluginManifestTests, test_Load_TruncatedFile_ReturnsNull) {
+    FILE *fp = fopen (_path, "wb");
+    ASSERT_TRUE(fp);
+    fputs ("version 1\nplugin \"/usr/lib/deadbeef/flac.so\"\nstat 1 2\n", fp);
+    fclose (fp);
+
+    EXPECT_FALSE(plugin_manifest_load (_path));
+}
+
+TEST_F(PluginManifestTests, test_Load_WrongVersion_ReturnsNull) {
+    FILE *fp = fopen (_path, "wb");
+    ASSERT_TRUE(fp);
+    fputs ("version 1000\n", fp);
+    fclose (fp);
+
+    EXPECT_FALSE(plugin_manifest_load (_path));
+}
@@ -400,6 +400,39 @@ TEST_F(TaggingTests, test_ShortMP3WithApev2AndId3v1_TailIs186Bytes) {
     EXPECT_TRUE(tail == 186);
 }
 
+TEST_F(TaggingTests, test_ReadTagsShortMP3WithApev2AndId3v1_TailIs186BytesAndBothTagsRead) {
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData/tone1sec_id3v1_apev2.mp3", dbplugindir);
+    DB_FILE *fp = vfs_fopen (path);
+    uint32_t head, tail;
+    int res = junk_read_tags (it, fp, &head, &tail);
+    vfs_fclose (fp);
+    EXPECT_EQ(res, 0);
+    EXPECT_EQ(head, 0);
+    EXPECT_EQ(tail, 186);
+    uint32_t flags = pl_get_item_flags (it);
+    EXPECT_TRUE(flags & DDB_TAG_APEV2);
+    EXPECT_TRUE(flags & DDB_TAG_ID3V1);
+}
+
+TEST_F(TaggingTests, test_ReadTagsID3v23MultiValueTPE1_SameAsID3v2Read) {
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData/tpe1_multivalue_id3v2.3.mp3", dbplugindir);
+    DB_FILE *fp = vfs_fopen (path);
+    uint32_t head, tail;
+    junk_read_tags (it, fp, &head, &tail);
+    vfs_fclose (fp);
+
+    EXPECT_EQ(head, 2121);
+    EXPECT_EQ(tail, 0);
+    EXPECT_TRUE(pl_get_item_flags (it) & DDB_TAG_ID3V23);
+
+    DB_metaInfo_t *meta = pl_meta_for_key (it, "artist");
+    EXPECT_TRUE(meta);
+    const char refdata[] = "Value1\0Value2\0Value3\0";
+    EXPECT_TRUE(sizeof (refdata)-1 == meta->valuesize && !memcmp (meta->value, refdata, meta->valuesize));
+}
+
 TEST_F(TaggingTests, test_ShortMP3WithId3v1_ScansCorrectSize) {
     playlist_t *plt = plt_alloc("test");
 
@@ -6,9 +6,21 @@
 //  Copyright © 2019 Oleksiy Yakovenko. All rights reserved.
 //
 
+#include <deadbeef/common.h>
 #include "../plugins/vfs_curl/vfs_curl.h"
 #include "messagepump.h"
 #include "plmeta.h"
+#include <arpa/inet.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 
 extern "C" DB_functions_t *deadbeef;
@@ -99,3 +111,424 @@ TEST_F(VfsCurlTests, test_HandleIcyHeaders_IcyHeaderAndTitleMetaSeparatePackets_
     EXPECT_NE (title, nullptr);
     EXPECT_EQ (strcmp (title, "Title"), 0);
 }
+
+#pragma mark - Local HTTP server
+
+// Minimal HTTP/1.1 server on 127.0.0.1, serving one buffer with optional Range support
+class LocalHttpServer {
+public:
+    LocalHttpServer (const std::string &body, bool supportsRanges = true) : _body(body), _supportsRanges(supportsRanges) {
+        _socket = socket (AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind (_socket, (struct sockaddr *)&addr, sizeof (addr));
+        socklen_t len = sizeof (addr);
+        getsockname (_socket, (struct sockaddr *)&addr, &len);
+        _port = ntohs (addr.sin_port);
+        listen (_socket, 16);
+        _acceptThread = std::thread ([this] { acceptLoop (); });
+    }
+
+    ~LocalHttpServer () {
+        shutdown (_socket, SHUT_RDWR);
+        close (_socket);
+        _acceptThread.join ();
+        {
+            // the client may keep idle connections open
+            std::lock_guard<std::mutex> lock (_connectionsMutex);
+            for (int s : _connections) {
+                shutdown (s, SHUT_RDWR);
+            }
+        }
+        for (auto &t : _connectionThreads) {
+            t.join ();
+        }
+    }
+
+    std::string url () const {
+        return "http://127.0.0.1:" + std::to_string (_port) + "/data.bin";
+    }
+
+    int requestCount () const {
+        return _requestCount;
+    }
+
+    // Replaces the served data, changing the ETag unless keepETag is set
+    void setBody (const std::string &body, bool keepETag = false) {
+        std::lock_guard<std::mutex> lock (_bodyMutex);
+        _body = body;
+        if (!keepETag) {
+            _version++;
+        }
+    }
+
+private:
+    void acceptLoop () {
+        for (;;) {
+            int s = accept (_socket, NULL, NULL);
+            if (s < 0) {
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock (_connectionsMutex);
+                _connections.push_back (s);
+            }
+            _connectionThreads.emplace_back ([this, s] { serve (s); });
+        }
+    }
+
+    void serve (int s) {
+        std::string request;
+        char buffer[1024];
+        for (;;) {
+            size_t end = request.find ("\r\n\r\n");
+            if (end == std::string::npos) {
+                ssize_t rb = recv (s, buffer, sizeof (buffer), 0);
+                if (rb <= 0) {
+                    break;
+                }
+                request.append (buffer, rb);
+                continue;
+            }
+
+            std::string head = request.substr (0, end);
+            request.erase (0, end + 4);
+            _requestCount++;
+
+            std::string body;
+            int version;
+            {
+                std::lock_guard<std::mutex> lock (_bodyMutex);
+                body = _body;
+                version = _version;
+            }
+
+            size_t from = 0;
+            size_t range = _supportsRanges ? head.find ("Range: bytes=") : std::string::npos;
+            if (range != std::string::npos) {
+                from = strtoull (head.c_str () + range + 13, NULL, 10);
+                if (from > body.size ()) {
+                    from = body.size ();
+                }
+            }
+
+            std::string response = range != std::string::npos ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+            response += "Content-Type: application/octet-stream\r\n";
+            if (_supportsRanges) {
+                response += "Accept-Ranges: bytes\r\n";
+                response += "ETag: \"" + std::to_string (version) + "\"\r\n";
+            }
+            response += "Content-Length: " + std::to_string (body.size () - from) + "\r\n";
+            if (range != std::string::npos) {
+                response += "Content-Range: bytes " + std::to_string (from) + "-" + std::to_string (body.size () - 1) + "/" + std::to_string (body.size ()) + "\r\n";
+            }
+            response += "\r\n";
+            response.append (body, from, std::string::npos);
+
+            if (!sendAll (s, response)) {
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lock (_connectionsMutex);
+        _connections.erase (std::find (_connections.begin (), _connections.end (), s));
+        close (s);
+    }
+
+    static bool sendAll (int s, const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size ()) {
+#ifdef MSG_NOSIGNAL
+            ssize_t rb = send (s, data.data () + sent, data.size () - sent, MSG_NOSIGNAL);
+#else
+            ssize_t rb = send (s, data.data () + sent, data.size () - sent, 0);
+#endif
+            if (rb <= 0) {
+                return false;
+            }
+            sent += rb;
+        }
+        return true;
+    }
+
+    std::string _body;
+    int _version = 1;
+    std::mutex _bodyMutex;
+    bool _supportsRanges;
+    std::atomic<int> _requestCount {0};
+    int _socket;
+    int _port;
+    std::thread _acceptThread;
+    std::vector<std::thread> _connectionThreads;
+    std::mutex _connectionsMutex;
+    std::vector<int> _connections;
+};
+
+class VfsCurlServerTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        signal (SIGPIPE, SIG_IGN);
+        messagepump_init();
+        // keep the tests independent of the persistent cache
+        deadbeef->conf_set_int ("vfs_curl.disk_cache", 0);
+        _vfs = (DB_vfs_t *)vfs_curl_load (deadbeef);
+        _vfs->plugin.start ();
+
+        // larger than the stream buffer, to exercise pause/resume
+        _data.resize (3 * 1024 * 1024);
+        for (size_t i = 0; i < _data.size (); i++) {
+            _data[i] = (char)((i * 2654435761u) >> 13);
+        }
+        _server = new LocalHttpServer (_data);
+    }
+    void TearDown() override {
+        _vfs->plugin.stop ();
+        deadbeef->conf_set_int ("vfs_curl.disk_cache", 0);
+        delete _server;
+        uint32_t msg;
+        uintptr_t ctx;
+        uint32_t p1;
+        uint32_t p2;
+        while (messagepump_pop(&msg, &ctx, &p1, &p2) != -1) {
+            if (msg >= DB_EV_FIRST && ctx) {
+                messagepump_event_free ((ddb_event_t *)ctx);
+            }
+        }
+        messagepump_free();
+    }
+
+    // Simulates the next session, which only has the disk cache
+    void restartPlugin () {
+        _vfs->plugin.stop ();
+        _vfs->plugin.start ();
+    }
+
+    bool readExpected (DB_FILE *fp, size_t offset, size_t size) {
+        std::string buffer (size, 0);
+        size_t rb = 0;
+        while (rb < size) {
+            size_t n = _vfs->read (&buffer[rb], 1, size - rb, fp);
+            if (n == 0) {
+                break;
+            }
+            rb += n;
+        }
+        return rb == size && !memcmp (buffer.data (), _data.data () + offset, size);
+    }
+
+    DB_vfs_t *_vfs;
+    std::string _data;
+    LocalHttpServer *_server;
+};
+
+TEST_F(VfsCurlServerTests, test_SequentialRead_ReturnsServedData) {
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+
+    EXPECT_EQ(_vfs->getlength (fp), (int64_t)_data.size ());
+    EXPECT_TRUE(readExpected (fp, 0, _data.size ()));
+
+    char byte;
+    EXPECT_EQ(_vfs->read (&byte, 1, 1, fp), 0);
+
+    _vfs->close (fp);
+}
+
+TEST_F(VfsCurlServerTests, test_SeekForwardAndBack_ReadsFromNewPosition) {
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+
+    EXPECT_TRUE(readExpected (fp, 0, 1000));
+
+    EXPECT_EQ(_vfs->seek (fp, 2000000, SEEK_SET), 0);
+    EXPECT_EQ(_vfs->tell (fp), 2000000);
+    EXPECT_TRUE(readExpected (fp, 2000000, 50000));
+
+    EXPECT_EQ(_vfs->seek (fp, 100, SEEK_SET), 0);
+    EXPECT_TRUE(readExpected (fp, 100, 50000));
+
+    _vfs->close (fp);
+}
+
+TEST_F(VfsCurlServerTests, test_ConcurrentStreams_ShareIoThread) {
+    const int count = 4;
+    DB_FILE *files[count];
+    for (int i = 0; i < count; i++) {
+        files[i] = _vfs->open (_server->url ().c_str ());
+        ASSERT_TRUE(files[i]);
+    }
+
+    // interleave reads so that all transfers are active at the same time
+    for (size_t offset = 0; offset < _data.size (); offset += 65536) {
+        size_t size = std::min ((size_t)65536, _data.size () - offset);
+        for (int i = 0; i < count; i++) {
+            EXPECT_TRUE(readExpected (files[i], offset, size));
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        _vfs->close (files[i]);
+    }
+}
+
+TEST_F(VfsCurlServerTests, test_ClosePausedStream_DoesNotBlock) {
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+
+    EXPECT_TRUE(readExpected (fp, 0, 100));
+    // let the transfer fill the buffer and pause
+    usleep (200000);
+
+    _vfs->close (fp);
+}
+
+TEST_F(VfsCurlServerTests, test_SeekBackInStream_DoesNotStallOtherStreams) {
+    LocalHttpServer server (_data, false);
+    DB_FILE *stream = _vfs->open (server.url ().c_str ());
+    ASSERT_TRUE(stream);
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+
+    // reading resumes the stream, seeking back right after that may fill its buffer above the limit
+    size_t offset = 0;
+    for (size_t pos = 0; pos + 65536 <= _data.size (); pos += 65536) {
+        EXPECT_TRUE(readExpected (stream, offset, 35000));
+        EXPECT_EQ(_vfs->seek (stream, offset + 5000, SEEK_SET), 0);
+        offset += 5000;
+        EXPECT_TRUE(readExpected (fp, pos, 65536));
+    }
+
+    _vfs->close (fp);
+    _vfs->close (stream);
+}
+
+#pragma mark - Block cache
+
+TEST_F(VfsCurlServerTests, test_SeekBackIntoFetchedData_NoNewRequest) {
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+
+    EXPECT_TRUE(readExpected (fp, 0, 1000000));
+    int requests = _server->requestCount ();
+
+    EXPECT_EQ(_vfs->seek (fp, 1000, SEEK_SET), 0);
+    EXPECT_TRUE(readExpected (fp, 1000, 500000));
+    EXPECT_EQ(_server->requestCount (), requests);
+
+    _vfs->close (fp);
+}
+
+TEST_F(VfsCurlServerTests, test_SeekFromEnd_ReadsTail) {
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+
+    EXPECT_EQ(_vfs->seek (fp, -128, SEEK_END), 0);
+    EXPECT_EQ(_vfs->tell (fp), (int64_t)_data.size () - 128);
+    EXPECT_TRUE(readExpected (fp, _data.size () - 128, 128));
+
+    _vfs->close (fp);
+}
+
+TEST_F(VfsCurlServerTests, test_ReopenCachedFile_NoNetwork) {
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+    EXPECT_TRUE(readExpected (fp, 0, _data.size ()));
+    _vfs->close (fp);
+
+    int requests = _server->requestCount ();
+
+    fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+    EXPECT_EQ(_vfs->getlength (fp), (int64_t)_data.size ());
+    EXPECT_STREQ(_vfs->get_content_type (fp), "application/octet-stream");
+    EXPECT_EQ(_vfs->seek (fp, 2000000, SEEK_SET), 0);
+    EXPECT_TRUE(readExpected (fp, 2000000, 100000));
+    _vfs->rewind (fp);
+    EXPECT_TRUE(readExpected (fp, 0, _data.size ()));
+    _vfs->close (fp);
+
+    EXPECT_EQ(_server->requestCount (), requests);
+}
+
+TEST_F(VfsCurlServerTests, test_ServerWithoutRanges_ReadsSequentially) {
+    LocalHttpServer server (_data, false);
+    DB_FILE *fp = _vfs->open (server.url ().c_str ());
+    ASSERT_TRUE(fp);
+
+    EXPECT_TRUE(readExpected (fp, 0, _data.size ()));
+    EXPECT_EQ(_vfs->seek (fp, -128, SEEK_END), -1);
+
+    _vfs->close (fp);
+}
+
+class VfsCurlDiskCacheTests: public VfsCurlServerTests {
+protected:
+    void SetUp() override {
+        strcpy (_savedCacheDir, dbcachedir);
+        char tmpl[] = "/tmp/ddb_vfs_curl_XXXXXX";
+        ASSERT_NE(mkdtemp (tmpl), nullptr);
+        _dir = tmpl;
+        snprintf (dbcachedir, sizeof (dbcachedir), "%s/cache", _dir.c_str ());
+        VfsCurlServerTests::SetUp ();
+        deadbeef->conf_set_int ("vfs_curl.disk_cache", 1);
+        restartPlugin ();
+    }
+    void TearDown() override {
+        VfsCurlServerTests::TearDown ();
+        std::string cmd = "rm -rf " + _dir;
+        (void)system (cmd.c_str ());
+        strcpy (dbcachedir, _savedCacheDir);
+    }
+
+    bool readAll (DB_FILE *fp) {
+        return readExpected (fp, 0, _data.size ());
+    }
+
+    std::string changedData () const {
+        std::string data = _data;
+        for (size_t i = 0; i < data.size (); i++) {
+            data[i] ^= 0x5a;
+        }
+        return data;
+    }
+
+    char _savedCacheDir[PATH_MAX];
+    std::string _dir;
+};
+
+TEST_F(VfsCurlDiskCacheTests, test_ReopenAfterRestart_SameETag_ReadsFromDisk) {
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+    EXPECT_TRUE(readAll (fp));
+    _vfs->close (fp);
+
+    restartPlugin ();
+    // the cache can only tell the files apart by length and ETag
+    _server->setBody (changedData (), true);
+    int requests = _server->requestCount ();
+
+    fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+    EXPECT_TRUE(readAll (fp));
+    _vfs->close (fp);
+
+    // the first response confirms the ETag, the data comes from disk
+    EXPECT_EQ(_server->requestCount (), requests + 1);
+}
+
+TEST_F(VfsCurlDiskCacheTests, test_ReopenAfterRestart_RemoteFileChanged_ReadsNewData) {
+    DB_FILE *fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+    EXPECT_TRUE(readAll (fp));
+    _vfs->close (fp);
+
+    restartPlugin ();
+    _data = changedData ();
+    _server->setBody (_data);
+
+    fp = _vfs->open (_server->url ().c_str ());
+    ASSERT_TRUE(fp);
+    EXPECT_TRUE(readAll (fp));
+    _vfs->close (fp);
+}
@@ -0,0 +1,187 @@
+//
+//  VfsStdioTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include "conf.h"
+#include "logger.h"
+#include "playlist.h"
+#include "plugins.h"
+#include "vfs.h"
+#include <deadbeef/common.h>
+#include <chrono>
+#include <gtest/gtest.h>
+
+class VfsStdioTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        ddb_logger_init ();
+        conf_init ();
+        conf_enable_saving (0);
+    }
+    void TearDown() override {
+        setMmapEnabled (0);
+        conf_free();
+        ddb_logger_free();
+    }
+
+    void setMmapEnabled (int enabled) {
+        conf_set_int ("vfs_stdio.mmap", enabled);
+        DB_plugin_t *stdio = plug_get_for_id ("vfs_stdio");
+        ASSERT_TRUE(stdio);
+        stdio->message (DB_EV_CONFIGCHANGED, 0, 0, 0);
+    }
+
+    // Reads the file the way the tag readers do: head, tail, then everything sequentially
+    std::string readWithProbePattern (const char *path) {
+        DB_FILE *fp = vfs_fopen (path);
+        EXPECT_TRUE(fp);
+        if (!fp) {
+            return "";
+        }
+
+        std::string result;
+        char buffer[5000];
+
+        size_t rb = vfs_fread (buffer, 1, 10, fp);
+        result.append (buffer, rb);
+
+        if (!vfs_fseek (fp, -128, SEEK_END)) {
+            rb = vfs_fread (buffer, 1, 128, fp);
+            result.append (buffer, rb);
+        }
+        if (!vfs_fseek (fp, -32, SEEK_END)) {
+            rb = vfs_fread (buffer, 1, 32, fp);
+            result.append (buffer, rb);
+        }
+
+        result.append (std::to_string (vfs_fgetlength (fp)));
+
+        vfs_rewind (fp);
+        for (size_t size = 1; ; size = size * 3 % sizeof (buffer) + 1) {
+            rb = vfs_fread (buffer, 1, size, fp);
+            result.append (buffer, rb);
+            if (rb != size) {
+                break;
+            }
+        }
+        result.append (std::to_string (vfs_ftell (fp)));
+
+        vfs_fclose (fp);
+        return result;
+    }
+
+#ifdef __linux__
+    // Number of read syscalls (read, pread, readv, ...) issued by the process so far
+    static int64_t readSyscallCount (void) {
+        FILE *fp = fopen ("/proc/self/io", "rt");
+        if (!fp) {
+            return -1;
+        }
+        char line[100];
+        int64_t count = -1;
+        while (fgets (line, sizeof (line), fp)) {
+            long long value;
+            if (sscanf (line, "syscr: %lld", &value) == 1) {
+                count = value;
+                break;
+            }
+        }
+        fclose (fp);
+        return count;
+    }
+#endif
+};
+
+TEST_F(VfsStdioTests, test_ReadWithProbePattern_MmapAndBufferedGiveSameData) {
+    const char *files[] = {
+        "chirp-1sec.mp3",
+        "comm_id3v2.3.mp3",
+        "tone1sec_id3v1_apev2.mp3",
+        "opus.mp4",
+        "empty.mp3",
+    };
+
+    for (size_t i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+        char path[PATH_MAX];
+        snprintf (path, sizeof (path), "%s/TestData/%s", dbplugindir, files[i]);
+
+        setMmapEnabled (0);
+        std::string buffered = readWithProbePattern (path);
+        setMmapEnabled (1);
+        std::string mapped = readWithProbePattern (path);
+
+        EXPECT_FALSE(buffered.empty());
+        EXPECT_EQ(buffered, mapped) << files[i];
+    }
+}
+
+TEST_F(VfsStdioTests, test_SeekBeforeStart_Fails) {
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData/chirp-1sec.mp3", dbplugindir);
+    DB_FILE *fp = vfs_fopen (path);
+    ASSERT_TRUE(fp);
+
+    EXPECT_EQ(vfs_fseek (fp, 100, SEEK_SET), 0);
+    EXPECT_NE(vfs_fseek (fp, -101, SEEK_CUR), 0);
+    EXPECT_EQ(vfs_ftell (fp), 100);
+
+    vfs_fclose (fp);
+}
+
+TEST_F(VfsStdioTests, test_ReadPastEnd_ReturnsZero) {
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData/chirp-1sec.mp3", dbplugindir);
+    DB_FILE *fp = vfs_fopen (path);
+    ASSERT_TRUE(fp);
+
+    char buffer[10];
+    EXPECT_EQ(vfs_fseek (fp, 10, SEEK_END), 0);
+    EXPECT_EQ(vfs_fread (buffer, 1, sizeof (buffer), fp), 0);
+
+    vfs_fclose (fp);
+}
+
+// Benchmark: the read syscalls and time spent importing the test data folder, with the buffered and the mmap reader.
+// Disabled by default, run with --gtest_also_run_disabled_tests --gtest_filter=*Benchmark
+TEST_F(VfsStdioTests, DISABLED_test_ImportDirectory_Benchmark) {
+#ifndef __linux__
+    GTEST_SKIP() << "/proc/self/io is not available";
+#else
+    if (readSyscallCount () < 0) {
+        GTEST_SKIP() << "/proc/self/io is not available";
+    }
+
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData", dbplugindir);
+
+    int64_t syscalls[2];
+    int count[2];
+
+    for (int mmap_enabled = 0; mmap_enabled < 2; mmap_enabled++) {
+        setMmapEnabled (mmap_enabled);
+        playlist_t *plt = plt_alloc ("test");
+
+        auto start = std::chrono::steady_clock::now ();
+        int64_t before = readSyscallCount ();
+        plt_insert_dir2 (0, plt, NULL, path, NULL, NULL, NULL);
+        syscalls[mmap_enabled] = readSyscallCount () - before;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now () - start).count ();
+
+        count[mmap_enabled] = plt_get_item_count (plt, PL_MAIN);
+        printf ("vfs_stdio %s: %d tracks, %lld read syscalls, %lld us\n",
+                mmap_enabled ? "mmap" : "buffered",
+                count[mmap_enabled],
+                (long long)syscalls[mmap_enabled],
+                (long long)elapsed);
+
+        plt_free (plt);
+    }
+
+    EXPECT_GT(count[0], 0);
+    EXPECT_EQ(count[0], count[1]);
+    EXPECT_LT(syscalls[1], syscalls[0]);
+#endif
+}
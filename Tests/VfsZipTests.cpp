@@ -0,0 +1,165 @@
+//
+//  VfsZipTests.cpp
+//  Tests
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include <deadbeef/deadbeef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zip.h>
+#include <gtest/gtest.h>
+
+extern "C" DB_functions_t *deadbeef;
+extern "C" DB_plugin_t *vfs_zip_load (DB_functions_t *api);
+
+class VfsZipTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        _vfs = (DB_vfs_t *)vfs_zip_load (deadbeef);
+        _vfs->plugin.start ();
+
+        char tmpl[] = "/tmp/ddb_vfs_zip_XXXXXX";
+        ASSERT_NE(mkdtemp (tmpl), nullptr);
+        _dir = tmpl;
+        _zipPath = _dir + "/test.zip";
+        _url = "zip://" + _zipPath + ":data.bin";
+
+        // compressible, but not too much, so that the seek index gets a few checkpoints (one per 1MB)
+        _data.resize (5 * 1024 * 1024 + 12345);
+        uint32_t seed = 1;
+        for (size_t i = 0; i < _data.size (); i++) {
+            seed = seed * 1103515245 + 12345;
+            _data[i] = "abcdefgh"[(seed >> 16) & 7];
+        }
+
+        int error = 0;
+        struct zip *z = zip_open (_zipPath.c_str (), ZIP_CREATE|ZIP_TRUNCATE, &error);
+        ASSERT_TRUE(z);
+        struct zip_source *source = zip_source_buffer (z, _data.data (), _data.size (), 0);
+        ASSERT_TRUE(source);
+        zip_int64_t index = zip_file_add (z, "data.bin", source, ZIP_FL_OVERWRITE);
+        ASSERT_GE(index, 0);
+        EXPECT_EQ(zip_set_file_compression (z, index, ZIP_CM_DEFLATE, 0), 0);
+        ASSERT_EQ(zip_close (z), 0);
+    }
+    void TearDown() override {
+        _vfs->plugin.stop ();
+        std::string cmd = "rm -rf " + _dir;
+        (void)system (cmd.c_str ());
+    }
+
+    bool readExpected (DB_FILE *fp, size_t offset, size_t size) {
+        std::string buffer (size, 0);
+        size_t rb = 0;
+        while (rb < size) {
+            size_t n = _vfs->read (&buffer[rb], 1, size - rb, fp);
+            if (n == 0) {
+                break;
+            }
+            rb += n;
+        }
+        return rb == size && !memcmp (buffer.data (), _data.data () + offset, size);
+    }
+
+    bool seekAndReadExpected (DB_FILE *fp, size_t offset) {
+        size_t size = std::min ((size_t)65536, _data.size () - offset);
+        return _vfs->seek (fp, offset, SEEK_SET) == 0
+            && _vfs->tell (fp) == (int64_t)offset
+            && readExpected (fp, offset, size);
+    }
+
+    DB_vfs_t *_vfs;
+    std::string _dir;
+    std::string _zipPath;
+    std::string _url;
+    std::string _data;
+};
+
+TEST_F(VfsZipTests, test_SequentialRead_ReturnsStoredData) {
+    DB_FILE *fp = _vfs->open (_url.c_str ());
+    ASSERT_TRUE(fp);
+
+    EXPECT_EQ(_vfs->getlength (fp), (int64_t)_data.size ());
+    EXPECT_TRUE(readExpected (fp, 0, _data.size ()));
+
+    char byte;
+    EXPECT_EQ(_vfs->read (&byte, 1, 1, fp), 0);
+
+    _vfs->close (fp);
+}
+
+TEST_F(VfsZipTests, test_SeekAfterSequentialRead_MatchesSequentialData) {
+    DB_FILE *fp = _vfs->open (_url.c_str ());
+    ASSERT_TRUE(fp);
+
+    // the sequential pass builds the seek index
+    EXPECT_TRUE(readExpected (fp, 0, _data.size ()));
+
+    // seek backwards and forwards, before the first checkpoint and between the later ones
+    const size_t positions[] = { _data.size () / 2, 100, _data.size () - 5000, 3 * 1024 * 1024 + 7, 1024 * 1024 - 1, 1024 * 1024, 4 * 1024 * 1024 + 1, 0 };
+    for (size_t offset : positions) {
+        EXPECT_TRUE(seekAndReadExpected (fp, offset)) << offset;
+    }
+
+    _vfs->close (fp);
+}
+
+TEST_F(VfsZipTests, test_SeekInAnotherFile_UsesSharedIndex) {
+    DB_FILE *fp = _vfs->open (_url.c_str ());
+    ASSERT_TRUE(fp);
+    EXPECT_TRUE(readExpected (fp, 0, _data.size ()));
+
+    DB_FILE *fp2 = _vfs->open (_url.c_str ());
+    ASSERT_TRUE(fp2);
+    const size_t positions[] = { _data.size () - 1000, 2 * 1024 * 1024 + 300000, 12345 };
+    for (size_t offset : positions) {
+        EXPECT_TRUE(seekAndReadExpected (fp2, offset)) << offset;
+    }
+
+    _vfs->close (fp2);
+    _vfs->close (fp);
+}
+
+TEST_F(VfsZipTests, test_SeekBeforeIndexBuilt_MatchesSequentialData) {
+    DB_FILE *fp = _vfs->open (_url.c_str ());
+    ASSERT_TRUE(fp);
+
+    const size_t positions[] = { 3 * 1024 * 1024 + 100, 1024 * 1024 + 5, 4 * 1024 * 1024, 10 };
+    for (size_t offset : positions) {
+        EXPECT_TRUE(seekAndReadExpected (fp, offset)) << offset;
+    }
+
+    _vfs->close (fp);
+}
+
+TEST_F(VfsZipTests, test_OpenFromSeveralThreads_AllFilesReadCorrectly) {
+    const int count = 8;
+    std::atomic<int> failures (0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < count; i++) {
+        threads.emplace_back ([this, i, &failures] {
+            DB_FILE *fp = _vfs->open (_url.c_str ());
+            if (!fp) {
+                failures++;
+                return;
+            }
+            size_t offset = (_data.size () / count) * i;
+            if (!seekAndReadExpected (fp, offset) || !seekAndReadExpected (fp, offset / 2)) {
+                failures++;
+            }
+            _vfs->close (fp);
+        });
+    }
+    for (auto &t : threads) {
+        t.join ();
+    }
+    EXPECT_EQ(failures, 0);
+}
@@ -1783,6 +1783,38 @@ typedef struct {
     /// The deinit func will be called before unloading a plugin,
     /// and the caller will wait until completion block is performed.
     void (*plug_register_for_async_deinit) (DB_plugin_t *plugin, void (*deinit_func)(void (*completion_callback)(DB_plugin_t *plugin)));
+
+    /// Subscribe to changes of config keys starting with the prefix.
+    /// The callback is called on a background queue, with the key which has changed.
+    /// This can be used instead of handling every DB_EV_CONFIGCHANGED.
+    /// @return subscription ID
+    intptr_t (*conf_subscribe) (const char *prefix, void (*callback) (const char *key, void *user_data), void *user_data);
+
+    /// Remove a subscription created by conf_subscribe.
+    /// When called outside of the callback, waits for the callbacks which are in progress.
+    void (*conf_unsubscribe) (intptr_t subscription);
+
+    /// Interleave separate channels into the output buffer, in the format described by @c fmt.
+    /// This is intended for decoders which get planar data from the codec library, and is vectorized for common cases.
+    /// @param fmt Output format: 8, 16, 24 or 32 bit integer, or 32 bit float.
+    /// @param input Array of @c fmt->channels pointers to the first sample of each channel.
+    /// The channels can be remapped by reordering the pointers.
+    /// For integer formats, the samples are @c int32_t with the value in the low bits, otherwise @c float.
+    /// @param stride Distance between consecutive samples of a channel: 1 for planar data,
+    /// or the number of channels, when remapping an interleaved buffer.
+    /// @param shift Number of bits to shift integer samples left by, e.g. to output 20 bit samples as 24 bit.
+    /// @param output The output buffer, which must not overlap the input.
+    /// @param nframes Number of samples per channel.
+    /// @return number of bytes written, or -1 if the format is not supported
+    int (*pcm_interleave) (const ddb_waveformat_t *fmt, const void * const *input, int stride, int shift, char *output, int nframes);
+
+    /// Read the APEv2, ID3v2 and ID3v1 tags into the track, in this order of priority,
+    /// which is the same as calling junk_apev2_read, junk_id3v2_read and junk_id3v1_read.
+    /// The head and the tail of the file are read once, instead of seeking to each tag separately.
+    /// @param head, tail Receive the sizes of the tags at the beginning and end of the file,
+    /// same as junk_get_tag_offsets. Can be NULL.
+    /// @return 0 if any tag was found, -1 otherwise
+    int (*junk_read_tags) (DB_playItem_t *it, DB_FILE *fp, uint32_t *head, uint32_t *tail);
 #endif
 } DB_functions_t;
 
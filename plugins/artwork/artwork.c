@@ -58,6 +58,7 @@
 #include "artwork_internal.h"
 #include "cache.h"
 #include "coverinfo.h"
+#include "dircache.h"
 #include "lastfm.h"
 #include "musicbrainz.h"
 #include "mp4tagutil.h"
@@ -392,6 +393,19 @@ local_image_file (const char *local_path, const char *uri, DB_vfs_t *vfsplug, dd
         return -1;
     }
 
+    // All tracks in the same folder share the scan result
+    const char *cache_key = uri ? uri : local_path;
+    char *cached_image_filename = NULL;
+    if (!dir_cache_find (cache_key, &cached_image_filename)) {
+        if (cached_image_filename == NULL) {
+            trace ("No cover art files in local folder (cached)\n");
+            return -1;
+        }
+        trace ("found cover %s in folder cache\n", cached_image_filename);
+        cover->image_filename = cached_image_filename;
+        return 0;
+    }
+
     char *p;
 
     char *folders = strdup (artwork_folders);
@@ -400,6 +414,12 @@ local_image_file (const char *local_path, const char *uri, DB_vfs_t *vfsplug, dd
         *p = '\0';
     }
 
+    // Folders which were scanned, to validate the cached result.
+    // Inside VFS containers, only the container file itself can be checked.
+    int scanned_count = 0;
+    char **scanned_dirs = calloc (strlen (artwork_folders) + 2, sizeof (char *));
+
+    int res = -1;
     int root = 1;
     char *folder = folders;
     while (folder < folders_end) {
@@ -412,18 +432,30 @@ local_image_file (const char *local_path, const char *uri, DB_vfs_t *vfsplug, dd
             path = get_case_insensitive_path (local_path, folder, vfsplug);
             folder += strlen (folder) + 1;
         }
+        if (path && (!uri || scanned_count == 0)) {
+            scanned_dirs[scanned_count++] = strdup (path);
+        }
         trace ("scanning %s for artwork\n", path);
         if (path && !scan_local_path (path, uri, vfsplug, cover)) {
-            free (folders);
             free (path);
-            return 0;
+            res = 0;
+            break;
         }
         free (path);
     }
 
-    trace ("No cover art files in local folder\n");
+    if (res != 0) {
+        trace ("No cover art files in local folder\n");
+    }
+
+    dir_cache_store (cache_key, (const char **)scanned_dirs, scanned_count, res == 0 ? cover->image_filename : NULL);
+
+    for (int i = 0; i < scanned_count; i++) {
+        free (scanned_dirs[i]);
+    }
+    free (scanned_dirs);
     free (folders);
-    return -1;
+    return res;
 }
 
 static const uint8_t *
@@ -1618,6 +1650,39 @@ artwork_cancel_queries_with_source_id (int64_t source_id) {
     });
 }
 
+static int
+artwork_thumbnail_size_for_size (int size) {
+    return thumbnail_size_for_size (size);
+}
+
+static int
+artwork_thumbnail_path (const char *image_filename, int thumbnail_size, char *path, size_t path_size) {
+    if (thumbnail_size <= 0 || make_thumbnail_path (image_filename, thumbnail_size, path, path_size)) {
+        return -1;
+    }
+
+    struct stat stat_struct;
+    if (stat (path, &stat_struct) || !S_ISREG (stat_struct.st_mode) || stat_struct.st_size == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+artwork_thumbnail_store (const char *image_filename, int thumbnail_size, const char *data, size_t data_size) {
+    if (data == NULL || data_size == 0) {
+        return -1;
+    }
+
+    char path[PATH_MAX];
+    if (thumbnail_size <= 0 || make_thumbnail_path (image_filename, thumbnail_size, path, sizeof (path))) {
+        return -1;
+    }
+
+    trace ("artwork: storing %dpx thumbnail for %s\n", thumbnail_size, image_filename);
+    return write_file (path, data, data_size);
+}
+
 static void
 _get_fetcher_preferences (void) {
     deadbeef->conf_lock ();
@@ -1769,6 +1834,7 @@ artwork_configchanged (void) {
         free (old_artwork_folders);
     });
     if (need_clear_queue) {
+        dir_cache_clear ();
         queue_clear ();
         _notify_listeners (DDB_ARTWORK_SETTINGS_DID_CHANGE, NULL);
     }
@@ -1784,6 +1850,18 @@ artwork_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
     return 0;
 }
 
+// Forget the local folder scan results for the folder (or VFS container) of the track
+static void
+_dir_cache_remove_for_path (const char *filepath) {
+    char *fname_copy = strdup (filepath);
+    char *vfs_fname = vfs_path (fname_copy);
+    if (vfs_fname) {
+        dir_cache_remove (fname_copy);
+    }
+    dir_cache_remove (dirname (vfs_fname ? vfs_fname : fname_copy));
+    free (fname_copy);
+}
+
 static int
 invalidate_playitem_cache (DB_plugin_action_t *action, ddb_action_context_t ctx) {
     ddb_playlist_t *plt = deadbeef->action_get_playlist ();
@@ -1810,6 +1888,8 @@ invalidate_playitem_cache (DB_plugin_action_t *action, ddb_action_context_t ctx)
                     (void)unlink (cover->priv->track_cache_path);
                 }
 
+                _dir_cache_remove_for_path (cover->priv->filepath);
+
                 cover_info_release (cover);
 
                 _notify_listeners (DDB_ARTWORK_SETTINGS_DID_CHANGE, it);
@@ -1862,6 +1942,7 @@ artwork_plugin_stop (void (*completion_callback) (DB_plugin_t *plugin)) {
         fetch_semaphore = NULL;
 
         cover_cache_free ();
+        dir_cache_free ();
 
         cover_info_cleanup ();
 
@@ -1933,6 +2014,7 @@ artwork_plugin_start (void) {
     fetch_semaphore = dispatch_semaphore_create (FETCH_CONCURRENT_LIMIT);
 
     start_cache_cleaner ();
+    dir_cache_init ();
 
     return 0;
 }
@@ -2010,6 +2092,9 @@ ddb_artwork_plugin_t plugin = {
     .default_image_path = artwork_default_image_path,
     .allocate_source_id = artwork_allocate_source_id,
     .cancel_queries_with_source_id = artwork_cancel_queries_with_source_id,
+    .thumbnail_size_for_size = artwork_thumbnail_size_for_size,
+    .thumbnail_path = artwork_thumbnail_path,
+    .thumbnail_store = artwork_thumbnail_store,
 };
 
 DB_plugin_t *
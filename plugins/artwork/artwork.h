@@ -28,7 +28,7 @@
 #include <time.h>
 
 #define DDB_ARTWORK_MAJOR_VERSION 2
-#define DDB_ARTWORK_MINOR_VERSION 0
+#define DDB_ARTWORK_MINOR_VERSION 1
 
 /// The flags below can be used in the `flags` member of the `ddb_cover_query_t` structure,
 /// and can be OR'ed together.
@@ -136,6 +136,31 @@ typedef struct {
     /// Cancel all queries with the specified source_id
     void
     (*cancel_queries_with_source_id) (int64_t source_id);
+
+    // Version 2.1
+
+    /// Returns the standard thumbnail size (in pixels) which should be used to display an image at @c size,
+    /// or 0 if the size is too large for thumbnails, and the original image should be used.
+    int
+    (*thumbnail_size_for_size) (int size);
+
+    /// Get the path of the pre-scaled thumbnail of the image at @c image_filename,
+    /// for the standard size returned by @c thumbnail_size_for_size.
+    ///
+    /// Thumbnails are stored in the artwork cache, and are keyed by the source image path, size and modification time.
+    ///
+    /// Returns 0 if an up-to-date thumbnail exists at @c path, which can be loaded instead of the original image.
+    /// Returns -1 if the thumbnail doesn't exist, or the source image has changed.
+    /// The @c path is set in both cases, unless the image is not a local file.
+    int
+    (*thumbnail_path) (const char *image_filename, int thumbnail_size, char *path, size_t path_size);
+
+    /// Store the encoded (e.g. PNG) thumbnail image data for the image at @c image_filename.
+    /// The image must be already scaled to fit into @c thumbnail_size.
+    /// The data is written to a temporary file first, which is then renamed, so readers never see partial thumbnails.
+    /// Returns 0 on success.
+    int
+    (*thumbnail_store) (const char *image_filename, int thumbnail_size, const char *data, size_t data_size);
 } ddb_artwork_plugin_t;
 
 #endif /*__ARTWORK_H*/
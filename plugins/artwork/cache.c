@@ -25,6 +25,8 @@
 #include <dispatch/dispatch.h>
 #include <libgen.h>
 #include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -45,6 +47,10 @@ extern ddb_artwork_plugin_t plugin;
 
 extern DB_functions_t *deadbeef;
 
+// Standard thumbnail sizes, in ascending order
+static const int _thumbnail_sizes[] = { 64, 128, 256, 512, 1024 };
+#define THUMBNAIL_SIZE_COUNT (sizeof (_thumbnail_sizes) / sizeof (_thumbnail_sizes[0]))
+
 static dispatch_queue_t sync_queue;
 static dispatch_queue_t worker_queue;
 static int _terminate;
@@ -73,6 +79,64 @@ path_ok (const char *entry) {
     return strcmp (entry, ".") && strcmp (entry, "..");
 }
 
+int
+thumbnail_size_for_size (int size) {
+    for (size_t i = 0; i < THUMBNAIL_SIZE_COUNT; i++) {
+        if (size <= _thumbnail_sizes[i]) {
+            return _thumbnail_sizes[i];
+        }
+    }
+    return 0;
+}
+
+// 64-bit FNV-1a
+static uint64_t
+_hash_bytes (uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int
+make_thumbnail_path (const char *image_path, int thumbnail_size, char *path, size_t path_size) {
+    *path = 0;
+
+    struct stat stat_buf;
+    if (stat (image_path, &stat_buf) || !S_ISREG (stat_buf.st_mode)) {
+        return -1;
+    }
+
+    char root_path[PATH_MAX];
+    if (make_cache_root_path (root_path, sizeof (root_path))) {
+        return -1;
+    }
+
+    // The key includes the source modification time and size,
+    // so that a changed image never matches an old thumbnail
+    int64_t mtime = (int64_t)stat_buf.st_mtime;
+    int64_t size = (int64_t)stat_buf.st_size;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = _hash_bytes (hash, image_path, strlen (image_path));
+    hash = _hash_bytes (hash, &mtime, sizeof (mtime));
+    hash = _hash_bytes (hash, &size, sizeof (size));
+
+    size_t res = snprintf (
+        path,
+        path_size,
+        "%s/thumbs/%d/%016llx.png",
+        root_path,
+        thumbnail_size,
+        (unsigned long long)hash);
+    if (res >= path_size) {
+        *path = 0;
+        return -1;
+    }
+    return 0;
+}
+
 static int
 should_terminate(void) {
     __block int terminate = 0;
@@ -83,15 +147,7 @@ should_terminate(void) {
 }
 
 static void
-cache_cleaner_worker (void) {
-    char covers_path[PATH_MAX];
-    if (make_cache_root_path (covers_path, sizeof (covers_path))) {
-        return;
-    }
-
-    const int32_t cache_secs = _file_expiration_time;
-    const time_t cache_expiry = time (NULL) - cache_secs;
-
+cache_cleaner_scan_dir (const char *covers_path, const time_t cache_expiry, int depth) {
     DIR *covers_dir = opendir (covers_path);
     if (covers_dir == NULL) {
         return;
@@ -109,7 +165,13 @@ cache_cleaner_worker (void) {
             // Test against the cache expiry time
             struct stat stat_buf;
             if (!stat (entry_path, &stat_buf)) {
-                if (stat_buf.st_mtime <= cache_expiry) {
+                if (S_ISDIR (stat_buf.st_mode)) {
+                    // thumbs/<size>/<file>
+                    if ((depth == 0 && !strcmp (entry->d_name, "thumbs")) || depth == 1) {
+                        cache_cleaner_scan_dir (entry_path, cache_expiry, depth + 1);
+                    }
+                }
+                else if (stat_buf.st_mtime <= cache_expiry) {
                     trace ("%s expired from cache\n", entry_path);
                     remove_cache_item (entry_path);
                 }
@@ -122,6 +184,19 @@ cache_cleaner_worker (void) {
     }
 }
 
+static void
+cache_cleaner_worker (void) {
+    char covers_path[PATH_MAX];
+    if (make_cache_root_path (covers_path, sizeof (covers_path))) {
+        return;
+    }
+
+    const int32_t cache_secs = _file_expiration_time;
+    const time_t cache_expiry = time (NULL) - cache_secs;
+
+    cache_cleaner_scan_dir (covers_path, cache_expiry, 0);
+}
+
 void
 cache_configchanged (void) {
     dispatch_sync(sync_queue, ^{
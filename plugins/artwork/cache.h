@@ -30,4 +30,7 @@ void cache_configchanged(void);
 void start_cache_cleaner(void);
 void stop_cache_cleaner(void);
 
+int thumbnail_size_for_size (int size);
+int make_thumbnail_path (const char *image_path, int thumbnail_size, char *path, size_t path_size);
+
 #endif /*__ARTWORK_CACHE_H*/
@@ -0,0 +1,227 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2021 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <dispatch/dispatch.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "dircache.h"
+
+#define MAX_DIRS_IN_CACHE 500
+#define MAX_DIRS_PER_ENTRY 8
+
+typedef struct {
+    char *key;
+    char *image_filename; // NULL if nothing was found
+    int dir_count;
+    char *dirs[MAX_DIRS_PER_ENTRY];
+    time_t mtimes[MAX_DIRS_PER_ENTRY];
+    uint64_t last_used;
+} dir_cache_entry_t;
+
+static dispatch_queue_t _sync_queue;
+static dir_cache_entry_t *_entries[MAX_DIRS_IN_CACHE];
+static uint64_t _use_counter;
+
+static void
+_entry_free (dir_cache_entry_t *entry) {
+    free (entry->key);
+    free (entry->image_filename);
+    for (int i = 0; i < entry->dir_count; i++) {
+        free (entry->dirs[i]);
+    }
+    free (entry);
+}
+
+static dir_cache_entry_t *
+_entry_copy (const dir_cache_entry_t *entry) {
+    dir_cache_entry_t *copy = calloc (1, sizeof (dir_cache_entry_t));
+    copy->key = strdup (entry->key);
+    copy->image_filename = entry->image_filename ? strdup (entry->image_filename) : NULL;
+    copy->dir_count = entry->dir_count;
+    for (int i = 0; i < entry->dir_count; i++) {
+        copy->dirs[i] = strdup (entry->dirs[i]);
+        copy->mtimes[i] = entry->mtimes[i];
+    }
+    return copy;
+}
+
+static int
+_find_index (const char *key) {
+    for (int i = 0; i < MAX_DIRS_IN_CACHE; i++) {
+        if (_entries[i] != NULL && !strcmp (_entries[i]->key, key)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void
+_remove_key (const char *key) {
+    int idx = _find_index (key);
+    if (idx >= 0) {
+        _entry_free (_entries[idx]);
+        _entries[idx] = NULL;
+    }
+}
+
+int
+dir_cache_find (const char *key, char **image_filename) {
+    *image_filename = NULL;
+    if (_sync_queue == NULL) {
+        return -1;
+    }
+
+    __block dir_cache_entry_t *entry = NULL;
+    dispatch_sync (_sync_queue, ^{
+        int idx = _find_index (key);
+        if (idx >= 0) {
+            _entries[idx]->last_used = ++_use_counter;
+            entry = _entry_copy (_entries[idx]);
+        }
+    });
+
+    if (entry == NULL) {
+        return -1;
+    }
+
+    // validate outside of the lock, since stat may be slow on network filesystems
+    int valid = 1;
+    for (int i = 0; i < entry->dir_count; i++) {
+        struct stat stat_buf;
+        if (stat (entry->dirs[i], &stat_buf) || stat_buf.st_mtime != entry->mtimes[i]) {
+            valid = 0;
+            break;
+        }
+    }
+
+    if (!valid) {
+        dispatch_sync (_sync_queue, ^{
+            _remove_key (key);
+        });
+        _entry_free (entry);
+        return -1;
+    }
+
+    *image_filename = entry->image_filename;
+    entry->image_filename = NULL;
+    _entry_free (entry);
+    return 0;
+}
+
+void
+dir_cache_store (const char *key, const char **dirs, int dir_count, const char *image_filename) {
+    if (_sync_queue == NULL || dir_count > MAX_DIRS_PER_ENTRY) {
+        return;
+    }
+
+    dir_cache_entry_t *entry = calloc (1, sizeof (dir_cache_entry_t));
+    entry->key = strdup (key);
+    entry->image_filename = image_filename ? strdup (image_filename) : NULL;
+
+    time_t now = time (NULL);
+    for (int i = 0; i < dir_count; i++) {
+        struct stat stat_buf;
+        // Don't cache folders modified during the current second,
+        // since further changes in the same second would not be detected.
+        if (stat (dirs[i], &stat_buf) || stat_buf.st_mtime >= now) {
+            _entry_free (entry);
+            return;
+        }
+        entry->dirs[i] = strdup (dirs[i]);
+        entry->mtimes[i] = stat_buf.st_mtime;
+        entry->dir_count++;
+    }
+
+    dispatch_sync (_sync_queue, ^{
+        _remove_key (key);
+
+        int empty_idx = -1;
+        int lru_idx = -1;
+        for (int i = 0; i < MAX_DIRS_IN_CACHE; i++) {
+            if (_entries[i] == NULL) {
+                empty_idx = i;
+                break;
+            }
+            if (lru_idx == -1 || _entries[i]->last_used < _entries[lru_idx]->last_used) {
+                lru_idx = i;
+            }
+        }
+
+        if (empty_idx < 0) {
+            _entry_free (_entries[lru_idx]);
+            _entries[lru_idx] = NULL;
+            empty_idx = lru_idx;
+        }
+
+        entry->last_used = ++_use_counter;
+        _entries[empty_idx] = entry;
+    });
+}
+
+void
+dir_cache_remove (const char *key) {
+    if (_sync_queue == NULL) {
+        return;
+    }
+    dispatch_sync (_sync_queue, ^{
+        _remove_key (key);
+    });
+}
+
+static void
+_clear (void) {
+    for (int i = 0; i < MAX_DIRS_IN_CACHE; i++) {
+        if (_entries[i] != NULL) {
+            _entry_free (_entries[i]);
+            _entries[i] = NULL;
+        }
+    }
+}
+
+void
+dir_cache_clear (void) {
+    if (_sync_queue == NULL) {
+        return;
+    }
+    dispatch_sync (_sync_queue, ^{
+        _clear ();
+    });
+}
+
+void
+dir_cache_init (void) {
+    _sync_queue = dispatch_queue_create ("ArtworkDirCacheSyncQueue", NULL);
+}
+
+void
+dir_cache_free (void) {
+    if (_sync_queue == NULL) {
+        return;
+    }
+    _clear ();
+    dispatch_release (_sync_queue);
+    _sync_queue = NULL;
+}
@@ -0,0 +1,55 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2021 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ARTWORK_DIRCACHE_H
+#define __ARTWORK_DIRCACHE_H
+
+#include <stddef.h>
+
+// Cache of local folder scan results, shared by all tracks in the same folder.
+// The key is the folder path, or the container URI for VFS containers.
+// Entries are validated against the modification time of the scanned folders.
+
+/// Returns 0 if a valid entry was found.
+/// @c image_filename is set to a newly allocated path to the found image, or NULL if the folder has no artwork.
+int
+dir_cache_find (const char *key, char **image_filename);
+
+/// Store the scan result. @c dirs is the list of @c dir_count local paths which were scanned,
+/// used to validate the entry later. @c image_filename can be NULL, to store a negative result.
+void
+dir_cache_store (const char *key, const char **dirs, int dir_count, const char *image_filename);
+
+void
+dir_cache_remove (const char *key);
+
+void
+dir_cache_clear (void);
+
+void
+dir_cache_init (void);
+
+void
+dir_cache_free (void);
+
+#endif /*__ARTWORK_DIRCACHE_H*/
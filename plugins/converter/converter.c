@@ -35,9 +35,17 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#if HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+#endif
 #include <inttypes.h>
 #include <errno.h>
 #include <deadbeef/deadbeef.h>
@@ -1114,41 +1122,130 @@ _get_encoder_cmdline (ddb_encoder_preset_t *encoder_preset, char *enc, int len,
 }
 
 #define BUFFER_SIZE 4096
+#define LOCAL_BUFFER_SIZE (1024 * 1024)
+
+// Returns the local filesystem path for the URI, or NULL if the file needs to be read via VFS plugin
+static const char *
+_local_path_for_uri (const char *uri) {
+    if (!strncasecmp (uri, "file://", 7)) {
+        return uri + 7;
+    }
+    if (uri[0] == '/') {
+        return uri;
+    }
+    return NULL;
+}
+
+// Copy a local file, letting the kernel do the work where possible:
+// reflink (FICLONE), then copy_file_range, then sendfile, then read/write with a large buffer.
+// Each step continues from the current file offsets, so it's fine to fall back after a partial copy.
 static int
-_copy_file (const char *in, const char *out) {
-    char *final_path = strdupa (out);
-    char *sep = strrchr (final_path, '/');
-    if (sep) {
-        *sep = 0;
-        if (!check_dir (final_path, 0755)) {
-            trace ("Failed to create output folder: %s\n", final_path);
-            return -1;
+_copy_local_file (const char *in, const char *out, int64_t *pbytes) {
+    int err = -1;
+    char *buffer = NULL;
+
+    int fd_in = open (in, O_RDONLY | O_LARGEFILE | _O_BINARY);
+    if (fd_in == -1) {
+        trace ("Failed to open file %s for reading\n", in);
+        return -1;
+    }
+
+    int fd_out = open (out, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE | _O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd_out == -1) {
+        trace ("Failed to open file %s for writing\n", out);
+        close (fd_in);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat (fd_in, &st)) {
+        goto error;
+    }
+    int64_t size = st.st_size;
+    int64_t copied = 0;
+
+#if defined(__linux__) && defined(FICLONE)
+    if (!ioctl (fd_out, FICLONE, fd_in)) {
+        trace ("Cloned %s\n", in);
+        copied = size;
+    }
+#endif
+
+#if HAVE_COPY_FILE_RANGE
+    while (copied < size) {
+        ssize_t n = copy_file_range (fd_in, NULL, fd_out, NULL, size - copied, 0);
+        if (n <= 0) {
+            break;
+        }
+        copied += n;
+    }
+#endif
+
+#if defined(__linux__) && HAVE_SENDFILE
+    while (copied < size) {
+        ssize_t n = sendfile (fd_out, fd_in, NULL, size - copied);
+        if (n <= 0) {
+            break;
+        }
+        copied += n;
+    }
+#endif
+
+    if (copied < size) {
+        buffer = malloc (LOCAL_BUFFER_SIZE);
+        for (;;) {
+            ssize_t n = read (fd_in, buffer, LOCAL_BUFFER_SIZE);
+            if (n < 0) {
+                trace ("Failed to read file %s: %s\n", in, strerror (errno));
+                goto error;
+            }
+            if (n == 0) {
+                break;
+            }
+            if (write (fd_out, buffer, n) != n) {
+                trace ("Failed to write file %s: %s\n", out, strerror (errno));
+                goto error;
+            }
+            copied += n;
         }
     }
 
+    *pbytes = copied;
+    err = 0;
+
+error:
+    free (buffer);
+    close (fd_in);
+    if (close (fd_out)) {
+        trace ("Failed to write file %s: %s\n", out, strerror (errno));
+        err = -1;
+    }
+    return err;
+}
+
+static int
+_copy_vfs_file (const char *in, const char *out, int64_t *pbytes) {
     DB_FILE *infile = deadbeef->fopen (in);
     if (!infile) {
         trace ("Failed to open file %s for reading\n", in);
         return -1;
     }
 
-    char tmp_out[PATH_MAX];
-    snprintf (tmp_out, PATH_MAX, "%s.part", out);
-    FILE *fout = fopen (tmp_out, "w+b");
+    FILE *fout = fopen (out, "w+b");
     if (!fout) {
-        trace ("Failed to open file %s for writing\n", tmp_out);
+        trace ("Failed to open file %s for writing\n", out);
         deadbeef->fclose (infile);
         return -1;
     }
 
     int err = 0;
     int64_t bytes_read;
-    size_t file_bytes = 0;
+    int64_t file_bytes = 0;
     do {
         char buffer[BUFFER_SIZE];
         bytes_read = deadbeef->fread (buffer, 1, BUFFER_SIZE, infile);
         if (bytes_read > 0 && fwrite (buffer, bytes_read, 1, fout) != 1) {
-            trace ("Failed to write file %s: %s\n", tmp_out, strerror (errno));
+            trace ("Failed to write file %s: %s\n", out, strerror (errno));
             err = -1;
         }
         file_bytes += bytes_read;
@@ -1157,12 +1254,50 @@ _copy_file (const char *in, const char *out) {
     deadbeef->fclose (infile);
 
     if (fclose (fout)) {
-        trace ("Failed to write file %s: %s\n", tmp_out, strerror (errno));
-        unlink (tmp_out);
-        return -1;
+        trace ("Failed to write file %s: %s\n", out, strerror (errno));
+        err = -1;
+    }
+
+    *pbytes = file_bytes;
+    return err;
+}
+
+static int
+_copy_file (const char *in, const char *out) {
+    char *final_path = strdupa (out);
+    char *sep = strrchr (final_path, '/');
+    if (sep) {
+        *sep = 0;
+        if (!check_dir (final_path, 0755)) {
+            trace ("Failed to create output folder: %s\n", final_path);
+            return -1;
+        }
+    }
+
+    char tmp_out[PATH_MAX];
+    snprintf (tmp_out, PATH_MAX, "%s.part", out);
+
+    struct timeval tm1;
+    gettimeofday (&tm1, NULL);
+
+    int err;
+    int64_t file_bytes = 0;
+    const char *local_in = _local_path_for_uri (in);
+    if (local_in) {
+        err = _copy_local_file (local_in, tmp_out, &file_bytes);
+    }
+    else {
+        err = _copy_vfs_file (in, tmp_out, &file_bytes);
     }
 
     if (file_bytes > 0 && !err) {
+        struct timeval tm2;
+        gettimeofday (&tm2, NULL);
+        double elapsed = (double)(tm2.tv_sec - tm1.tv_sec) + (double)(tm2.tv_usec - tm1.tv_usec) / 1000000.0;
+        if (elapsed > 0) {
+            trace ("Copied %"PRId64" bytes in %.3f sec (%.1f MB/s): %s\n", file_bytes, elapsed, file_bytes / elapsed / (1024 * 1024), in);
+        }
+
         err = rename (tmp_out, out);
         if (err) {
             trace ("Failed to move %s to %s: %s\n", tmp_out, out, strerror (errno));
@@ -1331,6 +1466,53 @@ ddb_mktemp(char *template, size_t template_size, char *suffix) {
 #endif
 }
 
+#ifdef __APPLE__
+// The PATH is shared by all conversions running in parallel,
+// so it's modified by the first one, and restored by the last one.
+static uintptr_t _path_env_mutex;
+static int _path_env_refc;
+static char *_path_env_orig;
+
+static int
+_path_env_push (void) {
+    int res = 0;
+    deadbeef->mutex_lock (_path_env_mutex);
+    if (_path_env_refc == 0) {
+        char *pathenvorig = getenv("PATH");
+        if (pathenvorig == NULL) {
+            res = -1;
+        }
+        else {
+            _path_env_orig = strdup(pathenvorig);
+
+            size_t bufsize = strlen(_path_env_orig) + 100;
+            char *modifiedpath = malloc(bufsize);
+            snprintf(modifiedpath, bufsize, "%s:/opt/homebrew/bin:/opt/local/bin", _path_env_orig);
+            setenv("PATH", modifiedpath, 1);
+            free (modifiedpath);
+            modifiedpath = NULL;
+        }
+    }
+    if (res == 0) {
+        _path_env_refc++;
+    }
+    deadbeef->mutex_unlock (_path_env_mutex);
+    return res;
+}
+
+static void
+_path_env_pop (void) {
+    deadbeef->mutex_lock (_path_env_mutex);
+    _path_env_refc--;
+    if (_path_env_refc == 0) {
+        setenv("PATH", _path_env_orig, 1);
+        free(_path_env_orig);
+        _path_env_orig = NULL;
+    }
+    deadbeef->mutex_unlock (_path_env_mutex);
+}
+#endif
+
 static int
 convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out, int *pabort) {
     int output_bps = settings->output_bps;
@@ -1380,22 +1562,11 @@ convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out
     char input_file_name[PATH_MAX] = "";
 
 #ifdef __APPLE__
-    // Remember/copy the original PATH variable.
-    char *pathenvorig = getenv("PATH");
-    if (pathenvorig == NULL) {
-        return -1;
-    }
-    char *pathenvcopy = strdup(pathenvorig);
-
     // Add homebrew and macports paths.
-    size_t bufsize = strlen(pathenvcopy) + 100;
-    char *modifiedpath = malloc(bufsize);
-    snprintf(modifiedpath, bufsize, "%s:/opt/homebrew/bin:/opt/local/bin", pathenvcopy);
-    setenv("PATH", modifiedpath, 1);
-    free (modifiedpath);
-    modifiedpath = NULL;
-
     // Note: the original value of PATH env variable is restored at the end of this function.
+    if (_path_env_push ()) {
+        return -1;
+    }
 #endif
 
     char *final_path = strdupa (out);
@@ -1524,9 +1695,7 @@ convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out
 error:
 
 #ifdef __APPLE__
-    setenv("PATH", pathenvcopy, 1);
-    free(pathenvcopy);
-    pathenvcopy = NULL;
+    _path_env_pop ();
 #endif
     if (temp_file != -1 && (!enc_pipe || temp_file != fileno (enc_pipe))) {
         close (temp_file);
@@ -1579,6 +1748,264 @@ convert_1_0 (DB_playItem_t *it, const char *outfolder, const char *outfile, int
     return -1;
 }
 
+// Batch conversion
+
+struct ddb_converter_batch_s {
+    ddb_converter_settings_t settings;
+    DB_playItem_t **tracks;
+    char **outpaths;
+    int count;
+
+    ddb_converter_batch_progress_t progress;
+    void *user_data;
+
+    intptr_t *threads;
+    int num_threads;
+
+    uintptr_t mutex;
+    int cancelled;
+    int *pabort; // either user-supplied, or points to `cancelled`
+    int next_job; // index of the next track to be picked up by a worker
+    int next_callback; // index of the next track to report in the progress callback
+    int failed_count;
+    ddb_converter_job_stats_t *stats;
+    int *done; // set when the stats for the track are ready to be reported
+    int *duplicate; // set when an earlier track in the batch has the same output path
+};
+
+typedef struct {
+    ddb_converter_batch_t *batch;
+    ddb_converter_settings_t settings;
+} batch_worker_t;
+
+static int
+_cpu_count (void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf (_SC_NPROCESSORS_ONLN);
+    if (n > 0) {
+        return (int)n;
+    }
+#endif
+    return 1;
+}
+
+typedef struct {
+    const char *path;
+    int index;
+} batch_outpath_t;
+
+static int
+_outpath_cmp (const void *a, const void *b) {
+    const batch_outpath_t *pa = a;
+    const batch_outpath_t *pb = b;
+    int res = strcmp (pa->path, pb->path);
+    if (res) {
+        return res;
+    }
+    return pa->index - pb->index;
+}
+
+// Parallel jobs writing to the same file would corrupt it, so only the first track with each output path is converted
+static void
+_batch_find_duplicates (ddb_converter_batch_t *batch) {
+    batch_outpath_t *paths = calloc (batch->count, sizeof (batch_outpath_t));
+    int n = 0;
+    for (int i = 0; i < batch->count; i++) {
+        if (batch->outpaths[i]) {
+            paths[n].path = batch->outpaths[i];
+            paths[n].index = i;
+            n++;
+        }
+    }
+    qsort (paths, n, sizeof (batch_outpath_t), _outpath_cmp);
+    for (int i = 1; i < n; i++) {
+        if (!strcmp (paths[i].path, paths[i-1].path)) {
+            trace_err ("converter: skipping track %d, output path %s is used by track %d\n", paths[i].index, paths[i].path, paths[i-1].index);
+            batch->duplicate[paths[i].index] = 1;
+        }
+    }
+    free (paths);
+}
+
+// Must be called with the batch mutex locked
+static void
+_batch_report_progress (ddb_converter_batch_t *batch) {
+    while (batch->next_callback < batch->count && batch->done[batch->next_callback]) {
+        ddb_converter_job_stats_t *stats = &batch->stats[batch->next_callback];
+        batch->next_callback++;
+        if (batch->progress) {
+            batch->progress (stats, batch->user_data);
+        }
+    }
+}
+
+static void
+_batch_worker (void *ctx) {
+    batch_worker_t *worker = ctx;
+    ddb_converter_batch_t *batch = worker->batch;
+
+    for (;;) {
+        deadbeef->mutex_lock (batch->mutex);
+        int idx = batch->next_job++;
+        deadbeef->mutex_unlock (batch->mutex);
+
+        if (idx >= batch->count) {
+            break;
+        }
+
+        ddb_converter_job_stats_t *stats = &batch->stats[idx];
+        stats->_size = sizeof (ddb_converter_job_stats_t);
+        stats->index = idx;
+        stats->count = batch->count;
+        stats->track = batch->tracks[idx];
+        stats->outpath = batch->outpaths[idx];
+
+        struct timeval tm1;
+        gettimeofday (&tm1, NULL);
+
+        if (*batch->pabort) {
+            stats->status = DDB_CONVERTER_JOB_STATUS_CANCELLED;
+        }
+        else if (stats->outpath == NULL || batch->duplicate[idx]) {
+            stats->status = DDB_CONVERTER_JOB_STATUS_SKIPPED;
+        }
+        else {
+            int res = convert2 (&worker->settings, stats->track, stats->outpath, batch->pabort);
+            if (*batch->pabort) {
+                stats->status = DDB_CONVERTER_JOB_STATUS_CANCELLED;
+            }
+            else if (res != 0) {
+                stats->status = DDB_CONVERTER_JOB_STATUS_FAILED;
+            }
+            else {
+                stats->status = DDB_CONVERTER_JOB_STATUS_DONE;
+                struct stat st;
+                if (!stat (stats->outpath, &st)) {
+                    stats->output_size = st.st_size;
+                }
+            }
+        }
+
+        struct timeval tm2;
+        gettimeofday (&tm2, NULL);
+        stats->elapsed = (float)(tm2.tv_sec - tm1.tv_sec) + (float)(tm2.tv_usec - tm1.tv_usec) / 1000000.f;
+
+        deadbeef->mutex_lock (batch->mutex);
+        if (stats->status == DDB_CONVERTER_JOB_STATUS_FAILED) {
+            batch->failed_count++;
+        }
+        batch->done[idx] = 1;
+        _batch_report_progress (batch);
+        deadbeef->mutex_unlock (batch->mutex);
+    }
+
+    // each worker has its own DSP chain instance, since DSP plugins keep state
+    if (worker->settings.dsp_preset) {
+        dsp_preset_free (worker->settings.dsp_preset);
+    }
+    free (worker);
+}
+
+static ddb_converter_batch_t *
+batch_start (ddb_converter_settings_t *settings, DB_playItem_t **tracks, const char **outpaths, int count, int num_threads, ddb_converter_batch_progress_t progress, void *user_data, int *pabort) {
+    ddb_converter_batch_t *batch = calloc (1, sizeof (ddb_converter_batch_t));
+    batch->pabort = pabort ? pabort : &batch->cancelled;
+    batch->settings = *settings;
+    batch->count = count;
+    batch->progress = progress;
+    batch->user_data = user_data;
+    batch->mutex = deadbeef->mutex_create ();
+
+    batch->tracks = calloc (count, sizeof (DB_playItem_t *));
+    batch->outpaths = calloc (count, sizeof (char *));
+    batch->stats = calloc (count, sizeof (ddb_converter_job_stats_t));
+    batch->done = calloc (count, sizeof (int));
+    batch->duplicate = calloc (count, sizeof (int));
+    for (int i = 0; i < count; i++) {
+        batch->tracks[i] = tracks[i];
+        deadbeef->pl_item_ref (tracks[i]);
+        batch->outpaths[i] = outpaths[i] ? strdup (outpaths[i]) : NULL;
+    }
+    _batch_find_duplicates (batch);
+
+    if (num_threads <= 0) {
+        num_threads = _cpu_count ();
+    }
+    if (num_threads > count) {
+        num_threads = count;
+    }
+
+    batch->threads = calloc (num_threads > 0 ? num_threads : 1, sizeof (intptr_t));
+    for (int i = 0; i < num_threads; i++) {
+        batch_worker_t *worker = calloc (1, sizeof (batch_worker_t));
+        worker->batch = batch;
+        worker->settings = *settings;
+        if (settings->dsp_preset) {
+            worker->settings.dsp_preset = dsp_preset_alloc ();
+            dsp_preset_copy (worker->settings.dsp_preset, settings->dsp_preset);
+        }
+        intptr_t tid = deadbeef->thread_start_low_priority (_batch_worker, worker);
+        if (!tid) {
+            trace_err ("converter: failed to start worker thread\n");
+            if (worker->settings.dsp_preset) {
+                dsp_preset_free (worker->settings.dsp_preset);
+            }
+            free (worker);
+            continue;
+        }
+        batch->threads[batch->num_threads++] = tid;
+    }
+
+    if (batch->num_threads == 0 && count > 0) {
+        // report all tracks as failed
+        deadbeef->mutex_lock (batch->mutex);
+        for (int i = 0; i < count; i++) {
+            ddb_converter_job_stats_t *stats = &batch->stats[i];
+            stats->_size = sizeof (ddb_converter_job_stats_t);
+            stats->index = i;
+            stats->count = count;
+            stats->track = batch->tracks[i];
+            stats->outpath = batch->outpaths[i];
+            stats->status = DDB_CONVERTER_JOB_STATUS_FAILED;
+            batch->done[i] = 1;
+        }
+        batch->failed_count = count;
+        _batch_report_progress (batch);
+        deadbeef->mutex_unlock (batch->mutex);
+    }
+
+    return batch;
+}
+
+static void
+batch_cancel (ddb_converter_batch_t *batch) {
+    *batch->pabort = 1;
+}
+
+static int
+batch_wait (ddb_converter_batch_t *batch) {
+    for (int i = 0; i < batch->num_threads; i++) {
+        deadbeef->thread_join (batch->threads[i]);
+    }
+
+    int res = *batch->pabort ? -1 : batch->failed_count;
+
+    for (int i = 0; i < batch->count; i++) {
+        deadbeef->pl_item_unref (batch->tracks[i]);
+        free (batch->outpaths[i]);
+    }
+    free (batch->tracks);
+    free (batch->outpaths);
+    free (batch->stats);
+    free (batch->done);
+    free (batch->duplicate);
+    free (batch->threads);
+    deadbeef->mutex_free (batch->mutex);
+    free (batch);
+
+    return res;
+}
+
 int
 converter_cmd (int cmd, ...) {
     return -1;
@@ -1586,6 +2013,9 @@ converter_cmd (int cmd, ...) {
 
 int
 converter_start (void) {
+#ifdef __APPLE__
+    _path_env_mutex = deadbeef->mutex_create ();
+#endif
     load_encoder_presets ();
     load_dsp_presets ();
 
@@ -1596,6 +2026,12 @@ int
 converter_stop (void) {
     free_encoder_presets ();
     free_dsp_presets ();
+#ifdef __APPLE__
+    if (_path_env_mutex) {
+        deadbeef->mutex_free (_path_env_mutex);
+        _path_env_mutex = 0;
+    }
+#endif
     return 0;
 }
 
@@ -1604,7 +2040,7 @@ static ddb_converter_t plugin = {
     .misc.plugin.api_vmajor = DB_API_VERSION_MAJOR,
     .misc.plugin.api_vminor = DB_API_VERSION_MINOR,
     .misc.plugin.version_major = 1,
-    .misc.plugin.version_minor = 5,
+    .misc.plugin.version_minor = 6,
     .misc.plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
     .misc.plugin.type = DB_PLUGIN_MISC,
     .misc.plugin.name = "Converter",
@@ -1671,6 +2107,10 @@ static ddb_converter_t plugin = {
     .get_output_path2 = get_output_path2,
     // 1.5 entry points
     .convert2 = convert2,
+    // 1.6 entry points
+    .batch_start = batch_start,
+    .batch_cancel = batch_cancel,
+    .batch_wait = batch_wait,
 };
 
 DB_plugin_t *
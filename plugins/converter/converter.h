@@ -25,6 +25,8 @@
 
 #include <stdint.h>
 
+// changes in 1.6:
+//   added batch conversion API: `batch_start`, `batch_cancel`, `batch_wait`
 // changes in 1.5:
 //   added mp4 tagging support
 //   added converter option to copy files without conversion, if file format isn't changing
@@ -101,6 +103,47 @@ typedef struct ddb_converter_settings_s {
     int rewrite_tags_after_copy;
 } ddb_converter_settings_t;
 
+// since 1.6
+enum {
+    DDB_CONVERTER_JOB_STATUS_DONE = 0,
+    DDB_CONVERTER_JOB_STATUS_FAILED = 1,
+    DDB_CONVERTER_JOB_STATUS_SKIPPED = 2, // the output path was NULL, or the same as for an earlier track in the batch
+    DDB_CONVERTER_JOB_STATUS_CANCELLED = 3,
+};
+
+// since 1.6
+// Per-track statistics, passed to the batch progress callback
+typedef struct {
+    // size of this struct
+    int _size;
+
+    // index of the track in the batch
+    int index;
+
+    // total number of tracks in the batch
+    int count;
+
+    DB_playItem_t *track;
+
+    const char *outpath;
+
+    // DDB_CONVERTER_JOB_STATUS_*
+    int status;
+
+    // size of the output file in bytes, or 0 if the conversion did not succeed
+    int64_t output_size;
+
+    // wall clock time spent on the track, in seconds
+    float elapsed;
+} ddb_converter_job_stats_t;
+
+typedef struct ddb_converter_batch_s ddb_converter_batch_t;
+
+// Called once for every track in the batch, in the same order as the tracks were passed to `batch_start`,
+// regardless of the order in which the worker threads complete them.
+// The calls are serialized, but may happen on any of the worker threads.
+typedef void (*ddb_converter_batch_progress_t) (ddb_converter_job_stats_t *stats, void *user_data);
+
 typedef struct {
     DB_misc_t misc;
 
@@ -265,6 +308,42 @@ typedef struct {
          // *pabort will be checked regularly, conversion will be interrupted if it's non-zero
          int *pabort
     );
+
+    // since 1.6
+    // Start converting `count` tracks on a pool of worker threads, and return immediately.
+    // Parameters:
+    //  settings: converter settings, copied by the function
+    //  tracks: the tracks to convert, the array is copied, and each track is referenced
+    //  outpaths: fully qualified output path for each track, or NULL to skip the track.
+    //            the array is copied. if several tracks have the same path, only the first one is converted.
+    //  num_threads: number of worker threads, or 0 to use the number of CPU cores.
+    //  progress: called after each track is done, in the track order, can be NULL
+    //  pabort: *pabort will be checked regularly, all conversions will be interrupted if it's non-zero.
+    //          can be NULL, in which case `batch_cancel` should be used.
+    // Returns the batch, which must be passed to `batch_wait` to release it.
+    ddb_converter_batch_t *
+    (*batch_start) (
+        ddb_converter_settings_t *settings,
+        DB_playItem_t **tracks,
+        const char **outpaths,
+        int count,
+        int num_threads,
+        ddb_converter_batch_progress_t progress,
+        void *user_data,
+        int *pabort
+    );
+
+    // since 1.6
+    // Interrupt the running conversions, and skip the remaining tracks, same as setting *pabort.
+    // Can be called from any thread, including the progress callback.
+    void
+    (*batch_cancel) (ddb_converter_batch_t *batch);
+
+    // since 1.6
+    // Wait until all tracks are processed, and release the batch.
+    // Returns the number of tracks which failed to convert, or -1 if the batch was cancelled.
+    int
+    (*batch_wait) (ddb_converter_batch_t *batch);
 } ddb_converter_t;
 
 #endif
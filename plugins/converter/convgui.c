@@ -169,6 +169,30 @@ overwrite_prompt (const char *outpath) {
     return ctl.result;
 }
 
+static void
+converter_progress (ddb_converter_job_stats_t *stats, void *user_data) {
+    converter_ctx_t *conv = user_data;
+    if (stats->status == DDB_CONVERTER_JOB_STATUS_SKIPPED || stats->status == DDB_CONVERTER_JOB_STATUS_CANCELLED) {
+        return;
+    }
+
+    update_progress_info_t *info = malloc (sizeof (update_progress_info_t));
+    info->entry = conv->progress_entry;
+    g_object_ref (info->entry);
+    deadbeef->pl_lock ();
+    const char *uri = deadbeef->pl_find_meta (stats->track, ":URI");
+    size_t len = strlen (uri) + 50;
+    info->text = malloc (len);
+    if (stats->output_size > 0 && stats->elapsed > 0) {
+        snprintf (info->text, len, "%d/%d (%.1f MB/s): %s", stats->index + 1, stats->count, stats->output_size / stats->elapsed / (1024 * 1024), uri);
+    }
+    else {
+        snprintf (info->text, len, "%d/%d: %s", stats->index + 1, stats->count, uri);
+    }
+    deadbeef->pl_unlock ();
+    g_idle_add (update_progress_cb, info);
+}
+
 static void
 converter_worker (void *ctx) {
     deadbeef->background_job_increment ();
@@ -219,15 +243,9 @@ converter_worker (void *ctx) {
         .rewrite_tags_after_copy = conv->retag_after_copy,
     };
 
-    for (int n = 0; n < conv->convert_items_count; n++) {
-        update_progress_info_t *info = malloc (sizeof (update_progress_info_t));
-        info->entry = conv->progress_entry;
-        g_object_ref (info->entry);
-        deadbeef->pl_lock ();
-        info->text = strdup (deadbeef->pl_find_meta (conv->convert_items[n], ":URI"));
-        deadbeef->pl_unlock ();
-        g_idle_add (update_progress_cb, info);
-
+    // resolve the output paths, and ask about overwriting before starting the conversion
+    char **outpaths = calloc (conv->convert_items_count, sizeof (char *));
+    for (int n = 0; n < conv->convert_items_count && !conv->cancelled; n++) {
         char outpath[2000];
         converter_plugin->get_output_path2 (conv->convert_items[n], conv->convert_playlist, conv->outfolder, conv->outfile, conv->encoder_preset, conv->preserve_folder_structure, root, conv->write_to_source_folder, outpath, sizeof (outpath));
 
@@ -251,16 +269,22 @@ converter_worker (void *ctx) {
         }
 
         if (!skip) {
-            converter_plugin->convert2 (&settings, conv->convert_items[n], outpath, &conv->cancelled);
-        }
-        if (conv->cancelled) {
-            for (; n < conv->convert_items_count; n++) {
-                deadbeef->pl_item_unref (conv->convert_items[n]);
-            }
-            break;
+            outpaths[n] = strdup (outpath);
         }
+    }
+
+    if (!conv->cancelled) {
+        int num_threads = deadbeef->conf_get_int ("converter.threads", 0);
+        ddb_converter_batch_t *batch = converter_plugin->batch_start (&settings, conv->convert_items, (const char **)outpaths, conv->convert_items_count, num_threads, converter_progress, conv, &conv->cancelled);
+        converter_plugin->batch_wait (batch);
+    }
+
+    for (int n = 0; n < conv->convert_items_count; n++) {
+        free (outpaths[n]);
         deadbeef->pl_item_unref (conv->convert_items[n]);
     }
+    free (outpaths);
+
     g_idle_add (destroy_progress_cb, conv->progress);
     if (conv->convert_items) {
         free (conv->convert_items);
@@ -601,6 +625,7 @@ converter_show_cb (void *data) {
     gtk_widget_set_sensitive (lookup_widget (conv->converter, "output_folder"), !write_to_source_folder);
     gtk_widget_set_sensitive (lookup_widget (conv->converter, "preserve_folders"), !write_to_source_folder);
     gtk_combo_box_set_active (GTK_COMBO_BOX (lookup_widget (conv->converter, "overwrite_action")), deadbeef->conf_get_int ("converter.overwrite_action", 0));
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (lookup_widget (conv->converter, "numthreads")), deadbeef->conf_get_int ("converter.threads", 0));
     deadbeef->conf_unlock ();
 
     GtkComboBox *combo;
@@ -1827,7 +1852,7 @@ convgui_connect (void) {
         fprintf (stderr, "convgui: converter plugin not found\n");
         return -1;
     }
-#define REQ_CONV_VERSION 4
+#define REQ_CONV_VERSION 6
     if (!PLUG_TEST_COMPAT(&converter_plugin->misc.plugin, 1, REQ_CONV_VERSION)) {
         fprintf (stderr, "convgui: need converter>=1.%d, but found %d.%d\n", REQ_CONV_VERSION, converter_plugin->misc.plugin.version_major, converter_plugin->misc.plugin.version_minor);
         return -1;
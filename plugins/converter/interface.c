@@ -206,13 +206,14 @@ create_converterdlg (void)
   gtk_container_add (GTK_CONTAINER (edit_dsp_presets), image470);
 
   hbox88 = gtk_hbox_new (FALSE, 8);
+  gtk_widget_show (hbox88);
   gtk_box_pack_start (GTK_BOX (vbox26), hbox88, FALSE, TRUE, 0);
 
   label116 = gtk_label_new (_("Number of threads:"));
   gtk_widget_show (label116);
   gtk_box_pack_start (GTK_BOX (hbox88), label116, FALSE, FALSE, 0);
 
-  numthreads_adj = G_OBJECT(gtk_adjustment_new (1, 0, 100, 1, 10, 0));
+  numthreads_adj = G_OBJECT(gtk_adjustment_new (0, 0, 100, 1, 10, 0));
   numthreads = gtk_spin_button_new (GTK_ADJUSTMENT (numthreads_adj), 1, 0);
   gtk_widget_show (numthreads);
   gtk_box_pack_start (GTK_BOX (hbox88), numthreads, TRUE, TRUE, 0);
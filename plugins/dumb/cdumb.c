@@ -32,12 +32,14 @@
 #include "modloader.h"
 #include <deadbeef/deadbeef.h>
 #include <deadbeef/strdupa.h>
+#include "../../shared/lengthcache.h"
 
 //#define trace(...) { fprintf(stderr, __VA_ARGS__); }
 #define trace(fmt,...)
 
 static DB_decoder_t plugin;
 DB_functions_t *deadbeef;
+static lengthcache_t *lengthcache;
 
 typedef struct {
     DB_fileinfo_t info;
@@ -379,11 +381,25 @@ cdumb_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 
     read_metadata_internal (it, itsd);
 
-    dumb_it_do_initial_runthrough (duh);
-    deadbeef->plt_set_item_duration (plt, it, duh_get_length (duh)/65536.0f);
+    // the length is found by running through the whole module, which is done in the background
+    float duration;
+    int need_probe = 0;
+    if (!lengthcache_get (lengthcache, fname, 0, &duration)) {
+        deadbeef->plt_set_item_duration (plt, it, duration);
+    }
+    else if (!strstr (fname, "://")) {
+        need_probe = 1;
+    }
+    else {
+        dumb_it_do_initial_runthrough (duh);
+        deadbeef->plt_set_item_duration (plt, it, duh_get_length (duh)/65536.0f);
+    }
     deadbeef->pl_add_meta (it, ":FILETYPE", ftype);
 //    printf ("duration: %f\n", _info->duration);
     after = deadbeef->plt_insert_item (plt, after, it);
+    if (need_probe) {
+        lengthcache_probe (lengthcache, it, fname, 0);
+    }
     deadbeef->pl_item_unref (it);
     unload_duh (duh);
 
@@ -452,14 +468,65 @@ dumb_register_db_vfs (void) {
     register_dumbfile_system (&dumb_vfs);
 }
 
+static float
+cdumb_probe_length (const char *fname, int subsong, const int *terminate, void *user_data) {
+    int is_it;
+    int is_dos;
+    int is_ptcompat;
+    const char *ftype = NULL;
+    DUH* duh = g_open_module(fname, &is_it, &is_dos, &is_ptcompat, 0, &ftype);
+    if (!duh) {
+        return -1;
+    }
+
+    // Same as dumb_it_do_initial_runthrough, but in steps, so that it can be interrupted by lengthcache_free
+    DUH_SIGRENDERER *sr = dumb_it_start_at_order (duh, 0, 0);
+    DUMB_IT_SIGRENDERER *itsr = duh_get_it_sigrenderer (sr);
+    if (!itsr) {
+        duh_end_sigrenderer (sr);
+        unload_duh (duh);
+        return -1;
+    }
+    itsr->initial_runthrough = 1;
+    dumb_it_set_loop_callback (itsr, &dumb_it_callback_terminate, NULL);
+    dumb_it_set_xm_speed_zero_callback (itsr, &dumb_it_callback_terminate, NULL);
+    dumb_it_set_global_volume_zero_callback (itsr, &dumb_it_callback_terminate, NULL);
+
+    const long step = 10 * 65536;
+    const long max_length = 120 * 60 * 65536;
+    long length = 0;
+    for (;;) {
+        if (__atomic_load_n (terminate, __ATOMIC_RELAXED)) {
+            length = -65536;
+            break;
+        }
+        long l = duh_sigrenderer_generate_samples (sr, 0, 1.0f, step, NULL);
+        length += l;
+        if (l < step) {
+            break;
+        }
+        if (length >= max_length) {
+            // probably a pattern loop, which dumb doesn't detect
+            length = 0;
+            break;
+        }
+    }
+    duh_end_sigrenderer (sr);
+    unload_duh (duh);
+    return length/65536.0f;
+}
+
 int
 cdumb_start (void) {
     dumb_register_db_vfs ();
+    lengthcache = lengthcache_alloc (deadbeef, "dumb", cdumb_probe_length, NULL);
     return 0;
 }
 
 int
 cdumb_stop (void) {
+    lengthcache_free (lengthcache);
+    lengthcache = NULL;
     dumb_exit ();
     return 0;
 }
@@ -0,0 +1,152 @@
+/*
+    DeaDBeeF - The Ultimate Music Player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko <waker@users.sourceforge.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "dsputil.h"
+
+#if APE_DSP_X86
+#include <immintrin.h>
+#elif APE_DSP_NEON
+#include <arm_neon.h>
+#endif
+
+// The products are accumulated in 32 bits, and v1 is updated in 16 bits,
+// both wrapping around, the same way as the C version does.
+
+int32_t
+ape_scalarproduct_and_madd_int16_c (int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul) {
+    int res = 0;
+    while (order--) {
+        res   += *v1 * *v2++;
+        *v1++ += mul * *v3++;
+    }
+    return res;
+}
+
+#if APE_DSP_X86
+
+// The target attributes allow building the kernels without -msse2/-mavx2,
+// the AVX2 one is only called when mm_support reports it.
+
+__attribute__((target("sse2")))
+int32_t
+ape_scalarproduct_and_madd_int16_sse2 (int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul) {
+    __m128i vmul = _mm_set1_epi16 ((int16_t)mul);
+    __m128i sum0 = _mm_setzero_si128 ();
+    __m128i sum1 = _mm_setzero_si128 ();
+
+    for (int i = 0; i < order; i += 16) {
+        __m128i a0 = _mm_load_si128 ((const __m128i *)(v1 + i));
+        __m128i a1 = _mm_load_si128 ((const __m128i *)(v1 + i + 8));
+        __m128i b0 = _mm_loadu_si128 ((const __m128i *)(v2 + i));
+        __m128i b1 = _mm_loadu_si128 ((const __m128i *)(v2 + i + 8));
+        __m128i c0 = _mm_loadu_si128 ((const __m128i *)(v3 + i));
+        __m128i c1 = _mm_loadu_si128 ((const __m128i *)(v3 + i + 8));
+
+        sum0 = _mm_add_epi32 (sum0, _mm_madd_epi16 (a0, b0));
+        sum1 = _mm_add_epi32 (sum1, _mm_madd_epi16 (a1, b1));
+
+        _mm_store_si128 ((__m128i *)(v1 + i), _mm_add_epi16 (a0, _mm_mullo_epi16 (c0, vmul)));
+        _mm_store_si128 ((__m128i *)(v1 + i + 8), _mm_add_epi16 (a1, _mm_mullo_epi16 (c1, vmul)));
+    }
+
+    __m128i sum = _mm_add_epi32 (sum0, sum1);
+    sum = _mm_add_epi32 (sum, _mm_shuffle_epi32 (sum, _MM_SHUFFLE (1, 0, 3, 2)));
+    sum = _mm_add_epi32 (sum, _mm_shuffle_epi32 (sum, _MM_SHUFFLE (2, 3, 0, 1)));
+    return _mm_cvtsi128_si32 (sum);
+}
+
+__attribute__((target("avx2")))
+int32_t
+ape_scalarproduct_and_madd_int16_avx2 (int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul) {
+    __m256i vmul = _mm256_set1_epi16 ((int16_t)mul);
+    __m256i sum0 = _mm256_setzero_si256 ();
+    __m256i sum1 = _mm256_setzero_si256 ();
+    int i = 0;
+
+    // v1 is only guaranteed to be 16-byte aligned
+    for (; i + 32 <= order; i += 32) {
+        __m256i a0 = _mm256_loadu_si256 ((const __m256i *)(v1 + i));
+        __m256i a1 = _mm256_loadu_si256 ((const __m256i *)(v1 + i + 16));
+        __m256i b0 = _mm256_loadu_si256 ((const __m256i *)(v2 + i));
+        __m256i b1 = _mm256_loadu_si256 ((const __m256i *)(v2 + i + 16));
+        __m256i c0 = _mm256_loadu_si256 ((const __m256i *)(v3 + i));
+        __m256i c1 = _mm256_loadu_si256 ((const __m256i *)(v3 + i + 16));
+
+        sum0 = _mm256_add_epi32 (sum0, _mm256_madd_epi16 (a0, b0));
+        sum1 = _mm256_add_epi32 (sum1, _mm256_madd_epi16 (a1, b1));
+
+        _mm256_storeu_si256 ((__m256i *)(v1 + i), _mm256_add_epi16 (a0, _mm256_mullo_epi16 (c0, vmul)));
+        _mm256_storeu_si256 ((__m256i *)(v1 + i + 16), _mm256_add_epi16 (a1, _mm256_mullo_epi16 (c1, vmul)));
+    }
+    if (i < order) {
+        __m256i a0 = _mm256_loadu_si256 ((const __m256i *)(v1 + i));
+        __m256i b0 = _mm256_loadu_si256 ((const __m256i *)(v2 + i));
+        __m256i c0 = _mm256_loadu_si256 ((const __m256i *)(v3 + i));
+
+        sum0 = _mm256_add_epi32 (sum0, _mm256_madd_epi16 (a0, b0));
+        _mm256_storeu_si256 ((__m256i *)(v1 + i), _mm256_add_epi16 (a0, _mm256_mullo_epi16 (c0, vmul)));
+    }
+
+    __m256i sum256 = _mm256_add_epi32 (sum0, sum1);
+    __m128i sum = _mm_add_epi32 (_mm256_castsi256_si128 (sum256), _mm256_extracti128_si256 (sum256, 1));
+    sum = _mm_add_epi32 (sum, _mm_shuffle_epi32 (sum, _MM_SHUFFLE (1, 0, 3, 2)));
+    sum = _mm_add_epi32 (sum, _mm_shuffle_epi32 (sum, _MM_SHUFFLE (2, 3, 0, 1)));
+    return _mm_cvtsi128_si32 (sum);
+}
+
+#endif
+
+#if APE_DSP_NEON
+
+int32_t
+ape_scalarproduct_and_madd_int16_neon (int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul) {
+    int16x8_t vmul = vdupq_n_s16 ((int16_t)mul);
+    int32x4_t sum0 = vdupq_n_s32 (0);
+    int32x4_t sum1 = vdupq_n_s32 (0);
+
+    for (int i = 0; i < order; i += 16) {
+        int16x8_t a0 = vld1q_s16 (v1 + i);
+        int16x8_t a1 = vld1q_s16 (v1 + i + 8);
+        int16x8_t b0 = vld1q_s16 (v2 + i);
+        int16x8_t b1 = vld1q_s16 (v2 + i + 8);
+        int16x8_t c0 = vld1q_s16 (v3 + i);
+        int16x8_t c1 = vld1q_s16 (v3 + i + 8);
+
+        sum0 = vmlal_s16 (sum0, vget_low_s16 (a0), vget_low_s16 (b0));
+        sum1 = vmlal_s16 (sum1, vget_high_s16 (a0), vget_high_s16 (b0));
+        sum0 = vmlal_s16 (sum0, vget_low_s16 (a1), vget_low_s16 (b1));
+        sum1 = vmlal_s16 (sum1, vget_high_s16 (a1), vget_high_s16 (b1));
+
+        vst1q_s16 (v1 + i, vmlaq_s16 (a0, c0, vmul));
+        vst1q_s16 (v1 + i + 8, vmlaq_s16 (a1, c1, vmul));
+    }
+
+    int32x4_t sum = vaddq_s32 (sum0, sum1);
+#if defined(__aarch64__)
+    return vaddvq_s32 (sum);
+#else
+    int32x2_t sum2 = vadd_s32 (vget_low_s32 (sum), vget_high_s32 (sum));
+    return vget_lane_s32 (vpadd_s32 (sum2, sum2), 0);
+#endif
+}
+
+#endif
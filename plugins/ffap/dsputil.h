@@ -0,0 +1,60 @@
+/*
+    DeaDBeeF - The Ultimate Music Player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko <waker@users.sourceforge.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+    
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __FFAP_DSPUTIL_H
+#define __FFAP_DSPUTIL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NLMS filter kernels, written with compiler intrinsics, so that they don't need yasm.
+// Each returns the scalar product of v1 and v2, and adds mul*v3 to v1.
+// The order must be a multiple of 16, v1 must be 16-byte aligned, v2 and v3 may be unaligned.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define APE_DSP_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define APE_DSP_NEON 1
+#endif
+
+int32_t
+ape_scalarproduct_and_madd_int16_c (int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul);
+
+#if APE_DSP_X86
+int32_t
+ape_scalarproduct_and_madd_int16_sse2 (int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul);
+
+// Must be called only if the CPU and OS support AVX2
+int32_t
+ape_scalarproduct_and_madd_int16_avx2 (int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul);
+#endif
+
+#if APE_DSP_NEON
+int32_t
+ape_scalarproduct_and_madd_int16_neon (int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -39,6 +39,7 @@
 #include <math.h>
 #include <deadbeef/deadbeef.h>
 #include <deadbeef/strdupa.h>
+#include "dsputil.h"
 
 #ifdef TARGET_ANDROID
 int posix_memalign (void **memptr, size_t alignment, size_t size) {
@@ -267,14 +268,23 @@ typedef struct APEContext {
     int filterbuf_size[APE_FILTER_LEVELS];
 } APEContext;
 
+struct ape_parallel_s;
+
 typedef struct {
     DB_fileinfo_t info;
     int64_t startsample;
     int64_t endsample;
     APEContext ape_ctx;
     DB_FILE *fp;
+    struct ape_parallel_s *parallel; // frame-parallel decoder, NULL when decoding serially
 } ape_info_t;
 
+static int
+ape_parallel_start (ape_info_t *info, int nthreads);
+
+static void
+ape_parallel_free (ape_info_t *info);
+
 
 inline static int
 read_uint16(DB_FILE *fp, uint16_t* x)
@@ -588,6 +598,27 @@ static inline const uint32_t bswap_32(uint32_t x)
     return x;
 }
 
+/* Calculate how many blocks there are in the frame */
+static int ape_frame_nblocks(APEContext *ape, int frame)
+{
+    if (frame == (ape->totalframes - 1))
+        return ape->finalframeblocks;
+    else
+        return ape->blocksperframe;
+}
+
+static void ape_update_bitrate(APEContext *ape, int frame, int nblocks)
+{
+    int bitrate = -1;
+    if (nblocks != 0 && ape->frames[frame].size != 0) {
+        float sec = (float)nblocks / ape->samplerate;
+        bitrate = ape->frames[frame].size / sec * 8;
+    }
+    if (bitrate > 0) {
+        deadbeef->streamer_set_bitrate (bitrate/1000);
+    }
+}
+
 static int ape_read_packet(DB_FILE *fp, APEContext *ape_ctx)
 {
     int nblocks;
@@ -601,25 +632,13 @@ static int ape_read_packet(DB_FILE *fp, APEContext *ape_ctx)
         return -1;
     }
 
-    /* Calculate how many blocks there are in this frame */
-    if (ape->currentframe == (ape->totalframes - 1))
-        nblocks = ape->finalframeblocks;
-    else
-        nblocks = ape->blocksperframe;
+    nblocks = ape_frame_nblocks(ape, ape->currentframe);
 
     AV_WL32(ape->packet_data    , nblocks);
     AV_WL32(ape->packet_data + 4, ape->frames[ape->currentframe].skip);
 //    packet_sizeleft -= 8;
 
-// update bitrate
-    int bitrate = -1;
-    if (nblocks != 0 && ape->frames[ape->currentframe].size != 0) {
-        float sec = (float)nblocks / ape->samplerate;
-        bitrate = ape->frames[ape->currentframe].size / sec * 8;
-    }
-    if (bitrate > 0) {
-        deadbeef->streamer_set_bitrate (bitrate/1000);
-    }
+    ape_update_bitrate(ape, ape->currentframe, nblocks);
 
     int sz = PACKET_BUFFER_SIZE-8;
     sz = min (sz, ape->frames[ape->currentframe].size);
@@ -661,6 +680,7 @@ static void
 ffap_free (DB_fileinfo_t *_info)
 {
     ape_info_t *info = (ape_info_t *)_info;
+    ape_parallel_free (info);
     ape_free_ctx (&info->ape_ctx);
     if (info->fp) {
         deadbeef->fclose (info->fp);
@@ -736,6 +756,13 @@ ffap_init (DB_fileinfo_t *_info, DB_playItem_t *it)
         return -1;
     }
 
+    int nthreads = deadbeef->conf_get_int ("ffap.decode_threads", 0);
+    if (nthreads > 0 && info->ape_ctx.totalframes > 1) {
+        if (ape_parallel_start (info, nthreads) < 0) {
+            fprintf (stderr, "ape: failed to start decoding threads, falling back to serial decoding\n");
+        }
+    }
+
     int64_t endsample = deadbeef->pl_item_get_endsample (it);
     if (endsample > 0) {
         info->startsample = deadbeef->pl_item_get_startsample (it);
@@ -1263,16 +1290,6 @@ typedef struct { uint64_t a, b; } xmm_reg;
 #define DECLARE_ALIGNED_16(t, v) DECLARE_ALIGNED(16, t, v)
 #endif
 
-static int32_t scalarproduct_and_madd_int16_c(int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul)
-{
-    int res = 0;
-    while (order--) {
-        res   += *v1 * *v2++;
-        *v1++ += mul * *v3++;
-    }
-    return res;
-}
-
 static int32_t
 (*scalarproduct_and_madd_int16)(int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul);
 
@@ -1444,6 +1461,59 @@ static void ape_unpack_stereo(APEContext * ctx, int count)
     }
 }
 
+/* Write the decoded blocks [i, end) to the output in the stream format */
+static char *ape_output_samples(APEContext *s, int bps, char *samples, int i, int end)
+{
+    if (bps == 32) {
+        for (; i < end; i++) {
+            *((int32_t*)samples) = s->decoded0[i];
+            samples += 4;
+            if(s->channels > 1) {
+                *((int32_t*)samples) = s->decoded1[i];
+                samples += 4;
+            }
+        }
+    }
+    else if (bps == 24) {
+        for (; i < end; i++) {
+            int32_t sample = s->decoded0[i];
+
+            samples[0] = sample&0xff;
+            samples[1] = (sample&0xff00)>>8;
+            samples[2] = (sample&0xff0000)>>16;
+            samples += 3;
+            if(s->channels > 1) {
+                sample = s->decoded1[i];
+                samples[0] = sample&0xff;
+                samples[1] = (sample&0xff00)>>8;
+                samples[2] = (sample&0xff0000)>>16;
+                samples += 3;
+            }
+        }
+    }
+    else if (bps == 16) {
+        for (; i < end; i++) {
+            *((int16_t*)samples) = (int16_t)s->decoded0[i];
+            samples += 2;
+            if(s->channels > 1) {
+                *((int16_t*)samples) = (int16_t)s->decoded1[i];
+                samples += 2;
+            }
+        }
+    }
+    else if (bps == 8) {
+        for (; i < end; i++) {
+            *samples = (int16_t)s->decoded0[i];
+            samples++;
+            if(s->channels > 1) {
+                *samples = (int16_t)s->decoded1[i];
+                samples++;
+            }
+        }
+    }
+    return samples;
+}
+
 static int
 ape_decode_frame(DB_fileinfo_t *_info, void *data, int *data_size)
 {
@@ -1451,7 +1521,7 @@ ape_decode_frame(DB_fileinfo_t *_info, void *data, int *data_size)
     APEContext *s = &info->ape_ctx;
     char *samples = data;
     int nblocks;
-    int i, n;
+    int n;
     int blockstodecode;
     long bytes_used;
     int samplesize = _info->fmt.bps/8 * s->channels;;
@@ -1552,56 +1622,8 @@ ape_decode_frame(DB_fileinfo_t *_info, void *data, int *data_size)
     }
 
     int skip = min (s->samplestoskip, blockstodecode);
-    i = skip;
-
-    if (_info->fmt.bps == 32) {
-        for (; i < blockstodecode; i++) {
-            *((int32_t*)samples) = s->decoded0[i];
-            samples += 4;
-            if(s->channels > 1) {
-                *((int32_t*)samples) = s->decoded1[i];
-                samples += 4;
-            }
-        }
-    }
-    else if (_info->fmt.bps == 24) {
-        for (; i < blockstodecode; i++) {
-            int32_t sample = s->decoded0[i];
+    ape_output_samples (s, _info->fmt.bps, samples, skip, blockstodecode);
 
-            samples[0] = sample&0xff;
-            samples[1] = (sample&0xff00)>>8;
-            samples[2] = (sample&0xff0000)>>16;
-            samples += 3;
-            if(s->channels > 1) {
-                sample = s->decoded1[i];
-                samples[0] = sample&0xff;
-                samples[1] = (sample&0xff00)>>8;
-                samples[2] = (sample&0xff0000)>>16;
-                samples += 3;
-            }
-        }
-    }
-    else if (_info->fmt.bps == 16) {
-        for (; i < blockstodecode; i++) {
-            *((int16_t*)samples) = (int16_t)s->decoded0[i];
-            samples += 2;
-            if(s->channels > 1) {
-                *((int16_t*)samples) = (int16_t)s->decoded1[i];
-                samples += 2;
-            }
-        }
-    }
-    else if (_info->fmt.bps == 8) {
-        for (; i < blockstodecode; i++) {
-            *samples = (int16_t)s->decoded0[i];
-            samples++;
-            if(s->channels > 1) {
-                *samples = (int16_t)s->decoded1[i];
-                samples++;
-            }
-        }
-    }
-    
     s->samplestoskip -= skip;
     s->samples -= blockstodecode;
 
@@ -1621,6 +1643,391 @@ error:
     return (int)bytes_used;
 }
 
+/**
+ * @defgroup parallel Frame-parallel decoding
+ * The frames are independently decodable, so the next frames are read ahead
+ * by the reading thread, decoded by a pool of workers with their own decoder
+ * contexts, and consumed in order from a ring of frame slots.
+ * @{
+ */
+
+#define APE_MAX_DECODE_THREADS 16
+
+enum {
+    APE_SLOT_FREE,
+    APE_SLOT_PENDING,   ///< frame data is read, waiting for a worker
+    APE_SLOT_DECODING,
+    APE_SLOT_DONE,
+};
+
+typedef struct {
+    int state;
+    int frame;
+    int error;
+    uint8_t *input;     ///< frame data, in the same layout as the packet data of the serial decoder
+    int input_size;
+    int input_len;
+    uint8_t *output;    ///< decoded frame, in the stream format
+    int output_size;
+    int output_len;
+    int output_pos;     ///< number of consumed bytes
+} APEFrameSlot;
+
+typedef struct ape_parallel_s ape_parallel_t;
+
+typedef struct {
+    ape_parallel_t *parallel;
+    APEContext ctx;
+    intptr_t tid;
+} APEWorker;
+
+struct ape_parallel_s {
+    uintptr_t mutex;
+    uintptr_t cond;
+    int quit;
+    int bps;
+    int nworkers;
+    APEWorker *workers;
+    int nslots;
+    APEFrameSlot *slots;
+    int nextframe;      ///< next frame to read
+};
+
+/* Decode a whole frame, the same way as ape_decode_frame does in chunks */
+static int ape_decode_frame_data(APEContext *s, int bps, APEFrameSlot *slot)
+{
+    int samplesize = bps/8 * s->channels;
+    char *samples = (char *)slot->output;
+
+    s->ptr = s->last_ptr = slot->input;
+    s->data_end = slot->input + slot->input_len;
+    slot->output_len = 0;
+
+    int nblocks = s->samples = bytestream_get_be32(&s->ptr);
+    int n = bytestream_get_be32(&s->ptr);
+    if (n < 0 || n > 3) {
+        trace ("ape: Incorrect offset passed\n");
+        return -1;
+    }
+    s->ptr += n;
+
+    s->currentframeblocks = nblocks;
+    if (nblocks <= 0) {
+        return 0;
+    }
+    if (nblocks * samplesize > slot->output_size) {
+        return -1;
+    }
+
+    memset(s->decoded0,  0, sizeof(s->decoded0));
+    memset(s->decoded1,  0, sizeof(s->decoded1));
+    init_frame_decoder(s);
+
+    while (s->samples > 0) {
+        int blockstodecode = min(BLOCKS_PER_LOOP, s->samples);
+
+        s->error=0;
+
+        if ((s->channels == 1) || (s->frameflags & APE_FRAMECODE_PSEUDO_STEREO))
+            ape_unpack_mono(s, blockstodecode);
+        else
+            ape_unpack_stereo(s, blockstodecode);
+
+        if(s->error || s->ptr >= s->data_end){
+            s->samples=0;
+            return -1;
+        }
+
+        samples = ape_output_samples (s, bps, samples, 0, blockstodecode);
+        s->samples -= blockstodecode;
+    }
+
+    slot->output_len = (int)(samples - (char *)slot->output);
+    return 0;
+}
+
+static void
+ape_parallel_worker (void *ctx) {
+    APEWorker *worker = ctx;
+    ape_parallel_t *par = worker->parallel;
+
+    deadbeef->mutex_lock (par->mutex);
+    while (!par->quit) {
+        // decode the earliest pending frame first, since it is going to be consumed first
+        APEFrameSlot *slot = NULL;
+        for (int i = 0; i < par->nslots; i++) {
+            if (par->slots[i].state == APE_SLOT_PENDING && (!slot || par->slots[i].frame < slot->frame)) {
+                slot = &par->slots[i];
+            }
+        }
+        if (!slot) {
+            deadbeef->cond_wait (par->cond, par->mutex);
+            continue;
+        }
+        slot->state = APE_SLOT_DECODING;
+        deadbeef->mutex_unlock (par->mutex);
+
+        int res = ape_decode_frame_data (&worker->ctx, par->bps, slot);
+
+        deadbeef->mutex_lock (par->mutex);
+        slot->error = res < 0;
+        slot->output_pos = 0;
+        slot->state = APE_SLOT_DONE;
+        deadbeef->cond_broadcast (par->cond);
+    }
+    deadbeef->mutex_unlock (par->mutex);
+}
+
+/* Read the whole frame into the slot, the same way as ape_read_packet and ape_decode_frame do in chunks */
+static int ape_read_frame(DB_FILE *fp, APEContext *ape, int frame, APEFrameSlot *slot)
+{
+    int size = ape->frames[frame].size;
+    if (size < 0 || size > INT_MAX - 16) {
+        return -1;
+    }
+
+    int input_size = size + 16;
+    if (slot->input_size < input_size) {
+        free (slot->input);
+        slot->input = malloc (input_size);
+        if (!slot->input) {
+            slot->input_size = 0;
+            return -1;
+        }
+        slot->input_size = input_size;
+    }
+
+    if (deadbeef->fseek (fp, ape->frames[frame].pos + ape->skip_header, SEEK_SET) != 0) {
+        return -1;
+    }
+
+    AV_WL32(slot->input    , ape_frame_nblocks(ape, frame));
+    AV_WL32(slot->input + 4, ape->frames[frame].skip);
+
+    // the serial decoder reads 8 bytes past the frame size
+    size_t r = deadbeef->fread (slot->input + 8, 1, size + 8, fp);
+    slot->input_len = 8 + (int)(r & ~3);
+    bswap_buf((uint32_t*)slot->input, (const uint32_t*)slot->input, slot->input_len >> 2);
+
+    slot->frame = frame;
+    slot->error = 0;
+    return 0;
+}
+
+/* Wait for the workers to finish the frames in progress, and drop all frames */
+static void
+ape_parallel_reset (ape_info_t *info) {
+    ape_parallel_t *par = info->parallel;
+    deadbeef->mutex_lock (par->mutex);
+    for (int i = 0; i < par->nslots; i++) {
+        while (par->slots[i].state == APE_SLOT_DECODING) {
+            deadbeef->cond_wait (par->cond, par->mutex);
+        }
+    }
+    for (int i = 0; i < par->nslots; i++) {
+        par->slots[i].state = APE_SLOT_FREE;
+    }
+    par->nextframe = info->ape_ctx.currentframe;
+    deadbeef->mutex_unlock (par->mutex);
+}
+
+/* Read the frames ahead of the current one, to keep all slots busy */
+static void
+ape_parallel_schedule (ape_info_t *info) {
+    ape_parallel_t *par = info->parallel;
+    APEContext *s = &info->ape_ctx;
+
+    if (par->nextframe < s->currentframe) {
+        par->nextframe = s->currentframe;
+    }
+
+    while (par->nextframe < s->totalframes && par->nextframe < s->currentframe + par->nslots) {
+        APEFrameSlot *slot = &par->slots[par->nextframe % par->nslots];
+
+        // the slot of a consumed frame is only reused by this thread, so it can be filled without locking
+        deadbeef->mutex_lock (par->mutex);
+        int state = slot->state;
+        deadbeef->mutex_unlock (par->mutex);
+        if (state != APE_SLOT_FREE) {
+            break;
+        }
+
+        int res = ape_read_frame (info->fp, s, par->nextframe, slot);
+
+        deadbeef->mutex_lock (par->mutex);
+        if (res < 0) {
+            slot->frame = par->nextframe;
+            slot->error = 1;
+            slot->output_len = 0;
+            slot->state = APE_SLOT_DONE;
+        }
+        else {
+            slot->state = APE_SLOT_PENDING;
+            deadbeef->cond_signal (par->cond);
+        }
+        deadbeef->mutex_unlock (par->mutex);
+        par->nextframe++;
+    }
+}
+
+/* Same as ape_decode_frame, but takes the data from the frames decoded by the workers */
+static int
+ape_parallel_decode (ape_info_t *info, void *data, int *data_size) {
+    ape_parallel_t *par = info->parallel;
+    APEContext *s = &info->ape_ctx;
+    int samplesize = info->info.fmt.bps/8 * s->channels;
+
+    for (;;) {
+        if (s->currentframe >= s->totalframes) {
+            return -1;
+        }
+
+        ape_parallel_schedule (info);
+
+        APEFrameSlot *slot = &par->slots[s->currentframe % par->nslots];
+        deadbeef->mutex_lock (par->mutex);
+        while (slot->state != APE_SLOT_DONE) {
+            deadbeef->cond_wait (par->cond, par->mutex);
+        }
+        deadbeef->mutex_unlock (par->mutex);
+
+        if (slot->error) {
+            fprintf (stderr, "ape: Error decoding frame %d\n", slot->frame);
+            return -1;
+        }
+
+        if (slot->output_pos == 0) {
+            ape_update_bitrate (s, slot->frame, slot->output_len / samplesize);
+        }
+
+        int skip = min (s->samplestoskip, (slot->output_len - slot->output_pos) / samplesize);
+        slot->output_pos += skip * samplesize;
+        s->samplestoskip -= skip;
+
+        int avail = slot->output_len - slot->output_pos;
+        if (avail > 0) {
+            int sz = min (avail, *data_size);
+            memcpy (data, slot->output + slot->output_pos, sz);
+            slot->output_pos += sz;
+            *data_size = sz;
+            return sz;
+        }
+
+        deadbeef->mutex_lock (par->mutex);
+        slot->state = APE_SLOT_FREE;
+        deadbeef->mutex_unlock (par->mutex);
+        s->currentframe++;
+    }
+}
+
+static void
+ape_parallel_free (ape_info_t *info) {
+    ape_parallel_t *par = info->parallel;
+    if (!par) {
+        return;
+    }
+
+    deadbeef->mutex_lock (par->mutex);
+    par->quit = 1;
+    deadbeef->cond_broadcast (par->cond);
+    deadbeef->mutex_unlock (par->mutex);
+
+    for (int i = 0; i < par->nworkers; i++) {
+        APEWorker *worker = &par->workers[i];
+        if (worker->tid) {
+            deadbeef->thread_join (worker->tid);
+        }
+        for (int j = 0; j < APE_FILTER_LEVELS; j++) {
+            free (worker->ctx.filterbuf[j]);
+        }
+    }
+    free (par->workers);
+
+    for (int i = 0; i < par->nslots; i++) {
+        free (par->slots[i].input);
+        free (par->slots[i].output);
+    }
+    free (par->slots);
+
+    deadbeef->cond_free (par->cond);
+    deadbeef->mutex_free (par->mutex);
+    free (par);
+    info->parallel = NULL;
+}
+
+static int
+ape_parallel_start (ape_info_t *info, int nthreads) {
+    APEContext *s = &info->ape_ctx;
+    if (nthreads > APE_MAX_DECODE_THREADS) {
+        nthreads = APE_MAX_DECODE_THREADS;
+    }
+
+    ape_parallel_t *par = calloc (1, sizeof (ape_parallel_t));
+    if (!par) {
+        return -1;
+    }
+    info->parallel = par;
+    par->mutex = deadbeef->mutex_create_nonrecursive ();
+    par->cond = deadbeef->cond_create ();
+    par->bps = info->info.fmt.bps;
+    par->nextframe = s->currentframe;
+
+    // two frames per worker, so that the workers don't wait for the reader
+    par->nslots = nthreads * 2;
+    par->slots = calloc (par->nslots, sizeof (APEFrameSlot));
+    if (!par->slots) {
+        goto error;
+    }
+    int output_size = s->blocksperframe * (par->bps/8) * s->channels;
+    for (int i = 0; i < par->nslots; i++) {
+        par->slots[i].output = malloc (output_size);
+        if (!par->slots[i].output) {
+            goto error;
+        }
+        par->slots[i].output_size = output_size;
+    }
+
+    par->workers = calloc (nthreads, sizeof (APEWorker));
+    if (!par->workers) {
+        goto error;
+    }
+    for (int i = 0; i < nthreads; i++) {
+        APEWorker *worker = &par->workers[i];
+        worker->parallel = par;
+
+        // the header fields are shared, the decoding state is per worker
+        memcpy (&worker->ctx, s, sizeof (APEContext));
+        worker->ctx.frames = NULL;
+        worker->ctx.seektable = NULL;
+        worker->ctx.packet_data = NULL;
+        memset (worker->ctx.filterbuf, 0, sizeof (worker->ctx.filterbuf));
+        par->nworkers++;
+
+        for (int j = 0; j < APE_FILTER_LEVELS; j++) {
+            if (!s->filterbuf[j]) {
+                break;
+            }
+            int err = posix_memalign ((void **)&worker->ctx.filterbuf[j], 16, s->filterbuf_size[j]);
+            if (err) {
+                worker->ctx.filterbuf[j] = NULL;
+                goto error;
+            }
+        }
+
+        worker->tid = deadbeef->thread_start (ape_parallel_worker, worker);
+        if (!worker->tid) {
+            goto error;
+        }
+    }
+
+    return 0;
+
+error:
+    ape_parallel_free (info);
+    return -1;
+}
+/** @} */ // group parallel
+
 static DB_playItem_t *
 ffap_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     APEContext ape_ctx;
@@ -1739,7 +2146,7 @@ ffap_read (DB_fileinfo_t *_info, char *buffer, int size) {
         assert (info->ape_ctx.remaining <= s/2);
         s -= info->ape_ctx.remaining;
         uint8_t *buf = info->ape_ctx.buffer + info->ape_ctx.remaining;
-        int n = ape_decode_frame (_info, buf, &s);
+        int n = info->parallel ? ape_parallel_decode (info, buf, &s) : ape_decode_frame (_info, buf, &s);
         if (n == -1) {
             break;
         }
@@ -1806,6 +2213,9 @@ ffap_seek_sample (DB_fileinfo_t *_info, int sample) {
     info->ape_ctx.packet_remaining = 0;
     info->ape_ctx.samples = 0;
     info->ape_ctx.currentsample = newsample;
+    if (info->parallel) {
+        ape_parallel_reset (info);
+    }
     _info->readpos = (float)(newsample-info->startsample)/info->ape_ctx.samplerate;
     return 0;
 }
@@ -1825,9 +2235,7 @@ static int ffap_read_metadata (DB_playItem_t *it) {
         return -1;
     }
     deadbeef->pl_delete_all_meta (it);
-    /*int apeerr = */deadbeef->junk_apev2_read (it, fp);
-    /*int v2err = */deadbeef->junk_id3v2_read (it, fp);
-    /*int v1err = */deadbeef->junk_id3v1_read (it, fp);
+    /*int tagerr = */deadbeef->junk_read_tags (it, fp, NULL, NULL);
     deadbeef->pl_add_meta (it, "title", NULL);
     deadbeef->fclose (fp);
     return 0;
@@ -1867,6 +2275,10 @@ static int ffap_write_metadata (DB_playItem_t *it) {
 
 static const char *exts[] = { "ape", NULL };
 
+static const char settings_dlg[] =
+    "property \"Frame-parallel decoding threads (0 to disable)\" spinbtn[0,16,1] ffap.decode_threads 0;\n"
+;
+
 // define plugin interface
 static DB_decoder_t plugin = {
     DDB_PLUGIN_SET_API_VERSION
@@ -1897,6 +2309,7 @@ static DB_decoder_t plugin = {
         "Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.\n"
     ,
     .plugin.website = "http://deadbeef.sf.net",
+    .plugin.configdialog = settings_dlg,
     .open = ffap_open,
     .init = ffap_init,
     .free = ffap_free,
@@ -1911,7 +2324,9 @@ static DB_decoder_t plugin = {
 
 #if HAVE_SSE2 && !ARCH_UNKNOWN
 
+#ifdef APE_USE_ASM
 int32_t ff_scalarproduct_and_madd_int16_sse2(int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul);
+#endif
 
 #define FF_MM_MMX      0x0001 ///< standard MMX
 #define FF_MM_3DNOW    0x0004 ///< AMD 3DNOW
@@ -1925,6 +2340,7 @@ int32_t ff_scalarproduct_and_madd_int16_sse2(int16_t *v1, const int16_t *v2, con
 #define FF_MM_SSE42    0x0200 ///< Nehalem SSE4.2 functions
 #define FF_MM_IWMMXT   0x0100 ///< XScale IWMMXT
 #define FF_MM_ALTIVEC  0x0001 ///< standard AltiVec
+#define FF_MM_AVX2     0x8000 ///< AVX2 functions
 
 #ifdef __APPLE__
 #define mm_support() FF_MM_SSE2
@@ -1939,6 +2355,15 @@ int32_t ff_scalarproduct_and_madd_int16_sse2(int16_t *v1, const int16_t *v2, con
            "=c" (ecx), "=d" (edx)\
          : "0" (index));
 
+#define cpuid_count(index,count,eax,ebx,ecx,edx)\
+    __asm__ volatile\
+        ("mov %%"REG_b", %%"REG_S"\n\t"\
+         "cpuid\n\t"\
+         "xchg %%"REG_b", %%"REG_S\
+         : "=a" (eax), "=S" (ebx),\
+           "=c" (ecx), "=d" (edx)\
+         : "0" (index), "2" (count));
+
 /* Function to test if multimedia instructions are supported...  */
 int mm_support(void)
 {
@@ -1995,6 +2420,16 @@ int mm_support(void)
             rval |= FF_MM_SSE4;
         if (ecx & 0x00100000 )
             rval |= FF_MM_SSE42;
+        // AVX2 also needs the OS to save the ymm registers (OSXSAVE, AVX and XCR0 bits)
+        if ((ecx & 0x18000000) == 0x18000000 && max_std_level >= 7) {
+            int xcr0_lo, xcr0_hi;
+            __asm__ volatile ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+            if ((xcr0_lo & 6) == 6) {
+                cpuid_count(7, 0, eax, ebx, ecx, edx);
+                if (ebx & (1<<5))
+                    rval |= FF_MM_AVX2;
+            }
+        }
 #endif
                   ;
     }
@@ -2027,23 +2462,30 @@ int32_t EXTERN_ASMff_scalarproduct_and_madd_int16_neon(int16_t *v1, const int16_
 
 DB_plugin_t *
 ffap_load (DB_functions_t *api) {
-    // detect sse2
+    scalarproduct_and_madd_int16 = ape_scalarproduct_and_madd_int16_c;
 #if ARCH_ARM
-        scalarproduct_and_madd_int16 = EXTERN_ASMff_scalarproduct_and_madd_int16_neon;
-#elif HAVE_SSE2 && !ARCH_UNKNOWN
-    trace ("ffap: was compiled with sse2 support\n");
+    scalarproduct_and_madd_int16 = EXTERN_ASMff_scalarproduct_and_madd_int16_neon;
+#elif APE_DSP_NEON
+    trace ("ffap: using neon intrinsics\n");
+    scalarproduct_and_madd_int16 = ape_scalarproduct_and_madd_int16_neon;
+#elif HAVE_SSE2 && !ARCH_UNKNOWN && APE_DSP_X86
+    // detect sse2 / avx2
     int mm_flags = mm_support ();
-    if (mm_flags & FF_MM_SSE2) {
+    if (mm_flags & FF_MM_AVX2) {
+        trace ("ffap: avx2 support detected\n");
+        scalarproduct_and_madd_int16 = ape_scalarproduct_and_madd_int16_avx2;
+    }
+    else if (mm_flags & FF_MM_SSE2) {
         trace ("ffap: sse2 support detected\n");
+#ifdef APE_USE_ASM
         scalarproduct_and_madd_int16 = ff_scalarproduct_and_madd_int16_sse2;
+#else
+        scalarproduct_and_madd_int16 = ape_scalarproduct_and_madd_int16_sse2;
+#endif
     }
     else {
         trace ("ffap: sse2 is not supported by CPU\n");
-        scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_c;
     }
-#else
-//    trace ("ffap: sse2 support was not compiled in\n");
-    scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_c;
 #endif
     deadbeef = api;
     return DB_PLUGIN (&plugin);
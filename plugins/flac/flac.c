@@ -149,67 +149,16 @@ cflac_write_callback (const FLAC__StreamDecoder *decoder, const FLAC__Frame *fra
 
     unsigned bps = FLAC__stream_decoder_get_bits_per_sample(decoder);
 
-    if (bps == 16) {
-        for (int i = 0; i <  nsamples; i++) {
-            for (int c = 0; c < channels; c++) {
-                int32_t sample = inputbuffer[c][i];
-                *bufptr++ = sample&0xff;
-                *bufptr++ = (sample&0xff00)>>8;
-            }
-        }
-    }
-    else if (bps == 24) {
-        for (int i = 0; i <  nsamples; i++) {
-            for (int c = 0; c < channels; c++) {
-                int32_t sample = inputbuffer[c][i];
-                *bufptr++ = sample&0xff;
-                *bufptr++ = (sample&0xff00)>>8;
-                *bufptr++ = (sample&0xff0000)>>16;
-            }
-        }
-    }
-    else if (bps == 32) {
-        for (int i = 0; i <  nsamples; i++) {
-            for (int c = 0; c < channels; c++) {
-                int32_t sample = inputbuffer[c][i];
-                *((int32_t*)bufptr) = sample;
-                bufptr += 4;
-            }
-        }
+    // non-byte-aligned samples are shifted up to the output bps
+    int written = -1;
+    if (bps > 0 && bps <= (unsigned)_info->fmt.bps) {
+        written = deadbeef->pcm_interleave (&_info->fmt, (const void * const *)inputbuffer, 1, _info->fmt.bps - bps, bufptr, nsamples);
     }
-    else if (bps == 8) {
-        for (int i = 0; i <  nsamples; i++) {
-            for (int c = 0; c < channels; c++) {
-                int32_t sample = inputbuffer[c][i];
-                *bufptr++ = sample&0xff;
-            }
-        }
-    }
-    else if (bps & 7) {
-        // support for non-byte-aligned bps
-        unsigned shift = _info->fmt.bps - bps;
-        bps = _info->fmt.bps;
-        int nsamples = min(bufsize / samplesize, frame->header.blocksize);
-        for (int s = 0; s < nsamples; s++) {
-            for (int c = 0; c < channels; c++) {
-                FLAC__int32 sample = inputbuffer[c][s] << shift;
-                *bufptr++ = sample & 0xff;
-                if (bps > 8) {
-                    *bufptr++ = (sample>>8) & 0xff;
-                    if (bps > 16) {
-                        *bufptr++ = (sample>>16) & 0xff;
-                        if (bps > 24) {
-                            *bufptr++ = (sample>>24) & 0xff;
-                        }
-                    }
-                 }
-             }
-         }
-    }
-    else {
+    if (written < 0) {
         trace ("flac: unsupported bits per sample: %d\n", bps);
         return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     }
+    bufptr += written;
 
     info->remaining = (int)(bufptr - info->buffer);
 
@@ -693,6 +642,18 @@ cflac_add_metadata (DB_playItem_t *it, const char *s, int length) {
     }
 }
 
+// Called after all the comments of a VORBIS_COMMENT block were added with cflac_add_metadata
+static void
+cflac_finish_vorbis_comments (DB_playItem_t *it, uint32_t num_comments) {
+    deadbeef->pl_add_meta (it, "title", NULL);
+    if (num_comments > 0) {
+        uint32_t f = deadbeef->pl_get_item_flags (it);
+        f &= ~DDB_TAG_MASK;
+        f |= DDB_TAG_VORBISCOMMENTS;
+        deadbeef->pl_set_item_flags (it, f);
+    }
+}
+
 static void
 cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data) {
     flac_info_t *info = (flac_info_t *)client_data;
@@ -725,13 +686,7 @@ cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__Str
                 cflac_add_metadata (it, s, c->length);
             }
         }
-        deadbeef->pl_add_meta (it, "title", NULL);
-        if (vc->num_comments > 0) {
-            uint32_t f = deadbeef->pl_get_item_flags (it);
-            f &= ~DDB_TAG_MASK;
-            f |= DDB_TAG_VORBISCOMMENTS;
-            deadbeef->pl_set_item_flags (it, f);
-        }
+        cflac_finish_vorbis_comments (it, vc->num_comments);
         info->got_vorbis_comments = 1;
     }
     else if (metadata->type == FLAC__METADATA_TYPE_CUESHEET) {
@@ -741,6 +696,177 @@ cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__Str
     }
 }
 
+// Direct metadata block parser, used by cflac_insert instead of initializing a libFLAC decoder.
+// It handles the common case of a native FLAC file with STREAMINFO and VORBIS_COMMENT blocks,
+// and skips PICTURE and other blocks without reading them.
+// Everything else (cuesheet blocks, damaged files) is left to libFLAC.
+
+#define FLAC_PROBE_BUFFER_SIZE 65536
+#define FLAC_PROBE_MAX_VORBIS_COMMENT_SIZE (16*1024*1024)
+
+typedef struct {
+    int samplerate;
+    int channels;
+    int bps;
+    int64_t totalsamples;
+    int64_t audio_offset; // absolute offset of the first audio frame
+    uint8_t *vorbis_comment;
+    uint32_t vorbis_comment_size;
+} flac_probe_t;
+
+static uint32_t
+flac_probe_le32 (const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int
+flac_probe_validate_vorbis_comment (const uint8_t *data, uint32_t size) {
+    if (size < 8) {
+        return -1;
+    }
+    uint32_t vendor_length = flac_probe_le32 (data);
+    if (vendor_length > size - 8) {
+        return -1;
+    }
+    const uint8_t *p = data + 4 + vendor_length;
+    const uint8_t *end = data + size;
+    uint32_t count = flac_probe_le32 (p);
+    p += 4;
+    for (uint32_t i = 0; i < count; i++) {
+        if (end - p < 4) {
+            return -1;
+        }
+        uint32_t length = flac_probe_le32 (p);
+        p += 4;
+        if (length > (size_t)(end - p)) {
+            return -1;
+        }
+        p += length;
+    }
+    return 0;
+}
+
+// Returns 0 on success, or -1 if libFLAC needs to be used.
+// The vorbis_comment buffer must be freed by the caller on success.
+static int
+cflac_probe_metadata (DB_FILE *file, int64_t skip, flac_probe_t *probe) {
+    memset (probe, 0, sizeof (flac_probe_t));
+
+    uint8_t *buffer = malloc (FLAC_PROBE_BUFFER_SIZE);
+    if (!buffer) {
+        return -1;
+    }
+    if (deadbeef->fseek (file, skip, SEEK_SET)) {
+        free (buffer);
+        return -1;
+    }
+    size_t buffer_size = deadbeef->fread (buffer, 1, FLAC_PROBE_BUFFER_SIZE, file);
+    if (buffer_size < 4 + 4 + 34 || memcmp (buffer, "fLaC", 4)) {
+        free (buffer);
+        return -1;
+    }
+
+    int got_streaminfo = 0;
+    int last = 0;
+    size_t pos = 4; // relative to skip
+    while (!last) {
+        uint8_t header[4];
+        if (pos + 4 <= buffer_size) {
+            memcpy (header, buffer + pos, 4);
+        }
+        else if (deadbeef->fseek (file, skip + pos, SEEK_SET) || deadbeef->fread (header, 1, 4, file) != 4) {
+            goto error;
+        }
+        last = header[0] & 0x80;
+        int type = header[0] & 0x7f;
+        uint32_t length = (header[1] << 16) | (header[2] << 8) | header[3];
+        pos += 4;
+
+        if (!got_streaminfo && type != FLAC__METADATA_TYPE_STREAMINFO) {
+            goto error;
+        }
+
+        if (type == FLAC__METADATA_TYPE_STREAMINFO) {
+            if (got_streaminfo || length < 34 || pos + 34 > buffer_size) {
+                goto error;
+            }
+            const uint8_t *si = buffer + pos;
+            probe->samplerate = (si[10] << 12) | (si[11] << 4) | (si[12] >> 4);
+            probe->channels = ((si[12] >> 1) & 7) + 1;
+            probe->bps = (((si[12] & 1) << 4) | (si[13] >> 4)) + 1;
+            probe->totalsamples = ((int64_t)(si[13] & 0x0f) << 32) | ((uint32_t)si[14] << 24) | (si[15] << 16) | (si[16] << 8) | si[17];
+            if (probe->samplerate <= 0 || probe->bps < 4) {
+                goto error;
+            }
+            got_streaminfo = 1;
+        }
+        else if (type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
+            if (probe->vorbis_comment || length > FLAC_PROBE_MAX_VORBIS_COMMENT_SIZE) {
+                goto error;
+            }
+            probe->vorbis_comment = malloc (length);
+            if (!probe->vorbis_comment) {
+                goto error;
+            }
+            probe->vorbis_comment_size = length;
+            if (pos + length <= buffer_size) {
+                memcpy (probe->vorbis_comment, buffer + pos, length);
+            }
+            else if (deadbeef->fseek (file, skip + pos, SEEK_SET) || deadbeef->fread (probe->vorbis_comment, 1, length, file) != length) {
+                goto error;
+            }
+            if (flac_probe_validate_vorbis_comment (probe->vorbis_comment, length)) {
+                goto error;
+            }
+        }
+        else if (type == FLAC__METADATA_TYPE_CUESHEET || type == 127) {
+            // cuesheets are parsed by libFLAC; 127 is an invalid block type
+            goto error;
+        }
+        // everything else, including PICTURE, is skipped
+
+        pos += length;
+    }
+
+    free (buffer);
+    buffer = NULL;
+    probe->audio_offset = skip + pos;
+    int64_t fsize = deadbeef->fgetlength (file);
+    if (fsize >= 0 && probe->audio_offset > fsize) {
+        goto error;
+    }
+    return 0;
+
+error:
+    free (buffer);
+    free (probe->vorbis_comment);
+    probe->vorbis_comment = NULL;
+    return -1;
+}
+
+static void
+cflac_add_probed_vorbis_comment (DB_playItem_t *it, const uint8_t *data) {
+    const uint8_t *p = data + 4 + flac_probe_le32 (data);
+    uint32_t count = flac_probe_le32 (p);
+    p += 4;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t length = flac_probe_le32 (p);
+        p += 4;
+        if (length > 0) {
+            // cflac_add_metadata needs a terminated string
+            char *s = malloc (length + 1);
+            if (s) {
+                memcpy (s, p, length);
+                s[length] = 0;
+                cflac_add_metadata (it, s, length);
+                free (s);
+            }
+        }
+        p += length;
+    }
+    cflac_finish_vorbis_comments (it, count);
+}
+
 static DB_playItem_t *
 cflac_insert_with_embedded_cue (ddb_playlist_t *plt, DB_playItem_t *after, DB_playItem_t *origin, const FLAC__StreamMetadata_CueSheet *cuesheet, uint64_t totalsamples, int samplerate) {
     deadbeef->pl_lock ();
@@ -886,40 +1012,68 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     }
     info.init_stop_decoding = 0;
 
-    // open decoder for metadata reading
-    FLAC__StreamDecoderInitStatus status;
-    decoder = FLAC__stream_decoder_new();
-    if (!decoder) {
-        trace ("flac: failed to create decoder\n");
-        goto cflac_insert_fail;
-    }
-
-    // read all metadata
-    FLAC__stream_decoder_set_md5_checking(decoder, 0);
-    FLAC__stream_decoder_set_metadata_respond_all (decoder);
+    int is_streaming = info.file->vfs->is_streaming ();
 
     it = info.it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);;
 
-    if (isogg) {
-        status = FLAC__stream_decoder_init_ogg_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
+    // try reading the metadata blocks directly first, it's much faster than initializing the decoder
+    flac_probe_t probe;
+    int probed = !isogg && !is_streaming && !cflac_probe_metadata (info.file, skip, &probe);
+    if (probed) {
+        trace ("flac: samplerate=%d, channels=%d, totalsamples=%lld (probed)\n", probe.samplerate, probe.channels, (long long)probe.totalsamples);
+        _info->fmt.samplerate = probe.samplerate;
+        _info->fmt.channels = probe.channels;
+        _info->fmt.bps = fix_bps (probe.bps);
+        info.totalsamples = probe.totalsamples;
+        if (probe.totalsamples > 0) {
+            deadbeef->plt_set_item_duration (plt, it, probe.totalsamples / (float)probe.samplerate);
+        }
+        else {
+            deadbeef->plt_set_item_duration (plt, it, -1);
+        }
+        if (probe.vorbis_comment) {
+            cflac_add_probed_vorbis_comment (it, probe.vorbis_comment);
+            free (probe.vorbis_comment);
+            info.got_vorbis_comments = 1;
+        }
     }
     else {
-        status = FLAC__stream_decoder_init_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
-    }
-    if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK || info.init_stop_decoding) {
-        trace ("flac: FLAC__stream_decoder_init_stream [2] failed\n");
-        goto cflac_insert_fail;
-    }
-    if (!FLAC__stream_decoder_process_until_end_of_metadata (decoder) || info.init_stop_decoding) {
-        trace ("flac: FLAC__stream_decoder_process_until_end_of_metadata [2] failed\n");
-        goto cflac_insert_fail;
+        if (!isogg) {
+            deadbeef->fseek (info.file, skip, SEEK_SET);
+        }
+
+        // open decoder for metadata reading
+        FLAC__StreamDecoderInitStatus status;
+        decoder = FLAC__stream_decoder_new();
+        if (!decoder) {
+            trace ("flac: failed to create decoder\n");
+            goto cflac_insert_fail;
+        }
+
+        // read all metadata
+        FLAC__stream_decoder_set_md5_checking(decoder, 0);
+        FLAC__stream_decoder_set_metadata_respond_all (decoder);
+
+        if (isogg) {
+            status = FLAC__stream_decoder_init_ogg_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
+        }
+        else {
+            status = FLAC__stream_decoder_init_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
+        }
+        if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK || info.init_stop_decoding) {
+            trace ("flac: FLAC__stream_decoder_init_stream [2] failed\n");
+            goto cflac_insert_fail;
+        }
+        if (!FLAC__stream_decoder_process_until_end_of_metadata (decoder) || info.init_stop_decoding) {
+            trace ("flac: FLAC__stream_decoder_process_until_end_of_metadata [2] failed\n");
+            goto cflac_insert_fail;
+        }
     }
 
     if (info.info.fmt.samplerate <= 0) {
         goto cflac_insert_fail;
     }
     int64_t fsize = deadbeef->fgetlength (info.file);
-    int is_streaming = info.file->vfs->is_streaming ();
 
     deadbeef->pl_add_meta (it, ":FILETYPE", isogg ? "OggFLAC" : "FLAC");
 
@@ -933,7 +1087,10 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     snprintf (s, sizeof (s), "%d", info.info.fmt.samplerate);
     deadbeef->pl_add_meta (it, ":SAMPLERATE", s);
     if ( deadbeef->pl_get_item_duration (it) > 0) {
-        if (!isogg) {
+        if (probed) {
+            fsize -= probe.audio_offset;
+        }
+        else if (!isogg) {
             FLAC__uint64 position;
             if (FLAC__stream_decoder_get_decode_position (decoder, &position))
                 fsize -= position;
@@ -947,8 +1104,10 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 #endif
         deadbeef->pl_set_meta_int (it, ":BITRATE", (int)roundf(fsize / deadbeef->pl_get_item_duration (it) * 8 / 1000));
     }
-    FLAC__stream_decoder_delete(decoder);
-    decoder = NULL;
+    if (decoder) {
+        FLAC__stream_decoder_delete(decoder);
+        decoder = NULL;
+    }
 
     deadbeef->fclose (info.file);
     info.file = NULL;
@@ -40,6 +40,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include "gmewrap.h"
+#include "../../shared/lengthcache.h"
 
 #define trace(...) { deadbeef->log_detailed (&plugin.plugin, 0, __VA_ARGS__); }
 
@@ -52,6 +53,7 @@ static int conf_fadeout = 10;
 static int conf_loopcount = 2;
 static int conf_play_forever = 0;
 static char *coleco_rom;
+static lengthcache_t *lengthcache;
 
 typedef struct {
     DB_fileinfo_t info;
@@ -180,6 +182,49 @@ error:
     return res;
 }
 
+// Opens the file with gzip support, and falls back to reading it as is
+static gme_err_t
+cgme_open_emu (const char *fname, int samplerate, Music_Emu **emu) {
+    gme_err_t res = "gme uninitialized";
+    char *buffer = NULL;
+    int sz;
+    if (!read_gzfile (fname, &buffer, &sz)) {
+        res = gme_open_data (buffer, sz, emu, samplerate);
+    }
+    free (buffer);
+    if (res) {
+        DB_FILE *f = deadbeef->fopen (fname);
+        if (!f) {
+            return res;
+        }
+        int64_t sz = deadbeef->fgetlength (f);
+        if (sz <= 0) {
+            deadbeef->fclose (f);
+            return res;
+        }
+        char *buf = malloc (sz);
+        if (!buf) {
+            deadbeef->fclose (f);
+            return res;
+        }
+        int64_t rb = deadbeef->fread (buf, 1, sz, f);
+        deadbeef->fclose(f);
+        if (rb != sz) {
+            free (buf);
+            return res;
+        }
+
+        res = gme_open_data (buf, sz, emu, samplerate);
+        free (buf);
+    }
+    return res;
+}
+
+static int
+_has_length_info (const gme_info_t *inf) {
+    return (inf->length != -1 && inf->length != 0) || (inf->loop_length > 0 && conf_loopcount > 0);
+}
+
 static float
 _get_duration (const gme_info_t *inf) {
     if (inf->length != -1 && inf->length != 0) {
@@ -203,41 +248,10 @@ cgme_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     gme_fileinfo_t *info = (gme_fileinfo_t*)_info;
     int samplerate = deadbeef->conf_get_int ("synth.samplerate", 44100);
 
-    gme_err_t res = "gme uninitialized";
     deadbeef->pl_lock ();
     const char *fname = strdupa(deadbeef->pl_find_meta (it, ":URI"));
     deadbeef->pl_unlock ();
-    char *buffer;
-    int sz;
-    if (!read_gzfile (fname, &buffer, &sz)) {
-        res = gme_open_data (buffer, sz, &info->emu, samplerate);
-        free (buffer);
-    }
-    if (res) {
-        DB_FILE *f = deadbeef->fopen (fname);
-        if (!f) {
-            return -1;
-        }
-        int64_t sz = deadbeef->fgetlength (f);
-        if (sz <= 0) {
-            deadbeef->fclose (f);
-            return -1;
-        }
-        char *buf = malloc (sz);
-        if (!buf) {
-            deadbeef->fclose (f);
-            return -1;
-        }
-        int64_t rb = deadbeef->fread (buf, 1, sz, f);
-        deadbeef->fclose(f);
-        if (rb != sz) {
-            free (buf);
-            return -1;
-        }
-
-        res = gme_open_data (buf, sz, &info->emu, samplerate);
-        free (buf);
-    }
+    gme_err_t res = cgme_open_emu (fname, samplerate, &info->emu);
 
     if (res) {
         trace ("failed with error %d\n", res);
@@ -254,6 +268,12 @@ cgme_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     _info->fmt.samplerate = samplerate;
     _info->fmt.channelmask = _info->fmt.channels == 1 ? DDB_SPEAKER_FRONT_LEFT : (DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT);
     info->duration = _get_duration(inf);
+    if (!_has_length_info (inf)) {
+        float probed;
+        if (!lengthcache_get (lengthcache, fname, deadbeef->pl_find_meta_int (it, ":TRACKNUM", 0), &probed) && probed > 0) {
+            info->duration = probed;
+        }
+    }
     info->reallength = inf->length;
     _info->readpos = 0;
     info->eof = 0;
@@ -357,40 +377,7 @@ cgme_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     Music_Emu *emu = NULL;
     trace ("gme_open_file %s\n", fname);
 
-    gme_err_t res = "gme uninitialized";
-
-    char *buffer = NULL;
-    int sz;
-    if (!read_gzfile (fname, &buffer, &sz)) {
-        res = gme_open_data (buffer, sz, &emu, gme_info_only);
-    }
-    free (buffer);
-    if (res) {
-        DB_FILE *f = deadbeef->fopen (fname);
-        if (!f) {
-            return NULL;
-        }
-        int64_t sz = deadbeef->fgetlength (f);
-        if (sz <= 0) {
-            deadbeef->fclose (f);
-            return NULL;
-        }
-        char *buf = malloc (sz);
-        if (!buf) {
-            deadbeef->fclose (f);
-            return NULL;
-        }
-        int64_t rb = deadbeef->fread (buf, 1, sz, f);
-        deadbeef->fclose(f);
-        if (rb != sz) {
-            free (buf);
-            return NULL;
-        }
-
-        res = gme_open_data (buf, sz, &emu, gme_info_only);
-        free (buf);
-    }
-
+    gme_err_t res = cgme_open_emu (fname, gme_info_only, &emu);
 
     if (!res) {
         int cnt = gme_track_count (emu);
@@ -441,7 +428,19 @@ cgme_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
                 deadbeef->pl_add_meta (it, ":GME_INTRO_LENGTH", str);
                 snprintf (str, sizeof(str), "%d", inf->loop_length);
                 deadbeef->pl_add_meta (it, ":GME_LOOP_LENGTH", str);
-                deadbeef->plt_set_item_duration (plt, it, _get_duration(inf));
+                // the tracks without length info get the default duration, until they're probed
+                float duration = _get_duration(inf);
+                int need_probe = 0;
+                if (!_has_length_info (inf)) {
+                    float probed;
+                    if (lengthcache_get (lengthcache, fname, i, &probed)) {
+                        need_probe = 1;
+                    }
+                    else if (probed > 0) {
+                        duration = probed;
+                    }
+                }
+                deadbeef->plt_set_item_duration (plt, it, duration);
                 const char *ext = fname + strlen (fname) - 1;
                 while (ext >= fname && *ext != '.') {
                     ext--;
@@ -459,6 +458,9 @@ cgme_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
                     deadbeef->pl_set_item_flags (it, deadbeef->pl_get_item_flags (it) | DDB_IS_SUBTRACK);
                 }
                 after = deadbeef->plt_insert_item (plt, after, it);
+                if (need_probe) {
+                    lengthcache_probe (lengthcache, it, fname, i);
+                }
                 deadbeef->pl_item_unref (it);
             }
             else {
@@ -480,13 +482,43 @@ static const char * exts[]=
 	"ay","gbs","gym","hes","kss","nsf","nsfe","sap","sfm","spc","vgm","vgz","sgc",NULL
 };
 
+// Plays the track until the emulator detects the end of the song by the silence,
+// or until the max song length
+static float
+cgme_probe_length (const char *fname, int subsong, const int *terminate, void *user_data) {
+    Music_Emu *emu = NULL;
+    if (cgme_open_emu (fname, 44100, &emu)) {
+        return -1;
+    }
+
+    float duration = -1;
+    if (!gme_start_track (emu, subsong)) {
+        int maxlength = (int)(deadbeef->conf_get_float ("gme.songlength", 3) * 60 * 1000);
+        short buffer[4096];
+        while (gme_tell (emu) < maxlength && !__atomic_load_n (terminate, __ATOMIC_RELAXED)) {
+            if (gme_play (emu, 4096, buffer)) {
+                break;
+            }
+            if (gme_track_ended (emu)) {
+                duration = gme_tell (emu) / 1000.f;
+                break;
+            }
+        }
+    }
+    gme_delete (emu);
+    return duration;
+}
+
 static int
 cgme_start (void) {
+    lengthcache = lengthcache_alloc (deadbeef, "gme", cgme_probe_length, NULL);
     return 0;
 }
 
 static int
 cgme_stop (void) {
+    lengthcache_free (lengthcache);
+    lengthcache = NULL;
     if (coleco_rom) {
         free (coleco_rom);
         coleco_rom = NULL;
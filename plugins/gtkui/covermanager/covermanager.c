@@ -153,19 +153,88 @@ error:
     return NULL;
 }
 
+static GdkPixbuf *
+_load_image_from_file (const char *fname) {
+    GdkPixbuf *img = NULL;
+    long size = 0;
+    char *buf = _buffer_from_file (fname, &size);
+    if (buf != NULL) {
+        GdkPixbufLoader *loader = gdk_pixbuf_loader_new ();
+        gdk_pixbuf_loader_write (loader, (const guchar *)buf, size, NULL);
+        gdk_pixbuf_loader_close (loader, NULL);
+        img = gdk_pixbuf_loader_get_pixbuf (loader);
+        free (buf);
+    }
+    return img;
+}
+
+static int
+_thumbnails_supported (covermanager_t *impl) {
+    DB_plugin_t *p = &impl->plugin->plugin.plugin;
+    return p->version_major == 2 && p->version_minor >= 1;
+}
+
+// Downscale the original image to the thumbnail size, and save it to the artwork cache.
+// Returns the thumbnail image, or the original image if it's already small enough.
+static GdkPixbuf *
+_create_thumbnail (covermanager_t *impl, const char *image_filename, GdkPixbuf *img, int thumbnail_size) {
+    GtkAllocation size = {
+        .width = gdk_pixbuf_get_width (img),
+        .height = gdk_pixbuf_get_height (img),
+    };
+
+    if (size.width <= thumbnail_size && size.height <= thumbnail_size) {
+        return img;
+    }
+
+    GtkAllocation new_size = {
+        .width = thumbnail_size,
+        .height = thumbnail_size,
+    };
+    new_size = covermanager_desired_size_for_image_size (impl, size, new_size);
+
+    GdkPixbuf *thumbnail = covermanager_create_scaled_image (impl, img, new_size);
+    gobj_unref (img);
+
+    gchar *data = NULL;
+    gsize data_size = 0;
+    if (gdk_pixbuf_save_to_buffer (thumbnail, &data, &data_size, "png", NULL, NULL)) {
+        impl->plugin->thumbnail_store (image_filename, thumbnail_size, data, data_size);
+        g_free (data);
+    }
+
+    return thumbnail;
+}
+
 static GdkPixbuf *
 _load_image_from_cover (covermanager_t *impl, ddb_cover_info_t *cover, int want_default) {
     GdkPixbuf *img = NULL;
 
     if (cover && cover->image_filename) {
-        long size = 0;
-        char *buf = _buffer_from_file (cover->image_filename, &size);
-        if (buf != NULL) {
-            GdkPixbufLoader *loader = gdk_pixbuf_loader_new ();
-            gdk_pixbuf_loader_write (loader, (const guchar *)buf, size, NULL);
-            gdk_pixbuf_loader_close (loader, NULL);
-            img = gdk_pixbuf_loader_get_pixbuf (loader);
-            free (buf);
+        int thumbnail_size = 0;
+        if (_thumbnails_supported (impl)) {
+            thumbnail_size = impl->plugin->thumbnail_size_for_size (impl->image_size);
+        }
+
+        if (thumbnail_size > 0) {
+            char thumbnail_path[PATH_MAX];
+            if (!impl->plugin->thumbnail_path (
+                    cover->image_filename,
+                    thumbnail_size,
+                    thumbnail_path,
+                    sizeof (thumbnail_path))) {
+                img = _load_image_from_file (thumbnail_path);
+            }
+
+            if (img == NULL) {
+                img = _load_image_from_file (cover->image_filename);
+                if (img != NULL) {
+                    img = _create_thumbnail (impl, cover->image_filename, img, thumbnail_size);
+                }
+            }
+        }
+        else {
+            img = _load_image_from_file (cover->image_filename);
         }
     }
 
@@ -982,6 +982,8 @@ gtkui_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
         });
     }
 
+    pl_common_text_cache_message (id, ctx, p1, p2);
+
     switch (id) {
     case DB_EV_SONGSTARTED: {
         ddb_event_track_t *ev = (ddb_event_track_t *)ctx;
@@ -34,6 +34,7 @@
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#include <dispatch/dispatch.h>
 #include <deadbeef/deadbeef.h>
 #include "../../artwork/artwork.h"
 #include "../actionhandlers.h"
@@ -59,6 +60,9 @@ extern GtkWidget *theme_button;
 #define NUM_ROWS_TO_NOTIFY_SINGLY 10
 #define BLANK_GROUP_SUBDIVISION 100
 
+// the groups of smaller playlists are built synchronously, to avoid flicker
+#define GROUPS_ASYNC_MIN_ITEMS 2000
+
 //#define trace(...) { fprintf(stderr, __VA_ARGS__); }
 #define trace(fmt, ...)
 
@@ -122,6 +126,9 @@ struct _DdbListviewPrivate {
     int artwork_subgroup_level;
     int subgroup_title_padding;
     int groups_build_idx; // must be the same as playlist modification idx
+    dispatch_queue_t groups_queue; // evaluates the group titles of large playlists
+    int groups_generation; // incremented on each build, to discard the outdated results
+    struct _DdbListviewGroupLayout **groups_cache; // the last evaluated layout, only accessed on groups_queue
     int grouptitle_height;
     int calculated_grouptitle_height;
 
@@ -167,6 +174,9 @@ static void
 ddb_listview_class_init (DdbListviewClass *klass);
 static void
 ddb_listview_init (DdbListview *listview);
+static void
+ddb_listview_dispose (GObject *object);
+
 static void
 ddb_listview_destroy (GObject *object);
 
@@ -174,6 +184,10 @@ ddb_listview_destroy (GObject *object);
 static void
 ddb_listview_build_groups (DdbListview *listview);
 
+typedef struct _DdbListviewGroupLayout DdbListviewGroupLayout;
+static void
+group_layout_free (DdbListviewGroupLayout *layout);
+
 static int
 ddb_listview_resize_subgroup (
     DdbListview *listview,
@@ -340,6 +354,7 @@ list_tooltip_handler (GtkWidget *widget, gint x, gint y, gboolean keyboard_mode,
 static void
 ddb_listview_class_init (DdbListviewClass *class) {
     GObjectClass *object_class = (GObjectClass *)class;
+    object_class->dispose = ddb_listview_dispose;
     object_class->finalize = ddb_listview_destroy;
     g_type_class_add_private (class, sizeof (DdbListviewPrivate));
 }
@@ -615,6 +630,8 @@ ddb_listview_init (DdbListview *listview) {
     priv->lock_columns = -1;
     priv->groups = NULL;
     priv->plt = NULL;
+    priv->groups_queue = dispatch_queue_create ("DdbListviewGroupsQueue", NULL);
+    priv->groups_cache = calloc (1, sizeof (DdbListviewGroupLayout *));
 
     priv->calculated_grouptitle_height = DEFAULT_GROUP_TITLE_HEIGHT;
 
@@ -630,6 +647,15 @@ ddb_listview_new (void) {
     return GTK_WIDGET (g_object_new (ddb_listview_get_type (), NULL));
 }
 
+// Called when the widget is destroyed, which can happen before the group builds holding a reference complete
+static void
+ddb_listview_dispose (GObject *object) {
+    DdbListviewPrivate *priv = DDB_LISTVIEW_GET_PRIVATE (DDB_LISTVIEW (object));
+    // discard the builds in progress, the child widgets are about to be destroyed
+    priv->groups_generation++;
+    G_OBJECT_CLASS (ddb_listview_parent_class)->dispose (object);
+}
+
 static void
 ddb_listview_destroy (GObject *object) {
     DdbListview *listview;
@@ -643,6 +669,15 @@ ddb_listview_destroy (GObject *object) {
 
     ddb_listview_free_all_groups (listview);
 
+    DdbListviewGroupLayout **groups_cache = priv->groups_cache;
+    dispatch_async (priv->groups_queue, ^{
+        group_layout_free (*groups_cache);
+        free (groups_cache);
+    });
+    priv->groups_cache = NULL;
+    dispatch_release (priv->groups_queue);
+    priv->groups_queue = NULL;
+
     while (priv->columns) {
         DdbListviewColumn *next = priv->columns->next;
         ddb_listview_column_free (listview, priv->columns);
@@ -3405,133 +3440,362 @@ calc_group_height (DdbListview *listview, DdbListviewGroup *grp, int min_height,
     return grp->height;
 }
 
-static int
-build_groups (DdbListview *listview) {
+#pragma mark - Group building
+
+// Snapshot of the playlist items, and the hashes of their group titles.
+// The titles are evaluated on groups_queue, without holding pl_lock,
+// and the previous layout is reused for the items which didn't move.
+struct _DdbListviewGroupLayout {
+    ddb_playlist_t *plt;
+    int group_depth;
+    char **formats;
+    char **bytecode; // compiled formats, handed over to the next layout with the same formats
+    int count;
+    DdbListviewIter *items;
+    uint64_t *keys; // count * group_depth title hashes, 0 for empty titles
+    void (*ref) (DdbListviewIter);
+    void (*unref) (DdbListviewIter);
+};
+
+// Must be called with pl_lock held
+static DdbListviewGroupLayout *
+group_layout_create (DdbListview *listview) {
     DdbListviewPrivate *priv = DDB_LISTVIEW_GET_PRIVATE (listview);
-    priv->groups_build_idx = listview->datasource->modification_idx ();
-    ddb_listview_free_all_groups (listview);
-    priv->plt = deadbeef->plt_get_curr ();
+    DdbListviewGroupLayout *layout = calloc (1, sizeof (DdbListviewGroupLayout));
+    layout->plt = deadbeef->plt_get_curr ();
+    layout->ref = listview->datasource->ref;
+    layout->unref = listview->datasource->unref;
 
+    for (DdbListviewGroupFormat *fmt = priv->group_formats; fmt; fmt = fmt->next) {
+        layout->group_depth++;
+    }
+    layout->formats = calloc (layout->group_depth, sizeof (char *));
+    int i = 0;
+    for (DdbListviewGroupFormat *fmt = priv->group_formats; fmt; fmt = fmt->next, i++) {
+        layout->formats[i] = strdup (fmt->format ? fmt->format : "");
+    }
+
+    int count = listview->datasource->count ();
+    layout->items = malloc (count * sizeof (DdbListviewIter));
     DdbListviewIter it = listview->datasource->head ();
-    if (!it) {
+    while (it && layout->count < count) {
+        layout->items[layout->count++] = it;
+        it = listview->datasource->next (it);
+    }
+    if (it) {
+        layout->unref (it);
+    }
+    return layout;
+}
+
+static void
+group_layout_free (DdbListviewGroupLayout *layout) {
+    if (!layout) {
+        return;
+    }
+    for (int i = 0; i < layout->count; i++) {
+        layout->unref (layout->items[i]);
+    }
+    for (int i = 0; i < layout->group_depth; i++) {
+        free (layout->formats[i]);
+        if (layout->bytecode && layout->bytecode[i]) {
+            deadbeef->tf_free (layout->bytecode[i]);
+        }
+    }
+    free (layout->bytecode);
+    if (layout->plt) {
+        deadbeef->plt_unref (layout->plt);
+    }
+    free (layout->formats);
+    free (layout->items);
+    free (layout->keys);
+    free (layout);
+}
+
+static uint64_t
+group_title_key (const char *title) {
+    if (!*title) {
         return 0;
     }
-    if (!priv->group_formats->format || !priv->group_formats->format[0]) {
-        priv->grouptitle_height = 0;
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (const uint8_t *p = (const uint8_t *)title; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+static int
+group_layout_same_formats (DdbListviewGroupLayout *layout, DdbListviewGroupLayout *prev) {
+    if (!prev || prev->group_depth != layout->group_depth) {
+        return 0;
+    }
+    for (int i = 0; i < layout->group_depth; i++) {
+        if (strcmp (prev->formats[i], layout->formats[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int
+group_layout_is_compatible (DdbListviewGroupLayout *layout, DdbListviewGroupLayout *prev) {
+    return prev && prev->plt == layout->plt && group_layout_same_formats (layout, prev);
+}
+
+// Evaluates the group titles of all items, reusing the titles and the compiled formats from the previous layout.
+// Called on groups_queue, which owns prev.
+static void
+group_layout_eval (DdbListviewGroupLayout *layout, DdbListviewGroupLayout *prev) {
+    const int depth = layout->group_depth;
+    layout->keys = calloc (layout->count * depth, sizeof (uint64_t));
+
+    // When items were inserted or removed, only the changed range is evaluated.
+    // Same count means that the playlist was sorted, or the metadata has changed.
+    int prefix = 0;
+    int suffix = 0;
+    if (group_layout_is_compatible (layout, prev) && prev->count != layout->count) {
+        int n = min (prev->count, layout->count);
+        while (prefix < n && prev->items[prefix] == layout->items[prefix]) {
+            prefix++;
+        }
+        while (suffix < n - prefix
+               && prev->items[prev->count - 1 - suffix] == layout->items[layout->count - 1 - suffix]) {
+            suffix++;
+        }
+        memcpy (layout->keys, prev->keys, prefix * depth * sizeof (uint64_t));
+        memcpy (layout->keys + (layout->count - suffix) * depth,
+                prev->keys + (prev->count - suffix) * depth,
+                suffix * depth * sizeof (uint64_t));
+    }
+
+    // the formats are only compiled when they change
+    if (prev && prev->bytecode && group_layout_same_formats (layout, prev)) {
+        layout->bytecode = prev->bytecode;
+        prev->bytecode = NULL;
     }
     else {
-        priv->grouptitle_height = priv->calculated_grouptitle_height;
+        layout->bytecode = calloc (depth, sizeof (char *));
+        for (int i = 0; i < depth; i++) {
+            layout->bytecode[i] = deadbeef->tf_compile (layout->formats[i]);
+        }
+    }
+    char **bytecode = layout->bytecode;
+
+    char title[1024];
+    for (int idx = prefix; idx < layout->count - suffix; idx++) {
+        for (int i = 0; i < depth; i++) {
+            title[0] = 0;
+            if (bytecode[i]) {
+                ddb_tf_context_t ctx = {
+                    ._size = sizeof (ddb_tf_context_t),
+                    .it = layout->items[idx],
+                    .plt = layout->plt,
+                    .flags = DDB_TF_CONTEXT_NO_DYNAMIC,
+                };
+                deadbeef->tf_eval (&ctx, bytecode[i], title, sizeof (title));
+                title[strcspn (title, "\r\n")] = 0;
+            }
+            layout->keys[idx * depth + i] = group_title_key (title);
+        }
     }
-    int group_depth = 1;
-    DdbListviewGroupFormat *fmt = priv->group_formats;
-    while (fmt->next) {
-        group_depth++;
-        fmt = fmt->next;
+}
+
+// Evaluates the group titles using the formats compiled by the datasource.
+// Must be called on the UI thread, with pl_lock held.
+static void
+group_layout_eval_sync (DdbListview *listview, DdbListviewGroupLayout *layout) {
+    const int depth = layout->group_depth;
+    layout->keys = calloc (layout->count * depth, sizeof (uint64_t));
+
+    char title[1024];
+    for (int idx = 0; idx < layout->count; idx++) {
+        for (int i = 0; i < depth; i++) {
+            title[0] = 0;
+            if (listview->datasource->get_group_text (listview, layout->items[idx], title, sizeof (title), i) < 0) {
+                title[0] = 0;
+            }
+            layout->keys[idx * depth + i] = group_title_key (title);
+        }
     }
-    priv->groups = new_group (listview, it, 0);
-    DdbListviewGroup *grps = priv->groups;
-    for (int i = 1; i < group_depth; i++) {
-        grps->subgroups = new_group (listview, it, 0);
-        grps = grps->subgroups;
+}
+
+static DdbListviewGroup *
+group_layout_new_group (DdbListviewGroupLayout *layout, DdbListviewIter it, int group_label_visible) {
+    layout->ref (it);
+    DdbListviewGroup *grp = calloc (1, sizeof (DdbListviewGroup));
+    grp->head = it;
+    grp->group_label_visible = group_label_visible;
+    return grp;
+}
+
+// Creates the group tree from the evaluated layout, without the heights.
+// Can be called on any thread.
+static DdbListviewGroup *
+group_layout_build_tree (DdbListviewGroupLayout *layout) {
+    const int depth = layout->group_depth;
+    if (!layout->count || !depth) {
+        return NULL;
     }
-    int min_height = ddb_listview_min_group_height (priv->columns);
-    int min_no_artwork_height = ddb_listview_min_no_artwork_group_height (priv->columns);
-    int full_height = 0;
-    // groups
-    if (priv->grouptitle_height) {
-        DdbListviewGroup *last_group[group_depth];
-        char (*group_titles)[1024] = malloc (sizeof (char[1024]) * group_depth);
-        DdbListviewGroup *grp = priv->groups;
-        // populate all subgroups from the first item
-        for (int i = 0; i < group_depth; i++) {
-            last_group[i] = grp;
-            grp = grp->subgroups;
-            listview->datasource->get_group_text (listview, it, group_titles[i], sizeof (*group_titles), i);
-            last_group[i]->group_label_visible = group_titles[i][0] != 0;
-        }
-        while ((it = next_playitem (listview, it))) {
-            int make_new_group_offset = -1;
-            for (int i = 0; i < group_depth; i++) {
-                char next_title[1024];
-                listview->datasource->get_group_text (listview, it, next_title, sizeof (next_title), i);
-                if (strcmp (group_titles[i], next_title)) {
-                    make_new_group_offset = i;
-                    break;
+    DdbListviewGroup *groups = NULL;
+    DdbListviewGroup *last_group[depth];
+
+    for (int idx = 0; idx < layout->count; idx++) {
+        DdbListviewIter it = layout->items[idx];
+        const uint64_t *keys = layout->keys + idx * depth;
+        int level;
+        if (idx == 0) {
+            // populate all subgroups from the first item
+            for (level = 0; level < depth; level++) {
+                DdbListviewGroup *grp = group_layout_new_group (layout, it, keys[level] != 0);
+                if (level == 0) {
+                    groups = grp;
+                }
+                else {
+                    last_group[level - 1]->subgroups = grp;
                 }
-                last_group[i]->num_items++;
+                last_group[level] = grp;
             }
-            if (make_new_group_offset >= 0) {
-                // finish remaining groups
-                // must be done in reverse order so heights are calculated correctly
-                for (int i = group_depth - 1; i >= make_new_group_offset; i--) {
-                    char next_title[1024];
-                    last_group[i]->num_items++;
-                    listview->datasource->get_group_text (listview, it, next_title, sizeof (next_title), i);
-                    int height = calc_group_height (
-                        listview,
-                        last_group[i],
-                        i == priv->artwork_subgroup_level ? min_height : min_no_artwork_height,
-                        !(it > 0));
-                    if (i == 0) {
-                        full_height += height;
-                    }
-                    DdbListviewGroup *new_grp = NULL;
-                    if (it != NULL) {
-                        // ensure that the top-level groups always have titles
-                        int title_visible = i == 0 || next_title[0] != 0;
-                        new_grp = new_group (listview, it, title_visible);
-                    }
-                    if (i == make_new_group_offset) {
-                        last_group[i]->next = new_grp;
-                    }
-                    last_group[i] = new_grp;
-                    if (last_group[i] && i < group_depth - 1) {
-                        last_group[i]->subgroups = last_group[i + 1];
-                    }
-                    strcpy (group_titles[i], next_title);
+        }
+        else {
+            // a new group starts at the first level where the title changes, and all the levels below it
+            const uint64_t *prev_keys = keys - depth;
+            for (level = 0; level < depth && keys[level] == prev_keys[level]; level++)
+                ;
+            for (int i = level; i < depth; i++) {
+                // ensure that the top-level groups always have titles
+                DdbListviewGroup *grp = group_layout_new_group (layout, it, i == 0 || keys[i] != 0);
+                if (i == level) {
+                    last_group[i]->next = grp;
+                }
+                else {
+                    last_group[i - 1]->subgroups = grp;
                 }
+                last_group[i] = grp;
             }
         }
-        // calculate final group heights
-        for (int i = group_depth - 1; i >= 0; i--) {
+        for (int i = 0; i < depth; i++) {
             last_group[i]->num_items++;
-            int height = calc_group_height (
-                listview,
-                last_group[i],
-                i == priv->artwork_subgroup_level ? min_height : min_no_artwork_height,
-                1);
-            if (i == 0) {
-                full_height += height;
-            }
         }
-        free (group_titles);
     }
-    // no groups fast path
-    else {
-        for (DdbListviewGroup *grp = priv->groups; grp; grp = grp->next) {
-            do {
-                grp->num_items++;
-                it = next_playitem (listview, it);
-            } while (it && grp->num_items < BLANK_GROUP_SUBDIVISION);
-            full_height += calc_group_height (listview, grp, min_height, !(it > 0));
-            if (it) {
-                grp->next = new_group (listview, it, 0);
-            }
+    return groups;
+}
+
+// Builds the groups without titles, which doesn't need evaluating anything.
+// Must be called with pl_lock held.
+static DdbListviewGroup *
+build_blank_groups (DdbListview *listview) {
+    DdbListviewIter it = listview->datasource->head ();
+    if (!it) {
+        return NULL;
+    }
+    DdbListviewGroup *groups = new_group (listview, it, 0);
+    for (DdbListviewGroup *grp = groups; grp; grp = grp->next) {
+        do {
+            grp->num_items++;
+            it = next_playitem (listview, it);
+        } while (it && grp->num_items < BLANK_GROUP_SUBDIVISION);
+        if (it) {
+            grp->next = new_group (listview, it, 0);
         }
     }
-    return full_height;
+    return groups;
 }
 
+// Releases the items held by the last evaluated layout
 static void
-ddb_listview_build_groups (DdbListview *listview) {
+ddb_listview_drop_groups_cache (DdbListview *listview) {
     DdbListviewPrivate *priv = DDB_LISTVIEW_GET_PRIVATE (listview);
-    deadbeef->pl_lock ();
-    int height = build_groups (listview);
+    DdbListviewGroupLayout **groups_cache = priv->groups_cache;
+    dispatch_async (priv->groups_queue, ^{
+        group_layout_free (*groups_cache);
+        *groups_cache = NULL;
+    });
+}
+
+// Replaces the groups, and calculates their heights
+static void
+ddb_listview_set_groups (DdbListview *listview, DdbListviewGroup *groups, ddb_playlist_t *plt) {
+    DdbListviewPrivate *priv = DDB_LISTVIEW_GET_PRIVATE (listview);
+    ddb_listview_free_all_groups (listview);
+    priv->groups = groups;
+    priv->plt = plt;
+
+    int min_height = ddb_listview_min_group_height (priv->columns);
+    int min_no_artwork_height = ddb_listview_min_no_artwork_group_height (priv->columns);
+    int height = ddb_listview_resize_subgroup (listview, priv->groups, 0, min_height, min_no_artwork_height);
     if (height != priv->fullheight) {
         priv->fullheight = height;
         g_idle_add_full (GTK_PRIORITY_RESIZE, ddb_listview_list_setup_vscroll, listview, NULL);
     }
-    deadbeef->pl_unlock ();
+}
+
+static void
+ddb_listview_build_groups (DdbListview *listview) {
+    DdbListviewPrivate *priv = DDB_LISTVIEW_GET_PRIVATE (listview);
+    // discard the builds in progress
+    int generation = ++priv->groups_generation;
+
+    deadbeef->pl_lock ();
+    priv->groups_build_idx = listview->datasource->modification_idx ();
+
+    if (!priv->group_formats->format || !priv->group_formats->format[0]) {
+        priv->grouptitle_height = 0;
+        DdbListviewGroup *groups = build_blank_groups (listview);
+        deadbeef->pl_unlock ();
+        ddb_listview_set_groups (listview, groups, deadbeef->plt_get_curr ());
+        ddb_listview_drop_groups_cache (listview);
+        return;
+    }
+    priv->grouptitle_height = priv->calculated_grouptitle_height;
+
+    DdbListviewGroupLayout *layout = group_layout_create (listview);
+    if (layout->count < GROUPS_ASYNC_MIN_ITEMS) {
+        group_layout_eval_sync (listview, layout);
+        deadbeef->pl_unlock ();
+        DdbListviewGroup *groups = group_layout_build_tree (layout);
+        deadbeef->plt_ref (layout->plt);
+        ddb_listview_set_groups (listview, groups, layout->plt);
+        group_layout_free (layout);
+        ddb_listview_drop_groups_cache (listview);
+        return;
+    }
+
+    // Until the new layout is ready, the last one is displayed.
+    // If it belongs to another playlist, use the groups without titles.
+    if (!priv->groups || priv->plt != layout->plt) {
+        DdbListviewGroup *groups = build_blank_groups (listview);
+        deadbeef->pl_unlock ();
+        ddb_listview_set_groups (listview, groups, deadbeef->plt_get_curr ());
+    }
+    else {
+        deadbeef->pl_unlock ();
+    }
+
+    DdbListviewGroupLayout **groups_cache = priv->groups_cache;
+    g_object_ref (listview);
+    dispatch_async (priv->groups_queue, ^{
+        group_layout_eval (layout, *groups_cache);
+        group_layout_free (*groups_cache);
+        *groups_cache = layout;
+        DdbListviewGroup *groups = group_layout_build_tree (layout);
+        ddb_playlist_t *plt = layout->plt;
+        deadbeef->plt_ref (plt);
+
+        gtkui_dispatch_on_main (^{
+            // the generation is also incremented when the widget is disposed
+            if (generation == priv->groups_generation) {
+                ddb_listview_set_groups (listview, groups, plt);
+                gtk_widget_queue_draw (listview->list);
+            }
+            else {
+                ddb_listview_free_group (listview, groups);
+                deadbeef->plt_unref (plt);
+            }
+            g_object_unref (listview);
+        });
+    });
 }
 
 static int
@@ -3588,9 +3852,7 @@ ddb_listview_list_setup (DdbListview *listview, int scroll_to) {
     if (priv->scrollpos == -1) {
         priv->scrollpos = 0;
     }
-    deadbeef->pl_lock ();
-    priv->fullheight = build_groups (listview);
-    deadbeef->pl_unlock ();
+    ddb_listview_build_groups (listview);
     adjust_scrollbar (listview->scrollbar, priv->fullheight, priv->list_height);
     gtk_range_set_value (GTK_RANGE (listview->scrollbar), scroll_to);
     g_idle_add (unlock_columns_cb, listview);
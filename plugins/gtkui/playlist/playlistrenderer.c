@@ -42,6 +42,194 @@ tf_redraw_cb (gpointer user_data) {
     return FALSE;
 }
 
+// Cache of the evaluated column text, so that the visible cells don't need to
+// be re-evaluated on every expose.
+// The entries are validated against revision counters, which are bumped per track
+// on DB_EV_TRACKINFOCHANGED, and globally on the events which may affect any track.
+// The revisions are updated from the message thread, the entries are only accessed
+// on the main thread.
+// The cells which request periodic updates (e.g. playback time) are never cached.
+#define TEXT_CACHE_SIZE 4096 // power of 2
+#define TEXT_CACHE_TRACK_REVISIONS 1024 // power of 2
+
+typedef struct {
+    DdbListviewIter it;
+    col_info_t *info;
+    ddb_playlist_t *plt;
+    int idx;
+    int iter;
+    int selected;
+    int modification_idx;
+    uint32_t revision;
+    int is_dimmed;
+    char *text;
+} text_cache_entry_t;
+
+static text_cache_entry_t text_cache[TEXT_CACHE_SIZE];
+static uint32_t text_cache_revision = 1;
+static uint32_t text_cache_flush_revision;
+static uint32_t text_cache_track_revisions[TEXT_CACHE_TRACK_REVISIONS];
+
+static inline uint32_t
+_text_cache_hash_ptr (const void *ptr) {
+    uintptr_t v = (uintptr_t)ptr;
+    v ^= v >> 17;
+    v *= 0x9e3779b1;
+    return (uint32_t)(v ^ (v >> 15));
+}
+
+static text_cache_entry_t *
+_text_cache_entry (DdbListviewIter it, col_info_t *info) {
+    uint32_t h = _text_cache_hash_ptr (it) ^ (_text_cache_hash_ptr (info) * 31);
+    return &text_cache[h & (TEXT_CACHE_SIZE-1)];
+}
+
+static uint32_t *
+_text_cache_track_revision (DdbListviewIter it) {
+    return &text_cache_track_revisions[_text_cache_hash_ptr (it) & (TEXT_CACHE_TRACK_REVISIONS-1)];
+}
+
+void
+pl_common_text_cache_invalidate (DB_playItem_t *track) {
+    uint32_t revision = __atomic_add_fetch (&text_cache_revision, 1, __ATOMIC_SEQ_CST);
+    if (track) {
+        __atomic_store_n (_text_cache_track_revision (track), revision, __ATOMIC_SEQ_CST);
+    }
+    else {
+        __atomic_store_n (&text_cache_flush_revision, revision, __ATOMIC_SEQ_CST);
+    }
+}
+
+void
+pl_common_text_cache_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
+    switch (id) {
+    case DB_EV_TRACKINFOCHANGED:
+        {
+            ddb_event_track_t *ev = (ddb_event_track_t *)ctx;
+            // the playqueue changes affect the queue indexes of the other tracks
+            pl_common_text_cache_invalidate (p1 == DDB_PLAYLIST_CHANGE_PLAYQUEUE ? NULL : ev->track);
+        }
+        break;
+    case DB_EV_SONGCHANGED:
+    case DB_EV_SONGSTARTED:
+    case DB_EV_SONGFINISHED:
+    case DB_EV_PAUSED:
+    case DB_EV_STOP:
+    case DB_EV_PLAYLISTCHANGED:
+    case DB_EV_PLAYLISTSWITCHED:
+    case DB_EV_CONFIGCHANGED:
+        pl_common_text_cache_invalidate (NULL);
+        break;
+    }
+}
+
+void
+pl_common_text_cache_free (void) {
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        free (text_cache[i].text);
+    }
+    memset (text_cache, 0, sizeof (text_cache));
+}
+
+static int
+_text_cache_entry_is_valid (text_cache_entry_t *entry, DdbListviewIter it, col_info_t *info, ddb_playlist_t *plt, int idx, int iter, int selected, int modification_idx) {
+    if (!entry->text
+        || entry->it != it
+        || entry->info != info
+        || entry->plt != plt
+        || entry->idx != idx
+        || entry->iter != iter
+        || entry->selected != selected
+        || entry->modification_idx != modification_idx) {
+        return 0;
+    }
+    // the revisions only grow, so the entry is valid if it was evaluated after the last invalidation
+    uint32_t revision = entry->revision;
+    return (int32_t)(revision - __atomic_load_n (&text_cache_flush_revision, __ATOMIC_SEQ_CST)) >= 0
+        && (int32_t)(revision - __atomic_load_n (_text_cache_track_revision (it), __ATOMIC_SEQ_CST)) >= 0;
+}
+
+static int
+_eval_column_text (DdbListview *listview, DdbListviewIter it, int idx, int iter, col_info_t *info, char *text, size_t size) {
+    ddb_playlist_t *plt = deadbeef->plt_get_curr ();
+    int selected = deadbeef->pl_is_selected (it);
+    int modification_idx = listview->datasource->modification_idx ();
+
+    text_cache_entry_t *entry = _text_cache_entry (it, info);
+    if (_text_cache_entry_is_valid (entry, it, info, plt, idx, iter, selected, modification_idx)) {
+        if (plt) {
+            deadbeef->plt_unref (plt);
+        }
+        size_t len = min (strlen (entry->text), size - 1);
+        memcpy (text, entry->text, len);
+        text[len] = 0;
+        return entry->is_dimmed;
+    }
+
+    // taken before the evaluation, so that the concurrent invalidations are not lost
+    uint32_t revision = __atomic_load_n (&text_cache_revision, __ATOMIC_SEQ_CST);
+
+    ddb_tf_context_t ctx = {
+        ._size = sizeof (ddb_tf_context_t),
+        .it = it,
+        .plt = plt,
+        .iter = iter,
+        .id = info->id,
+        .idx = idx,
+        .flags = DDB_TF_CONTEXT_HAS_ID | DDB_TF_CONTEXT_HAS_INDEX,
+    };
+    if (!selected) {
+        ctx.flags |= DDB_TF_CONTEXT_TEXT_DIM;
+    }
+    deadbeef->tf_eval (&ctx, info->bytecode, text, (int)size);
+    int is_dimmed = ctx.dimmed;
+    if (ctx.update > 0) {
+        int idx;
+
+        if ((ctx.flags & DDB_TF_CONTEXT_HAS_INDEX) && ctx.iter == PL_MAIN) {
+            idx = ctx.idx;
+        }
+        else {
+            idx = deadbeef->plt_get_item_idx (ctx.plt, it, ctx.iter);
+        }
+
+        ddb_listview_schedule_draw_tf(listview, idx, g_timeout_add (ctx.update, tf_redraw_cb, listview), it);
+    }
+    char *lb = strchr (text, '\r');
+    if (lb) {
+        *lb = 0;
+    }
+    lb = strchr (text, '\n');
+    if (lb) {
+        *lb = 0;
+    }
+
+    if (ctx.update <= 0) {
+        free (entry->text);
+        entry->text = strdup (text);
+        entry->it = it;
+        entry->info = info;
+        entry->plt = plt;
+        entry->idx = idx;
+        entry->iter = iter;
+        entry->selected = selected;
+        entry->modification_idx = modification_idx;
+        entry->revision = revision;
+        entry->is_dimmed = is_dimmed;
+    }
+    else if (entry->it == it && entry->info == info) {
+        // the cell became dynamic
+        free (entry->text);
+        entry->text = NULL;
+    }
+
+    if (ctx.plt) {
+        deadbeef->plt_unref (ctx.plt);
+        ctx.plt = NULL;
+    }
+    return is_dimmed;
+}
+
 void
 pl_common_draw_column_data (DdbListview *listview, cairo_t *cr, DdbListviewIter it, int idx, int iter, int align, void *user_data, GdkColor *fg_clr, int x, int y, int width, int height, int even) {
     col_info_t *info = user_data;
@@ -85,44 +273,7 @@ pl_common_draw_column_data (DdbListview *listview, cairo_t *cr, DdbListviewIter
             }
         }
         else {
-            ddb_tf_context_t ctx = {
-                ._size = sizeof (ddb_tf_context_t),
-                .it = it,
-                .plt = deadbeef->plt_get_curr (),
-                .iter = iter,
-                .id = info->id,
-                .idx = idx,
-                .flags = DDB_TF_CONTEXT_HAS_ID | DDB_TF_CONTEXT_HAS_INDEX,
-            };
-            if (!deadbeef->pl_is_selected (it)) {
-                ctx.flags |= DDB_TF_CONTEXT_TEXT_DIM;
-            }
-            deadbeef->tf_eval (&ctx, info->bytecode, text, sizeof (text));
-            is_dimmed = ctx.dimmed;
-            if (ctx.update > 0) {
-                int idx;
-
-                if ((ctx.flags & DDB_TF_CONTEXT_HAS_INDEX) && ctx.iter == PL_MAIN) {
-                    idx = ctx.idx;
-                }
-                else {
-                    idx = deadbeef->plt_get_item_idx (ctx.plt, it, ctx.iter);
-                }
-
-                ddb_listview_schedule_draw_tf(listview, idx, g_timeout_add (ctx.update, tf_redraw_cb, listview), it);
-            }
-            if (ctx.plt) {
-                deadbeef->plt_unref (ctx.plt);
-                ctx.plt = NULL;
-            }
-            char *lb = strchr (text, '\r');
-            if (lb) {
-                *lb = 0;
-            }
-            lb = strchr (text, '\n');
-            if (lb) {
-                *lb = 0;
-            }
+            is_dimmed = _eval_column_text (listview, it, idx, iter, info, text, sizeof (text));
         }
         GdkColor *color = NULL;
         GdkColor temp_color;
@@ -138,6 +138,7 @@ pl_common_free (void) {
         g_object_unref(buffering16_pixbuf);
         buffering16_pixbuf = NULL;
     }
+    pl_common_text_cache_free ();
 }
 
 static col_info_t *
@@ -168,6 +169,8 @@ pl_common_free_col_info (void *data) {
         free (info->sort_bytecode);
     }
     free (info);
+    // the cached text is keyed by the column pointer
+    pl_common_text_cache_invalidate (NULL);
 }
 
 #define COL_CONF_BUFFER_SIZE 10000
@@ -699,6 +702,8 @@ init_column (col_info_t *inf, int id, const char *format, const char *sort_forma
         inf->sort_format = strdup(sort_format);
         inf->sort_bytecode = deadbeef->tf_compile (inf->sort_format);
     }
+
+    pl_common_text_cache_invalidate (NULL);
 }
 
 static void
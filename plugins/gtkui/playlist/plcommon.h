@@ -71,6 +71,18 @@ list_handle_keypress (DdbListview *ps, int keyval, int state, int iter);
 void
 pl_common_draw_column_data (DdbListview *listview, cairo_t *cr, DdbListviewIter it, int idx, int iter, int align, void *user_data, GdkColor *fg_clr, int x, int y, int width, int height, int even);
 
+// Invalidates the cached column text of the track, or of all tracks if track is NULL.
+// Can be called from any thread.
+void
+pl_common_text_cache_invalidate (DB_playItem_t *track);
+
+// Invalidates the cached column text affected by the message.
+void
+pl_common_text_cache_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2);
+
+void
+pl_common_text_cache_free (void);
+
 int
 pl_common_load_column_config (DdbListview *listview, const char *key);
 
@@ -72,7 +72,7 @@ cmp3_seek_stream (DB_fileinfo_t *_info, int64_t sample) {
 #endif
 
     mp3info_t mp3info;
-    int res = mp3_parse_file(&mp3info, info->mp3flags, info->file, deadbeef->fgetlength(info->file), info->startoffs, info->endoffs, sample);
+    int res = mp3_parse_file_indexed(&mp3info, info->mp3flags, info->file, deadbeef->fgetlength(info->file), info->startoffs, info->endoffs, sample, &info->seekindex);
 
     if (!res) {
         deadbeef->fseek (info->file, mp3info.packet_offs, SEEK_SET);
@@ -216,8 +216,8 @@ cmp3_set_extra_properties (DB_playItem_t *it, mp3info_t *mp3info, int fake) {
 }
 
 static int
-_mp3_parse_and_validate (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample) {
-    int res = mp3_parse_file(info, flags, fp, fsize, startoffs, endoffs, seek_to_sample);
+_mp3_parse_and_validate (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample, mp3_seekindex_t *index) {
+    int res = mp3_parse_file_indexed(info, flags, fp, fsize, startoffs, endoffs, seek_to_sample, index);
     if (res < 0) {
         return res;
     }
@@ -276,7 +276,7 @@ cmp3_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
         if (info->startoffs > 0) {
             trace ("mp3: skipping %d(%xH) bytes of junk\n", info->startoffs, info->endoffs);
         }
-        int res = _mp3_parse_and_validate(&info->mp3info, info->mp3flags, info->file, deadbeef->fgetlength(info->file), info->startoffs, info->endoffs, -1);
+        int res = _mp3_parse_and_validate(&info->mp3info, info->mp3flags, info->file, deadbeef->fgetlength(info->file), info->startoffs, info->endoffs, -1, &info->seekindex);
         if (res < 0) {
             trace ("mp3: cmp3_init: initial mp3_parse_file failed\n");
             return -1;
@@ -304,7 +304,7 @@ cmp3_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     else {
         info->startoffs = (uint32_t)deadbeef->junk_get_leading_size(info->file);
         deadbeef->pl_add_meta (it, "title", NULL);
-        int res = _mp3_parse_and_validate(&info->mp3info, info->mp3flags, info->file, deadbeef->fgetlength(info->file), info->startoffs, 0, -1);
+        int res = _mp3_parse_and_validate(&info->mp3info, info->mp3flags, info->file, deadbeef->fgetlength(info->file), info->startoffs, 0, -1, NULL);
         if (res < 0) {
             trace ("mp3: cmp3_init: initial mp3_parse_file failed\n");
             return -1;
@@ -432,6 +432,7 @@ cmp3_free (DB_fileinfo_t *_info) {
     if (info->conv_buf) {
         free (info->conv_buf);
     }
+    mp3_seekindex_free (&info->seekindex);
     if (info->file) {
         deadbeef->fclose (info->file);
         info->file = NULL;
@@ -613,9 +614,11 @@ cmp3_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
         return after;
     }
 
+    // the tags are read before parsing, which gets the tag offsets from the same reads
+    DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
     uint32_t start;
     uint32_t end;
-    deadbeef->junk_get_tag_offsets (fp, &start, &end);
+    /*int tagerr = */deadbeef->junk_read_tags (it, fp, &start, &end);
 
     mp3info_t mp3info;
 
@@ -625,24 +628,15 @@ cmp3_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
         mp3flags = MP3_PARSE_ESTIMATE_DURATION;
     }
 
-    int res = _mp3_parse_and_validate(&mp3info, mp3flags, fp, fsize, start, end, -1);
+    int res = _mp3_parse_and_validate(&mp3info, mp3flags, fp, fsize, start, end, -1, NULL);
 
     if (res < 0) {
         trace ("mp3: mp3_parse_file returned error\n");
+        deadbeef->pl_item_unref (it);
         deadbeef->fclose (fp);
         return NULL;
     }
 
-    DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
-
-    deadbeef->rewind (fp);
-    // reset tags
-    uint32_t f = deadbeef->pl_get_item_flags (it);
-    f &= ~DDB_TAG_MASK;
-    deadbeef->pl_set_item_flags (it, f);
-    /*int apeerr = */deadbeef->junk_apev2_read (it, fp);
-    /*int v2err = */deadbeef->junk_id3v2_read (it, fp);
-    /*int v1err = */deadbeef->junk_id3v1_read (it, fp);
     deadbeef->pl_set_meta_int (it, ":MP3_DELAY", mp3info.delay);
     deadbeef->pl_set_meta_int (it, ":MP3_PADDING", mp3info.padding);
 
@@ -674,9 +668,7 @@ cmp3_read_metadata (DB_playItem_t *it) {
     }
     deadbeef->pl_delete_all_meta (it);
     // FIXME: reload and apply the Xing header
-    /*int apeerr = */deadbeef->junk_apev2_read (it, fp);
-    /*int v2err = */deadbeef->junk_id3v2_read (it, fp);
-    /*int v1err = */deadbeef->junk_id3v1_read (it, fp);
+    /*int tagerr = */deadbeef->junk_read_tags (it, fp, NULL, NULL);
     deadbeef->pl_add_meta (it, "title", NULL);
     deadbeef->fclose (fp);
     return 0;
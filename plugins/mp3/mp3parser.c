@@ -43,6 +43,7 @@ extern DB_functions_t *deadbeef;
 #define MAX_INVALID_BYTES 1000000
 #define MAX_INVALID_BYTES_STREAM 1000
 #define MAX_FREEFORMAT_PACKETS 10
+#define SEEKINDEX_INTERVAL 32 // packets between the seek index points
 
 static const int vertbl[] = {3, -1, 2, 1}; // 3 is 2.5
 static const int ltbl[] = { -1, 3, 2, 1 };
@@ -400,8 +401,56 @@ _packet_same_fmt (mp3packet_t *ref_packet, mp3packet_t *packet) {
         && packet->ver == ref_packet->ver;
 }
 
+void
+mp3_seekindex_free (mp3_seekindex_t *index) {
+    free (index->points);
+    memset (index, 0, sizeof (mp3_seekindex_t));
+}
+
+static void
+_seekindex_add (mp3_seekindex_t *index, int64_t offs, int64_t pcmsample, int samples_per_frame) {
+    int64_t last = index->count > 0 ? index->points[index->count-1].pcmsample : 0;
+    if (pcmsample - last < SEEKINDEX_INTERVAL * samples_per_frame) {
+        return;
+    }
+    if (index->count == index->capacity) {
+        int64_t capacity = index->capacity ? index->capacity * 2 : 256;
+        mp3_seekpoint_t *points = realloc (index->points, capacity * sizeof (mp3_seekpoint_t));
+        if (!points) {
+            return;
+        }
+        index->points = points;
+        index->capacity = capacity;
+    }
+    index->points[index->count].offs = offs;
+    index->points[index->count].pcmsample = pcmsample;
+    index->count++;
+}
+
+// returns the last point at or before the sample, or NULL
+static mp3_seekpoint_t *
+_seekindex_find (mp3_seekindex_t *index, int64_t sample) {
+    int64_t lo = 0;
+    int64_t hi = index->count;
+    while (lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (index->points[mid].pcmsample <= sample) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? &index->points[lo-1] : NULL;
+}
+
 int
 mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample) {
+    return mp3_parse_file_indexed (info, flags, fp, fsize, startoffs, endoffs, seek_to_sample, NULL);
+}
+
+int
+mp3_parse_file_indexed (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample, mp3_seekindex_t *index) {
 #if PERFORMANCE_STATS
     struct timeval start_tv;
     struct timeval end_tv;
@@ -441,6 +490,23 @@ mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int
     int64_t offs = startoffs;
     int64_t fileoffs = startoffs;
 
+    // sample position at the start of the current packet, counted for the seek index
+    int64_t scan_sample = 0;
+
+    // the index can't be used for streams, because their data is not stable
+    if (info->is_streaming) {
+        index = NULL;
+    }
+
+    if (index && seek_to_sample > 0) {
+        mp3_seekpoint_t *point = _seekindex_find (index, seek_to_sample);
+        if (point) {
+            offs = point->offs;
+            scan_sample = info->pcmsample = point->pcmsample;
+            info->checked_xing_header = 1;
+        }
+    }
+
     int prev_br = -1;
     int prev_length = -1;
     int variable_packets = 0;
@@ -560,6 +626,11 @@ mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int
             }
 
             if (!got_xing) {
+                if (index) {
+                    _seekindex_add (index, offs, scan_sample, packet.samples_per_frame);
+                    scan_sample += packet.samples_per_frame;
+                }
+
                 // interrupt if the current packet contains the sample being seeked to
                 if (seek_to_sample > 0 && info->pcmsample+packet.samples_per_frame >= seek_to_sample) {
                     goto end;
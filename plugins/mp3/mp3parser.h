@@ -103,6 +103,22 @@ typedef struct {
     uint64_t bytes_read;
 } mp3info_t;
 
+// Sparse index of packet offsets, which is filled by the scans, and then used to start
+// the subsequent seek scans from the closest preceding packet instead of the stream start.
+typedef struct {
+    int64_t offs; // stream position of the packet
+    int64_t pcmsample; // sample position at the start of the packet
+} mp3_seekpoint_t;
+
+typedef struct {
+    mp3_seekpoint_t *points;
+    int64_t count;
+    int64_t capacity;
+} mp3_seekindex_t;
+
+void
+mp3_seekindex_free (mp3_seekindex_t *index);
+
 // Params:
 // seek_to_sample: -1 means to the end (scan whole file), otherwise a sample to seek to
 // When seeking, the packet offset returned will be the one containing seek_to_sample, not accounting for delay.
@@ -118,6 +134,12 @@ typedef struct {
 int
 mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample);
 
+// Same as mp3_parse_file, but adds the scanned packets to the index, and uses it for seeking.
+// The index is only valid for the same fp, startoffs and endoffs.
+// When the seek starts from an index point, only packet_offs and pcmsample are set accordingly.
+int
+mp3_parse_file_indexed (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample, mp3_seekindex_t *index);
+
 #ifdef __cplusplus
 }
 #endif
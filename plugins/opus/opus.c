@@ -41,6 +41,8 @@ typedef struct {
 
     OggOpusFile *opusfile;
     uint8_t *channelmap;
+    float *remap_buffer; // decoded samples waiting for the channelmap reordering
+    int remap_buffer_size;
 
     int cur_bit_stream;
 
@@ -350,6 +352,10 @@ opusdec_free (DB_fileinfo_t *_info) {
         deadbeef->pl_item_unref (info->it);
         info->it = NULL;
     }
+    free (info->channelmap);
+    info->channelmap = NULL;
+    free (info->remap_buffer);
+    info->remap_buffer = NULL;
 
     if (info) {
         free (info);
@@ -447,7 +453,22 @@ opusdec_read (DB_fileinfo_t *_info, char *bytes, int size) {
     while (samples_read < samples_to_read && (ret > 0 || ret == OP_HOLE))
     {
         int nframes = samples_to_read-samples_read;
-        float pcm[nframes * _info->fmt.channels];
+        float *out = (float *)bytes + samples_read*_info->fmt.channels;
+
+        // decode straight into the output buffer, unless the channels need reordering
+        float *pcm = out;
+        if (info->channelmap) {
+            if (info->remap_buffer_size < nframes * _info->fmt.channels) {
+                free (info->remap_buffer);
+                info->remap_buffer_size = nframes * _info->fmt.channels;
+                info->remap_buffer = malloc (info->remap_buffer_size * sizeof (float));
+                if (!info->remap_buffer) {
+                    info->remap_buffer_size = 0;
+                    break;
+                }
+            }
+            pcm = info->remap_buffer;
+        }
         int new_link = -1;
         ret = op_read_float(info->opusfile, pcm, nframes * _info->fmt.channels, &new_link);
 
@@ -458,13 +479,12 @@ opusdec_read (DB_fileinfo_t *_info, char *bytes, int size) {
             break;
         }
         else if (ret > 0) {
-            for (int channel = 0; channel < _info->fmt.channels; channel++) {
-                const float *pcm_channel = &pcm[info->channelmap ? info->channelmap[channel] : channel];
-                float *ptr = ((float *)bytes + samples_read*_info->fmt.channels) + channel;
-                for (int sample = 0; sample < ret; sample ++, pcm_channel += _info->fmt.channels) {
-                    *ptr = *pcm_channel;
-                    ptr += _info->fmt.channels;
+            if (info->channelmap) {
+                const float *channels[_info->fmt.channels];
+                for (int channel = 0; channel < _info->fmt.channels; channel++) {
+                    channels[channel] = &pcm[info->channelmap[channel]];
                 }
+                deadbeef->pcm_interleave (&_info->fmt, (const void * const *)channels, _info->fmt.channels, 0, (char *)out, ret);
             }
             samples_read += ret;
         }
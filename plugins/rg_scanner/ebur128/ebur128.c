@@ -8,6 +8,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* This can be replaced by any BSD-like queue implementation. */
 #include <sys/queue.h>
 
@@ -420,6 +424,72 @@ static void ebur128_check_true_peak(ebur128_state* st, size_t frames) {
     st->d->v[ci][1] = fabs(st->d->v[ci][1]) < DBL_MIN ? 0.0 : st->d->v[ci][1];
 #endif
 
+#define EBUR128_SAMPLE_PEAK(type, min_scale, max_scale)                        \
+static void ebur128_calc_sample_peak_scalar_##type(ebur128_state* st,          \
+                                                   const type* src,            \
+                                                   size_t frames) {            \
+  static double scaling_factor = -((double) min_scale) > (double) max_scale ?  \
+                                 -((double) min_scale) : (double) max_scale;   \
+  size_t i, c;                                                                 \
+  for (c = 0; c < st->channels; ++c) {                                         \
+    double max = 0.0;                                                          \
+    for (i = 0; i < frames; ++i) {                                             \
+      if (src[i * st->channels + c] > max) {                                   \
+        max =        src[i * st->channels + c];                                \
+      } else if (-src[i * st->channels + c] > max) {                           \
+        max = -1.0 * src[i * st->channels + c];                                \
+      }                                                                        \
+    }                                                                          \
+    max /= scaling_factor;                                                     \
+    if (max > st->d->sample_peak[c]) st->d->sample_peak[c] = max;              \
+  }                                                                            \
+}
+EBUR128_SAMPLE_PEAK(short, SHRT_MIN, SHRT_MAX)
+EBUR128_SAMPLE_PEAK(int, INT_MIN, INT_MAX)
+EBUR128_SAMPLE_PEAK(float, -1.0f, 1.0f)
+EBUR128_SAMPLE_PEAK(double, -1.0, 1.0)
+
+#define ebur128_calc_sample_peak_short ebur128_calc_sample_peak_scalar_short
+#define ebur128_calc_sample_peak_int ebur128_calc_sample_peak_scalar_int
+#define ebur128_calc_sample_peak_double ebur128_calc_sample_peak_scalar_double
+
+/* deadbeef: float input is the common case, so scan the interleaved buffer
+ * 4 samples at a time. When the channel count divides 4, lane l always holds
+ * channel (l % channels), which keeps the per-channel peaks separate. */
+static void ebur128_calc_sample_peak_float(ebur128_state* st,
+                                           const float* src,
+                                           size_t frames) {
+#ifdef __SSE2__
+  if (st->channels == 1 || st->channels == 2 || st->channels == 4) {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 vmax = _mm_setzero_ps();
+    size_t samples = frames * st->channels;
+    size_t i = 0, c, l;
+    float lanes[4];
+    for (; i + 4 <= samples; i += 4) {
+      /* NaN in the first operand yields the second, so NaNs are skipped like
+       * in the scalar loop */
+      vmax = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(src + i), abs_mask), vmax);
+    }
+    _mm_storeu_ps(lanes, vmax);
+    for (; i < samples; ++i) {
+      float v = fabsf(src[i]);
+      l = i % 4;
+      if (v > lanes[l]) lanes[l] = v;
+    }
+    for (c = 0; c < st->channels; ++c) {
+      double max = 0.0;
+      for (l = c; l < 4; l += st->channels) {
+        if (lanes[l] > max) max = lanes[l];
+      }
+      if (max > st->d->sample_peak[c]) st->d->sample_peak[c] = max;
+    }
+    return;
+  }
+#endif
+  ebur128_calc_sample_peak_scalar_float(st, src, frames);
+}
+
 #define EBUR128_FILTER(type, min_scale, max_scale)                             \
 static void ebur128_filter_##type(ebur128_state* st, const type* src,          \
                                   size_t frames) {                             \
@@ -431,18 +501,7 @@ static void ebur128_filter_##type(ebur128_state* st, const type* src,          \
   TURN_ON_FTZ                                                                  \
                                                                                \
   if ((st->mode & EBUR128_MODE_SAMPLE_PEAK) == EBUR128_MODE_SAMPLE_PEAK) {     \
-    for (c = 0; c < st->channels; ++c) {                                       \
-      double max = 0.0;                                                        \
-      for (i = 0; i < frames; ++i) {                                           \
-        if (src[i * st->channels + c] > max) {                                 \
-          max =        src[i * st->channels + c];                              \
-        } else if (-src[i * st->channels + c] > max) {                         \
-          max = -1.0 * src[i * st->channels + c];                              \
-        }                                                                      \
-      }                                                                        \
-      max /= scaling_factor;                                                   \
-      if (max > st->d->sample_peak[c]) st->d->sample_peak[c] = max;            \
-    }                                                                          \
+    ebur128_calc_sample_peak_##type(st, src, frames);                          \
   }                                                                            \
   if (ebur128_use_speex_resampler(st)) {                                       \
     for (c = 0; c < st->channels; ++c) {                                       \
@@ -781,6 +840,64 @@ int ebur128_loudness_global_multiple(ebur128_state** sts, size_t size,
   return ebur128_gated_loudness(sts, size, out);
 }
 
+int ebur128_get_block_energies(ebur128_state* st, double* out,
+                               size_t* count) {
+  struct ebur128_dq_entry* it;
+  size_t n = 0;
+  if ((st->mode & EBUR128_MODE_I) != EBUR128_MODE_I || st->d->use_histogram) {
+    return EBUR128_ERROR_INVALID_MODE;
+  }
+  SLIST_FOREACH(it, &st->d->block_list, entries) {
+    if (out) {
+      if (n >= *count) break;
+      out[n] = it->z;
+    }
+    ++n;
+  }
+  *count = n;
+  return EBUR128_SUCCESS;
+}
+
+int ebur128_loudness_global_blocks(const double* const* blocks,
+                                   const size_t* counts, size_t size,
+                                   double* out) {
+  double relative_threshold = 0.0;
+  double gated_loudness = 0.0;
+  size_t above_thresh_counter = 0;
+  size_t i, j;
+
+  for (i = 0; i < size; i++) {
+    for (j = 0; j < counts[i]; j++) {
+      if (blocks[i][j] < histogram_energy_boundaries[0]) continue;
+      ++above_thresh_counter;
+      relative_threshold += blocks[i][j];
+    }
+  }
+  if (!above_thresh_counter) {
+    *out = -HUGE_VAL;
+    return EBUR128_SUCCESS;
+  }
+  relative_threshold /= (double) above_thresh_counter;
+  relative_threshold *= relative_gate_factor;
+  above_thresh_counter = 0;
+  for (i = 0; i < size; i++) {
+    for (j = 0; j < counts[i]; j++) {
+      if (blocks[i][j] < histogram_energy_boundaries[0]) continue;
+      if (blocks[i][j] >= relative_threshold) {
+        ++above_thresh_counter;
+        gated_loudness += blocks[i][j];
+      }
+    }
+  }
+  if (!above_thresh_counter) {
+    *out = -HUGE_VAL;
+    return EBUR128_SUCCESS;
+  }
+  gated_loudness /= (double) above_thresh_counter;
+  *out = ebur128_energy_to_loudness(gated_loudness);
+  return EBUR128_SUCCESS;
+}
+
 static int ebur128_energy_in_interval(ebur128_state* st,
                                       size_t interval_frames,
                                       double* out) {
@@ -191,6 +191,39 @@ int ebur128_loudness_global_multiple(ebur128_state** sts,
                                      size_t size,
                                      double* out);
 
+/** \brief Get the gating block energies collected so far (deadbeef addition).
+ *
+ *  Only blocks above the absolute gate are stored by the library. The result
+ *  can be persisted and later passed to ebur128_loudness_global_blocks().
+ *
+ *  @param st library state.
+ *  @param out array to fill, or NULL to only query the number of blocks.
+ *  @param count in: capacity of out; out: number of blocks.
+ *  @return
+ *    - EBUR128_SUCCESS on success.
+ *    - EBUR128_ERROR_INVALID_MODE if mode "EBUR128_MODE_I" has not been set,
+ *      or if "EBUR128_MODE_HISTOGRAM" is used.
+ */
+int ebur128_get_block_energies(ebur128_state* st, double* out, size_t* count);
+/** \brief Get global integrated loudness in LUFS from stored block energies
+ *         (deadbeef addition).
+ *
+ *  Equivalent to ebur128_loudness_global_multiple() over the states the
+ *  blocks were taken from.
+ *
+ *  @param blocks array of block energy arrays, one per measured item.
+ *  @param counts number of blocks in each array.
+ *  @param size length of blocks and counts.
+ *  @param out integrated loudness in LUFS. -HUGE_VAL if result is negative
+ *             infinity.
+ *  @return
+ *    - EBUR128_SUCCESS on success.
+ */
+int ebur128_loudness_global_blocks(const double* const* blocks,
+                                   const size_t* counts,
+                                   size_t size,
+                                   double* out);
+
 /** \brief Get momentary loudness (last 400ms) in LUFS.
  *
  *  @param st library state.
@@ -34,6 +34,7 @@
 
 #include <deadbeef/deadbeef.h>
 #include "ebur128/ebur128.h"
+#include "scancache.h"
 #include <deadbeef/strdupa.h>
 
 #ifndef DISPATCH_QUEUE_CONCURRENT
@@ -47,45 +48,102 @@ static const char *album_signature = "$if2(%album artist% - %album%,%filename%)"
 static ddb_rg_scanner_t plugin;
 static DB_functions_t *deadbeef;
 
+typedef struct {
+    // Energies of the gating blocks above the absolute gate, as returned by ebur128_get_block_energies
+    double *energies;
+    size_t count;
+} track_blocks_t;
+
 typedef struct {
     int track_index;
     ddb_rg_scanner_settings_t *settings;
-    ebur128_state **gain_state;
-    ebur128_state **peak_state;
-    dispatch_queue_t sync_queue;
+    track_blocks_t *blocks;
 } track_state_t;
 
+static void
+_add_cd_samples_processed (ddb_rg_scanner_settings_t *settings, int64_t samples, int samplerate) {
+    __atomic_fetch_add (&settings->cd_samples_processed, (uint64_t)(samples * 44100 / samplerate), __ATOMIC_RELAXED);
+}
+
+static double
+_loudness_for_blocks (track_blocks_t *blocks, size_t count, double loudness) {
+    const double **energies = calloc (count, sizeof (double *));
+    size_t *counts = calloc (count, sizeof (size_t));
+    for (size_t i = 0; i < count; i++) {
+        energies[i] = blocks[i].energies;
+        counts[i] = blocks[i].count;
+    }
+    ebur128_loudness_global_blocks (energies, counts, count, &loudness);
+    free (energies);
+    free (counts);
+    return loudness;
+}
+
+static void
+_set_track_result (track_state_t *st, float peak) {
+    st->settings->results[st->track_index].track_peak = peak;
+
+    // calculate track loudness
+    double loudness = _loudness_for_blocks (&st->blocks[st->track_index], 1, st->settings->ref_loudness);
+    /*
+     * EBUR128 sets the target level to -23 LUFS = 84dB
+     * -> -23 - loudness = track gain to get to 84dB
+     *
+     * The old implementation of RG used 89dB, most people still use that
+     * -> the above + (loudness - 84) = track gain to get to 89dB (or user specified)
+     */
+    if (loudness != -HUGE_VAL) {
+        st->settings->results[st->track_index].track_gain = -23 - loudness + st->settings->ref_loudness - 84;
+    }
+}
+
 void
 rg_calc_track(track_state_t *st) {
     DB_decoder_t *dec = NULL;
     DB_fileinfo_t *fileinfo = NULL;
+    ebur128_state *state = NULL;
 
     char *buffer = NULL;
     float *bufferf = NULL;
 
+    DB_playItem_t *track = st->settings->tracks[st->track_index];
+    track_blocks_t *blocks = &st->blocks[st->track_index];
+
     if (st->settings->pabort && *(st->settings->pabort)) {
         return;
     }
-    if (deadbeef->pl_get_item_duration (st->settings->tracks[st->track_index]) <= 0) {
+    float duration = deadbeef->pl_get_item_duration (track);
+    if (duration <= 0) {
         st->settings->results[st->track_index].scan_result = DDB_RG_SCAN_RESULT_INVALID_FILE;
         return;
     }
 
+    // unchanged files don't need to be decoded again
+    float cached_peak;
+    if (!scan_cache_load (track, &cached_peak, &blocks->energies, &blocks->count)) {
+        _add_cd_samples_processed (st->settings, (int64_t)(duration * 44100), 44100);
+        _set_track_result (st, cached_peak);
+        return;
+    }
 
     deadbeef->pl_lock ();
-    dec = (DB_decoder_t *)deadbeef->plug_get_for_id (deadbeef->pl_find_meta (st->settings->tracks[st->track_index], ":DECODER"));
+    dec = (DB_decoder_t *)deadbeef->plug_get_for_id (deadbeef->pl_find_meta (track, ":DECODER"));
     deadbeef->pl_unlock ();
 
     if (dec) {
         fileinfo = dec->open (DDB_DECODER_HINT_RAW_SIGNAL);
 
-        if (!fileinfo || dec->init (fileinfo, DB_PLAYITEM (st->settings->tracks[st->track_index])) != 0) {
+        if (!fileinfo || dec->init (fileinfo, DB_PLAYITEM (track)) != 0) {
             st->settings->results[st->track_index].scan_result = DDB_RG_SCAN_RESULT_FILE_NOT_FOUND;
             goto error;
         }
 
-        st->gain_state[st->track_index] = ebur128_init(fileinfo->fmt.channels, fileinfo->fmt.samplerate, EBUR128_MODE_I);
-        st->peak_state[st->track_index] = ebur128_init(fileinfo->fmt.channels, fileinfo->fmt.samplerate, EBUR128_MODE_SAMPLE_PEAK);
+        // loudness and sample peak are measured in the same pass
+        state = ebur128_init(fileinfo->fmt.channels, fileinfo->fmt.samplerate, EBUR128_MODE_I | EBUR128_MODE_SAMPLE_PEAK);
+        if (!state) {
+            st->settings->results[st->track_index].scan_result = DDB_RG_SCAN_RESULT_INVALID_FILE;
+            goto error;
+        }
 
         // speaker mask mapping from WAV to EBUR128
         static const int chmap[18] = {
@@ -117,14 +175,12 @@ rg_calc_track(track_state_t *st) {
             if (i < 18) {
                 if (channelmask & (1<<i))
                 {
-                    ebur128_set_channel (st->gain_state[st->track_index], ch, chmap[i]);
-                    ebur128_set_channel (st->peak_state[st->track_index], ch, chmap[i]);
+                    ebur128_set_channel (state, ch, chmap[i]);
                     ch++;
                 }
             }
             else {
-                ebur128_set_channel (st->gain_state[st->track_index], ch, EBUR128_UNUSED);
-                ebur128_set_channel (st->peak_state[st->track_index], ch, EBUR128_UNUSED);
+                ebur128_set_channel (state, ch, EBUR128_UNUSED);
                 ch++;
             }
         }
@@ -136,7 +192,11 @@ rg_calc_track(track_state_t *st) {
 
         buffer = malloc (bs);
 
-        if (!fileinfo->fmt.is_float) {
+        // 16 and 32 bit integer samples are fed to the analyzer as is,
+        // other integer formats need to be converted to float
+        int is_native = fileinfo->fmt.is_float || fileinfo->fmt.bps == 16 || fileinfo->fmt.bps == 32;
+
+        if (!is_native) {
             bufferf = malloc (2000 * sizeof (float) * fileinfo->fmt.channels);
             memcpy (&fmt, &fileinfo->fmt, sizeof (fmt));
             fmt.bps = 32;
@@ -157,26 +217,28 @@ rg_calc_track(track_state_t *st) {
 
             int sz = dec->read (fileinfo, buffer, bs); // read one block
 
-            dispatch_sync(st->sync_queue, ^{
-                int samplesize = fileinfo->fmt.channels * (fileinfo->fmt.bps >> 3);
-                int numsamples = sz / samplesize;
-                st->settings->cd_samples_processed += numsamples * 44100 / fileinfo->fmt.samplerate;
-            });
-
             if (sz != bs) {
                 eof = 1;
             }
 
-            // convert from native output to float,
-            // only if the input is not float already
-            if (!fileinfo->fmt.is_float) {
-                deadbeef->pcm_convert (&fileinfo->fmt, buffer, &fmt, (char *)bufferf, sz);
-            }
-
             int frames = sz / samplesize;
 
-            ebur128_add_frames_float (st->gain_state[st->track_index], bufferf, frames); // collect data
-            ebur128_add_frames_float (st->peak_state[st->track_index], bufferf, frames); // collect data
+            _add_cd_samples_processed (st->settings, frames, fileinfo->fmt.samplerate);
+
+            // collect data
+            if (fileinfo->fmt.is_float) {
+                ebur128_add_frames_float (state, bufferf, frames);
+            }
+            else if (fileinfo->fmt.bps == 16) {
+                ebur128_add_frames_short (state, (const short *)buffer, frames);
+            }
+            else if (fileinfo->fmt.bps == 32) {
+                ebur128_add_frames_int (state, (const int *)buffer, frames);
+            }
+            else {
+                deadbeef->pcm_convert (&fileinfo->fmt, buffer, &fmt, (char *)bufferf, sz);
+                ebur128_add_frames_float (state, bufferf, frames);
+            }
         }
 
         if (!st->settings->pabort || !(*(st->settings->pabort))) {
@@ -184,36 +246,34 @@ rg_calc_track(track_state_t *st) {
             // libEBUR128 calculates peak per channel, so we have to pick the highest value
             double tr_peak = 0;
             double ch_peak = 0;
-            int res;
             for (int ch = 0; ch < fileinfo->fmt.channels; ++ch) {
-                res = ebur128_sample_peak (st->peak_state[st->track_index], ch, &ch_peak);
-                //trace ("rg_scanner: peak for ch %d: %f\n", ch, ch_peak);
+                ebur128_sample_peak (state, ch, &ch_peak);
                 if (ch_peak > tr_peak) {
-                    //trace ("rg_scanner: %f > %f\n", ch_peak, tr_peak);
                     tr_peak = ch_peak;
                 }
             }
 
-            st->settings->results[st->track_index].track_peak = (float) tr_peak;
-
-            // calculate track loudness
-            double loudness = st->settings->ref_loudness;
-            ebur128_loudness_global (st->gain_state[st->track_index], &loudness);
-            /*
-             * EBUR128 sets the target level to -23 LUFS = 84dB
-             * -> -23 - loudness = track gain to get to 84dB
-             *
-             * The old implementation of RG used 89dB, most people still use that
-             * -> the above + (loudness - 84) = track gain to get to 89dB (or user specified)
-             */
-            if (loudness != -HUGE_VAL) {
-                st->settings->results[st->track_index].track_gain = -23 - loudness + st->settings->ref_loudness - 84;
+            // keep the gating blocks, they're needed to calculate album gain
+            size_t count = 0;
+            ebur128_get_block_energies (state, NULL, &count);
+            blocks->energies = count ? malloc (count * sizeof (double)) : NULL;
+            blocks->count = count;
+            if (count) {
+                ebur128_get_block_energies (state, blocks->energies, &blocks->count);
             }
+
+            scan_cache_store (track, (float)tr_peak, blocks->energies, blocks->count);
+
+            _set_track_result (st, (float)tr_peak);
         }
     }
 
 error:
     // clean up
+    if (state) {
+        ebur128_destroy (&state);
+    }
+
     if (fileinfo) {
         dec->free (fileinfo);
     }
@@ -230,7 +290,7 @@ error:
 }
 
 static int
-_update_album_gain (ddb_rg_scanner_settings_t *settings, int i, int album_start, char *current_album, char *album, double loudness, ebur128_state **gain_state) {
+_update_album_gain (ddb_rg_scanner_settings_t *settings, int i, int album_start, char *current_album, char *album, double loudness, track_blocks_t *blocks) {
     if (strcmp (album, current_album)) {
         if (i > 0) {
             // update current album gain/peak
@@ -243,7 +303,7 @@ _update_album_gain (ddb_rg_scanner_settings_t *settings, int i, int album_start,
             }
 
             // calculate gain of all tracks of the current album
-            ebur128_loudness_global_multiple(&gain_state[album_start], (size_t)i-album_start, &loudness);
+            loudness = _loudness_for_blocks (&blocks[album_start], (size_t)i-album_start, loudness);
 
             float album_gain = -23 - (float)loudness + settings->ref_loudness - 84;
 
@@ -280,8 +340,7 @@ rg_scan (ddb_rg_scanner_settings_t *settings) {
 
     //trace ("rg_scanner: using %d thread(s)\n", settings->num_threads);
 
-    ebur128_state **gain_state = NULL;
-    ebur128_state **peak_state = NULL;
+    track_blocks_t *blocks = NULL;
 
     if (settings->ref_loudness == 0) {
         settings->ref_loudness = DDB_RG_SCAN_DEFAULT_LOUDNESS;
@@ -290,14 +349,12 @@ rg_scan (ddb_rg_scanner_settings_t *settings) {
     double loudness = settings->ref_loudness;
 
     // allocate status array
-    gain_state = calloc (settings->num_tracks, sizeof (ebur128_state *));
-    peak_state = calloc (settings->num_tracks, sizeof (ebur128_state *));
+    blocks = calloc (settings->num_tracks, sizeof (track_blocks_t));
 
     track_state_t *track_states = calloc (settings->num_tracks, sizeof (track_state_t));
 
     dispatch_semaphore_t semaphore = dispatch_semaphore_create(settings->num_threads);
     dispatch_queue_t queue = dispatch_queue_create("rg_scanner", DISPATCH_QUEUE_CONCURRENT);
-    dispatch_queue_t sync_queue = dispatch_queue_create("rg_scanner_sync", 0);
 
     // calculate gain for each track and album
     for (int i = 0; i < settings->num_tracks; ++i) {
@@ -319,9 +376,7 @@ rg_scan (ddb_rg_scanner_settings_t *settings) {
         // initialize arguments
         track_states[i].track_index = i;
         track_states[i].settings = settings;
-        track_states[i].gain_state = gain_state;
-        track_states[i].peak_state = peak_state;
-        track_states[i].sync_queue = sync_queue;
+        track_states[i].blocks = blocks;
 
         dispatch_async(queue, ^{
             rg_calc_track(&track_states[i]);
@@ -358,7 +413,7 @@ rg_scan (ddb_rg_scanner_settings_t *settings) {
             else {
                 *album = 0;
             }
-            album_start = _update_album_gain (settings, i, album_start, current_album, album, loudness, gain_state);
+            album_start = _update_album_gain (settings, i, album_start, current_album, album, loudness, blocks);
         }
     }
 
@@ -372,7 +427,7 @@ rg_scan (ddb_rg_scanner_settings_t *settings) {
         }
 
         // calculate gain of all tracks combined
-        ebur128_loudness_global_multiple(gain_state, (size_t)settings->num_tracks, &loudness);
+        loudness = _loudness_for_blocks (blocks, (size_t)settings->num_tracks, loudness);
 
         float album_gain = -23 - (float)loudness + settings->ref_loudness - 84;
 
@@ -392,32 +447,20 @@ cleanup:
     semaphore = NULL;
     dispatch_release(queue);
     queue = NULL;
-    dispatch_release(sync_queue);
-    sync_queue = NULL;
+
+    scan_cache_prune ();
 
     if (track_states) {
         free (track_states);
         track_states = NULL;
     }
 
-    if (gain_state) {
-        for (int i = 0; i < settings->num_tracks; ++i) {
-            if (gain_state[i]) {
-                ebur128_destroy (&gain_state[i]);
-            }
-        }
-        free (gain_state);
-        gain_state = NULL;
-    }
-
-    if (peak_state) {
+    if (blocks) {
         for (int i = 0; i < settings->num_tracks; ++i) {
-            if (peak_state[i]) {
-                ebur128_destroy (&peak_state[i]);
-            }
+            free (blocks[i].energies);
         }
-        free (peak_state);
-        peak_state = NULL;
+        free (blocks);
+        blocks = NULL;
     }
 
     if (album_signature_tf) {
@@ -523,7 +566,7 @@ static ddb_rg_scanner_t plugin = {
     .misc.plugin.api_vmajor = DB_API_VERSION_MAJOR,
     .misc.plugin.api_vminor = DB_API_VERSION_MINOR,
     .misc.plugin.version_major = 1,
-    .misc.plugin.version_minor = 0,
+    .misc.plugin.version_minor = 1,
     .misc.plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
     .misc.plugin.type = DB_PLUGIN_MISC,
     .misc.plugin.name = "ReplayGain Scanner",
@@ -566,5 +609,6 @@ static ddb_rg_scanner_t plugin = {
 DB_plugin_t *
 rg_scanner_load (DB_functions_t *api) {
     deadbeef = api;
+    scan_cache_init (api);
     return DB_PLUGIN (&plugin);
 }
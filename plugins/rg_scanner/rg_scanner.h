@@ -82,6 +82,7 @@ typedef struct {
 
     // How many 44.1kHz samples of PCM data have been processed.
     // Set by the scanner, can be used in the progress callback, to calculate scanning speed.
+    // Updated atomically by the scanner threads; tracks loaded from the scan cache count as processed.
     uint64_t cd_samples_processed;
 } ddb_rg_scanner_settings_t;
 
@@ -0,0 +1,423 @@
+/*
+ * ReplayGain Scanner plugin for DeaDBeeF Player
+ *
+ * Copyright (c) 2016-2026 Oleksiy Yakovenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+#include "scancache.h"
+
+// The cache files are little endian, with the fields written one by one, without padding:
+// magic, u32 version, u64 file size, u64 file mtime, i64 startsample, i64 endsample, u32 path length, path,
+// the peak as u32 float bits, u64 block count, and the block energies as u64 double bits.
+#define SCAN_CACHE_MAGIC "RGSC"
+#define SCAN_CACHE_VERSION 2
+#define SCAN_CACHE_HEADER_SIZE 44 // up to the path
+#define SCAN_CACHE_TAIL_SIZE 12 // peak and block count, after the path
+#define SCAN_CACHE_CHUNK 1024 // blocks per read/write
+
+// Sanity limit, ~1 week of audio
+#define SCAN_CACHE_MAX_BLOCKS (10 * 60 * 60 * 24 * 7)
+
+#define SCAN_CACHE_DEFAULT_SIZE_MB 128
+
+// Temp files of the writers which didn't finish, e.g. on crash
+#define SCAN_CACHE_STALE_TEMP_SECONDS (60 * 60)
+
+static DB_functions_t *deadbeef;
+
+typedef struct {
+    char path[PATH_MAX];
+    int64_t size;
+    int64_t mtime;
+    int64_t startsample;
+    int64_t endsample;
+} scan_cache_key_t;
+
+static inline void
+le_uint32 (uint32_t in, unsigned char *out) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (in >> (i * 8)) & 0xff;
+    }
+}
+
+static inline void
+le_uint64 (uint64_t in, unsigned char *out) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (in >> (i * 8)) & 0xff;
+    }
+}
+
+static inline uint32_t
+le_read_uint32 (const unsigned char *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static inline uint64_t
+le_read_uint64 (const unsigned char *in) {
+    return (uint64_t)le_read_uint32 (in) | ((uint64_t)le_read_uint32 (in + 4) << 32);
+}
+
+void
+scan_cache_init (DB_functions_t *api) {
+    deadbeef = api;
+}
+
+// 64-bit FNV-1a
+static uint64_t
+_hash_bytes (uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static int
+_make_key (DB_playItem_t *track, scan_cache_key_t *key) {
+    deadbeef->pl_lock ();
+    const char *uri = deadbeef->pl_find_meta_raw (track, ":URI");
+    if (!uri) {
+        deadbeef->pl_unlock ();
+        return -1;
+    }
+    if (!strncasecmp (uri, "file://", 7)) {
+        uri += 7;
+    }
+    if (uri[0] != '/' || strlen (uri) >= sizeof (key->path)) {
+        // remote streams, or files inside containers
+        deadbeef->pl_unlock ();
+        return -1;
+    }
+    strcpy (key->path, uri);
+    deadbeef->pl_unlock ();
+
+    struct stat stat_buf;
+    if (stat (key->path, &stat_buf) || !S_ISREG (stat_buf.st_mode)) {
+        return -1;
+    }
+
+    key->size = (int64_t)stat_buf.st_size;
+    key->mtime = (int64_t)stat_buf.st_mtime;
+    key->startsample = deadbeef->pl_item_get_startsample (track);
+    key->endsample = deadbeef->pl_item_get_endsample (track);
+    return 0;
+}
+
+static int
+_make_cache_dir_path (char *path, size_t size) {
+    size_t res = snprintf (path, size, "%s/rg_scanner", deadbeef->get_system_dir (DDB_SYS_DIR_CACHE));
+    return res >= size ? -1 : 0;
+}
+
+static int
+_make_cache_path (const scan_cache_key_t *key, char *path, size_t size) {
+    unsigned char range[16];
+    le_uint64 ((uint64_t)key->startsample, range);
+    le_uint64 ((uint64_t)key->endsample, range + 8);
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = _hash_bytes (hash, key->path, strlen (key->path));
+    hash = _hash_bytes (hash, range, sizeof (range));
+
+    size_t res = snprintf (path, size, "%s/rg_scanner/%016llx", deadbeef->get_system_dir (DDB_SYS_DIR_CACHE), (unsigned long long)hash);
+    return res >= size ? -1 : 0;
+}
+
+static int
+_ensure_cache_dir (void) {
+    const char *cache_root = deadbeef->get_system_dir (DDB_SYS_DIR_CACHE);
+    if (mkdir (cache_root, 0755) && errno != EEXIST) {
+        return -1;
+    }
+    char dir[PATH_MAX];
+    if (_make_cache_dir_path (dir, sizeof (dir))) {
+        return -1;
+    }
+    if (mkdir (dir, 0755) && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+_read_key_and_compare (FILE *fp, const scan_cache_key_t *key) {
+    unsigned char header[SCAN_CACHE_HEADER_SIZE];
+    if (fread (header, 1, sizeof (header), fp) != sizeof (header)
+        || memcmp (header, SCAN_CACHE_MAGIC, 4)
+        || le_read_uint32 (header + 4) != SCAN_CACHE_VERSION) {
+        return -1;
+    }
+
+    if ((int64_t)le_read_uint64 (header + 8) != key->size
+        || (int64_t)le_read_uint64 (header + 16) != key->mtime
+        || (int64_t)le_read_uint64 (header + 24) != key->startsample
+        || (int64_t)le_read_uint64 (header + 32) != key->endsample) {
+        return -1;
+    }
+
+    // the full path is stored to rule out hash collisions
+    uint32_t path_len = le_read_uint32 (header + 40);
+    char path[PATH_MAX];
+    if (path_len >= sizeof (path)) {
+        return -1;
+    }
+    if (fread (path, 1, path_len, fp) != path_len) {
+        return -1;
+    }
+    path[path_len] = 0;
+    return strcmp (path, key->path) ? -1 : 0;
+}
+
+int
+scan_cache_load (DB_playItem_t *track, float *peak, double **blocks, size_t *num_blocks) {
+    scan_cache_key_t key;
+    char cache_path[PATH_MAX];
+    if (_make_key (track, &key) || _make_cache_path (&key, cache_path, sizeof (cache_path))) {
+        return -1;
+    }
+
+    FILE *fp = fopen (cache_path, "rb");
+    if (!fp) {
+        return -1;
+    }
+
+    int res = -1;
+    double *data = NULL;
+    unsigned char tail[SCAN_CACHE_TAIL_SIZE];
+    unsigned char buffer[SCAN_CACHE_CHUNK * 8];
+    uint32_t peak_bits;
+    uint64_t count;
+
+    if (_read_key_and_compare (fp, &key)) {
+        goto error;
+    }
+    if (fread (tail, 1, sizeof (tail), fp) != sizeof (tail)) {
+        goto error;
+    }
+    peak_bits = le_read_uint32 (tail);
+    count = le_read_uint64 (tail + 4);
+    if (count > SCAN_CACHE_MAX_BLOCKS) {
+        goto error;
+    }
+    if (count > 0) {
+        data = malloc (count * sizeof (double));
+        if (!data) {
+            goto error;
+        }
+        for (uint64_t i = 0; i < count; ) {
+            size_t n = count - i < SCAN_CACHE_CHUNK ? (size_t)(count - i) : SCAN_CACHE_CHUNK;
+            if (fread (buffer, 8, n, fp) != n) {
+                goto error;
+            }
+            for (size_t j = 0; j < n; j++, i++) {
+                uint64_t bits = le_read_uint64 (buffer + j * 8);
+                memcpy (&data[i], &bits, sizeof (double));
+            }
+        }
+    }
+
+    memcpy (peak, &peak_bits, sizeof (float));
+
+    *blocks = data;
+    *num_blocks = (size_t)count;
+    data = NULL;
+    res = 0;
+
+    // the pruning removes the least recently used entries first
+    (void)utime (cache_path, NULL);
+
+error:
+    free (data);
+    fclose (fp);
+    return res;
+}
+
+void
+scan_cache_store (DB_playItem_t *track, float peak, const double *blocks, size_t num_blocks) {
+    scan_cache_key_t key;
+    char cache_path[PATH_MAX];
+    if (_make_key (track, &key) || _make_cache_path (&key, cache_path, sizeof (cache_path))) {
+        return;
+    }
+    if (_ensure_cache_dir ()) {
+        return;
+    }
+
+    // Write to a temp file first, so that readers never see a partial entry.
+    // The same file may be scanned by several threads at once, hence the unique name.
+    char temp_path[PATH_MAX];
+    if (snprintf (temp_path, sizeof (temp_path), "%s.part.XXXXXX", cache_path) >= sizeof (temp_path)) {
+        return;
+    }
+
+    int fd = mkstemp (temp_path);
+    if (fd == -1) {
+        return;
+    }
+    FILE *fp = fdopen (fd, "w+b");
+    if (!fp) {
+        close (fd);
+        (void)unlink (temp_path);
+        return;
+    }
+
+    uint32_t path_len = (uint32_t)strlen (key.path);
+    unsigned char header[SCAN_CACHE_HEADER_SIZE];
+    memcpy (header, SCAN_CACHE_MAGIC, 4);
+    le_uint32 (SCAN_CACHE_VERSION, header + 4);
+    le_uint64 ((uint64_t)key.size, header + 8);
+    le_uint64 ((uint64_t)key.mtime, header + 16);
+    le_uint64 ((uint64_t)key.startsample, header + 24);
+    le_uint64 ((uint64_t)key.endsample, header + 32);
+    le_uint32 (path_len, header + 40);
+
+    uint32_t peak_bits;
+    memcpy (&peak_bits, &peak, sizeof (float));
+    unsigned char tail[SCAN_CACHE_TAIL_SIZE];
+    le_uint32 (peak_bits, tail);
+    le_uint64 ((uint64_t)num_blocks, tail + 4);
+
+    int err = fwrite (header, 1, sizeof (header), fp) != sizeof (header)
+        || fwrite (key.path, 1, path_len, fp) != path_len
+        || fwrite (tail, 1, sizeof (tail), fp) != sizeof (tail);
+
+    unsigned char buffer[SCAN_CACHE_CHUNK * 8];
+    for (size_t i = 0; i < num_blocks && !err; ) {
+        size_t n = num_blocks - i < SCAN_CACHE_CHUNK ? num_blocks - i : SCAN_CACHE_CHUNK;
+        for (size_t j = 0; j < n; j++, i++) {
+            uint64_t bits;
+            memcpy (&bits, &blocks[i], sizeof (double));
+            le_uint64 (bits, buffer + j * 8);
+        }
+        if (fwrite (buffer, 8, n, fp) != n) {
+            err = 1;
+        }
+    }
+
+    if (fclose (fp)) {
+        err = 1;
+    }
+
+    if (err || rename (temp_path, cache_path)) {
+        (void)unlink (temp_path);
+    }
+}
+
+typedef struct {
+    char name[64];
+    time_t mtime;
+    int64_t size;
+} scan_cache_entry_t;
+
+static int
+_entry_cmp_mtime (const void *a, const void *b) {
+    const scan_cache_entry_t *ea = a;
+    const scan_cache_entry_t *eb = b;
+    if (ea->mtime != eb->mtime) {
+        return ea->mtime < eb->mtime ? -1 : 1;
+    }
+    return strcmp (ea->name, eb->name);
+}
+
+void
+scan_cache_prune (void) {
+    int64_t limit = (int64_t)deadbeef->conf_get_int ("rg_scanner.cache_size_mb", SCAN_CACHE_DEFAULT_SIZE_MB) * 1024 * 1024;
+
+    char dir_path[PATH_MAX];
+    if (_make_cache_dir_path (dir_path, sizeof (dir_path))) {
+        return;
+    }
+    DIR *dir = opendir (dir_path);
+    if (!dir) {
+        return;
+    }
+
+    scan_cache_entry_t *entries = NULL;
+    size_t count = 0;
+    size_t reserved = 0;
+    int64_t total = 0;
+    time_t stale_time = time (NULL) - SCAN_CACHE_STALE_TEMP_SECONDS;
+
+    struct dirent *de;
+    char path[PATH_MAX];
+    while ((de = readdir (dir))) {
+        if (de->d_name[0] == '.' || strlen (de->d_name) >= sizeof (entries->name)) {
+            continue;
+        }
+        if (snprintf (path, sizeof (path), "%s/%s", dir_path, de->d_name) >= sizeof (path)) {
+            continue;
+        }
+        struct stat stat_buf;
+        if (stat (path, &stat_buf) || !S_ISREG (stat_buf.st_mode)) {
+            continue;
+        }
+        if (strstr (de->d_name, ".part.")) {
+            if (stat_buf.st_mtime < stale_time) {
+                (void)unlink (path);
+            }
+            continue;
+        }
+        if (count == reserved) {
+            size_t new_reserved = reserved ? reserved * 2 : 256;
+            scan_cache_entry_t *new_entries = realloc (entries, new_reserved * sizeof (scan_cache_entry_t));
+            if (!new_entries) {
+                break;
+            }
+            entries = new_entries;
+            reserved = new_reserved;
+        }
+        strcpy (entries[count].name, de->d_name);
+        entries[count].mtime = stat_buf.st_mtime;
+        entries[count].size = (int64_t)stat_buf.st_size;
+        total += entries[count].size;
+        count++;
+    }
+    closedir (dir);
+
+    if (total > limit) {
+        // remove the least recently used entries
+        qsort (entries, count, sizeof (scan_cache_entry_t), _entry_cmp_mtime);
+        for (size_t i = 0; i < count && total > limit; i++) {
+            if (snprintf (path, sizeof (path), "%s/%s", dir_path, entries[i].name) >= sizeof (path)) {
+                continue;
+            }
+            if (!unlink (path)) {
+                total -= entries[i].size;
+            }
+        }
+    }
+
+    free (entries);
+}
@@ -0,0 +1,52 @@
+/*
+ * ReplayGain Scanner plugin for DeaDBeeF Player
+ *
+ * Copyright (c) 2016-2026 Oleksiy Yakovenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef scancache_h
+#define scancache_h
+
+#include <stddef.h>
+#include <deadbeef/deadbeef.h>
+
+// Persistent per-file EBU R128 scan results.
+// Entries are keyed by the file path, size, modification time and the track's
+// sample range, so any change to the file makes the old entry unreachable.
+// Only local files are cached. The size of the cache is limited by "rg_scanner.cache_size_mb".
+
+void
+scan_cache_init (DB_functions_t *api);
+
+// Returns 0 on hit, with *blocks allocated using malloc (may be NULL if num_blocks is 0).
+int
+scan_cache_load (DB_playItem_t *track, float *peak, double **blocks, size_t *num_blocks);
+
+void
+scan_cache_store (DB_playItem_t *track, float peak, const double *blocks, size_t num_blocks);
+
+// Removes the least recently used entries when the cache is over the size limit
+// ("rg_scanner.cache_size_mb"), and the temp files left by the interrupted writers.
+void
+scan_cache_prune (void);
+
+#endif /* scancache_h */
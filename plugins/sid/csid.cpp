@@ -19,6 +19,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #ifdef HAVE_CONFIG_H
 #  include <config.h>
@@ -58,15 +61,56 @@ le_int16 (int16_t in, unsigned char *out) {
     out[1] = (in&0xff00)>>8;
 }
 
+static inline void
+le_uint32 (uint32_t in, unsigned char *out) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (in >> (i * 8)) & 0xff;
+    }
+}
+
+static inline void
+le_uint64 (uint64_t in, unsigned char *out) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (in >> (i * 8)) & 0xff;
+    }
+}
+
+static inline uint16_t
+le_read_uint16 (const unsigned char *in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static inline uint32_t
+le_read_uint32 (const unsigned char *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static inline uint64_t
+le_read_uint64 (const unsigned char *in) {
+    return (uint64_t)le_read_uint32 (in) | ((uint64_t)le_read_uint32 (in + 4) << 32);
+}
+
 // NOTE: we know that current SLDB is larger than that, but we want the code to go into realloc path
 #define SLDB_PREALLOC_ITEMS 50000
 #define SLDB_PREALLOC_LENGTHS SLDB_PREALLOC_ITEMS
+
+// The items are sorted by digest after loading
 typedef struct {
     uint8_t digest[16];
-    size_t lengths_offset;
+    uint32_t lengths_offset;
     uint16_t subsongs;
 } sldb_item_t;
 
+// The binary cache is little endian, with the fields written one by one, without padding:
+// magic, u32 version, u64 file size, u64 file mtime, u32 path length, path,
+// u32 item count, u32 length count, the items, and the u16 lengths.
+#define SLDB_CACHE_MAGIC "SLDB"
+#define SLDB_CACHE_VERSION 2
+#define SLDB_CACHE_MAX_ITEMS 10000000
+#define SLDB_CACHE_HEADER_SIZE 28
+#define SLDB_CACHE_ITEM_SIZE 22 // digest, u32 lengths_offset, u16 subsongs
+#define SLDB_CACHE_CHUNK 1024 // items or lengths per read/write
+
 static sldb_item_t *sldb;
 static size_t sldb_allocated_size;
 static size_t sldb_count;
@@ -81,6 +125,190 @@ static int sldb_legacy;
 
 static int conf_hvsc_enable = 0;
 
+static int
+sldb_item_compare (const void *a, const void *b) {
+    const sldb_item_t *ia = (const sldb_item_t *)a;
+    const sldb_item_t *ib = (const sldb_item_t *)b;
+    int res = memcmp (ia->digest, ib->digest, 16);
+    if (res) {
+        return res;
+    }
+    // keep the file order of duplicates, sldb_find returns the first one
+    return ia->lengths_offset < ib->lengths_offset ? -1 : ia->lengths_offset > ib->lengths_offset;
+}
+
+static int
+sldb_cache_path (char *path, size_t size, int create_dir) {
+    const char *cache_root = deadbeef->get_system_dir (DDB_SYS_DIR_CACHE);
+    if (create_dir && mkdir (cache_root, 0755) && errno != EEXIST) {
+        return -1;
+    }
+    if (snprintf (path, size, "%s/sid", cache_root) >= (int)size) {
+        return -1;
+    }
+    if (create_dir && mkdir (path, 0755) && errno != EEXIST) {
+        return -1;
+    }
+    if (snprintf (path, size, "%s/sid/songlengths", cache_root) >= (int)size) {
+        return -1;
+    }
+    return 0;
+}
+
+// Loads the parsed database from the cache, if it was made from the same file.
+// The cache is keyed by the full path, size and mtime of the songlengths file.
+static int
+sldb_cache_load (const char *fname, const struct stat *st) {
+    char cache_path[PATH_MAX];
+    if (sldb_cache_path (cache_path, sizeof (cache_path), 0)) {
+        return -1;
+    }
+    FILE *fp = fopen (cache_path, "rb");
+    if (!fp) {
+        return -1;
+    }
+
+    int res = -1;
+    sldb_item_t *items = NULL;
+    uint16_t *lengths = NULL;
+    unsigned char header[SLDB_CACHE_HEADER_SIZE];
+    uint32_t path_len;
+    char path[PATH_MAX];
+    unsigned char counts_data[8];
+    uint32_t counts[2];
+    unsigned char buffer[SLDB_CACHE_CHUNK * SLDB_CACHE_ITEM_SIZE];
+
+    if (fread (header, 1, sizeof (header), fp) != sizeof (header)
+        || memcmp (header, SLDB_CACHE_MAGIC, 4)
+        || le_read_uint32 (header + 4) != SLDB_CACHE_VERSION
+        || le_read_uint64 (header + 8) != (uint64_t)st->st_size
+        || le_read_uint64 (header + 16) != (uint64_t)st->st_mtime) {
+        goto error;
+    }
+    path_len = le_read_uint32 (header + 24);
+    if (path_len >= sizeof (path) || fread (path, 1, path_len, fp) != path_len) {
+        goto error;
+    }
+    path[path_len] = 0;
+    if (strcmp (path, fname)) {
+        goto error;
+    }
+    if (fread (counts_data, 1, sizeof (counts_data), fp) != sizeof (counts_data)) {
+        goto error;
+    }
+    counts[0] = le_read_uint32 (counts_data);
+    counts[1] = le_read_uint32 (counts_data + 4);
+    if (counts[0] == 0 || counts[0] > SLDB_CACHE_MAX_ITEMS || counts[1] > SLDB_CACHE_MAX_ITEMS) {
+        goto error;
+    }
+    items = (sldb_item_t *)malloc (counts[0] * sizeof (sldb_item_t));
+    lengths = (uint16_t *)malloc ((counts[1] + 1) * sizeof (uint16_t));
+    if (!items || !lengths) {
+        goto error;
+    }
+    for (uint32_t i = 0; i < counts[0]; ) {
+        uint32_t n = min (counts[0] - i, SLDB_CACHE_CHUNK);
+        if (fread (buffer, SLDB_CACHE_ITEM_SIZE, n, fp) != n) {
+            goto error;
+        }
+        for (uint32_t j = 0; j < n; j++, i++) {
+            const unsigned char *data = buffer + j * SLDB_CACHE_ITEM_SIZE;
+            memcpy (items[i].digest, data, 16);
+            items[i].lengths_offset = le_read_uint32 (data + 16);
+            items[i].subsongs = le_read_uint16 (data + 20);
+            if ((uint64_t)items[i].lengths_offset + items[i].subsongs > counts[1]) {
+                goto error;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < counts[1]; ) {
+        uint32_t n = min (counts[1] - i, SLDB_CACHE_CHUNK);
+        if (fread (buffer, sizeof (uint16_t), n, fp) != n) {
+            goto error;
+        }
+        for (uint32_t j = 0; j < n; j++, i++) {
+            lengths[i] = le_read_uint16 (buffer + j * 2);
+        }
+    }
+
+    free (sldb);
+    free (sldb_lengths);
+    sldb = items;
+    sldb_count = sldb_allocated_size = counts[0];
+    sldb_lengths = lengths;
+    sldb_lengths_count = counts[1];
+    sldb_lengths_allocated_size = counts[1] + 1;
+    items = NULL;
+    lengths = NULL;
+    res = 0;
+
+error:
+    free (items);
+    free (lengths);
+    fclose (fp);
+    return res;
+}
+
+static void
+sldb_cache_store (const char *fname, const struct stat *st) {
+    char cache_path[PATH_MAX];
+    if (sldb_cache_path (cache_path, sizeof (cache_path), 1)) {
+        return;
+    }
+
+    // write to a temp file first, so that a partial cache is never loaded
+    char temp_path[PATH_MAX];
+    if (snprintf (temp_path, sizeof (temp_path), "%s.part", cache_path) >= (int)sizeof (temp_path)) {
+        return;
+    }
+    FILE *fp = fopen (temp_path, "w+b");
+    if (!fp) {
+        return;
+    }
+
+    uint32_t path_len = (uint32_t)strlen (fname);
+    unsigned char header[SLDB_CACHE_HEADER_SIZE];
+    memcpy (header, SLDB_CACHE_MAGIC, 4);
+    le_uint32 (SLDB_CACHE_VERSION, header + 4);
+    le_uint64 ((uint64_t)st->st_size, header + 8);
+    le_uint64 ((uint64_t)st->st_mtime, header + 16);
+    le_uint32 (path_len, header + 24);
+    unsigned char counts[8];
+    le_uint32 ((uint32_t)sldb_count, counts);
+    le_uint32 ((uint32_t)sldb_lengths_count, counts + 4);
+
+    int err = fwrite (header, 1, sizeof (header), fp) != sizeof (header)
+        || fwrite (fname, 1, path_len, fp) != path_len
+        || fwrite (counts, 1, sizeof (counts), fp) != sizeof (counts);
+
+    unsigned char buffer[SLDB_CACHE_CHUNK * SLDB_CACHE_ITEM_SIZE];
+    for (size_t i = 0; i < sldb_count && !err; ) {
+        size_t n = min (sldb_count - i, SLDB_CACHE_CHUNK);
+        for (size_t j = 0; j < n; j++, i++) {
+            unsigned char *data = buffer + j * SLDB_CACHE_ITEM_SIZE;
+            memcpy (data, sldb[i].digest, 16);
+            le_uint32 (sldb[i].lengths_offset, data + 16);
+            le_int16 ((int16_t)sldb[i].subsongs, data + 20);
+        }
+        err = fwrite (buffer, SLDB_CACHE_ITEM_SIZE, n, fp) != n;
+    }
+    for (size_t i = 0; i < sldb_lengths_count && !err; ) {
+        size_t n = min (sldb_lengths_count - i, SLDB_CACHE_CHUNK);
+        for (size_t j = 0; j < n; j++, i++) {
+            le_int16 ((int16_t)sldb_lengths[i], buffer + j * 2);
+        }
+        err = fwrite (buffer, sizeof (uint16_t), n, fp) != n;
+    }
+
+    if (fclose (fp)) {
+        err = 1;
+    }
+
+    if (err || rename (temp_path, cache_path)) {
+        (void)unlink (temp_path);
+    }
+}
+
 static void
 sldb_load()
 {
@@ -106,6 +334,14 @@ sldb_load()
     }
 
     const char *fname = conf_hvsc_path;
+    struct stat st;
+    int have_stat = !stat (fname, &st);
+    if (have_stat && !sldb_cache_load (fname, &st)) {
+        trace ("sid: loaded %d songs from the sldb cache\n", (int)sldb_count);
+        sldb_disable = 1;
+        return;
+    }
+
     FILE *fp = fopen (fname, "r");
     if (!fp) {
         trace ("sid: failed to open file %s\n", fname);
@@ -255,6 +491,14 @@ sldb_load()
         sldb_count++;
     }
 
+    // sort by digest for sldb_find, and save the result, so that the text is parsed only once
+    if (sldb_count > 0) {
+        qsort (sldb, sldb_count, sizeof (sldb_item_t), sldb_item_compare);
+        if (have_stat) {
+            sldb_cache_store (fname, &st);
+        }
+    }
+
 fail:
     sldb_disable = 1;
     fclose (fp);
@@ -267,10 +511,20 @@ sldb_find (const uint8_t *digest) {
         trace ("sldb not loaded\n");
         return -1;
     }
-    for (int i = 0; i < sldb_count; i++) {
-        if (!memcmp (digest, sldb[i].digest, 16)) {
-            return i;
+    // lower bound, to find the first of the duplicates
+    size_t lo = 0;
+    size_t hi = sldb_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (memcmp (sldb[mid].digest, digest, 16) < 0) {
+            lo = mid + 1;
         }
+        else {
+            hi = mid;
+        }
+    }
+    if (lo < sldb_count && !memcmp (digest, sldb[lo].digest, 16)) {
+        return (int)lo;
     }
     return -1;
 }
@@ -214,9 +214,7 @@ tta_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     int64_t fsize = -1;
     if (fp) {
         fsize = deadbeef->fgetlength (fp);
-        /*int apeerr = */deadbeef->junk_apev2_read (it, fp);
-        /*int v2err = */deadbeef->junk_id3v2_read (it, fp);
-        /*int v1err = */deadbeef->junk_id3v1_read (it, fp);
+        /*int tagerr = */deadbeef->junk_read_tags (it, fp, NULL, NULL);
         deadbeef->fclose (fp);
     }
 
@@ -254,9 +252,7 @@ static int tta_read_metadata (DB_playItem_t *it) {
         return -1;
     }
     deadbeef->pl_delete_all_meta (it);
-    /*int apeerr = */deadbeef->junk_apev2_read (it, fp);
-    /*int v2err = */deadbeef->junk_id3v2_read (it, fp);
-    /*int v1err = */deadbeef->junk_id3v1_read (it, fp);
+    /*int tagerr = */deadbeef->junk_read_tags (it, fp, NULL, NULL);
     deadbeef->pl_add_meta (it, "title", NULL);
     deadbeef->fclose (fp);
     return 0;
@@ -0,0 +1,901 @@
+/*
+    CURL VFS plugin for DeaDBeeF Player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include "blockcache.h"
+
+#define BLOCKCACHE_MAGIC "DBBC"
+#define BLOCKCACHE_VERSION 1
+
+// Block data in the cache file starts at this alignment, after the header and the block map
+#define BLOCKCACHE_DATA_ALIGN 4096
+
+#define BLOCKCACHE_MAX_STRING 4096
+
+// Never go below this, otherwise the read-ahead blocks could be evicted before they're read
+#define BLOCKCACHE_MIN_MEMORY_MB 4
+
+// How long an entry can be reopened without asking the server whether the file has changed
+#define BLOCKCACHE_FRESH_SECONDS 300
+
+typedef struct blockcache_block_s {
+    struct blockcache_block_s *lru_prev;
+    struct blockcache_block_s *lru_next;
+    blockcache_entry_t *entry;
+    int64_t index;
+    size_t size;
+    uint8_t data[];
+} blockcache_block_t;
+
+struct blockcache_entry_s {
+    struct blockcache_entry_s *next;
+    char *url;
+    uint64_t hash;
+    int64_t length;
+    int64_t num_blocks;
+    char *content_type;
+    char *validator;
+    int refcount;
+    int in_list;
+    int invalid;
+    int64_t mem_blocks;
+    blockcache_block_t **blocks;
+
+    // when the length and validator were last confirmed by a server response
+    time_t validated;
+
+    // on-disk storage, fd is -1 if the entry is memory-only
+    int fd;
+    uint8_t *disk_map; // one bit per block
+    int64_t map_offset;
+    int64_t data_offset;
+
+    // The disk reads and writes are done without holding the mutex.
+    // The fd is closed when the last of them completes.
+    int disk_ops;
+    int disk_close_pending;
+};
+
+static DB_functions_t *deadbeef;
+
+static uintptr_t _mutex;
+// Serializes blockcache_entry_create, which opens and writes the cache files without holding _mutex
+static uintptr_t _create_mutex;
+static blockcache_entry_t *_entries;
+
+// Most recently used block at the head
+static blockcache_block_t *_lru_head;
+static blockcache_block_t *_lru_tail;
+
+static int _enabled;
+static int64_t _mem_usage;
+static int64_t _mem_limit;
+static int _disk_enabled;
+static int64_t _disk_limit;
+static int64_t _disk_usage = -1; // -1 until the cache folder is scanned
+static int64_t _disk_evict_threshold;
+static int _disk_evicting;
+
+void
+blockcache_init (DB_functions_t *api) {
+    deadbeef = api;
+    _mutex = deadbeef->mutex_create ();
+    _create_mutex = deadbeef->mutex_create ();
+    blockcache_configchanged ();
+}
+
+#pragma mark - Helpers
+
+// 64-bit FNV-1a
+static uint64_t
+_hash_url (const char *url) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const uint8_t *p = (const uint8_t *)url; *p; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static int
+_make_cache_dir_path (char *path, size_t size) {
+    size_t res = snprintf (path, size, "%s/vfs_curl", deadbeef->get_system_dir (DDB_SYS_DIR_CACHE));
+    return res >= size ? -1 : 0;
+}
+
+static int
+_make_cache_path (uint64_t hash, char *path, size_t size) {
+    size_t res = snprintf (path, size, "%s/vfs_curl/%016llx", deadbeef->get_system_dir (DDB_SYS_DIR_CACHE), (unsigned long long)hash);
+    return res >= size ? -1 : 0;
+}
+
+static int
+_ensure_cache_dir (void) {
+    const char *cache_root = deadbeef->get_system_dir (DDB_SYS_DIR_CACHE);
+    if (mkdir (cache_root, 0755) && errno != EEXIST) {
+        return -1;
+    }
+    char dir[PATH_MAX];
+    if (_make_cache_dir_path (dir, sizeof (dir))) {
+        return -1;
+    }
+    if (mkdir (dir, 0755) && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+_strings_equal (const char *a, const char *b) {
+    return !strcmp (a ? a : "", b ? b : "");
+}
+
+static int
+_disk_has_block (blockcache_entry_t *entry, int64_t index) {
+    return entry->fd >= 0 && !entry->disk_close_pending && (entry->disk_map[index >> 3] & (1 << (index & 7)));
+}
+
+static size_t
+_block_size (blockcache_entry_t *entry, int64_t index) {
+    int64_t start = index * BLOCKCACHE_BLOCK_SIZE;
+    int64_t size = entry->length - start;
+    return size > BLOCKCACHE_BLOCK_SIZE ? BLOCKCACHE_BLOCK_SIZE : (size_t)size;
+}
+
+#pragma mark - Memory cache
+
+static void
+_lru_unlink (blockcache_block_t *block) {
+    if (block->lru_prev) {
+        block->lru_prev->lru_next = block->lru_next;
+    }
+    else {
+        _lru_head = block->lru_next;
+    }
+    if (block->lru_next) {
+        block->lru_next->lru_prev = block->lru_prev;
+    }
+    else {
+        _lru_tail = block->lru_prev;
+    }
+    block->lru_prev = block->lru_next = NULL;
+}
+
+static void
+_lru_push_front (blockcache_block_t *block) {
+    block->lru_prev = NULL;
+    block->lru_next = _lru_head;
+    if (_lru_head) {
+        _lru_head->lru_prev = block;
+    }
+    _lru_head = block;
+    if (!_lru_tail) {
+        _lru_tail = block;
+    }
+}
+
+static void
+_block_free (blockcache_block_t *block) {
+    blockcache_entry_t *entry = block->entry;
+    _lru_unlink (block);
+    entry->blocks[block->index] = NULL;
+    entry->mem_blocks--;
+    _mem_usage -= block->size;
+    free (block);
+}
+
+static void
+_entry_free_blocks (blockcache_entry_t *entry) {
+    for (int64_t i = 0; i < entry->num_blocks && entry->mem_blocks > 0; i++) {
+        if (entry->blocks[i]) {
+            _block_free (entry->blocks[i]);
+        }
+    }
+}
+
+static void
+_entry_unlink (blockcache_entry_t *entry) {
+    if (!entry->in_list) {
+        return;
+    }
+    blockcache_entry_t **pp = &_entries;
+    while (*pp && *pp != entry) {
+        pp = &(*pp)->next;
+    }
+    if (*pp) {
+        *pp = entry->next;
+    }
+    entry->next = NULL;
+    entry->in_list = 0;
+}
+
+static void
+_entry_free (blockcache_entry_t *entry) {
+    _entry_unlink (entry);
+    _entry_free_blocks (entry);
+    if (entry->fd >= 0) {
+        close (entry->fd);
+    }
+    free (entry->disk_map);
+    free (entry->blocks);
+    free (entry->url);
+    free (entry->content_type);
+    free (entry->validator);
+    free (entry);
+}
+
+// Unused entries are kept around while they have blocks in memory, so they can be reopened quickly
+static void
+_entry_free_if_unused (blockcache_entry_t *entry) {
+    if (entry->refcount == 0 && (entry->mem_blocks == 0 || entry->invalid)) {
+        _entry_free (entry);
+    }
+}
+
+static void
+_evict_memory (void) {
+    while (_mem_usage > _mem_limit && _lru_tail) {
+        blockcache_entry_t *entry = _lru_tail->entry;
+        _block_free (_lru_tail);
+        _entry_free_if_unused (entry);
+    }
+}
+
+static blockcache_block_t *
+_block_alloc (size_t size) {
+    blockcache_block_t *block = malloc (sizeof (blockcache_block_t) + size);
+    if (block) {
+        block->size = size;
+    }
+    return block;
+}
+
+static void
+_block_link (blockcache_entry_t *entry, int64_t index, blockcache_block_t *block) {
+    block->entry = entry;
+    block->index = index;
+    entry->blocks[index] = block;
+    entry->mem_blocks++;
+    _mem_usage += block->size;
+    _lru_push_front (block);
+}
+
+#pragma mark - Disk cache
+
+// Header: magic, version, block size, length, string sizes, strings; followed by the block map
+static int
+_disk_read_header (blockcache_entry_t *entry, const char *url) {
+    uint8_t header[32];
+    if (pread (entry->fd, header, sizeof (header), 0) != sizeof (header)) {
+        return -1;
+    }
+    uint32_t version, block_size, url_len, ctype_len, validator_len;
+    int64_t length;
+    if (memcmp (header, BLOCKCACHE_MAGIC, 4)) {
+        return -1;
+    }
+    memcpy (&version, header + 4, 4);
+    memcpy (&block_size, header + 8, 4);
+    memcpy (&length, header + 12, 8);
+    memcpy (&url_len, header + 20, 4);
+    memcpy (&ctype_len, header + 24, 4);
+    memcpy (&validator_len, header + 28, 4);
+    if (version != BLOCKCACHE_VERSION || block_size != BLOCKCACHE_BLOCK_SIZE || length <= 0) {
+        return -1;
+    }
+    if (url_len != strlen (url) || ctype_len >= BLOCKCACHE_MAX_STRING || validator_len >= BLOCKCACHE_MAX_STRING) {
+        return -1;
+    }
+
+    size_t strings_size = url_len + ctype_len + validator_len;
+    char *strings = malloc (strings_size + 1);
+    if (!strings) {
+        return -1;
+    }
+    if (pread (entry->fd, strings, strings_size, sizeof (header)) != strings_size
+        || memcmp (strings, url, url_len)) {
+        free (strings);
+        return -1;
+    }
+
+    entry->length = length;
+    entry->num_blocks = (length + BLOCKCACHE_BLOCK_SIZE - 1) / BLOCKCACHE_BLOCK_SIZE;
+    entry->content_type = ctype_len ? strndup (strings + url_len, ctype_len) : NULL;
+    entry->validator = validator_len ? strndup (strings + url_len + ctype_len, validator_len) : NULL;
+    free (strings);
+
+    size_t map_size = (entry->num_blocks + 7) / 8;
+    entry->map_offset = sizeof (header) + strings_size;
+    entry->data_offset = (entry->map_offset + map_size + BLOCKCACHE_DATA_ALIGN - 1) / BLOCKCACHE_DATA_ALIGN * BLOCKCACHE_DATA_ALIGN;
+    entry->disk_map = calloc (1, map_size);
+    if (!entry->disk_map || pread (entry->fd, entry->disk_map, map_size, entry->map_offset) != map_size) {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+_disk_write_header (blockcache_entry_t *entry) {
+    uint32_t version = BLOCKCACHE_VERSION;
+    uint32_t block_size = BLOCKCACHE_BLOCK_SIZE;
+    uint32_t url_len = (uint32_t)strlen (entry->url);
+    uint32_t ctype_len = entry->content_type ? (uint32_t)strlen (entry->content_type) : 0;
+    uint32_t validator_len = entry->validator ? (uint32_t)strlen (entry->validator) : 0;
+    if (ctype_len >= BLOCKCACHE_MAX_STRING || validator_len >= BLOCKCACHE_MAX_STRING) {
+        return -1;
+    }
+
+    size_t map_size = (entry->num_blocks + 7) / 8;
+    entry->map_offset = 32 + url_len + ctype_len + validator_len;
+    entry->data_offset = (entry->map_offset + map_size + BLOCKCACHE_DATA_ALIGN - 1) / BLOCKCACHE_DATA_ALIGN * BLOCKCACHE_DATA_ALIGN;
+    entry->disk_map = calloc (1, map_size);
+    if (!entry->disk_map) {
+        return -1;
+    }
+
+    size_t size = entry->map_offset + map_size;
+    uint8_t *header = calloc (1, size);
+    if (!header) {
+        return -1;
+    }
+    memcpy (header, BLOCKCACHE_MAGIC, 4);
+    memcpy (header + 4, &version, 4);
+    memcpy (header + 8, &block_size, 4);
+    memcpy (header + 12, &entry->length, 8);
+    memcpy (header + 20, &url_len, 4);
+    memcpy (header + 24, &ctype_len, 4);
+    memcpy (header + 28, &validator_len, 4);
+    memcpy (header + 32, entry->url, url_len);
+    if (ctype_len) {
+        memcpy (header + 32 + url_len, entry->content_type, ctype_len);
+    }
+    if (validator_len) {
+        memcpy (header + 32 + url_len + ctype_len, entry->validator, validator_len);
+    }
+    int res = pwrite (entry->fd, header, size, 0) == size ? 0 : -1;
+    free (header);
+    return res;
+}
+
+// The file is removed right away, but the fd is kept open until the pending reads and writes complete.
+static void
+_disk_close (blockcache_entry_t *entry, int remove) {
+    if (entry->fd < 0 || entry->disk_close_pending) {
+        return;
+    }
+    if (remove) {
+        char path[PATH_MAX];
+        if (!_make_cache_path (entry->hash, path, sizeof (path))) {
+            (void)unlink (path);
+        }
+    }
+    if (entry->disk_ops > 0) {
+        entry->disk_close_pending = 1;
+        return;
+    }
+    close (entry->fd);
+    entry->fd = -1;
+}
+
+static void
+_disk_op_end (blockcache_entry_t *entry) {
+    entry->disk_ops--;
+    if (entry->disk_ops == 0 && entry->disk_close_pending) {
+        entry->disk_close_pending = 0;
+        close (entry->fd);
+        entry->fd = -1;
+    }
+}
+
+typedef struct {
+    uint64_t hash;
+    time_t mtime;
+    int64_t size;
+} disk_file_t;
+
+static int
+_disk_file_cmp (const void *a, const void *b) {
+    const disk_file_t *fa = a;
+    const disk_file_t *fb = b;
+    return fa->mtime < fb->mtime ? -1 : (fa->mtime > fb->mtime ? 1 : 0);
+}
+
+// Updates the disk usage, and deletes the least recently used files if it's over the limit,
+// skipping the ones which are currently open.
+// Called without holding the mutex, by the thread which has set _disk_evicting.
+static void
+_disk_evict (void) {
+    deadbeef->mutex_lock (_mutex);
+    int64_t limit = _disk_limit;
+    size_t open_count = 0;
+    for (blockcache_entry_t *entry = _entries; entry; entry = entry->next) {
+        open_count++;
+    }
+    uint64_t *open_hashes = malloc ((open_count + 1) * sizeof (uint64_t));
+    open_count = 0;
+    for (blockcache_entry_t *entry = _entries; open_hashes && entry; entry = entry->next) {
+        if (entry->fd >= 0) {
+            open_hashes[open_count++] = entry->hash;
+        }
+    }
+    deadbeef->mutex_unlock (_mutex);
+
+    int64_t usage = 0;
+    char dir_path[PATH_MAX];
+    DIR *dir = NULL;
+    if (open_hashes && !_make_cache_dir_path (dir_path, sizeof (dir_path))) {
+        dir = opendir (dir_path);
+    }
+    if (!dir) {
+        free (open_hashes);
+        deadbeef->mutex_lock (_mutex);
+        _disk_usage = 0;
+        _disk_evicting = 0;
+        deadbeef->mutex_unlock (_mutex);
+        return;
+    }
+
+    disk_file_t *files = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    struct dirent *de;
+    while ((de = readdir (dir))) {
+        char path[PATH_MAX];
+        struct stat st;
+        if (de->d_name[0] == '.' || snprintf (path, sizeof (path), "%s/%s", dir_path, de->d_name) >= sizeof (path)) {
+            continue;
+        }
+        if (stat (path, &st) || !S_ISREG (st.st_mode)) {
+            continue;
+        }
+        usage += (int64_t)st.st_blocks * 512;
+
+        char *end;
+        uint64_t hash = strtoull (de->d_name, &end, 16);
+        if (*end) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            disk_file_t *newfiles = realloc (files, capacity * sizeof (disk_file_t));
+            if (!newfiles) {
+                break;
+            }
+            files = newfiles;
+        }
+        files[count].hash = hash;
+        files[count].mtime = st.st_mtime;
+        files[count].size = (int64_t)st.st_blocks * 512;
+        count++;
+    }
+    closedir (dir);
+
+    if (usage > limit) {
+        qsort (files, count, sizeof (disk_file_t), _disk_file_cmp);
+
+        int64_t target = limit / 10 * 9;
+        for (size_t i = 0; i < count && usage > target; i++) {
+            int in_use = 0;
+            for (size_t j = 0; j < open_count; j++) {
+                if (open_hashes[j] == files[i].hash) {
+                    in_use = 1;
+                    break;
+                }
+            }
+            if (in_use) {
+                continue;
+            }
+            char path[PATH_MAX];
+            if (!_make_cache_path (files[i].hash, path, sizeof (path)) && !unlink (path)) {
+                usage -= files[i].size;
+            }
+        }
+    }
+    free (files);
+    free (open_hashes);
+
+    deadbeef->mutex_lock (_mutex);
+    _disk_usage = usage;
+    // if the open files alone exceed the limit, don't rescan on every block
+    _disk_evict_threshold = usage > limit ? usage + limit / 10 : 0;
+    _disk_evicting = 0;
+    deadbeef->mutex_unlock (_mutex);
+}
+
+// Called without holding the mutex, after incrementing entry->disk_ops
+static void
+_disk_store_block (blockcache_entry_t *entry, int64_t index, const void *data, size_t size) {
+    int ok = pwrite (entry->fd, data, size, entry->data_offset + index * BLOCKCACHE_BLOCK_SIZE) == size;
+
+    // the map is updated after the data, so an interrupted write never marks a block as present
+    uint8_t map_byte = 0;
+    deadbeef->mutex_lock (_mutex);
+    int mark = ok && !entry->disk_close_pending;
+    if (mark) {
+        entry->disk_map[index >> 3] |= (1 << (index & 7));
+        map_byte = entry->disk_map[index >> 3];
+    }
+    deadbeef->mutex_unlock (_mutex);
+
+    if (mark) {
+        ok = pwrite (entry->fd, &map_byte, 1, entry->map_offset + (index >> 3)) == 1;
+    }
+
+    deadbeef->mutex_lock (_mutex);
+    if (!ok) {
+        _disk_close (entry, 1);
+    }
+    _disk_op_end (entry);
+    int evict = 0;
+    if (mark && ok) {
+        if (_disk_usage >= 0) {
+            _disk_usage += size;
+        }
+        evict = !_disk_evicting && (_disk_usage < 0 || (_disk_usage > _disk_limit && _disk_usage > _disk_evict_threshold));
+        if (evict) {
+            _disk_evicting = 1;
+        }
+    }
+    deadbeef->mutex_unlock (_mutex);
+
+    if (evict) {
+        _disk_evict ();
+    }
+}
+
+#pragma mark - API
+
+void
+blockcache_free (void) {
+    if (!_mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (_mutex);
+    while (_entries) {
+        _entry_free (_entries);
+    }
+    deadbeef->mutex_unlock (_mutex);
+    deadbeef->mutex_free (_mutex);
+    _mutex = 0;
+    deadbeef->mutex_free (_create_mutex);
+    _create_mutex = 0;
+}
+
+void
+blockcache_configchanged (void) {
+    if (!_mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (_mutex);
+    _enabled = deadbeef->conf_get_int ("vfs_curl.cache", 1);
+    int memory_mb = deadbeef->conf_get_int ("vfs_curl.cache_memory_mb", 32);
+    if (memory_mb < BLOCKCACHE_MIN_MEMORY_MB) {
+        memory_mb = BLOCKCACHE_MIN_MEMORY_MB;
+    }
+    _mem_limit = (int64_t)memory_mb * 1024 * 1024;
+    _disk_enabled = deadbeef->conf_get_int ("vfs_curl.disk_cache", 0);
+    _disk_limit = (int64_t)deadbeef->conf_get_int ("vfs_curl.disk_cache_mb", 512) * 1024 * 1024;
+    _disk_evict_threshold = 0;
+    _evict_memory ();
+    deadbeef->mutex_unlock (_mutex);
+}
+
+int
+blockcache_enabled (void) {
+    return _enabled;
+}
+
+static blockcache_entry_t *
+_entry_alloc (const char *url, uint64_t hash) {
+    blockcache_entry_t *entry = calloc (1, sizeof (blockcache_entry_t));
+    if (!entry) {
+        return NULL;
+    }
+    entry->url = strdup (url);
+    entry->hash = hash;
+    entry->fd = -1;
+    return entry;
+}
+
+static void
+_entry_add (blockcache_entry_t *entry) {
+    entry->refcount = 1;
+    entry->next = _entries;
+    entry->in_list = 1;
+    _entries = entry;
+}
+
+static blockcache_entry_t *
+_entry_find (const char *url, uint64_t hash) {
+    for (blockcache_entry_t *entry = _entries; entry; entry = entry->next) {
+        if (entry->hash == hash && !strcmp (entry->url, url)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static blockcache_entry_t *
+_disk_open_entry (const char *url, uint64_t hash) {
+    char path[PATH_MAX];
+    if (_make_cache_path (hash, path, sizeof (path))) {
+        return NULL;
+    }
+    int fd = open (path, O_RDWR);
+    if (fd < 0) {
+        return NULL;
+    }
+    blockcache_entry_t *entry = _entry_alloc (url, hash);
+    if (!entry) {
+        close (fd);
+        return NULL;
+    }
+    entry->fd = fd;
+    if (_disk_read_header (entry, url)) {
+        _entry_free (entry);
+        (void)unlink (path);
+        return NULL;
+    }
+    entry->blocks = calloc (entry->num_blocks, sizeof (blockcache_block_t *));
+    if (!entry->blocks) {
+        _entry_free (entry);
+        return NULL;
+    }
+    // mark as recently used
+    (void)futimes (fd, NULL);
+    return entry;
+}
+
+blockcache_entry_t *
+blockcache_entry_open (const char *url) {
+    if (!_enabled) {
+        return NULL;
+    }
+    uint64_t hash = _hash_url (url);
+    deadbeef->mutex_lock (_mutex);
+    blockcache_entry_t *entry = _entry_find (url, hash);
+    if (entry && time (NULL) - entry->validated < BLOCKCACHE_FRESH_SECONDS) {
+        entry->refcount++;
+    }
+    else {
+        entry = NULL;
+    }
+    deadbeef->mutex_unlock (_mutex);
+    return entry;
+}
+
+blockcache_entry_t *
+blockcache_entry_create (const char *url, int64_t length, const char *content_type, const char *validator) {
+    if (!_enabled || length <= 0) {
+        return NULL;
+    }
+    uint64_t hash = _hash_url (url);
+    deadbeef->mutex_lock (_create_mutex);
+    deadbeef->mutex_lock (_mutex);
+    blockcache_entry_t *entry = _entry_find (url, hash);
+    if (entry) {
+        if (entry->length == length && _strings_equal (entry->validator, validator)) {
+            entry->refcount++;
+            entry->validated = time (NULL);
+            deadbeef->mutex_unlock (_mutex);
+            deadbeef->mutex_unlock (_create_mutex);
+            return entry;
+        }
+        // the remote file has changed
+        entry->invalid = 1;
+        _entry_unlink (entry);
+        _entry_free_blocks (entry);
+        _disk_close (entry, 1);
+        _entry_free_if_unused (entry);
+    }
+    int disk_enabled = _disk_enabled && _disk_limit > 0;
+    deadbeef->mutex_unlock (_mutex);
+
+    // The cache file is opened without holding the mutex, so a slow disk doesn't stall the other streams.
+    // The file from the previous session is only reused if the response confirms that the remote file is the same.
+    entry = disk_enabled ? _disk_open_entry (url, hash) : NULL;
+    if (entry && (entry->length != length || !_strings_equal (entry->validator, validator))) {
+        _entry_free (entry);
+        entry = NULL;
+    }
+    if (entry && !_strings_equal (entry->content_type, content_type)) {
+        free (entry->content_type);
+        entry->content_type = content_type ? strdup (content_type) : NULL;
+    }
+
+    if (!entry) {
+        entry = _entry_alloc (url, hash);
+        if (!entry) {
+            deadbeef->mutex_unlock (_create_mutex);
+            return NULL;
+        }
+        entry->length = length;
+        entry->num_blocks = (length + BLOCKCACHE_BLOCK_SIZE - 1) / BLOCKCACHE_BLOCK_SIZE;
+        entry->content_type = content_type ? strdup (content_type) : NULL;
+        entry->validator = validator && *validator ? strdup (validator) : NULL;
+        entry->blocks = calloc (entry->num_blocks, sizeof (blockcache_block_t *));
+        if (!entry->blocks) {
+            _entry_free (entry);
+            deadbeef->mutex_unlock (_create_mutex);
+            return NULL;
+        }
+
+        char path[PATH_MAX];
+        if (disk_enabled && !_ensure_cache_dir () && !_make_cache_path (hash, path, sizeof (path))) {
+            entry->fd = open (path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+            if (entry->fd >= 0 && _disk_write_header (entry)) {
+                _disk_close (entry, 1);
+            }
+        }
+    }
+    entry->validated = time (NULL);
+
+    deadbeef->mutex_lock (_mutex);
+    _entry_add (entry);
+    deadbeef->mutex_unlock (_mutex);
+    deadbeef->mutex_unlock (_create_mutex);
+    return entry;
+}
+
+void
+blockcache_entry_release (blockcache_entry_t *entry) {
+    deadbeef->mutex_lock (_mutex);
+    entry->refcount--;
+    _entry_free_if_unused (entry);
+    deadbeef->mutex_unlock (_mutex);
+}
+
+void
+blockcache_entry_invalidate (blockcache_entry_t *entry) {
+    deadbeef->mutex_lock (_mutex);
+    entry->invalid = 1;
+    _entry_unlink (entry);
+    _entry_free_blocks (entry);
+    _disk_close (entry, 1);
+    deadbeef->mutex_unlock (_mutex);
+}
+
+int64_t
+blockcache_entry_get_length (blockcache_entry_t *entry) {
+    return entry->length;
+}
+
+const char *
+blockcache_entry_get_content_type (blockcache_entry_t *entry) {
+    return entry->content_type;
+}
+
+const char *
+blockcache_entry_get_validator (blockcache_entry_t *entry) {
+    return entry->validator;
+}
+
+int
+blockcache_has_block (blockcache_entry_t *entry, int64_t index) {
+    if (index < 0 || index >= entry->num_blocks) {
+        return 0;
+    }
+    deadbeef->mutex_lock (_mutex);
+    int res = !entry->invalid && (entry->blocks[index] || _disk_has_block (entry, index));
+    deadbeef->mutex_unlock (_mutex);
+    return res;
+}
+
+size_t
+blockcache_read (blockcache_entry_t *entry, int64_t index, size_t offset, void *buffer, size_t size) {
+    if (index < 0 || index >= entry->num_blocks) {
+        return 0;
+    }
+    deadbeef->mutex_lock (_mutex);
+    if (entry->invalid) {
+        deadbeef->mutex_unlock (_mutex);
+        return 0;
+    }
+    blockcache_block_t *block = entry->blocks[index];
+    if (block) {
+        _lru_unlink (block);
+        _lru_push_front (block);
+    }
+    else if (_disk_has_block (entry, index)) {
+        // read without holding the mutex, so a slow disk doesn't stall the other streams
+        size_t block_size = _block_size (entry, index);
+        entry->disk_ops++;
+        deadbeef->mutex_unlock (_mutex);
+
+        blockcache_block_t *loaded = _block_alloc (block_size);
+        int failed = loaded && pread (entry->fd, loaded->data, block_size, entry->data_offset + index * BLOCKCACHE_BLOCK_SIZE) != block_size;
+
+        deadbeef->mutex_lock (_mutex);
+        if (failed) {
+            _disk_close (entry, 1);
+        }
+        _disk_op_end (entry);
+        // the block could have been stored by the transfer in the meantime
+        block = entry->blocks[index];
+        if (!block && loaded && !failed && !entry->invalid) {
+            _block_link (entry, index, loaded);
+            block = loaded;
+            loaded = NULL;
+        }
+        free (loaded);
+    }
+
+    size_t res = 0;
+    if (block && offset < block->size) {
+        res = block->size - offset;
+        if (res > size) {
+            res = size;
+        }
+        memcpy (buffer, block->data + offset, res);
+    }
+    if (block) {
+        _evict_memory ();
+    }
+    deadbeef->mutex_unlock (_mutex);
+    return res;
+}
+
+void
+blockcache_store (blockcache_entry_t *entry, int64_t index, const void *data, size_t size) {
+    if (index < 0 || index >= entry->num_blocks || size != _block_size (entry, index)) {
+        return;
+    }
+    deadbeef->mutex_lock (_mutex);
+    if (entry->invalid) {
+        deadbeef->mutex_unlock (_mutex);
+        return;
+    }
+    blockcache_block_t *block = entry->blocks[index];
+    if (block) {
+        _lru_unlink (block);
+        _lru_push_front (block);
+    }
+    else {
+        block = _block_alloc (size);
+        if (block) {
+            memcpy (block->data, data, size);
+            _block_link (entry, index, block);
+        }
+    }
+    _evict_memory ();
+    int write_disk = entry->fd >= 0 && !entry->disk_close_pending && !_disk_has_block (entry, index);
+    if (write_disk) {
+        entry->disk_ops++;
+    }
+    deadbeef->mutex_unlock (_mutex);
+
+    if (write_disk) {
+        _disk_store_block (entry, index, data, size);
+    }
+}
@@ -0,0 +1,100 @@
+/*
+    CURL VFS plugin for DeaDBeeF Player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef blockcache_h
+#define blockcache_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deadbeef/deadbeef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cache of fixed-size blocks of remote files, which were fetched using HTTP range requests.
+// The blocks are kept in memory, and optionally in an on-disk LRU cache under the cache dir.
+// An entry is identified by URL, and remembers the file length, content type and validator
+// (ETag or Last-Modified), which allows reopening a cached file without touching the network.
+
+#define BLOCKCACHE_BLOCK_SIZE (256*1024)
+
+typedef struct blockcache_entry_s blockcache_entry_t;
+
+void
+blockcache_init (DB_functions_t *api);
+
+void
+blockcache_free (void);
+
+// Re-reads the size limits from the config
+void
+blockcache_configchanged (void);
+
+int
+blockcache_enabled (void);
+
+// Returns the existing entry, if a server response has confirmed it recently, or NULL.
+// Files kept on disk are only reused by blockcache_entry_create, after the response matches them.
+// The returned entry must be released using blockcache_entry_release.
+blockcache_entry_t *
+blockcache_entry_open (const char *url);
+
+// Returns the entry matching the length and validator of a server response,
+// replacing any existing entry or disk file with the same URL and different properties.
+blockcache_entry_t *
+blockcache_entry_create (const char *url, int64_t length, const char *content_type, const char *validator);
+
+void
+blockcache_entry_release (blockcache_entry_t *entry);
+
+// Drops all cached data of the entry, e.g. when the remote file has changed.
+void
+blockcache_entry_invalidate (blockcache_entry_t *entry);
+
+int64_t
+blockcache_entry_get_length (blockcache_entry_t *entry);
+
+const char *
+blockcache_entry_get_content_type (blockcache_entry_t *entry);
+
+const char *
+blockcache_entry_get_validator (blockcache_entry_t *entry);
+
+int
+blockcache_has_block (blockcache_entry_t *entry, int64_t index);
+
+// Copies up to size bytes from the block, starting at offset.
+// Returns the number of bytes copied, or 0 if the block is not cached.
+size_t
+blockcache_read (blockcache_entry_t *entry, int64_t index, size_t offset, void *buffer, size_t size);
+
+// The size must be BLOCKCACHE_BLOCK_SIZE, except for the last block of the file.
+void
+blockcache_store (blockcache_entry_t *entry, int64_t index, const void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* blockcache_h */
@@ -63,47 +63,62 @@ http_cancel_abort (uint64_t identifier);
 static void
 vfs_curl_abort_with_identifier (uint64_t identifier);
 
+static void
+_io_request (HTTP_FILE *fp);
+
+// The ring buffer is never filled more than half, the rest is used for seeking backwards
+#define BUFFER_FILL_LIMIT (BUFFER_SIZE/2)
+
+// The transfer is resumed once this much space is available in the buffer.
+// Must be at least CURLOPT_BUFFERSIZE, the largest chunk passed to the write callback.
+#define RESUME_THRESHOLD (BUFFER_SIZE/4)
+
+// In block mode, the transfer is paused when it gets this many blocks ahead of the reader
+#define READAHEAD_BLOCKS 4
+
 static size_t
 http_curl_write_wrapper (HTTP_FILE *fp, void *ptr, size_t size) {
     size_t avail = size;
+    deadbeef->mutex_lock (fp->mutex);
     while (avail > 0) {
-        deadbeef->mutex_lock (fp->mutex);
         if (fp->status == STATUS_SEEK) {
             trace ("vfs_curl seek request, aborting current request\n");
-            deadbeef->mutex_unlock (fp->mutex);
-            return 0;
+            break;
         }
-        if (http_need_abort (fp->identifier)) {
+        if (fp->closing || http_need_abort (fp->identifier)) {
             fp->status = STATUS_ABORTED;
             trace ("vfs_curl STATUS_ABORTED in the middle of packet\n");
-            deadbeef->mutex_unlock (fp->mutex);
             break;
         }
-        int sz = BUFFER_SIZE/2 - fp->remaining; // number of bytes free in buffer
-                                                // don't allow to fill more than half -- used for seeking backwards
-
-        if (sz > 5000) { // wait until there are at least 5k bytes free
-            size_t cp = min (avail, sz);
-            int writepos = (fp->pos + fp->remaining) & BUFFER_MASK;
-            // copy 1st portion (before end of buffer
-            size_t part1 = BUFFER_SIZE - writepos;
-            // may not be more than total
-            part1 = min (part1, cp);
-            memcpy (fp->buffer+writepos, ptr, part1);
-            ptr += part1;
-            avail -= part1;
-            fp->remaining += part1;
-            cp -= part1;
-            if (cp > 0) {
-                memcpy (fp->buffer, ptr, cp);
-                ptr += cp;
-                avail -= cp;
-                fp->remaining += cp;
-            }
+        int sz = BUFFER_FILL_LIMIT - fp->remaining; // number of bytes free in buffer
+
+        if (sz <= 0) {
+            // http_curl_write pauses the transfer unless the whole chunk fits, so this should never happen.
+            // Never wait here: this runs on the I/O thread shared by all transfers.
+            trace ("vfs_curl buffer overflow, dropping %d bytes\n", (int)avail);
+            break;
         }
-        deadbeef->mutex_unlock (fp->mutex);
-        usleep (3000);
+
+        size_t cp = min (avail, sz);
+        int writepos = (fp->pos + fp->remaining) & BUFFER_MASK;
+        // copy 1st portion (before end of buffer
+        size_t part1 = BUFFER_SIZE - writepos;
+        // may not be more than total
+        part1 = min (part1, cp);
+        memcpy (fp->buffer+writepos, ptr, part1);
+        ptr += part1;
+        avail -= part1;
+        fp->remaining += part1;
+        cp -= part1;
+        if (cp > 0) {
+            memcpy (fp->buffer, ptr, cp);
+            ptr += cp;
+            avail -= cp;
+            fp->remaining += cp;
+        }
+        deadbeef->cond_broadcast (fp->cond);
     }
+    deadbeef->mutex_unlock (fp->mutex);
     return size - avail;
 }
 
@@ -337,13 +352,41 @@ http_content_header_handler_int (const void *ptr, size_t size, void *stream, int
         p = parse_header (p, end, key, sizeof (key), value, sizeof (value));
         trace ("%skey=%s value=%s\n", fp->icyheader ? "[icy] " : "", key, value);
         if (!strcasecmp ((char *)key, "Content-Type")) {
-            if (fp->content_type) {
-                free (fp->content_type);
+            // in block mode, the content type may be in use by the reader
+            if (!fp->blockmode) {
+                if (fp->content_type) {
+                    free (fp->content_type);
+                }
+                fp->content_type = strdup ((char *)value);
             }
-            fp->content_type = strdup ((char *)value);
         }
         else if (!strcasecmp ((char *)key, "Content-Length")) {
-            fp->length = atoi ((char *)value);
+            fp->content_length = atoll ((char *)value);
+            if (!fp->blockmode && !fp->range_total) {
+                fp->length = fp->content_length;
+            }
+        }
+        else if (!strcasecmp ((char *)key, "Content-Range")) {
+            // bytes <start>-<end>/<total>
+            const char *range = (const char *)value;
+            if (!strncasecmp (range, "bytes ", 6)) {
+                fp->range_start = atoll (range + 6);
+                const char *total = strchr (range, '/');
+                fp->range_total = total ? atoll (total + 1) : 0;
+                fp->accept_ranges = 1;
+                if (!fp->blockmode && fp->range_total > 0) {
+                    fp->length = fp->range_total;
+                }
+            }
+        }
+        else if (!strcasecmp ((char *)key, "Accept-Ranges")) {
+            fp->accept_ranges = !strcasecmp ((char *)value, "bytes");
+        }
+        else if (!strcasecmp ((char *)key, "ETag")) {
+            snprintf (fp->etag, sizeof (fp->etag), "%s", (char *)value);
+        }
+        else if (!strcasecmp ((char *)key, "Last-Modified")) {
+            snprintf (fp->last_modified, sizeof (fp->last_modified), "%s", (char *)value);
         }
         else if (!strcasecmp ((char *)key, "icy-name")) {
             if (fp->track) {
@@ -370,7 +413,7 @@ http_content_header_handler_int (const void *ptr, size_t size, void *stream, int
         }
 
         // for icy streams, reset length
-        if (!strncasecmp ((char *)key, "icy-", 4)) {
+        if (!strncasecmp ((char *)key, "icy-", 4) && !fp->blockmode) {
             fp->length = -1;
         }
     }
@@ -518,6 +561,156 @@ _handle_icy_metadata(size_t avail, HTTP_FILE *fp, char *ptr, int *error) {
     return size-avail;
 }
 
+#pragma mark - Block mode
+
+static const char *
+_response_validator (HTTP_FILE *fp) {
+    return fp->etag[0] ? fp->etag : fp->last_modified;
+}
+
+// Called on the first response, decides whether the file can be read through the block cache.
+// Must be called with fp->mutex locked.
+static void
+_block_mode_start (HTTP_FILE *fp) {
+    if (!blockcache_enabled () || fp->icyheader || fp->icy_metaint > 0 || fp->length <= 0 || !fp->accept_ranges) {
+        return;
+    }
+    if (fp->transfer_offset % BLOCKCACHE_BLOCK_SIZE) {
+        return;
+    }
+    long code = 0;
+    curl_easy_getinfo (fp->curl, CURLINFO_RESPONSE_CODE, &code);
+    if (code != 206 && !(code == 200 && fp->transfer_offset == 0)) {
+        return;
+    }
+
+    fp->fill_buffer = malloc (BLOCKCACHE_BLOCK_SIZE);
+    if (!fp->fill_buffer) {
+        return;
+    }
+    fp->cache_entry = blockcache_entry_create (fp->url, fp->length, fp->content_type, _response_validator (fp));
+    if (!fp->cache_entry) {
+        free (fp->fill_buffer);
+        fp->fill_buffer = NULL;
+        return;
+    }
+    trace ("vfs_curl: reading %s through the block cache\n", fp->url);
+    fp->blockmode = 1;
+    fp->fetch_pos = fp->transfer_offset;
+    fp->fill_size = 0;
+    fp->prefetch_block = -1;
+    fp->transfer_checked = 1;
+}
+
+// Returns 0 if the response doesn't match the requested range, or the remote file has changed
+static int
+_block_response_valid (HTTP_FILE *fp) {
+    long code = 0;
+    curl_easy_getinfo (fp->curl, CURLINFO_RESPONSE_CODE, &code);
+    int64_t total;
+    if (code == 206 && fp->range_start == fp->transfer_offset) {
+        total = fp->range_total;
+    }
+    else if (code == 200 && fp->transfer_offset == 0) {
+        total = fp->content_length;
+    }
+    else {
+        return 0;
+    }
+    if (total != fp->length) {
+        return 0;
+    }
+    const char *validator = _response_validator (fp);
+    const char *cached_validator = blockcache_entry_get_validator (fp->cache_entry);
+    if (*validator && cached_validator && strcmp (validator, cached_validator)) {
+        return 0;
+    }
+    return 1;
+}
+
+static int64_t
+_block_readahead_limit (HTTP_FILE *fp) {
+    return (fp->pos / BLOCKCACHE_BLOCK_SIZE + 1 + READAHEAD_BLOCKS) * BLOCKCACHE_BLOCK_SIZE;
+}
+
+// Collects the received data into blocks, and puts complete blocks into the cache.
+// The transfer stops when it reaches a block which is already cached.
+static size_t
+_block_write (HTTP_FILE *fp, const char *ptr, size_t size) {
+    size_t avail = size;
+
+    deadbeef->mutex_lock (fp->mutex);
+    if (fp->status == STATUS_SEEK) {
+        deadbeef->mutex_unlock (fp->mutex);
+        return 0;
+    }
+    if (fp->closing || http_need_abort (fp->identifier)) {
+        fp->status = STATUS_ABORTED;
+        deadbeef->mutex_unlock (fp->mutex);
+        return 0;
+    }
+    if (!fp->transfer_checked) {
+        fp->transfer_checked = 1;
+        if (!_block_response_valid (fp)) {
+            trace ("vfs_curl: unexpected response to a range request, dropping cached data of %s\n", fp->url);
+            blockcache_entry_invalidate (fp->cache_entry);
+            fp->fetch_error = 1;
+            deadbeef->cond_broadcast (fp->cond);
+            deadbeef->mutex_unlock (fp->mutex);
+            return 0;
+        }
+    }
+    int64_t fetch_pos = fp->fetch_pos;
+    if (fp->fill_size == 0 && (fetch_pos >= fp->length || blockcache_has_block (fp->cache_entry, fetch_pos / BLOCKCACHE_BLOCK_SIZE))) {
+        fp->fetch_stop = 1;
+        deadbeef->mutex_unlock (fp->mutex);
+        return 0;
+    }
+    if (fetch_pos >= _block_readahead_limit (fp)) {
+        fp->paused = 1;
+        deadbeef->mutex_unlock (fp->mutex);
+        return CURL_WRITEFUNC_PAUSE;
+    }
+    deadbeef->mutex_unlock (fp->mutex);
+
+    while (avail > 0) {
+        size_t block_size = (size_t)min (BLOCKCACHE_BLOCK_SIZE, fp->length - fetch_pos);
+        size_t cp = min (avail, block_size - fp->fill_size);
+        memcpy (fp->fill_buffer + fp->fill_size, ptr, cp);
+        fp->fill_size += cp;
+        ptr += cp;
+        avail -= cp;
+
+        if (fp->fill_size < block_size) {
+            break;
+        }
+
+        int64_t index = fetch_pos / BLOCKCACHE_BLOCK_SIZE;
+        blockcache_store (fp->cache_entry, index, fp->fill_buffer, block_size);
+        fetch_pos += block_size;
+        fp->fill_size = 0;
+
+        deadbeef->mutex_lock (fp->mutex);
+        fp->blocks_stored++;
+        deadbeef->cond_broadcast (fp->cond);
+        if (fp->status == STATUS_SEEK) {
+            // the reader has requested another position
+            deadbeef->mutex_unlock (fp->mutex);
+            return 0;
+        }
+        fp->fetch_pos = fetch_pos;
+        if (fetch_pos >= fp->length || blockcache_has_block (fp->cache_entry, index + 1)) {
+            fp->fetch_stop = 1;
+            deadbeef->mutex_unlock (fp->mutex);
+            return avail ? 0 : size;
+        }
+        deadbeef->mutex_unlock (fp->mutex);
+    }
+    return size - avail;
+}
+
+#pragma mark -
+
 static size_t
 http_curl_write (void *_ptr, size_t size, size_t nmemb, void *stream) {
     char *ptr = _ptr;
@@ -532,6 +725,22 @@ http_curl_write (void *_ptr, size_t size, size_t nmemb, void *stream) {
         return 0;
     }
 
+    if (fp->blockmode) {
+        return _block_write (fp, ptr, avail);
+    }
+
+    // The whole chunk must be either accepted or deferred, so pause if it may not fit.
+    // The reader asks the I/O thread to resume the transfer after consuming some data.
+    deadbeef->mutex_lock (fp->mutex);
+    // seeking backwards may fill the buffer above the limit, so the free space can be negative
+    int space = BUFFER_FILL_LIMIT - fp->remaining;
+    if (space <= 0 || (size_t)space < avail) {
+        fp->paused = 1;
+        deadbeef->mutex_unlock (fp->mutex);
+        return CURL_WRITEFUNC_PAUSE;
+    }
+    deadbeef->mutex_unlock (fp->mutex);
+
     // process the in-stream headers, if present
     if (!fp->gotheader) {
         size_t consumed = vfs_curl_handle_icy_headers (avail, fp, ptr);
@@ -545,9 +754,20 @@ http_curl_write (void *_ptr, size_t size, size_t nmemb, void *stream) {
     deadbeef->mutex_lock (fp->mutex);
     if (fp->status == STATUS_INITIAL && fp->gotheader) {
         fp->status = STATUS_READING;
+        if (!fp->responded) {
+            _block_mode_start (fp);
+            fp->responded = 1;
+        }
+        deadbeef->cond_broadcast (fp->cond);
     }
+    int blockmode = fp->blockmode;
     deadbeef->mutex_unlock (fp->mutex);
 
+    if (blockmode) {
+        // no in-stream headers were consumed, otherwise the file would not be seekable
+        return _block_write (fp, ptr, avail);
+    }
+
     int error = 0;
     size_t consumed = _handle_icy_metadata (avail, fp, ptr, &error);
     if (error) {
@@ -568,40 +788,18 @@ http_curl_write (void *_ptr, size_t size, size_t nmemb, void *stream) {
 
 static size_t
 http_content_header_handler (void *ptr, size_t size, size_t nmemb, void *stream) {
-    int end = 0;
-    return http_content_header_handler_int (ptr, size*nmemb, stream, &end);
-}
-
-static int
-http_curl_control (void *stream, double dltotal, double dlnow, double ultotal, double ulnow) {
     HTTP_FILE *fp = (HTTP_FILE *)stream;
-    deadbeef->mutex_lock (fp->mutex);
-
-    struct timeval tm;
-    gettimeofday (&tm, NULL);
-    float sec = tm.tv_sec - fp->last_read_time.tv_sec;
-    long response;
-    curl_easy_getinfo (fp->curl, CURLINFO_RESPONSE_CODE, &response);
-    //trace ("http_curl_control: status = %d, response = %d, interval: %f seconds\n", fp ? fp->status : -1, (int)response, sec);
-    if (fp->status == STATUS_READING && sec > TIMEOUT) {
-        trace ("http_curl_control: timed out, restarting read\n");
-        memcpy (&fp->last_read_time, &tm, sizeof (struct timeval));
-        http_stream_reset (fp);
-        fp->status = STATUS_SEEK;
-    }
-    else if (fp->status == STATUS_SEEK) {
-        trace ("vfs_curl STATUS_SEEK in progress callback\n");
-        deadbeef->mutex_unlock (fp->mutex);
-        return -1;
-    }
-    if (http_need_abort (fp->identifier)) {
-        fp->status = STATUS_ABORTED;
-        trace ("vfs_curl STATUS_ABORTED in progress callback\n");
-        deadbeef->mutex_unlock (fp->mutex);
-        return -1;
+    if (size * nmemb >= 5 && !memcmp (ptr, "HTTP/", 5)) {
+        // status line of a new response, e.g. after a redirect
+        fp->content_length = 0;
+        fp->range_start = 0;
+        fp->range_total = 0;
+        fp->accept_ranges = 0;
+        fp->etag[0] = 0;
+        fp->last_modified[0] = 0;
     }
-    deadbeef->mutex_unlock (fp->mutex);
-    return 0;
+    int end = 0;
+    return http_content_header_handler_int (ptr, size*nmemb, stream, &end);
 }
 
 void
@@ -615,164 +813,537 @@ vfs_curl_free_file (HTTP_FILE *fp) {
     if (fp->url) {
         free (fp->url);
     }
+    if (fp->curl) {
+        curl_easy_cleanup (fp->curl);
+    }
+    if (fp->headers) {
+        curl_slist_free_all (fp->headers);
+    }
+    if (fp->ok_aliases) {
+        curl_slist_free_all (fp->ok_aliases);
+    }
     if (fp->mutex) {
         deadbeef->mutex_free (fp->mutex);
     }
+    if (fp->cond) {
+        deadbeef->cond_free (fp->cond);
+    }
+    if (fp->cache_entry) {
+        blockcache_entry_release (fp->cache_entry);
+    }
+    free (fp->fill_buffer);
     free (fp);
 }
 
+#pragma mark - I/O thread
+
+// All transfers are performed by a single thread, using one curl multi handle.
+// Connections, DNS lookups and TLS sessions are shared between the transfers.
+// Readers talk to the I/O thread by setting flags on the file, and putting it into the request queue.
+
+static uintptr_t _io_mutex; // protects the request queue and the thread state
+static intptr_t _io_tid;
+static int _io_terminate;
+static CURLM *_io_multi;
+static CURLSH *_io_share;
+static HTTP_FILE *_io_queue;
+static HTTP_FILE *_io_active; // owned by the I/O thread
+
+#if LIBCURL_VERSION_NUM >= 0x074400 // 7.68.0
+#define HAVE_CURL_MULTI_WAKEUP 1
+#define IO_POLL_TIMEOUT_MS 1000
+#else
+#define IO_POLL_TIMEOUT_MS 50
+#endif
+
 static void
-http_thread_func (void *ctx) {
-    HTTP_FILE *fp = (HTTP_FILE *)ctx;
-    CURL *curl;
-    curl = curl_easy_init ();
-    fp->length = -1;
-    fp->status = STATUS_INITIAL;
-    fp->curl = curl;
+_io_wakeup (void) {
+#ifdef HAVE_CURL_MULTI_WAKEUP
+    if (_io_multi) {
+        curl_multi_wakeup (_io_multi);
+    }
+#endif
+}
 
-    int status;
+static void
+_setup_request (HTTP_FILE *fp) {
+    CURL *curl = fp->curl;
 
-    trace ("vfs_curl: started loading data %s\n", fp->url);
-    for (;;) {
-        struct curl_slist *headers = NULL;
-        struct curl_slist *ok_aliases = curl_slist_append (NULL, "ICY 200 OK");
-
-        curl_easy_reset (curl);
-        curl_easy_setopt (curl, CURLOPT_URL, fp->url);
-        char ua[100];
-        deadbeef->conf_get_str ("network.http_user_agent", "deadbeef", ua, sizeof (ua));
-        curl_easy_setopt (curl, CURLOPT_USERAGENT, ua);
-        curl_easy_setopt (curl, CURLOPT_NOPROGRESS, 1);
-        curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, http_curl_write);
-        curl_easy_setopt (curl, CURLOPT_WRITEDATA, ctx);
-        curl_easy_setopt (curl, CURLOPT_ERRORBUFFER, fp->http_err);
-        curl_easy_setopt (curl, CURLOPT_BUFFERSIZE, BUFFER_SIZE/2);
-        curl_easy_setopt (curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
-        curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, http_content_header_handler);
-        curl_easy_setopt (curl, CURLOPT_HEADERDATA, ctx);
-        curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1);
-        curl_easy_setopt (curl, CURLOPT_PROGRESSFUNCTION, http_curl_control);
-        curl_easy_setopt (curl, CURLOPT_NOPROGRESS, 0);
-        curl_easy_setopt (curl, CURLOPT_PROGRESSDATA, ctx);
-        // enable up to 10 redirects
-        curl_easy_setopt (curl, CURLOPT_FOLLOWLOCATION, 1);
-        curl_easy_setopt (curl, CURLOPT_MAXREDIRS, 10);
-
-        curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, 10);
-
-        headers = curl_slist_append (headers, "Icy-Metadata:1");
-        curl_easy_setopt (curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt (curl, CURLOPT_HTTP200ALIASES, ok_aliases);
+    if (fp->headers) {
+        curl_slist_free_all (fp->headers);
+    }
+    if (fp->ok_aliases) {
+        curl_slist_free_all (fp->ok_aliases);
+    }
+    fp->headers = curl_slist_append (NULL, "Icy-Metadata:1");
+    fp->ok_aliases = curl_slist_append (NULL, "ICY 200 OK");
+
+    curl_easy_reset (curl);
+    curl_easy_setopt (curl, CURLOPT_URL, fp->url);
+    char ua[100];
+    deadbeef->conf_get_str ("network.http_user_agent", "deadbeef", ua, sizeof (ua));
+    curl_easy_setopt (curl, CURLOPT_USERAGENT, ua);
+    curl_easy_setopt (curl, CURLOPT_NOPROGRESS, 1);
+    curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, http_curl_write);
+    curl_easy_setopt (curl, CURLOPT_WRITEDATA, fp);
+    curl_easy_setopt (curl, CURLOPT_ERRORBUFFER, fp->http_err);
+    curl_easy_setopt (curl, CURLOPT_BUFFERSIZE, RESUME_THRESHOLD);
+    curl_easy_setopt (curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, http_content_header_handler);
+    curl_easy_setopt (curl, CURLOPT_HEADERDATA, fp);
+    curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1);
+    curl_easy_setopt (curl, CURLOPT_PRIVATE, fp);
+    curl_easy_setopt (curl, CURLOPT_SHARE, _io_share);
+    // enable up to 10 redirects
+    curl_easy_setopt (curl, CURLOPT_FOLLOWLOCATION, 1);
+    curl_easy_setopt (curl, CURLOPT_MAXREDIRS, 10);
+
+    curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, 10);
+
+    curl_easy_setopt (curl, CURLOPT_HTTPHEADER, fp->headers);
+    curl_easy_setopt (curl, CURLOPT_HTTP200ALIASES, fp->ok_aliases);
 #ifdef __MINGW32__
-        curl_easy_setopt (curl, CURLOPT_CAINFO, getenv ("CURL_CA_BUNDLE"));
+    curl_easy_setopt (curl, CURLOPT_CAINFO, getenv ("CURL_CA_BUNDLE"));
 #endif
-        if (fp->pos > 0 && fp->length >= 0) {
-            curl_easy_setopt (curl, CURLOPT_RESUME_FROM, (long)fp->pos);
-        }
-        if (deadbeef->conf_get_int ("network.proxy", 0)) {
-            deadbeef->conf_lock ();
-            curl_easy_setopt (curl, CURLOPT_PROXY, deadbeef->conf_get_str_fast ("network.proxy.address", ""));
-            curl_easy_setopt (curl, CURLOPT_PROXYPORT, deadbeef->conf_get_int ("network.proxy.port", 8080));
-            const char *type = deadbeef->conf_get_str_fast ("network.proxy.type", "HTTP");
-            int curlproxytype = CURLPROXY_HTTP;
-            if (!strcasecmp (type, "HTTP")) {
-                curlproxytype = CURLPROXY_HTTP;
-            }
+    if (fp->transfer_offset > 0) {
+        curl_easy_setopt (curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)fp->transfer_offset);
+    }
+    if (deadbeef->conf_get_int ("network.proxy", 0)) {
+        deadbeef->conf_lock ();
+        curl_easy_setopt (curl, CURLOPT_PROXY, deadbeef->conf_get_str_fast ("network.proxy.address", ""));
+        curl_easy_setopt (curl, CURLOPT_PROXYPORT, deadbeef->conf_get_int ("network.proxy.port", 8080));
+        const char *type = deadbeef->conf_get_str_fast ("network.proxy.type", "HTTP");
+        int curlproxytype = CURLPROXY_HTTP;
+        if (!strcasecmp (type, "HTTP")) {
+            curlproxytype = CURLPROXY_HTTP;
+        }
 #if LIBCURL_VERSION_MINOR >= 19 && LIBCURL_VERSION_PATCH >= 4
-            else if (!strcasecmp (type, "HTTP_1_0")) {
-                curlproxytype = CURLPROXY_HTTP_1_0;
-            }
+        else if (!strcasecmp (type, "HTTP_1_0")) {
+            curlproxytype = CURLPROXY_HTTP_1_0;
+        }
 #endif
 #if LIBCURL_VERSION_MINOR >= 15 && LIBCURL_VERSION_PATCH >= 2
-            else if (!strcasecmp (type, "SOCKS4")) {
-                curlproxytype = CURLPROXY_SOCKS4;
-            }
+        else if (!strcasecmp (type, "SOCKS4")) {
+            curlproxytype = CURLPROXY_SOCKS4;
+        }
 #endif
-            else if (!strcasecmp (type, "SOCKS5")) {
-                curlproxytype = CURLPROXY_SOCKS5;
-            }
+        else if (!strcasecmp (type, "SOCKS5")) {
+            curlproxytype = CURLPROXY_SOCKS5;
+        }
 #if LIBCURL_VERSION_MINOR >= 18 && LIBCURL_VERSION_PATCH >= 0
-            else if (!strcasecmp (type, "SOCKS4A")) {
-                curlproxytype = CURLPROXY_SOCKS4A;
-            }
-            else if (!strcasecmp (type, "SOCKS5_HOSTNAME")) {
-                curlproxytype = CURLPROXY_SOCKS5_HOSTNAME;
-            }
+        else if (!strcasecmp (type, "SOCKS4A")) {
+            curlproxytype = CURLPROXY_SOCKS4A;
+        }
+        else if (!strcasecmp (type, "SOCKS5_HOSTNAME")) {
+            curlproxytype = CURLPROXY_SOCKS5_HOSTNAME;
+        }
 #endif
-            curl_easy_setopt (curl, CURLOPT_PROXYTYPE, curlproxytype);
+        curl_easy_setopt (curl, CURLOPT_PROXYTYPE, curlproxytype);
 
-            const char *proxyuser = deadbeef->conf_get_str_fast ("network.proxy.username", "");
-            const char *proxypass = deadbeef->conf_get_str_fast ("network.proxy.password", "");
-            if (*proxyuser || *proxypass) {
+        const char *proxyuser = deadbeef->conf_get_str_fast ("network.proxy.username", "");
+        const char *proxypass = deadbeef->conf_get_str_fast ("network.proxy.password", "");
+        if (*proxyuser || *proxypass) {
 #if LIBCURL_VERSION_MINOR >= 19 && LIBCURL_VERSION_PATCH >= 1
-                curl_easy_setopt (curl, CURLOPT_PROXYUSERNAME, proxyuser);
-                curl_easy_setopt (curl, CURLOPT_PROXYPASSWORD, proxypass);
+            curl_easy_setopt (curl, CURLOPT_PROXYUSERNAME, proxyuser);
+            curl_easy_setopt (curl, CURLOPT_PROXYPASSWORD, proxypass);
 #else
-                char pwd[200];
-                snprintf (pwd, sizeof (pwd), "%s:%s", proxyuser, proxypass);
-                curl_easy_setopt (curl, CURLOPT_PROXYUSERPWD, pwd);
+            char pwd[200];
+            snprintf (pwd, sizeof (pwd), "%s:%s", proxyuser, proxypass);
+            curl_easy_setopt (curl, CURLOPT_PROXYUSERPWD, pwd);
 #endif
-            }
-            deadbeef->conf_unlock ();
         }
-//        fp->status = STATUS_INITIAL;
-        trace ("vfs_curl: calling curl_easy_perform (status=%d)...\n", fp->status);
-        gettimeofday (&fp->last_read_time, NULL);
-        status = curl_easy_perform (curl);
-        trace ("vfs_curl: curl_easy_perform retval=%d\n", status);
-        if (status != 0) {
-            trace ("curl error:\n%s\n", fp->http_err);
+        deadbeef->conf_unlock ();
+    }
+}
+
+static void
+_io_remove_transfer (HTTP_FILE *fp) {
+    if (!fp->in_multi) {
+        return;
+    }
+    curl_multi_remove_handle (_io_multi, fp->curl);
+    fp->in_multi = 0;
+
+    HTTP_FILE **pp = &_io_active;
+    while (*pp && *pp != fp) {
+        pp = (HTTP_FILE **)&(*pp)->io_active_next;
+    }
+    if (*pp) {
+        *pp = fp->io_active_next;
+    }
+    fp->io_active_next = NULL;
+}
+
+static void
+_io_start_transfer (HTTP_FILE *fp) {
+    if (!fp->curl) {
+        fp->curl = curl_easy_init ();
+    }
+    _setup_request (fp);
+
+    trace ("vfs_curl: starting transfer (status=%d)...\n", fp->status);
+    gettimeofday (&fp->last_read_time, NULL);
+    if (curl_multi_add_handle (_io_multi, fp->curl) != CURLM_OK) {
+        deadbeef->mutex_lock (fp->mutex);
+        fp->status = STATUS_ABORTED;
+        deadbeef->cond_broadcast (fp->cond);
+        deadbeef->mutex_unlock (fp->mutex);
+        return;
+    }
+    fp->in_multi = 1;
+    fp->io_active_next = _io_active;
+    _io_active = fp;
+}
+
+static void
+_io_unqueue (HTTP_FILE *fp) {
+    deadbeef->mutex_lock (_io_mutex);
+    if (fp->io_queued) {
+        HTTP_FILE **pp = &_io_queue;
+        while (*pp && *pp != fp) {
+            pp = (HTTP_FILE **)&(*pp)->io_next;
+        }
+        if (*pp) {
+            *pp = fp->io_next;
+        }
+        fp->io_next = NULL;
+        fp->io_queued = 0;
+    }
+    deadbeef->mutex_unlock (_io_mutex);
+}
+
+// Brings the transfer in line with the file state: start, restart after seek, resume, or abort.
+// Must not be called with fp->mutex locked, since curl may call back into the write handler.
+static void
+_io_update_file (HTTP_FILE *fp) {
+    deadbeef->mutex_lock (fp->mutex);
+
+    if (fp->closing || http_need_abort (fp->identifier)) {
+        int closing = fp->closing;
+        deadbeef->mutex_unlock (fp->mutex);
+        _io_remove_transfer (fp);
+        if (closing && fp->curl) {
+            curl_easy_cleanup (fp->curl);
+            fp->curl = NULL;
         }
         deadbeef->mutex_lock (fp->mutex);
-        if (fp->status != STATUS_SEEK) {
-            trace ("vfs_curl: break loop\n");
-            deadbeef->mutex_unlock (fp->mutex);
-            break;
+        if (fp->status != STATUS_FINISHED) {
+            fp->status = STATUS_ABORTED;
         }
-        else {
-            trace ("vfs_curl: restart loop\n");
-            fp->skipbytes = 0;
-            fp->status = STATUS_INITIAL;
-            trace ("seeking to %lld\n", fp->pos);
-            if (fp->length < 0) {
-                // icy -- need full restart
-                fp->pos = 0;
-                if (fp->content_type) {
-                    free (fp->content_type);
-                    fp->content_type = NULL;
-                }
-                fp->seektoend = 0;
-                fp->gotheader = 0;
-                fp->icyheader = 0;
-                fp->gotsomeheader = 0;
-                fp->wait_meta = 0;
-                fp->icy_metaint = 0;
+        if (closing) {
+            _io_unqueue (fp);
+        }
+        fp->released = closing;
+        deadbeef->cond_broadcast (fp->cond);
+        // the file may be freed as soon as the mutex is unlocked
+        deadbeef->mutex_unlock (fp->mutex);
+        return;
+    }
+
+    int start = 0;
+    if (fp->status == STATUS_SEEK) {
+        trace ("vfs_curl: restart transfer\n");
+        fp->skipbytes = 0;
+        fp->status = STATUS_INITIAL;
+        trace ("seeking to %lld\n", fp->blockmode ? fp->fetch_pos : fp->pos);
+        if (fp->blockmode) {
+            // partially received block is discarded, the new transfer starts at a block boundary
+            fp->fill_size = 0;
+            fp->transfer_checked = 0;
+            fp->fetch_stop = 0;
+        }
+        else if (fp->length < 0) {
+            // icy -- need full restart
+            fp->pos = 0;
+            if (fp->content_type) {
+                free (fp->content_type);
+                fp->content_type = NULL;
             }
+            fp->seektoend = 0;
+            fp->gotheader = 0;
+            fp->icyheader = 0;
+            fp->gotsomeheader = 0;
+            fp->wait_meta = 0;
+            fp->icy_metaint = 0;
+        }
+        start = 1;
+    }
+    else if (fp->status == STATUS_INITIAL && !fp->in_multi) {
+        start = 1;
+    }
+
+    if (start) {
+        if (fp->blockmode) {
+            fp->transfer_offset = fp->fetch_pos;
+        }
+        else {
+            fp->transfer_offset = fp->length >= 0 ? fp->pos : 0;
         }
+        fp->paused = 0;
+        fp->need_unpause = 0;
         deadbeef->mutex_unlock (fp->mutex);
-        curl_slist_free_all (headers);
-        curl_slist_free_all (ok_aliases);
+        _io_remove_transfer (fp);
+        _io_start_transfer (fp);
+        return;
     }
-    fp->curl = NULL;
-    curl_easy_cleanup (curl);
 
-    deadbeef->mutex_lock (fp->mutex);
+    if (fp->need_unpause && fp->paused && fp->in_multi) {
+        fp->need_unpause = 0;
+        fp->paused = 0;
+        gettimeofday (&fp->last_read_time, NULL);
+        deadbeef->mutex_unlock (fp->mutex);
+        curl_easy_pause (fp->curl, CURLPAUSE_CONT);
+        return;
+    }
+
+    fp->need_unpause = 0;
+    deadbeef->mutex_unlock (fp->mutex);
+}
+
+static void
+_io_transfer_done (HTTP_FILE *fp, CURLcode result) {
+    trace ("vfs_curl: transfer finished, retval=%d\n", result);
+    if (result != CURLE_OK) {
+        trace ("curl error:\n%s\n", fp->http_err);
+    }
+    _io_remove_transfer (fp);
 
+    deadbeef->mutex_lock (fp->mutex);
+    if (fp->status == STATUS_SEEK) {
+        deadbeef->mutex_unlock (fp->mutex);
+        _io_update_file (fp);
+        return;
+    }
     if (fp->status == STATUS_ABORTED) {
-        trace ("vfs_curl: thread ended due to abort signal\n");
+        trace ("vfs_curl: transfer ended due to abort signal\n");
     }
     else {
-        trace ("vfs_curl: thread ended normally\n");
+        trace ("vfs_curl: transfer ended normally\n");
+        if (fp->blockmode && !fp->fetch_stop && fp->fetch_pos < fp->length) {
+            // the connection was closed before the requested data was received
+            fp->fetch_error = 1;
+        }
         fp->status = STATUS_FINISHED;
     }
+    deadbeef->cond_broadcast (fp->cond);
     deadbeef->mutex_unlock (fp->mutex);
 }
 
+static void
+_io_check_active_transfers (void) {
+    struct timeval tm;
+    gettimeofday (&tm, NULL);
+
+    HTTP_FILE *fp = _io_active;
+    while (fp) {
+        HTTP_FILE *next = fp->io_active_next;
+        int update = 0;
+
+        deadbeef->mutex_lock (fp->mutex);
+        if (http_need_abort (fp->identifier)) {
+            update = 1;
+        }
+        else if (fp->status == STATUS_READING && !fp->paused && tm.tv_sec - fp->last_read_time.tv_sec > TIMEOUT) {
+            trace ("vfs_curl: timed out, restarting read\n");
+            memcpy (&fp->last_read_time, &tm, sizeof (struct timeval));
+            http_stream_reset (fp);
+            fp->status = STATUS_SEEK;
+            fp->timedout = 1;
+            deadbeef->cond_broadcast (fp->cond);
+            update = 1;
+        }
+        deadbeef->mutex_unlock (fp->mutex);
+
+        if (update) {
+            _io_update_file (fp);
+        }
+        fp = next;
+    }
+}
+
+static void
+_io_thread_func (void *ctx) {
+    for (;;) {
+        deadbeef->mutex_lock (_io_mutex);
+        if (_io_terminate) {
+            deadbeef->mutex_unlock (_io_mutex);
+            break;
+        }
+        deadbeef->mutex_unlock (_io_mutex);
+
+        // Files are popped one by one, since they can be queued again while being processed
+        for (;;) {
+            deadbeef->mutex_lock (_io_mutex);
+            HTTP_FILE *fp = _io_queue;
+            if (fp) {
+                _io_queue = fp->io_next;
+                fp->io_next = NULL;
+                fp->io_queued = 0;
+            }
+            deadbeef->mutex_unlock (_io_mutex);
+            if (!fp) {
+                break;
+            }
+            _io_update_file (fp);
+        }
+
+        _io_check_active_transfers ();
+
+        int running = 0;
+        curl_multi_perform (_io_multi, &running);
+
+        CURLMsg *msg;
+        int msgs_left;
+        while ((msg = curl_multi_info_read (_io_multi, &msgs_left))) {
+            if (msg->msg == CURLMSG_DONE) {
+                HTTP_FILE *fp = NULL;
+                curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE, (char **)&fp);
+                if (fp) {
+                    _io_transfer_done (fp, msg->data.result);
+                }
+            }
+        }
+
+#ifdef HAVE_CURL_MULTI_WAKEUP
+        curl_multi_poll (_io_multi, NULL, 0, IO_POLL_TIMEOUT_MS, NULL);
+#else
+        curl_multi_wait (_io_multi, NULL, 0, IO_POLL_TIMEOUT_MS, NULL);
+#endif
+    }
+
+    // abort whatever is still running
+    while (_io_active) {
+        HTTP_FILE *fp = _io_active;
+        _io_remove_transfer (fp);
+        deadbeef->mutex_lock (fp->mutex);
+        fp->status = STATUS_ABORTED;
+        deadbeef->cond_broadcast (fp->cond);
+        deadbeef->mutex_unlock (fp->mutex);
+    }
+}
+
+// Puts the file into the I/O thread request queue, starting the thread if necessary.
+// Returns -1 if the I/O thread is shut down.
+static int
+_io_enqueue (HTTP_FILE *fp) {
+    deadbeef->mutex_lock (_io_mutex);
+    if (_io_terminate) {
+        deadbeef->mutex_unlock (_io_mutex);
+        return -1;
+    }
+    if (!_io_tid) {
+        _io_multi = curl_multi_init ();
+        _io_share = curl_share_init ();
+        // Handles are only used on the I/O thread, so the share doesn't need locking
+        curl_share_setopt (_io_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt (_io_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900 // 7.57.0
+        curl_share_setopt (_io_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+        _io_tid = deadbeef->thread_start (_io_thread_func, NULL);
+    }
+    if (!fp->io_queued) {
+        fp->io_queued = 1;
+        fp->io_next = _io_queue;
+        _io_queue = fp;
+    }
+    deadbeef->mutex_unlock (_io_mutex);
+    _io_wakeup ();
+    return 0;
+}
+
+static void
+_io_request (HTTP_FILE *fp) {
+    if (_io_enqueue (fp) < 0) {
+        deadbeef->mutex_lock (fp->mutex);
+        fp->status = STATUS_ABORTED;
+        deadbeef->cond_broadcast (fp->cond);
+        deadbeef->mutex_unlock (fp->mutex);
+    }
+}
+
+static void
+_io_shutdown (void) {
+    deadbeef->mutex_lock (_io_mutex);
+    _io_terminate = 1;
+    intptr_t tid = _io_tid;
+    deadbeef->mutex_unlock (_io_mutex);
+
+    if (tid) {
+        _io_wakeup ();
+        deadbeef->thread_join (tid);
+    }
+
+    deadbeef->mutex_lock (_io_mutex);
+    _io_tid = 0;
+    // files which were still waiting in the queue are not going to be serviced
+    while (_io_queue) {
+        HTTP_FILE *fp = _io_queue;
+        _io_queue = fp->io_next;
+        fp->io_next = NULL;
+        fp->io_queued = 0;
+        deadbeef->mutex_lock (fp->mutex);
+        if (fp->status != STATUS_FINISHED) {
+            fp->status = STATUS_ABORTED;
+        }
+        fp->released = fp->closing;
+        deadbeef->cond_broadcast (fp->cond);
+        deadbeef->mutex_unlock (fp->mutex);
+    }
+    deadbeef->mutex_unlock (_io_mutex);
+
+    if (_io_multi) {
+        curl_multi_cleanup (_io_multi);
+        _io_multi = NULL;
+    }
+    if (_io_share) {
+        curl_share_cleanup (_io_share);
+        _io_share = NULL;
+    }
+}
+
+#pragma mark -
+
+// Opens the file from the block cache, without making any requests.
+// The data which is not cached is fetched on demand.
+static int
+_open_cached (HTTP_FILE *fp) {
+    blockcache_entry_t *entry = blockcache_entry_open (fp->url);
+    if (!entry) {
+        return -1;
+    }
+    fp->fill_buffer = malloc (BLOCKCACHE_BLOCK_SIZE);
+    if (!fp->fill_buffer) {
+        blockcache_entry_release (entry);
+        return -1;
+    }
+    const char *content_type = blockcache_entry_get_content_type (entry);
+    if (content_type) {
+        fp->content_type = strdup (content_type);
+    }
+    fp->cache_entry = entry;
+    fp->length = blockcache_entry_get_length (entry);
+    fp->blockmode = 1;
+    fp->responded = 1;
+    fp->gotheader = 1;
+    fp->prefetch_block = -1;
+    fp->status = STATUS_FINISHED;
+    return 0;
+}
+
 static void
 http_start_streamer (HTTP_FILE *fp) {
     fp->mutex = deadbeef->mutex_create ();
-    fp->tid = deadbeef->thread_start (http_thread_func, fp);
-//    deadbeef->thread_detach (fp->tid);
+    fp->cond = deadbeef->cond_create ();
+    fp->length = -1;
+    fp->started = 1;
+    if (!_open_cached (fp)) {
+        trace ("vfs_curl: opened %s from cache\n", fp->url);
+        return;
+    }
+    fp->status = STATUS_INITIAL;
+    trace ("vfs_curl: started loading data %s\n", fp->url);
+    _io_request (fp);
 }
 
 static DB_FILE *
@@ -813,14 +1384,151 @@ http_close (DB_FILE *stream) {
 
     uint64_t identifier = fp->identifier;
     vfs_curl_abort_with_identifier (identifier);
-    if (fp->tid) {
-        deadbeef->thread_join (fp->tid);
+    if (fp->started) {
+        // wait until the I/O thread lets go of the file
+        deadbeef->mutex_lock (fp->mutex);
+        fp->closing = 1;
+        deadbeef->cond_broadcast (fp->cond);
+        deadbeef->mutex_unlock (fp->mutex);
+
+        if (_io_enqueue (fp) == 0) {
+            deadbeef->mutex_lock (fp->mutex);
+            while (!fp->released) {
+                deadbeef->cond_wait (fp->cond, fp->mutex);
+            }
+            deadbeef->mutex_unlock (fp->mutex);
+        }
     }
     http_cancel_abort (identifier);
     vfs_curl_free_file (fp);
     trace ("http_close done\n");
 }
 
+// Asks the I/O thread to resume the paused transfer, if there's enough space in the buffer.
+// Must be called with fp->mutex locked.
+static void
+_resume_if_needed (HTTP_FILE *fp) {
+    if (fp->paused && !fp->need_unpause && BUFFER_FILL_LIMIT - fp->remaining >= RESUME_THRESHOLD) {
+        fp->need_unpause = 1;
+        _io_enqueue (fp);
+    }
+}
+
+// Waits until the first response decides whether the file is read in block mode.
+// Must be called with fp->mutex locked.
+static void
+_wait_for_response (HTTP_FILE *fp) {
+    while (!fp->responded && fp->status != STATUS_FINISHED && fp->status != STATUS_ABORTED) {
+        deadbeef->cond_wait (fp->cond, fp->mutex);
+    }
+}
+
+static int
+_block_transfer_running (HTTP_FILE *fp) {
+    return (fp->status == STATUS_INITIAL || fp->status == STATUS_READING || fp->status == STATUS_SEEK) && !fp->fetch_stop;
+}
+
+// Restarts the transfer at the given block.
+// Must be called with fp->mutex locked.
+static void
+_block_fetch (HTTP_FILE *fp, int64_t index) {
+    trace ("vfs_curl: fetching block %lld\n", index);
+    fp->fetch_pos = index * BLOCKCACHE_BLOCK_SIZE;
+    fp->fetch_error = 0;
+    fp->status = STATUS_SEEK;
+    deadbeef->cond_broadcast (fp->cond);
+    _io_request (fp);
+}
+
+// Resumes the paused transfer, once the reader gets close enough.
+// Must be called with fp->mutex locked.
+static void
+_block_resume_if_needed (HTTP_FILE *fp) {
+    if (fp->paused && !fp->need_unpause && fp->fetch_pos < _block_readahead_limit (fp)) {
+        fp->need_unpause = 1;
+        _io_enqueue (fp);
+    }
+}
+
+// Makes sure that the missing block is going to be received soon.
+// Must be called with fp->mutex locked.
+static void
+_block_request (HTTP_FILE *fp, int64_t index) {
+    int64_t fetch_block = fp->fetch_pos / BLOCKCACHE_BLOCK_SIZE;
+    if (_block_transfer_running (fp) && fetch_block <= index && index - fetch_block <= 1) {
+        _block_resume_if_needed (fp);
+        return;
+    }
+    _block_fetch (fp, index);
+}
+
+// Starts fetching the first missing block after the one being read.
+// Must be called with fp->mutex locked.
+static void
+_block_prefetch (HTTP_FILE *fp, int64_t index) {
+    _block_resume_if_needed (fp);
+    if (index == fp->prefetch_block) {
+        return;
+    }
+    fp->prefetch_block = index;
+
+    int64_t fetch_block = fp->fetch_pos / BLOCKCACHE_BLOCK_SIZE;
+    if (_block_transfer_running (fp) && fetch_block > index && fetch_block <= index + READAHEAD_BLOCKS) {
+        return;
+    }
+    for (int64_t i = index + 1; i <= index + READAHEAD_BLOCKS && i * BLOCKCACHE_BLOCK_SIZE < fp->length; i++) {
+        if (!blockcache_has_block (fp->cache_entry, i)) {
+            if (!_block_transfer_running (fp) || fetch_block != i) {
+                _block_fetch (fp, i);
+            }
+            break;
+        }
+    }
+}
+
+// Must be called with fp->mutex locked.
+static size_t
+_block_read (HTTP_FILE *fp, uint8_t *ptr, size_t size) {
+    size_t total = 0;
+    fp->timedout = 0; // the transfer was restarted at the same block, nothing to do
+    if (fp->fetch_error && !_block_transfer_running (fp)) {
+        // try again
+        fp->fetch_error = 0;
+    }
+
+    while (total < size && fp->pos < fp->length) {
+        if (fp->status == STATUS_ABORTED) {
+            errno = ECONNABORTED;
+            break;
+        }
+        if (fp->fetch_error) {
+            errno = EIO;
+            break;
+        }
+        int64_t index = fp->pos / BLOCKCACHE_BLOCK_SIZE;
+        size_t offset = fp->pos % BLOCKCACHE_BLOCK_SIZE;
+        int blocks_stored = fp->blocks_stored;
+
+        deadbeef->mutex_unlock (fp->mutex);
+        size_t rb = blockcache_read (fp->cache_entry, index, offset, ptr + total, size - total);
+        deadbeef->mutex_lock (fp->mutex);
+
+        if (rb > 0) {
+            fp->pos += rb;
+            total += rb;
+            _block_prefetch (fp, index);
+            continue;
+        }
+
+        _block_request (fp, index);
+        if (fp->blocks_stored == blocks_stored && fp->status != STATUS_ABORTED && !fp->fetch_error) {
+            deadbeef->cond_wait (fp->cond, fp->mutex);
+        }
+        fp->timedout = 0;
+    }
+    return total;
+}
+
 static size_t
 http_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
     assert (stream);
@@ -828,13 +1536,22 @@ http_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
     HTTP_FILE *fp = (HTTP_FILE *)stream;
 //    trace ("http_read %d (status=%d)\n", size*nmemb, fp->status);
     fp->seektoend = 0;
+    if (!fp->started) {
+        http_start_streamer (fp);
+    }
+
+    deadbeef->mutex_lock (fp->mutex);
+    _wait_for_response (fp);
+    if (fp->blockmode) {
+        size_t res = _block_read (fp, ptr, size * nmemb);
+        deadbeef->mutex_unlock (fp->mutex);
+        return res / size;
+    }
     if (fp->status == STATUS_ABORTED || (fp->status == STATUS_FINISHED && fp->remaining == 0)) {
+        deadbeef->mutex_unlock (fp->mutex);
         errno = ECONNABORTED;
         return 0;
     }
-    if (!fp->tid) {
-        http_start_streamer (fp);
-    }
 
     size_t sz = size * nmemb;
     while ((fp->remaining > 0 || (fp->status != STATUS_FINISHED && fp->status != STATUS_ABORTED)) && sz > 0)
@@ -842,24 +1559,18 @@ http_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
         // wait until data is available
         while ((fp->remaining == 0 || fp->skipbytes > 0) && fp->status != STATUS_FINISHED && fp->status != STATUS_ABORTED) {
 //            trace ("vfs_curl: readwait, status: %d..\n", fp->status);
-            deadbeef->mutex_lock (fp->mutex);
-            if (fp->status == STATUS_READING) {
-                struct timeval tm;
-                gettimeofday (&tm, NULL);
-                float sec = tm.tv_sec - fp->last_read_time.tv_sec;
-                if (sec > TIMEOUT) {
-                    trace ("http_read: timed out, restarting read\n");
-                    memcpy (&fp->last_read_time, &tm, sizeof (struct timeval));
-                    http_stream_reset (fp);
-                    fp->status = STATUS_SEEK;
+            if (fp->timedout) {
+                // the I/O thread has already restarted the transfer
+                fp->timedout = 0;
+                if (fp->track) { // don't touch streamer if the stream is not assosiated with a track
                     deadbeef->mutex_unlock (fp->mutex);
-                    if (fp->track) { // don't touch streamer if the stream is not assosiated with a track
-                        deadbeef->streamer_reset (1);
-                        continue;
-                    }
-                    errno = ETIMEDOUT;
-                    return 0;
+                    deadbeef->streamer_reset (1);
+                    deadbeef->mutex_lock (fp->mutex);
+                    continue;
                 }
+                deadbeef->mutex_unlock (fp->mutex);
+                errno = ETIMEDOUT;
+                return 0;
             }
             int64_t skip = min (fp->remaining, fp->skipbytes);
             if (skip > 0) {
@@ -867,12 +1578,13 @@ http_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
                 fp->pos += skip;
                 fp->remaining -= skip;
                 fp->skipbytes -= skip;
+                _resume_if_needed (fp);
+                deadbeef->cond_broadcast (fp->cond);
+                continue;
             }
-            deadbeef->mutex_unlock (fp->mutex);
-            usleep (3000);
+            deadbeef->cond_wait (fp->cond, fp->mutex);
         }
     //    trace ("buffer remaining: %d\n", fp->remaining);
-        deadbeef->mutex_lock (fp->mutex);
         //trace ("http_read %lld/%lld/%d\n", fp->pos, fp->length, fp->remaining);
         size_t cp = min (sz, fp->remaining);
         int64_t readpos = fp->pos & BUFFER_MASK;
@@ -892,9 +1604,12 @@ http_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
             sz -= cp;
             ptr += cp;
         }
-        deadbeef->mutex_unlock (fp->mutex);
+        _resume_if_needed (fp);
+        deadbeef->cond_broadcast (fp->cond);
     }
-    if (fp->status == STATUS_ABORTED) {
+    int aborted = fp->status == STATUS_ABORTED;
+    deadbeef->mutex_unlock (fp->mutex);
+    if (aborted) {
         errno = ECONNABORTED;
         return 0;
     }
@@ -910,24 +1625,44 @@ http_seek (DB_FILE *stream, int64_t offset, int whence) {
     assert (stream);
     HTTP_FILE *fp = (HTTP_FILE *)stream;
     fp->seektoend = 0;
-    if (whence == SEEK_END) {
-        if (offset == 0) {
-            fp->seektoend = 1;
-            return 0;
-        }
-        trace ("vfs_curl: can't seek in curl stream relative to EOF\n");
-        return -1;
+    if (whence == SEEK_END && offset == 0) {
+        fp->seektoend = 1;
+        return 0;
     }
-    if (!fp->tid) {
+    if (!fp->started) {
         if (offset == 0 && (whence == SEEK_SET || whence == SEEK_CUR)) {
             return 0;
         }
-        else {
+        if (!blockcache_enabled ()) {
             trace ("vfs_curl: cannot do seek(%lld,%d)\n", offset, whence);
             return -1;
         }
+        // the response tells whether the file is seekable
+        http_start_streamer (fp);
     }
     deadbeef->mutex_lock (fp->mutex);
+    _wait_for_response (fp);
+    if (fp->blockmode) {
+        // any position can be read, missing data is fetched by the next read
+        if (whence == SEEK_CUR) {
+            offset += fp->pos;
+        }
+        else if (whence == SEEK_END) {
+            offset += fp->length;
+        }
+        if (offset < 0) {
+            deadbeef->mutex_unlock (fp->mutex);
+            return -1;
+        }
+        fp->pos = offset;
+        deadbeef->mutex_unlock (fp->mutex);
+        return 0;
+    }
+    if (whence == SEEK_END) {
+        deadbeef->mutex_unlock (fp->mutex);
+        trace ("vfs_curl: can't seek in curl stream relative to EOF\n");
+        return -1;
+    }
     if (whence == SEEK_CUR) {
         whence = SEEK_SET;
         offset = fp->pos + offset;
@@ -955,8 +1690,10 @@ http_seek (DB_FILE *stream, int64_t offset, int whence) {
     http_stream_reset (fp);
     fp->pos = offset;
     fp->status = STATUS_SEEK;
-
+    deadbeef->cond_broadcast (fp->cond);
     deadbeef->mutex_unlock (fp->mutex);
+
+    _io_request (fp);
     return 0;
 }
 
@@ -975,12 +1712,19 @@ http_rewind (DB_FILE *stream) {
     trace ("http_rewind\n");
     assert (stream);
     HTTP_FILE *fp = (HTTP_FILE *)stream;
-    if (fp->tid) {
+    if (fp->started) {
         deadbeef->mutex_lock (fp->mutex);
+        if (fp->blockmode) {
+            fp->pos = 0;
+            deadbeef->mutex_unlock (fp->mutex);
+            return;
+        }
         fp->status = STATUS_SEEK;
         http_stream_reset (fp);
         fp->pos = 0;
+        deadbeef->cond_broadcast (fp->cond);
         deadbeef->mutex_unlock (fp->mutex);
+        _io_request (fp);
     }
 }
 
@@ -993,14 +1737,17 @@ http_getlength (DB_FILE *stream) {
         trace ("length: -1\n");
         return -1;
     }
-    if (!fp->tid) {
+    if (!fp->started) {
         http_start_streamer (fp);
     }
-    while (fp->status == STATUS_INITIAL) {
-        usleep (3000);
+    deadbeef->mutex_lock (fp->mutex);
+    while (fp->status == STATUS_INITIAL && !fp->blockmode) {
+        deadbeef->cond_wait (fp->cond, fp->mutex);
     }
-    trace ("length: %lld\n", fp->length);
-    return fp->length;
+    int64_t length = fp->length;
+    deadbeef->mutex_unlock (fp->mutex);
+    trace ("length: %lld\n", length);
+    return length;
 }
 
 static const char *
@@ -1014,13 +1761,15 @@ http_get_content_type (DB_FILE *stream) {
     if (fp->gotheader) {
         return fp->content_type;
     }
-    if (!fp->tid) {
+    if (!fp->started) {
         http_start_streamer (fp);
     }
     trace ("http_get_content_type waiting for response...\n");
+    deadbeef->mutex_lock (fp->mutex);
     while (fp->status != STATUS_FINISHED && fp->status != STATUS_ABORTED && !fp->gotheader) {
-        usleep (3000);
+        deadbeef->cond_wait (fp->cond, fp->mutex);
     }
+    deadbeef->mutex_unlock (fp->mutex);
 
     if (!fp->content_type && fp->icyheader) {
         // assume mp3
@@ -1064,12 +1813,21 @@ static int
 vfs_curl_start (void) {
     allow_new_streams = 1;
     biglock = deadbeef->mutex_create ();
+    _io_mutex = deadbeef->mutex_create ();
+    _io_terminate = 0;
+    blockcache_init (deadbeef);
     return 0;
 }
 
 static int
 vfs_curl_stop (void) {
     allow_new_streams = 0;
+    if (_io_mutex) {
+        _io_shutdown ();
+        deadbeef->mutex_free (_io_mutex);
+        _io_mutex = 0;
+    }
+    blockcache_free ();
     if (biglock) {
         deadbeef->mutex_free (biglock);
         biglock = 0;
@@ -1121,18 +1879,33 @@ vfs_curl_abort_with_identifier (uint64_t identifier) {
         }
     }
     deadbeef->mutex_unlock (biglock);
+
+    // let the I/O thread notice the abort, even if the transfer is stalled or paused
+    _io_wakeup ();
 }
 
 
+static int
+vfs_curl_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
+    if (id == DB_EV_CONFIGCHANGED) {
+        blockcache_configchanged ();
+    }
+    return 0;
+}
+
 static const char settings_dlg[] =
     "property \"Enable logging\" checkbox vfs_curl.trace 0;\n"
+    "property \"Cache seekable files (podcasts, remote libraries)\" checkbox vfs_curl.cache 1;\n"
+    "property \"Memory cache size (MB)\" entry vfs_curl.cache_memory_mb 32;\n"
+    "property \"Keep cached files on disk\" checkbox vfs_curl.disk_cache 0;\n"
+    "property \"Disk cache size (MB)\" entry vfs_curl.disk_cache_mb 512;\n"
 ;
 
 
 static DB_vfs_t plugin = {
     DDB_PLUGIN_SET_API_VERSION
     .plugin.version_major = 1,
-    .plugin.version_minor = 0,
+    .plugin.version_minor = 2,
     .plugin.type = DB_PLUGIN_VFS,
 //    .plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
     .plugin.id = "vfs_curl",
@@ -1164,6 +1937,7 @@ static DB_vfs_t plugin = {
     .plugin.configdialog = settings_dlg,
     .plugin.start = vfs_curl_start,
     .plugin.stop = vfs_curl_stop,
+    .plugin.message = vfs_curl_message,
     .open = http_open,
     .set_track = http_set_track,
     .close = http_close,
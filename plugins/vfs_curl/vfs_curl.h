@@ -11,6 +11,7 @@
 
 #include <curl/curl.h>
 #include <deadbeef/deadbeef.h>
+#include "blockcache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,8 +43,8 @@ typedef struct {
     int64_t length;
     int32_t remaining; // remaining bytes in buffer read from stream
     int64_t skipbytes;
-    intptr_t tid; // thread id which does http requests
-    intptr_t mutex;
+    uintptr_t mutex;
+    uintptr_t cond; // signalled when data, status or buffer space changes
     uint8_t nheaderpackets;
     char *content_type;
     CURL *curl;
@@ -63,6 +64,42 @@ typedef struct {
 
     uint64_t identifier;
 
+    // The transfer is driven by the shared I/O thread, see vfs_curl.c
+    struct curl_slist *headers;
+    struct curl_slist *ok_aliases;
+    void *io_next; // next file in the I/O thread request queue, protected by the queue lock
+    void *io_active_next; // next file with an active transfer, owned by the I/O thread
+    int io_queued; // protected by the queue lock
+    int in_multi; // owned by the I/O thread
+    int started; // the request was handed over to the I/O thread
+    int paused; // the transfer is paused until the reader frees some buffer space
+    int need_unpause;
+    int timedout;
+    int closing;
+    int released; // the I/O thread will not touch this file anymore
+
+    // Seekable files with known length are read through the block cache instead of the ring buffer
+    blockcache_entry_t *cache_entry;
+    uint8_t *fill_buffer; // the block being received, owned by the I/O thread
+    size_t fill_size;
+    int64_t transfer_offset; // start of the byte range requested by the current transfer
+    int64_t fetch_pos; // start of the block which the current transfer is receiving
+    int64_t prefetch_block; // the block for which read-ahead was last checked
+    int blocks_stored; // incremented on every stored block, so that readers don't miss wakeups
+    int blockmode;
+    int responded; // the first response was received, blockmode is decided
+    int transfer_checked; // the current response was checked against the cache entry
+    int fetch_stop; // the transfer was stopped because the following data is cached
+    int fetch_error;
+
+    // properties of the current response
+    int64_t content_length;
+    int64_t range_start;
+    int64_t range_total; // 0 if there was no Content-Range
+    int accept_ranges;
+    char etag[100];
+    char last_modified[100];
+
     // flags (bitfields to save some space)
     unsigned seektoend : 1; // indicates that next tell must return length
     unsigned gotheader : 1; // tells that all headers (including ICY) were processed (to start reading body)
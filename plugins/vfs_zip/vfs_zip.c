@@ -23,8 +23,10 @@
 
 #include <string.h>
 #include <zip.h>
+#include <zlib.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/stat.h>
 #include <deadbeef/deadbeef.h>
 
 //#define trace(...) { fprintf(stderr, __VA_ARGS__); }
@@ -41,21 +43,100 @@ static DB_vfs_t plugin;
 #define ZIP_BUFFER_SIZE 8192
 #endif
 
+// Deflate history size, needed to resume inflating from an arbitrary block boundary
+#define ZIP_WINDOW_SIZE 32768
+
+// Distance between the seek index checkpoints, in uncompressed bytes
+#define ZIP_INDEX_SPAN (1024*1024)
+
+// Indexes of the entries which are not open anymore are dropped when the total size exceeds this
+#define ZIP_INDEX_MEMORY_LIMIT (32*1024*1024)
+
+#define ZIP_INPUT_SIZE 16384
+
+// Number of archives which are kept open after all their files were closed
+#define ZIP_MAX_IDLE_ARCHIVES 4
+
+// Shared archive handle.
+// libzip handles are not thread safe, so all calls on the archive and its files are serialized with the mutex.
+typedef struct zip_archive_s {
+    struct zip_archive_s *next;
+    char *path;
+    int64_t mtime;
+    int64_t size;
+    struct zip *z;
+    uintptr_t mutex;
+    int refcount;
+    int stale; // the file has changed, close as soon as possible
+    uint64_t last_used;
+} zip_archive_t;
+
+// Inflate state snapshot at a deflate block boundary, as in zlib's examples/zran.c
+typedef struct {
+    int64_t out; // uncompressed offset
+    int64_t in; // compressed offset of the first byte which wasn't fully consumed
+    int bits; // number of bits of the preceding byte which belong to the next block
+    uint8_t prev_byte;
+    uint8_t window[ZIP_WINDOW_SIZE]; // last uncompressed bytes before the checkpoint
+} zip_checkpoint_t;
+
+// Seek index of one archive entry, shared by all open files of the entry
+typedef struct zip_index_s {
+    struct zip_index_s *next;
+    char *path;
+    int64_t mtime;
+    int64_t size;
+    zip_uint64_t entry;
+    zip_checkpoint_t **points;
+    int count;
+    int capacity;
+    int refcount;
+    uint64_t last_used;
+} zip_index_t;
+
+enum {
+    ZIP_READ_LIBZIP, // decompressed by libzip, backward seeks reopen the file
+    ZIP_READ_STORED, // uncompressed, seekable
+    ZIP_READ_DEFLATE, // inflated here from the raw data, using the seek index
+};
+
 typedef struct {
     DB_FILE file;
-    struct zip* z;
+    zip_archive_t *archive;
     struct zip_file *zf;
     int64_t offset;
     zip_uint64_t index;
     int64_t size;
+    int64_t comp_size;
+    int mode;
 
 #if ENABLE_CACHE
     uint8_t buffer[ZIP_BUFFER_SIZE];
     zip_int64_t buffer_remaining;
     int buffer_pos;
 #endif
+
+    // position of the next byte returned by the decoder
+    int64_t out_pos;
+
+    // ZIP_READ_DEFLATE state
+    zip_index_t *zindex;
+    z_stream strm;
+    int strm_initialized;
+    int stream_end;
+    int64_t in_pos; // compressed offset of the end of input passed to zlib
+    uint8_t prev_byte; // the last byte of the previous input chunk
+    uint8_t input[ZIP_INPUT_SIZE];
+    uint8_t history[ZIP_WINDOW_SIZE]; // circular, the oldest byte at history_pos
+    int history_pos;
 } ddb_zip_file_t;
 
+static uintptr_t _mutex; // protects the archive and index lists
+static zip_archive_t *_archives;
+static zip_index_t *_indexes;
+static int64_t _index_memory;
+static uint64_t _use_counter;
+
 static const char *scheme_names[] = { "zip://", NULL };
 
 const char **
@@ -68,6 +149,478 @@ vfs_zip_is_streaming (void) {
     return 0;
 }
 
+#pragma mark - Archive handles
+
+static void
+_archive_free (zip_archive_t *a) {
+    if (a->z) {
+        zip_close (a->z);
+    }
+    if (a->mutex) {
+        deadbeef->mutex_free (a->mutex);
+    }
+    free (a->path);
+    free (a);
+}
+
+static void
+_archive_unlink (zip_archive_t *a) {
+    zip_archive_t **pp = &_archives;
+    while (*pp && *pp != a) {
+        pp = &(*pp)->next;
+    }
+    if (*pp) {
+        *pp = a->next;
+    }
+    a->next = NULL;
+}
+
+// Closes the least recently used archives which are not in use
+static void
+_archives_trim (int max_idle) {
+    for (;;) {
+        int idle = 0;
+        zip_archive_t *oldest = NULL;
+        for (zip_archive_t *a = _archives; a; a = a->next) {
+            if (a->refcount == 0) {
+                idle++;
+                if (!oldest || a->last_used < oldest->last_used) {
+                    oldest = a;
+                }
+            }
+        }
+        if (idle <= max_idle) {
+            break;
+        }
+        _archive_unlink (oldest);
+        _archive_free (oldest);
+    }
+}
+
+// Must be called with _mutex locked.
+// Returns the referenced handle of the archive if it's already open and wasn't modified since, or NULL.
+static zip_archive_t *
+_archive_find (const char *path, const struct stat *st) {
+    zip_archive_t *a;
+    for (a = _archives; a; a = a->next) {
+        if (!strcmp (a->path, path)) {
+            break;
+        }
+    }
+    if (a && (a->mtime != (int64_t)st->st_mtime || a->size != (int64_t)st->st_size)) {
+        _archive_unlink (a);
+        if (a->refcount == 0) {
+            _archive_free (a);
+        }
+        else {
+            a->stale = 1;
+        }
+        a = NULL;
+    }
+    if (a) {
+        a->refcount++;
+        a->last_used = ++_use_counter;
+    }
+    return a;
+}
+
+// Returns the shared handle of the archive, opening it if necessary.
+// Opening the archive means parsing the whole central directory, so during directory import
+// the handle opened by scandir is reused for every file.
+static zip_archive_t *
+_archive_open (const char *path) {
+    struct stat st;
+    if (stat (path, &st) || !S_ISREG (st.st_mode)) {
+        return NULL;
+    }
+
+    deadbeef->mutex_lock (_mutex);
+    zip_archive_t *a = _archive_find (path, &st);
+    deadbeef->mutex_unlock (_mutex);
+    if (a) {
+        return a;
+    }
+
+    // parsing a large central directory takes a while, don't block the other archives meanwhile
+    struct zip *z = zip_open (path, 0, NULL);
+    if (!z) {
+        return NULL;
+    }
+
+    deadbeef->mutex_lock (_mutex);
+    a = _archive_find (path, &st);
+    if (a) {
+        // opened by another thread in the meantime
+        deadbeef->mutex_unlock (_mutex);
+        zip_close (z);
+        return a;
+    }
+    a = calloc (1, sizeof (zip_archive_t));
+    a->path = strdup (path);
+    a->mtime = (int64_t)st.st_mtime;
+    a->size = (int64_t)st.st_size;
+    a->z = z;
+    a->mutex = deadbeef->mutex_create ();
+    a->refcount = 1;
+    a->last_used = ++_use_counter;
+    a->next = _archives;
+    _archives = a;
+    deadbeef->mutex_unlock (_mutex);
+    return a;
+}
+
+static void
+_archive_release (zip_archive_t *a) {
+    deadbeef->mutex_lock (_mutex);
+    a->refcount--;
+    if (a->refcount == 0) {
+        if (a->stale) {
+            _archive_free (a);
+        }
+        else {
+            _archives_trim (ZIP_MAX_IDLE_ARCHIVES);
+        }
+    }
+    deadbeef->mutex_unlock (_mutex);
+}
+
+#pragma mark - Seek index
+
+static void
+_index_free (zip_index_t *index) {
+    for (int i = 0; i < index->count; i++) {
+        free (index->points[i]);
+    }
+    _index_memory -= index->count * (int64_t)sizeof (zip_checkpoint_t);
+    free (index->points);
+    free (index->path);
+    free (index);
+}
+
+static void
+_indexes_trim (void) {
+    while (_index_memory > ZIP_INDEX_MEMORY_LIMIT) {
+        zip_index_t **oldest = NULL;
+        for (zip_index_t **pp = &_indexes; *pp; pp = &(*pp)->next) {
+            if ((*pp)->refcount == 0 && (!oldest || (*pp)->last_used < (*oldest)->last_used)) {
+                oldest = pp;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        zip_index_t *index = *oldest;
+        *oldest = index->next;
+        _index_free (index);
+    }
+}
+
+static zip_index_t *
+_index_get (zip_archive_t *a, zip_uint64_t entry) {
+    deadbeef->mutex_lock (_mutex);
+    zip_index_t **pp = &_indexes;
+    while (*pp) {
+        zip_index_t *index = *pp;
+        if (!strcmp (index->path, a->path) && index->entry == entry) {
+            if (index->mtime == a->mtime && index->size == a->size) {
+                index->refcount++;
+                index->last_used = ++_use_counter;
+                deadbeef->mutex_unlock (_mutex);
+                return index;
+            }
+            if (index->refcount == 0) {
+                // the archive has changed
+                *pp = index->next;
+                _index_free (index);
+                continue;
+            }
+        }
+        pp = &index->next;
+    }
+
+    zip_index_t *index = calloc (1, sizeof (zip_index_t));
+    index->path = strdup (a->path);
+    index->mtime = a->mtime;
+    index->size = a->size;
+    index->entry = entry;
+    index->refcount = 1;
+    index->last_used = ++_use_counter;
+    index->next = _indexes;
+    _indexes = index;
+    deadbeef->mutex_unlock (_mutex);
+    return index;
+}
+
+static void
+_index_release (zip_index_t *index) {
+    deadbeef->mutex_lock (_mutex);
+    index->refcount--;
+    _indexes_trim ();
+    deadbeef->mutex_unlock (_mutex);
+}
+
+// Must be called with _mutex locked.
+// Returns the last checkpoint at or before the offset, or NULL.
+static zip_checkpoint_t *
+_index_find (zip_index_t *index, int64_t offset) {
+    int lo = 0;
+    int hi = index->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (index->points[mid]->out <= offset) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? index->points[lo-1] : NULL;
+}
+
+// Called at every deflate block boundary, adds a checkpoint once the decoder gets
+// far enough past the last one. Checkpoints are only ever appended.
+static void
+_index_add_point (ddb_zip_file_t *zf) {
+    zip_index_t *index = zf->zindex;
+    deadbeef->mutex_lock (_mutex);
+    int64_t last = index->count > 0 ? index->points[index->count-1]->out : 0;
+    if (zf->out_pos - last < ZIP_INDEX_SPAN) {
+        deadbeef->mutex_unlock (_mutex);
+        return;
+    }
+    if (index->count == index->capacity) {
+        int capacity = index->capacity ? index->capacity * 2 : 16;
+        zip_checkpoint_t **points = realloc (index->points, capacity * sizeof (zip_checkpoint_t *));
+        if (!points) {
+            deadbeef->mutex_unlock (_mutex);
+            return;
+        }
+        index->points = points;
+        index->capacity = capacity;
+    }
+    zip_checkpoint_t *point = malloc (sizeof (zip_checkpoint_t));
+    if (!point) {
+        deadbeef->mutex_unlock (_mutex);
+        return;
+    }
+    point->out = zf->out_pos;
+    point->in = zf->in_pos - zf->strm.avail_in;
+    point->bits = zf->strm.data_type & 7;
+    point->prev_byte = zf->strm.next_in > zf->input ? zf->strm.next_in[-1] : zf->prev_byte;
+    size_t tail = ZIP_WINDOW_SIZE - zf->history_pos;
+    memcpy (point->window, zf->history + zf->history_pos, tail);
+    memcpy (point->window + tail, zf->history, zf->history_pos);
+    index->points[index->count++] = point;
+    _index_memory += sizeof (zip_checkpoint_t);
+    trace ("vfs_zip: checkpoint %d at %lld (in %lld)\n", index->count, point->out, point->in);
+    deadbeef->mutex_unlock (_mutex);
+}
+
+#pragma mark - Decoding
+
+static void
+_history_append (ddb_zip_file_t *zf, const uint8_t *data, size_t size) {
+    if (size >= ZIP_WINDOW_SIZE) {
+        memcpy (zf->history, data + size - ZIP_WINDOW_SIZE, ZIP_WINDOW_SIZE);
+        zf->history_pos = 0;
+        return;
+    }
+    size_t part1 = min (size, ZIP_WINDOW_SIZE - zf->history_pos);
+    memcpy (zf->history + zf->history_pos, data, part1);
+    memcpy (zf->history, data + part1, size - part1);
+    zf->history_pos = (int)((zf->history_pos + size) % ZIP_WINDOW_SIZE);
+}
+
+static zip_int64_t
+_raw_read (ddb_zip_file_t *zf, void *buffer, size_t size) {
+    deadbeef->mutex_lock (zf->archive->mutex);
+    zip_int64_t rb = zip_fread (zf->zf, buffer, size);
+    deadbeef->mutex_unlock (zf->archive->mutex);
+    return rb;
+}
+
+static int
+_reopen (ddb_zip_file_t *zf) {
+    deadbeef->mutex_lock (zf->archive->mutex);
+    if (zf->zf) {
+        zip_fclose (zf->zf);
+    }
+    zf->zf = zip_fopen_index (zf->archive->z, zf->index, zf->mode == ZIP_READ_DEFLATE ? ZIP_FL_COMPRESSED : 0);
+    deadbeef->mutex_unlock (zf->archive->mutex);
+    return zf->zf ? 0 : -1;
+}
+
+// Positions the file at the offset in the data returned by zip_fread,
+// using zip_fseek when the file is seekable, otherwise reopening and skipping
+static int
+_raw_seek (ddb_zip_file_t *zf, int64_t offset, int64_t curr) {
+    deadbeef->mutex_lock (zf->archive->mutex);
+    int res = zip_fseek (zf->zf, offset, SEEK_SET);
+    deadbeef->mutex_unlock (zf->archive->mutex);
+    if (!res) {
+        return 0;
+    }
+
+    if (offset < curr) {
+        if (_reopen (zf)) {
+            return -1;
+        }
+        curr = 0;
+    }
+    char buf[4096];
+    while (curr < offset) {
+        zip_int64_t rb = _raw_read (zf, buf, min (offset - curr, sizeof (buf)));
+        if (rb <= 0) {
+            return -1;
+        }
+        curr += rb;
+    }
+    return 0;
+}
+
+// Resets the inflate state to the last checkpoint at or before the offset, or to the start of the stream
+static int
+_inflate_restart (ddb_zip_file_t *zf, int64_t offset) {
+    zip_checkpoint_t point = { 0 };
+    deadbeef->mutex_lock (_mutex);
+    zip_checkpoint_t *p = _index_find (zf->zindex, offset);
+    if (p) {
+        point.out = p->out;
+        point.in = p->in;
+        point.bits = p->bits;
+        point.prev_byte = p->prev_byte;
+        memcpy (zf->history, p->window, ZIP_WINDOW_SIZE);
+    }
+    deadbeef->mutex_unlock (_mutex);
+
+    trace ("vfs_zip: resume inflate at %lld (in %lld) for %lld\n", point.out, point.in, offset);
+
+    if (_raw_seek (zf, point.in, zf->in_pos)) {
+        return -1;
+    }
+    zf->in_pos = point.in;
+    zf->out_pos = point.out;
+    zf->history_pos = 0;
+    zf->stream_end = 0;
+
+    if (inflateReset (&zf->strm) != Z_OK) {
+        return -1;
+    }
+    zf->strm.avail_in = 0;
+    zf->strm.next_in = zf->input;
+    if (point.bits) {
+        inflatePrime (&zf->strm, point.bits, point.prev_byte >> (8 - point.bits));
+    }
+    if (point.out > 0) {
+        size_t dictsize = min (point.out, ZIP_WINDOW_SIZE);
+        inflateSetDictionary (&zf->strm, zf->history + ZIP_WINDOW_SIZE - dictsize, (uInt)dictsize);
+    }
+    return 0;
+}
+
+static zip_int64_t
+_inflate_read (ddb_zip_file_t *zf, uint8_t *buffer, size_t size) {
+    size_t produced = 0;
+    while (produced < size && !zf->stream_end) {
+        if (zf->strm.avail_in == 0) {
+            if (zf->strm.next_in > zf->input) {
+                zf->prev_byte = zf->strm.next_in[-1];
+            }
+            zip_int64_t rb = _raw_read (zf, zf->input, min (ZIP_INPUT_SIZE, zf->comp_size - zf->in_pos));
+            if (rb <= 0) {
+                break;
+            }
+            zf->strm.next_in = zf->input;
+            zf->strm.avail_in = (uInt)rb;
+            zf->in_pos += rb;
+        }
+
+        zf->strm.next_out = buffer + produced;
+        zf->strm.avail_out = (uInt)(size - produced);
+        int ret = inflate (&zf->strm, Z_BLOCK);
+        size_t n = size - produced - zf->strm.avail_out;
+        _history_append (zf, buffer + produced, n);
+        zf->out_pos += n;
+        produced += n;
+
+        if (ret == Z_STREAM_END) {
+            zf->stream_end = 1;
+            break;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            trace ("vfs_zip: inflate error %d\n", ret);
+            return produced > 0 ? (zip_int64_t)produced : -1;
+        }
+        if ((zf->strm.data_type & 128) && !(zf->strm.data_type & 64)) {
+            _index_add_point (zf);
+        }
+    }
+    return produced;
+}
+
+// Returns the next chunk of uncompressed data
+static zip_int64_t
+_decode (ddb_zip_file_t *zf, void *buffer, size_t size) {
+    zip_int64_t rb;
+    if (zf->mode == ZIP_READ_DEFLATE) {
+        rb = _inflate_read (zf, buffer, size);
+    }
+    else {
+        rb = _raw_read (zf, buffer, size);
+        if (rb > 0) {
+            zf->out_pos += rb;
+        }
+    }
+    return rb;
+}
+
+// Moves the decoder to the offset. Returns -1 if the offset is past the end of file.
+static int
+_decoder_seek (ddb_zip_file_t *zf, int64_t offset) {
+    if (zf->mode == ZIP_READ_DEFLATE) {
+        // resume from the nearest checkpoint, unless the target is just ahead
+        if (offset < zf->out_pos || offset - zf->out_pos > ZIP_INDEX_SPAN) {
+            deadbeef->mutex_lock (_mutex);
+            zip_checkpoint_t *p = _index_find (zf->zindex, offset);
+            int64_t point_out = p ? p->out : 0;
+            deadbeef->mutex_unlock (_mutex);
+            if (offset < zf->out_pos || point_out > zf->out_pos) {
+                if (_inflate_restart (zf, offset)) {
+                    return -1;
+                }
+            }
+        }
+    }
+    else if (zf->mode == ZIP_READ_STORED && offset <= zf->size) {
+        if (!_raw_seek (zf, offset, zf->out_pos)) {
+            zf->out_pos = offset;
+            return 0;
+        }
+        return -1;
+    }
+    else if (offset < zf->out_pos) {
+        if (_reopen (zf)) {
+            return -1;
+        }
+        zf->out_pos = 0;
+    }
+
+    // skip the remaining data; this also extends the seek index
+    char buf[4096];
+    while (zf->out_pos < offset) {
+        zip_int64_t rb = _decode (zf, buf, min (offset - zf->out_pos, sizeof (buf)));
+        if (rb <= 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#pragma mark -
+
+void
+vfs_zip_close (DB_FILE *f);
+
 // fname must have form of zip://full_filepath.zip:full_filepath_in_zip
 DB_FILE*
 vfs_zip_open (const char *fname) {
@@ -78,7 +631,7 @@ vfs_zip_open (const char *fname) {
 
     fname += 6;
 
-    struct zip *z = NULL;
+    zip_archive_t *a = NULL;
     struct zip_stat st;
 
     const char *colon = fname;
@@ -95,8 +648,8 @@ vfs_zip_open (const char *fname) {
 
         colon = colon+1;
 
-        z = zip_open (zipname, 0, NULL);
-        if (!z) {
+        a = _archive_open (zipname);
+        if (!a) {
             continue;
         }
         memset (&st, 0, sizeof (st));
@@ -104,32 +657,46 @@ vfs_zip_open (const char *fname) {
         while (*colon == '/') {
             colon++;
         }
-        int res = zip_stat(z, colon, 0, &st);
+        deadbeef->mutex_lock (a->mutex);
+        int res = zip_stat(a->z, colon, 0, &st);
+        deadbeef->mutex_unlock (a->mutex);
         if (res != 0) {
-            zip_close (z);
+            _archive_release (a);
             return NULL;
         }
 
         break;
     }
 
-    if (!z) {
-        return NULL;
-    }
-
-    struct zip_file *zf = zip_fopen_index (z, st.index, 0);
-    if (!zf) {
-        zip_close (z);
+    if (!a) {
         return NULL;
     }
 
     ddb_zip_file_t *f = malloc (sizeof (ddb_zip_file_t));
     memset (f, 0, sizeof (ddb_zip_file_t));
     f->file.vfs = &plugin;
-    f->z = z;
-    f->zf = zf;
+    f->archive = a;
     f->index = st.index;
     f->size = st.size;
+    f->comp_size = st.comp_size;
+    f->mode = ZIP_READ_LIBZIP;
+
+    int encrypted = (st.valid & ZIP_STAT_ENCRYPTION_METHOD) && st.encryption_method != ZIP_EM_NONE;
+    if ((st.valid & ZIP_STAT_COMP_METHOD) && (st.valid & ZIP_STAT_COMP_SIZE) && !encrypted) {
+        if (st.comp_method == ZIP_CM_STORE) {
+            f->mode = ZIP_READ_STORED;
+        }
+        else if (st.comp_method == ZIP_CM_DEFLATE && inflateInit2 (&f->strm, -15) == Z_OK) {
+            f->strm_initialized = 1;
+            f->mode = ZIP_READ_DEFLATE;
+            f->zindex = _index_get (a, st.index);
+        }
+    }
+
+    if (_reopen (f)) {
+        vfs_zip_close ((DB_FILE *)f);
+        return NULL;
+    }
     trace ("vfs_zip: end open %s\n", fname);
     return (DB_FILE*)f;
 }
@@ -139,10 +706,18 @@ vfs_zip_close (DB_FILE *f) {
     trace ("vfs_zip: close\n");
     ddb_zip_file_t *zf = (ddb_zip_file_t *)f;
     if (zf->zf) {
+        deadbeef->mutex_lock (zf->archive->mutex);
         zip_fclose (zf->zf);
+        deadbeef->mutex_unlock (zf->archive->mutex);
+    }
+    if (zf->strm_initialized) {
+        inflateEnd (&zf->strm);
     }
-    if (zf->z) {
-        zip_close (zf->z);
+    if (zf->zindex) {
+        _index_release (zf->zindex);
+    }
+    if (zf->archive) {
+        _archive_release (zf->archive);
     }
     free (zf);
 }
@@ -157,7 +732,7 @@ vfs_zip_read (void *ptr, size_t size, size_t nmemb, DB_FILE *f) {
     while (sz) {
         if (zf->buffer_remaining == 0) {
             zf->buffer_pos = 0;
-            zip_int64_t rb = zip_fread (zf->zf, zf->buffer, ZIP_BUFFER_SIZE);
+            zip_int64_t rb = _decode (zf, zf->buffer, ZIP_BUFFER_SIZE);
             if (rb <= 0) {
                 break;
             }
@@ -172,9 +747,15 @@ vfs_zip_read (void *ptr, size_t size, size_t nmemb, DB_FILE *f) {
         ptr += from_buf;
     }
 #else
-    rb = zip_fread (zf->zf, ptr, sz);
-    sz -= rb;
-    zf->offset += rb;
+    while (sz) {
+        zip_int64_t rb = _decode (zf, ptr, sz);
+        if (rb <= 0) {
+            break;
+        }
+        sz -= rb;
+        ptr += rb;
+        zf->offset += rb;
+    }
 #endif
 
     return (size * nmemb - sz) / size;
@@ -222,37 +803,15 @@ vfs_zip_seek (DB_FILE *f, int64_t offset, int whence) {
 //        printf ("cache miss: abs_offs: %lld, offs: %lld, rem: %d, pos: %d\n", offset, offs, zf->buffer_remaining, zf->buffer_pos);
 //    }
 
-    zf->offset += zf->buffer_remaining;
-#endif
-    if (offset < zf->offset) {
-        // reopen
-        zip_fclose (zf->zf);
-        zf->zf = zip_fopen_index (zf->z, zf->index, 0);
-        if (!zf->zf) {
-            return -1;
-        }
-        zf->offset = 0;
-    }
-#if ENABLE_CACHE
     zf->buffer_pos = 0;
     zf->buffer_remaining = 0;
 #endif
-    char buf[4096];
-    int64_t n = offset - zf->offset;
-    while (n > 0) {
-        int64_t sz = min (n, sizeof (buf));
-        ssize_t rb = zip_fread (zf->zf, buf, sz);
-        n -= rb;
-        assert (n >= 0);
-        zf->offset += rb;
-        if (rb != sz) {
-            break;
-        }
-    }
-    if (n > 0) {
+    if (offset < 0) {
         return -1;
     }
-    return 0;
+    int res = _decoder_seek (zf, offset);
+    zf->offset = zf->out_pos;
+    return res;
 }
 
 int64_t
@@ -264,13 +823,13 @@ vfs_zip_tell (DB_FILE *f) {
 void
 vfs_zip_rewind (DB_FILE *f) {
     ddb_zip_file_t *zf = (ddb_zip_file_t *)f;
-    zip_fclose (zf->zf);
-    zf->zf = zip_fopen_index (zf->z, zf->index, 0);
-    assert (zf->zf); // FIXME: better error handling?
-    zf->offset = 0;
 #if ENABLE_CACHE
+    zf->buffer_pos = 0;
     zf->buffer_remaining = 0;
 #endif
+    int res = _decoder_seek (zf, 0);
+    assert (!res); // FIXME: better error handling?
+    zf->offset = zf->out_pos;
 }
 
 int64_t
@@ -282,18 +841,18 @@ vfs_zip_getlength (DB_FILE *f) {
 int
 vfs_zip_scandir (const char *dir, struct dirent ***namelist, int (*selector) (const struct dirent *), int (*cmp) (const struct dirent **, const struct dirent **)) {
     trace ("vfs_zip_scandir: %s\n", dir);
-    int error;
-    struct zip *z = zip_open (dir, 0, &error);
-    if (!z) {
-        trace ("zip_open failed (code: %d)\n", error);
+    zip_archive_t *a = _archive_open (dir);
+    if (!a) {
+        trace ("zip_open failed\n");
         return -1;
     }
 
+    deadbeef->mutex_lock (a->mutex);
     int num_files = 0;
-    const int n = zip_get_num_files(z);
+    const int n = zip_get_num_files(a->z);
     *namelist = malloc(sizeof(void *) * n);
     for (int i = 0; i < n; i++) {
-        const char *nm = zip_get_name(z, i, 0);
+        const char *nm = zip_get_name(a->z, i, 0);
         struct dirent entry;
         strncpy(entry.d_name, nm, sizeof(entry.d_name)-1);
         entry.d_name[sizeof(entry.d_name)-1] = '\0';
@@ -304,8 +863,10 @@ vfs_zip_scandir (const char *dir, struct dirent ***namelist, int (*selector) (co
             trace("vfs_zip: %s\n", nm);
         }
     }
+    deadbeef->mutex_unlock (a->mutex);
 
-    zip_close (z);
+    // the handle stays open, to be reused when the files are added
+    _archive_release (a);
     trace ("vfs_zip: scandir done\n");
     return num_files;
 }
@@ -323,10 +884,33 @@ vfs_zip_get_scheme_for_name (const char *fname) {
     return scheme_names[0];
 }
 
+static int
+vfs_zip_start (void) {
+    _mutex = deadbeef->mutex_create ();
+    return 0;
+}
+
+static int
+vfs_zip_stop (void) {
+    if (_mutex) {
+        deadbeef->mutex_lock (_mutex);
+        _archives_trim (0);
+        while (_indexes) {
+            zip_index_t *index = _indexes;
+            _indexes = index->next;
+            _index_free (index);
+        }
+        deadbeef->mutex_unlock (_mutex);
+        deadbeef->mutex_free (_mutex);
+        _mutex = 0;
+    }
+    return 0;
+}
+
 static DB_vfs_t plugin = {
     DDB_PLUGIN_SET_API_VERSION
     .plugin.version_major = 1,
-    .plugin.version_minor = 0,
+    .plugin.version_minor = 1,
     .plugin.type = DB_PLUGIN_VFS,
     .plugin.id = "vfs_zip",
     .plugin.name = "ZIP vfs",
@@ -354,6 +938,8 @@ static DB_vfs_t plugin = {
         "3. This notice may not be removed or altered from any source distribution.\n"
     ,
     .plugin.website = "http://deadbeef.sf.net",
+    .plugin.start = vfs_zip_start,
+    .plugin.stop = vfs_zip_stop,
     .open = vfs_zip_open,
     .close = vfs_zip_close,
     .read = vfs_zip_read,
@@ -464,13 +464,14 @@ cvorbis_read (DB_fileinfo_t *_info, char *buffer, int bytes_to_read) {
     }
 
     /* Don't read past the end of a sub-track */
-    int samples_to_read = bytes_to_read / sizeof(float) / _info->fmt.channels;
+    const int sample_size = _info->fmt.bps / 8;
+    int samples_to_read = bytes_to_read / sample_size / _info->fmt.channels;
     int64_t endsample = deadbeef->pl_item_get_endsample (info->it);
     if (endsample > 0) {
         const ogg_int64_t samples_left = endsample - ov_pcm_tell(&info->vorbis_file);
         if (samples_left < samples_to_read) {
             samples_to_read = (int)samples_left;
-            bytes_to_read = samples_to_read * sizeof(float) * _info->fmt.channels;
+            bytes_to_read = samples_to_read * sample_size * _info->fmt.channels;
         }
     }
 
@@ -521,19 +522,17 @@ cvorbis_read (DB_fileinfo_t *_info, char *buffer, int bytes_to_read) {
             break;
         }
         else if (ret > 0) {
-            float *ptr = (float *)buffer + samples_read*_info->fmt.channels;
-            for (int channel = 0; channel < _info->fmt.channels; channel++, ptr++) {
-                const float *pcm_channel = pcm[info->channel_map ? info->channel_map[channel] : channel];
-                for (int sample = 0; sample < ret; sample++) {
-                    ptr[sample*_info->fmt.channels] = pcm_channel[sample];
-                }
+            const float *channels[_info->fmt.channels];
+            for (int channel = 0; channel < _info->fmt.channels; channel++) {
+                channels[channel] = pcm[info->channel_map ? info->channel_map[channel] : channel];
             }
+            deadbeef->pcm_interleave (&_info->fmt, (const void * const *)channels, 1, 0, (char *)((float *)buffer + samples_read*_info->fmt.channels), ret);
             samples_read += ret;
         }
 
 //        trace("cvorbis_read got %d samples towards %d bytes (%d samples still required)\n", ret, bytes_to_read, samples_to_read-samples_read);
     }
-    bytes_read = samples_read * sizeof(float) * _info->fmt.channels;
+    bytes_read = samples_read * sample_size * _info->fmt.channels;
 #endif
 
     int64_t startsample = deadbeef->pl_item_get_startsample (info->it);
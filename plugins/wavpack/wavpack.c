@@ -249,34 +249,13 @@ wv_read (DB_fileinfo_t *_info, char *bytes, int size) {
         int32_t buffer[size/(_info->fmt.bps / 8)];
         n = WavpackUnpackSamples (info->ctx, (int32_t *)buffer, size / samplesize);
         size -= n * samplesize;
-        n *= _info->fmt.channels;
-
-        // convert from int32 to input (what???)
-        int32_t *p = buffer;
-        if (_info->fmt.bps == 16) {
-            while (n > 0) {
-                *((int16_t *)bytes) = (int16_t)(*p);
-                bytes += sizeof (int16_t);
-                p++;
-                n--;
-            }
-        }
-        else if (_info->fmt.bps == 8) {
-            while (n > 0) {
-                *bytes++ = (char)(*p);
-                p++;
-                n--;
-            }
-        }
-        else if (_info->fmt.bps == 24) {
-            while (n > 0) {
-                *bytes++ = (*p)&0xff;
-                *bytes++ = ((*p)&0xff00)>>8;
-                *bytes++ = ((*p)&0xff0000)>>16;
-                p++;
-                n--;
-            }
+
+        // WavpackUnpackSamples returns interleaved int32 samples, pack them to bps
+        const int32_t *channels[_info->fmt.channels];
+        for (int c = 0; c < _info->fmt.channels; c++) {
+            channels[c] = buffer + c;
         }
+        deadbeef->pcm_interleave (&_info->fmt, (const void * const *)channels, _info->fmt.channels, 0, bytes, n);
     }
     _info->readpos = (float)(WavpackGetSampleIndex (info->ctx)-info->startsample)/WavpackGetSampleRate (info->ctx);
 
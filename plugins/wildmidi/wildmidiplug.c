@@ -30,6 +30,7 @@
 #include <deadbeef/deadbeef.h>
 #include <deadbeef/strdupa.h>
 #include "wildmidi_lib.h"
+#include "../../shared/lengthcache.h"
 #ifdef HAVE_CONFIG_H
 #include "../../config.h"
 #endif
@@ -40,6 +41,7 @@ static DB_decoder_t wmidi_plugin;
 #define trace(...) { deadbeef->log_detailed (&wmidi_plugin.plugin, 0, __VA_ARGS__); }
 
 static DB_functions_t *deadbeef;
+static lengthcache_t *lengthcache;
 
 #define min(x,y) ((x)<(y)?(x):(y))
 #define max(x,y) ((x)>(y)?(x):(y))
@@ -125,26 +127,33 @@ wmidi_seek (DB_fileinfo_t *_info, float time) {
 
 DB_playItem_t *
 wmidi_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
-    if (wmidi_init_conf () < 0) {
-        return NULL;
-    }
-
     DB_playItem_t *it = NULL;
 
-    midi *m = WildMidi_Open (fname);
-    if (!m) {
-        trace ("wmidi: failed to open %s\n", fname);
-        return NULL;
+    // the cached length saves loading the patches and parsing the file
+    float duration;
+    if (lengthcache_get (lengthcache, fname, 0, &duration)) {
+        if (wmidi_init_conf () < 0) {
+            return NULL;
+        }
+
+        midi *m = WildMidi_Open (fname);
+        if (!m) {
+            trace ("wmidi: failed to open %s\n", fname);
+            return NULL;
+        }
+
+        struct _WM_Info *inf = WildMidi_GetInfo (m);
+        duration = inf->approx_total_samples / 44100.f;
+        WildMidi_Close (m);
+        lengthcache_set (lengthcache, fname, 0, duration);
     }
 
-    struct _WM_Info *inf = WildMidi_GetInfo (m);
     it = deadbeef->pl_item_alloc_init (fname, wmidi_plugin.plugin.id);
     deadbeef->pl_add_meta (it, "title", NULL);
-    deadbeef->plt_set_item_duration (plt, it, inf->approx_total_samples / 44100.f);
+    deadbeef->plt_set_item_duration (plt, it, duration);
     deadbeef->pl_add_meta (it, ":FILETYPE", "MID");
     after = deadbeef->plt_insert_item (plt, after, it);
     deadbeef->pl_item_unref (it);
-    WildMidi_Close (m);
     return after;
 }
 
@@ -202,11 +211,14 @@ wmidi_init_conf (void) {
 
 int
 wmidi_start (void) {
+    lengthcache = lengthcache_alloc (deadbeef, "wildmidi", NULL, NULL);
     return 0;
 }
 
 int
 wmidi_stop (void) {
+    lengthcache_free (lengthcache);
+    lengthcache = NULL;
     if (WM_Initialized) {
         WildMidi_Shutdown ();
     }
@@ -359,7 +359,8 @@ project "dumb_plugin"
     "plugins/dumb/unrealfmt.cpp",
     "plugins/dumb/unrealfmtdata.cpp",
     "plugins/dumb/cdumb.c",
-    "plugins/dumb/dumb-kode54/src/helpers/resampler_sse2.c"
+    "plugins/dumb/dumb-kode54/src/helpers/resampler_sse2.c",
+    "shared/lengthcache.c"
   }
   includedirs {
     "plugins/dumb/dumb-kode54/include"
@@ -380,6 +381,7 @@ project "gme_plugin"
   files {
     "plugins/gme/cgme.c",
     "plugins/gme/gmewrap.cpp",
+    "shared/lengthcache.c",
     "plugins/gme/game-music-emu-0.6pre/gme/Ay_Apu.cpp",
     "plugins/gme/game-music-emu-0.6pre/gme/Ay_Core.cpp",
     "plugins/gme/game-music-emu-0.6pre/gme/Ay_Cpu.cpp",
@@ -1106,7 +1108,8 @@ project "wildmidi_plugin"
   targetname "wildmidi"
   files {
     "plugins/wildmidi/*.c",
-    "plugins/wildmidi/src/*.c"
+    "plugins/wildmidi/src/*.c",
+    "shared/lengthcache.c"
   }
   excludes {
     "plugins/wildmidi/src/wildmidi.c"
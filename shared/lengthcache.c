@@ -0,0 +1,498 @@
+//
+//  lengthcache.c
+//  DeaDBeeF
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lengthcache.h"
+
+// The file is little endian, with the fields written one by one, without padding:
+// magic, u32 version, and the records, which are appended as the songs get probed.
+// Each record is u32 path length, path, u64 file size, u64 file mtime, i32 subsong, and the float duration bits as u32.
+// The later records override the earlier ones.
+#define LENGTHCACHE_MAGIC "DDBL"
+#define LENGTHCACHE_VERSION 2
+#define LENGTHCACHE_HEADER_SIZE 8
+#define LENGTHCACHE_RECORD_SIZE 24 // the part of the record after the path
+#define LENGTHCACHE_HASH_SIZE 4096
+
+typedef struct lengthcache_entry_s {
+    struct lengthcache_entry_s *next;
+    char *fname;
+    int64_t size;
+    int64_t mtime;
+    int32_t subsong;
+    float duration;
+} lengthcache_entry_t;
+
+typedef struct lengthcache_job_s {
+    struct lengthcache_job_s *next;
+    DB_playItem_t *it;
+    char *fname;
+    int subsong;
+} lengthcache_job_t;
+
+struct lengthcache_s {
+    DB_functions_t *deadbeef;
+    char path[PATH_MAX];
+    lengthcache_probe_fn_t probe;
+    void *user_data;
+
+    uintptr_t mutex;
+    uintptr_t cond;
+    intptr_t tid;
+    int terminate;
+
+    // Serializes the file writes, which are done without holding the mutex.
+    // Must be locked after the mutex, when both are needed.
+    uintptr_t file_mutex;
+
+    int loaded;
+    int entry_count;
+    int record_count; // protected by file_mutex
+    lengthcache_entry_t *hash[LENGTHCACHE_HASH_SIZE];
+
+    lengthcache_job_t *jobs;
+    lengthcache_job_t *jobs_tail;
+};
+
+static inline void
+le_uint32 (uint32_t in, unsigned char *out) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (in >> (i * 8)) & 0xff;
+    }
+}
+
+static inline void
+le_uint64 (uint64_t in, unsigned char *out) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (in >> (i * 8)) & 0xff;
+    }
+}
+
+static inline uint32_t
+le_read_uint32 (const unsigned char *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static inline uint64_t
+le_read_uint64 (const unsigned char *in) {
+    return (uint64_t)le_read_uint32 (in) | ((uint64_t)le_read_uint32 (in + 4) << 32);
+}
+
+static uint32_t
+_hash (const char *fname, int subsong) {
+    uint32_t h = 5381;
+    for (const uint8_t *p = (const uint8_t *)fname; *p; p++) {
+        h = h * 33 + *p;
+    }
+    return (h + (uint32_t)subsong * 2654435761u) % LENGTHCACHE_HASH_SIZE;
+}
+
+static lengthcache_entry_t *
+_find_entry (lengthcache_t *cache, const char *fname, int subsong) {
+    for (lengthcache_entry_t *e = cache->hash[_hash (fname, subsong)]; e; e = e->next) {
+        if (e->subsong == subsong && !strcmp (e->fname, fname)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static lengthcache_entry_t *
+_set_entry (lengthcache_t *cache, const char *fname, int64_t size, int64_t mtime, int subsong, float duration) {
+    lengthcache_entry_t *e = _find_entry (cache, fname, subsong);
+    if (!e) {
+        e = calloc (1, sizeof (lengthcache_entry_t));
+        e->fname = strdup (fname);
+        e->subsong = subsong;
+        uint32_t h = _hash (fname, subsong);
+        e->next = cache->hash[h];
+        cache->hash[h] = e;
+        cache->entry_count++;
+    }
+    e->size = size;
+    e->mtime = mtime;
+    e->duration = duration;
+    return e;
+}
+
+static int
+_file_stat (const char *fname, int64_t *size, int64_t *mtime) {
+    if (strstr (fname, "://")) {
+        return -1;
+    }
+    struct stat st;
+    if (stat (fname, &st) || !S_ISREG (st.st_mode)) {
+        return -1;
+    }
+    *size = (int64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return 0;
+}
+
+static int
+_ensure_cache_dir (lengthcache_t *cache) {
+    const char *cache_root = cache->deadbeef->get_system_dir (DDB_SYS_DIR_CACHE);
+    char path[PATH_MAX];
+    if (mkdir (cache_root, 0755) && errno != EEXIST) {
+        return -1;
+    }
+    if (snprintf (path, sizeof (path), "%s/lengthcache", cache_root) >= (int)sizeof (path)) {
+        return -1;
+    }
+    if (mkdir (path, 0755) && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+_write_header (FILE *fp) {
+    unsigned char header[LENGTHCACHE_HEADER_SIZE];
+    memcpy (header, LENGTHCACHE_MAGIC, 4);
+    le_uint32 (LENGTHCACHE_VERSION, header + 4);
+    if (fwrite (header, 1, sizeof (header), fp) != sizeof (header)) {
+        return -1;
+    }
+    return 0;
+}
+
+// Returns the record for the entry, which the caller must free, and its size in *size
+static unsigned char *
+_encode_entry (const lengthcache_entry_t *e, size_t *size) {
+    uint32_t path_len = (uint32_t)strlen (e->fname);
+    *size = 4 + path_len + LENGTHCACHE_RECORD_SIZE;
+    unsigned char *record = malloc (*size);
+    if (!record) {
+        return NULL;
+    }
+    le_uint32 (path_len, record);
+    memcpy (record + 4, e->fname, path_len);
+    unsigned char *data = record + 4 + path_len;
+    uint32_t duration;
+    memcpy (&duration, &e->duration, sizeof (duration));
+    le_uint64 ((uint64_t)e->size, data);
+    le_uint64 ((uint64_t)e->mtime, data + 8);
+    le_uint32 ((uint32_t)e->subsong, data + 16);
+    le_uint32 (duration, data + 20);
+    return record;
+}
+
+static int
+_write_entry (FILE *fp, const lengthcache_entry_t *e) {
+    size_t size;
+    unsigned char *record = _encode_entry (e, &size);
+    if (!record) {
+        return -1;
+    }
+    int err = fwrite (record, 1, size, fp) != size ? -1 : 0;
+    free (record);
+    return err;
+}
+
+// Writes the live entries to a new file, dropping the superseded records
+static void
+_compact (lengthcache_t *cache) {
+    char temp_path[PATH_MAX];
+    if (snprintf (temp_path, sizeof (temp_path), "%s.part", cache->path) >= (int)sizeof (temp_path)) {
+        return;
+    }
+    FILE *fp = fopen (temp_path, "w+b");
+    if (!fp) {
+        return;
+    }
+    int err = _write_header (fp);
+    for (int i = 0; i < LENGTHCACHE_HASH_SIZE && !err; i++) {
+        for (lengthcache_entry_t *e = cache->hash[i]; e && !err; e = e->next) {
+            err = _write_entry (fp, e);
+        }
+    }
+    if (fclose (fp)) {
+        err = -1;
+    }
+    if (err || rename (temp_path, cache->path)) {
+        (void)unlink (temp_path);
+        return;
+    }
+    cache->record_count = cache->entry_count;
+}
+
+// Must be called with the mutex locked
+static void
+_load (lengthcache_t *cache) {
+    if (cache->loaded) {
+        return;
+    }
+    cache->loaded = 1;
+
+    cache->deadbeef->mutex_lock (cache->file_mutex);
+    FILE *fp = fopen (cache->path, "rb");
+    if (!fp) {
+        cache->deadbeef->mutex_unlock (cache->file_mutex);
+        return;
+    }
+
+    unsigned char header[LENGTHCACHE_HEADER_SIZE];
+    if (fread (header, 1, sizeof (header), fp) != sizeof (header)
+        || memcmp (header, LENGTHCACHE_MAGIC, 4)
+        || le_read_uint32 (header + 4) != LENGTHCACHE_VERSION) {
+        fclose (fp);
+        cache->deadbeef->mutex_unlock (cache->file_mutex);
+        return;
+    }
+
+    char fname[PATH_MAX];
+    for (;;) {
+        unsigned char data[LENGTHCACHE_RECORD_SIZE];
+        if (fread (data, 1, 4, fp) != 4) {
+            break; // eof
+        }
+        uint32_t path_len = le_read_uint32 (data);
+        if (path_len == 0 || path_len >= sizeof (fname)
+            || fread (fname, 1, path_len, fp) != path_len
+            || fread (data, 1, sizeof (data), fp) != sizeof (data)) {
+            break; // a truncated or damaged record
+        }
+        fname[path_len] = 0;
+        uint32_t duration_bits = le_read_uint32 (data + 20);
+        float duration;
+        memcpy (&duration, &duration_bits, sizeof (duration));
+        _set_entry (cache, fname, (int64_t)le_read_uint64 (data), (int64_t)le_read_uint64 (data + 8), (int32_t)le_read_uint32 (data + 16), duration);
+        cache->record_count++;
+    }
+    fclose (fp);
+
+    if (cache->record_count > cache->entry_count * 2 + 100) {
+        _compact (cache);
+    }
+    cache->deadbeef->mutex_unlock (cache->file_mutex);
+}
+
+// Appends a record made by _encode_entry, and frees it.
+// Called without holding the mutex, so that the lookups don't wait for the disk.
+static void
+_append (lengthcache_t *cache, unsigned char *record, size_t size) {
+    if (!record) {
+        return;
+    }
+    cache->deadbeef->mutex_lock (cache->file_mutex);
+    FILE *fp = _ensure_cache_dir (cache) ? NULL : fopen (cache->path, "ab");
+    if (fp) {
+        int err = 0;
+        if (ftell (fp) == 0) {
+            err = _write_header (fp);
+        }
+        if (!err && fwrite (record, 1, size, fp) != size) {
+            err = -1;
+        }
+        if (fclose (fp)) {
+            err = -1;
+        }
+        if (!err) {
+            cache->record_count++;
+        }
+    }
+    cache->deadbeef->mutex_unlock (cache->file_mutex);
+    free (record);
+}
+
+static void
+_update_item_duration (lengthcache_t *cache, DB_playItem_t *it, float duration) {
+    DB_functions_t *deadbeef = cache->deadbeef;
+    ddb_playlist_t *plt = deadbeef->pl_get_playlist (it);
+    deadbeef->plt_set_item_duration (plt, it, duration);
+    if (plt) {
+        deadbeef->plt_modified (plt);
+        deadbeef->plt_unref (plt);
+        deadbeef->sendmessage (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+    }
+}
+
+static void
+_free_job (lengthcache_t *cache, lengthcache_job_t *job) {
+    cache->deadbeef->pl_item_unref (job->it);
+    free (job->fname);
+    free (job);
+}
+
+static void
+_worker (void *ctx) {
+    lengthcache_t *cache = ctx;
+    DB_functions_t *deadbeef = cache->deadbeef;
+
+    for (;;) {
+        deadbeef->mutex_lock (cache->mutex);
+        while (!cache->jobs && !cache->terminate) {
+            deadbeef->cond_wait (cache->cond, cache->mutex);
+        }
+        if (cache->terminate) {
+            deadbeef->mutex_unlock (cache->mutex);
+            break;
+        }
+        lengthcache_job_t *job = cache->jobs;
+        cache->jobs = job->next;
+        if (!cache->jobs) {
+            cache->jobs_tail = NULL;
+        }
+
+        // the same file may have been queued more than once
+        int64_t size, mtime;
+        int have_stat = !_file_stat (job->fname, &size, &mtime);
+        lengthcache_entry_t *e = have_stat ? _find_entry (cache, job->fname, job->subsong) : NULL;
+        float duration = -1;
+        int done = !have_stat;
+        if (e && e->size == size && e->mtime == mtime) {
+            duration = e->duration;
+            done = 1;
+        }
+        deadbeef->mutex_unlock (cache->mutex);
+
+        if (!done) {
+            duration = cache->probe (job->fname, job->subsong, &cache->terminate, cache->user_data);
+
+            deadbeef->mutex_lock (cache->mutex);
+            if (cache->terminate) {
+                // the probe was interrupted, the result is not valid
+                deadbeef->mutex_unlock (cache->mutex);
+                _free_job (cache, job);
+                break;
+            }
+            e = _set_entry (cache, job->fname, size, mtime, job->subsong, duration);
+            size_t record_size;
+            unsigned char *record = _encode_entry (e, &record_size);
+            deadbeef->mutex_unlock (cache->mutex);
+            _append (cache, record, record_size);
+        }
+
+        if (duration > 0) {
+            _update_item_duration (cache, job->it, duration);
+        }
+        _free_job (cache, job);
+    }
+}
+
+lengthcache_t *
+lengthcache_alloc (DB_functions_t *api, const char *name, lengthcache_probe_fn_t probe, void *user_data) {
+    lengthcache_t *cache = calloc (1, sizeof (lengthcache_t));
+    cache->deadbeef = api;
+    snprintf (cache->path, sizeof (cache->path), "%s/lengthcache/%s", api->get_system_dir (DDB_SYS_DIR_CACHE), name);
+    cache->probe = probe;
+    cache->user_data = user_data;
+    cache->mutex = api->mutex_create_nonrecursive ();
+    cache->cond = api->cond_create ();
+    cache->file_mutex = api->mutex_create_nonrecursive ();
+    return cache;
+}
+
+void
+lengthcache_free (lengthcache_t *cache) {
+    if (!cache) {
+        return;
+    }
+    DB_functions_t *deadbeef = cache->deadbeef;
+    if (cache->tid) {
+        deadbeef->mutex_lock (cache->mutex);
+        __atomic_store_n (&cache->terminate, 1, __ATOMIC_RELAXED);
+        deadbeef->cond_signal (cache->cond);
+        deadbeef->mutex_unlock (cache->mutex);
+        deadbeef->thread_join (cache->tid);
+    }
+
+    while (cache->jobs) {
+        lengthcache_job_t *next = cache->jobs->next;
+        _free_job (cache, cache->jobs);
+        cache->jobs = next;
+    }
+
+    for (int i = 0; i < LENGTHCACHE_HASH_SIZE; i++) {
+        while (cache->hash[i]) {
+            lengthcache_entry_t *next = cache->hash[i]->next;
+            free (cache->hash[i]->fname);
+            free (cache->hash[i]);
+            cache->hash[i] = next;
+        }
+    }
+
+    deadbeef->cond_free (cache->cond);
+    deadbeef->mutex_free (cache->mutex);
+    deadbeef->mutex_free (cache->file_mutex);
+    free (cache);
+}
+
+int
+lengthcache_get (lengthcache_t *cache, const char *fname, int subsong, float *duration) {
+    int64_t size, mtime;
+    if (_file_stat (fname, &size, &mtime)) {
+        return -1;
+    }
+
+    int res = -1;
+    cache->deadbeef->mutex_lock (cache->mutex);
+    _load (cache);
+    lengthcache_entry_t *e = _find_entry (cache, fname, subsong);
+    if (e && e->size == size && e->mtime == mtime) {
+        *duration = e->duration;
+        res = 0;
+    }
+    cache->deadbeef->mutex_unlock (cache->mutex);
+    return res;
+}
+
+void
+lengthcache_set (lengthcache_t *cache, const char *fname, int subsong, float duration) {
+    int64_t size, mtime;
+    if (_file_stat (fname, &size, &mtime)) {
+        return;
+    }
+
+    unsigned char *record = NULL;
+    size_t record_size = 0;
+    cache->deadbeef->mutex_lock (cache->mutex);
+    _load (cache);
+    lengthcache_entry_t *e = _find_entry (cache, fname, subsong);
+    if (!e || e->size != size || e->mtime != mtime || e->duration != duration) {
+        e = _set_entry (cache, fname, size, mtime, subsong, duration);
+        record = _encode_entry (e, &record_size);
+    }
+    cache->deadbeef->mutex_unlock (cache->mutex);
+    _append (cache, record, record_size);
+}
+
+void
+lengthcache_probe (lengthcache_t *cache, DB_playItem_t *it, const char *fname, int subsong) {
+    if (strstr (fname, "://")) {
+        return;
+    }
+    DB_functions_t *deadbeef = cache->deadbeef;
+
+    lengthcache_job_t *job = calloc (1, sizeof (lengthcache_job_t));
+    deadbeef->pl_item_ref (it);
+    job->it = it;
+    job->fname = strdup (fname);
+    job->subsong = subsong;
+
+    deadbeef->mutex_lock (cache->mutex);
+    _load (cache);
+    if (cache->jobs_tail) {
+        cache->jobs_tail->next = job;
+    }
+    else {
+        cache->jobs = job;
+    }
+    cache->jobs_tail = job;
+    if (!cache->tid) {
+        cache->tid = deadbeef->thread_start (_worker, cache);
+    }
+    deadbeef->cond_signal (cache->cond);
+    deadbeef->mutex_unlock (cache->mutex);
+}
@@ -0,0 +1,60 @@
+//
+//  lengthcache.h
+//  DeaDBeeF
+//
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+// Persistent cache of the probed subsong durations, for the decoders which can't get
+// an accurate duration without rendering the song (chiptunes, modules, etc).
+//
+// The entries are keyed by the file path, size, mtime and subsong index,
+// and are stored in $CACHE/lengthcache/<name>.
+//
+// The probing is done by a worker thread, which calls the plugin's probe function,
+// stores the result, and updates the duration of the waiting playlist items.
+
+#ifndef lengthcache_h
+#define lengthcache_h
+
+#include <deadbeef/deadbeef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lengthcache_s lengthcache_t;
+
+/// Called on the worker thread. Should render the subsong as fast as possible, without output.
+/// Returns the duration in seconds, or a negative value if the end of the song wasn't found.
+/// Should return a negative value as soon as possible after *terminate becomes non-zero,
+/// which should be read using __atomic_load_n.
+typedef float (*lengthcache_probe_fn_t) (const char *fname, int subsong, const int *terminate, void *user_data);
+
+/// The probe function can be NULL, if the plugin only uses lengthcache_get and lengthcache_set.
+lengthcache_t *
+lengthcache_alloc (DB_functions_t *api, const char *name, lengthcache_probe_fn_t probe, void *user_data);
+
+/// Interrupts the current probe, stops the worker thread, and drops the pending jobs.
+void
+lengthcache_free (lengthcache_t *cache);
+
+/// Returns 0 if the subsong was probed since the file was last modified.
+/// The duration is negative if the probe didn't find the end of the song.
+int
+lengthcache_get (lengthcache_t *cache, const char *fname, int subsong, float *duration);
+
+/// Stores a duration which the plugin got without probing.
+void
+lengthcache_set (lengthcache_t *cache, const char *fname, int subsong, float duration);
+
+/// Queues the subsong for probing, and sets the duration of the item when done.
+/// Only the local files are probed.
+void
+lengthcache_probe (lengthcache_t *cache, DB_playItem_t *it, const char *fname, int subsong);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* lengthcache_h */
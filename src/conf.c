@@ -35,19 +35,66 @@
 #include <unistd.h>
 #include <limits.h>
 #include <sys/stat.h>
+#include <dispatch/dispatch.h>
 #include "buffered_file_writer.h"
 #include "conf.h"
 #include "threading.h"
 #include <deadbeef/common.h>
 
+// The items are kept in a list sorted by key, which is exposed via conf_find,
+// and indexed by a hash table of case-folded keys.
+typedef struct conf_item_s {
+    DB_conf_item_t item; // must be the first member
+    struct conf_item_s *prev;
+    struct conf_item_s *hash_next;
+    uint32_t hash;
+
+    // parsed values, cached on first access, and reset when the value changes
+    unsigned has_int : 1;
+    unsigned has_int64 : 1;
+    unsigned has_float : 1;
+    int int_value;
+    int64_t int64_value;
+    float float_value;
+} conf_item_t;
+
+typedef struct conf_listener_s {
+    struct conf_listener_s *next;
+    intptr_t id;
+    char *prefix;
+    size_t prefix_len;
+    void (*callback) (const char *key, void *user_data);
+    void *user_data;
+} conf_listener_t;
+
+#define CONF_HASH_MIN_SIZE 256
+
+// delay between the first change and the save, with conf_save_deferred
+#define CONF_SAVE_DELAY_MS 1000
+
 static DB_conf_item_t *conf_items;
-static int changed;
+static conf_item_t *conf_items_tail;
+static conf_item_t **conf_hash;
+static size_t conf_hash_size;
+static size_t conf_count;
+static int changed_config;
+static int changed_secrets;
 static uintptr_t mutex;
 static int disable_saving;
+static int loading;
+
+static conf_listener_t *listeners;
+static intptr_t listener_id;
+
+// serializes change notifications and deferred saves
+static dispatch_queue_t conf_queue;
+static dispatch_source_t save_timer; // the pending deferred save, canceled by conf_free
+static __thread int in_notification;
 
 void
 conf_init (void) {
     mutex = mutex_create ();
+    conf_queue = dispatch_queue_create ("ConfQueue", NULL);
 }
 
 void
@@ -60,8 +107,254 @@ conf_unlock (void) {
     mutex_unlock (mutex);
 }
 
+static int
+_is_secret (const char *key) {
+    return strstr (key, ".secret.") != NULL;
+}
+
+static void
+_mark_changed (const char *key) {
+    if (_is_secret (key)) {
+        changed_secrets = 1;
+    }
+    else {
+        changed_config = 1;
+    }
+}
+
+#pragma mark - Hash index
+
+static uint32_t
+_conf_hash (const char *key) {
+    // FNV-1a over ASCII-lowercase bytes, to match strcasecmp
+    uint32_t h = 2166136261u;
+    for (const uint8_t *p = (const uint8_t *)key; *p; p++) {
+        uint8_t c = *p;
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void
+_hash_resize (size_t size) {
+    conf_item_t **hash = calloc (size, sizeof (conf_item_t *));
+    for (conf_item_t *it = (conf_item_t *)conf_items; it; it = (conf_item_t *)it->item.next) {
+        size_t idx = it->hash & (size - 1);
+        it->hash_next = hash[idx];
+        hash[idx] = it;
+    }
+    free (conf_hash);
+    conf_hash = hash;
+    conf_hash_size = size;
+}
+
+static conf_item_t *
+_hash_find (const char *key, uint32_t hash) {
+    if (!conf_hash) {
+        return NULL;
+    }
+    for (conf_item_t *it = conf_hash[hash & (conf_hash_size - 1)]; it; it = it->hash_next) {
+        if (it->hash == hash && !strcasecmp (key, it->item.key)) {
+            return it;
+        }
+    }
+    return NULL;
+}
+
+static void
+_hash_remove (conf_item_t *item) {
+    conf_item_t **pp = &conf_hash[item->hash & (conf_hash_size - 1)];
+    while (*pp && *pp != item) {
+        pp = &(*pp)->hash_next;
+    }
+    if (*pp) {
+        *pp = item->hash_next;
+    }
+}
+
+static void
+_item_unlink (conf_item_t *item) {
+    conf_item_t *next = (conf_item_t *)item->item.next;
+    if (item->prev) {
+        item->prev->item.next = item->item.next;
+    }
+    else {
+        conf_items = item->item.next;
+    }
+    if (next) {
+        next->prev = item->prev;
+    }
+    else {
+        conf_items_tail = item->prev;
+    }
+    _hash_remove (item);
+    conf_count--;
+}
+
+static void
+_item_insert (conf_item_t *item) {
+    // find the item to insert after, to keep the list sorted;
+    // the config file is sorted, so during loading the new items usually go to the end
+    conf_item_t *prev = NULL;
+    if (conf_items_tail && strcasecmp (item->item.key, conf_items_tail->item.key) > 0) {
+        prev = conf_items_tail;
+    }
+    else {
+        for (conf_item_t *it = (conf_item_t *)conf_items; it; it = (conf_item_t *)it->item.next) {
+            if (strcasecmp (item->item.key, it->item.key) < 0) {
+                break;
+            }
+            prev = it;
+        }
+    }
+
+    item->prev = prev;
+    if (prev) {
+        item->item.next = prev->item.next;
+        prev->item.next = &item->item;
+    }
+    else {
+        item->item.next = conf_items;
+        conf_items = &item->item;
+    }
+    if (item->item.next) {
+        ((conf_item_t *)item->item.next)->prev = item;
+    }
+    else {
+        conf_items_tail = item;
+    }
+
+    conf_count++;
+    if (conf_count > conf_hash_size) {
+        _hash_resize (conf_hash_size ? conf_hash_size * 2 : CONF_HASH_MIN_SIZE);
+    }
+    else {
+        size_t idx = item->hash & (conf_hash_size - 1);
+        item->hash_next = conf_hash[idx];
+        conf_hash[idx] = item;
+    }
+}
+
+#pragma mark - Change notifications
+
+static void
+_notify_callbacks (const char *key) {
+    typedef struct {
+        void (*callback) (const char *key, void *user_data);
+        void *user_data;
+    } callback_t;
+    callback_t *callbacks = NULL;
+    int count = 0;
+
+    conf_lock ();
+    for (conf_listener_t *l = listeners; l; l = l->next) {
+        if (!strncasecmp (l->prefix, key, l->prefix_len)) {
+            callbacks = realloc (callbacks, (count + 1) * sizeof (callback_t));
+            callbacks[count].callback = l->callback;
+            callbacks[count].user_data = l->user_data;
+            count++;
+        }
+    }
+    conf_unlock ();
+
+    in_notification = 1;
+    for (int i = 0; i < count; i++) {
+        callbacks[i].callback (key, callbacks[i].user_data);
+    }
+    in_notification = 0;
+    free (callbacks);
+}
+
+// Must be called with the lock held
+static void
+_notify_change (const char *key) {
+    if (loading) {
+        return;
+    }
+    conf_listener_t *l;
+    for (l = listeners; l; l = l->next) {
+        if (!strncasecmp (l->prefix, key, l->prefix_len)) {
+            break;
+        }
+    }
+    if (!l) {
+        return;
+    }
+    char *key_copy = strdup (key);
+    dispatch_async (conf_queue, ^{
+        _notify_callbacks (key_copy);
+        free (key_copy);
+    });
+}
+
+intptr_t
+conf_subscribe (const char *prefix, void (*callback) (const char *key, void *user_data), void *user_data) {
+    conf_listener_t *l = calloc (1, sizeof (conf_listener_t));
+    l->prefix = strdup (prefix);
+    l->prefix_len = strlen (prefix);
+    l->callback = callback;
+    l->user_data = user_data;
+    conf_lock ();
+    l->id = ++listener_id;
+    l->next = listeners;
+    listeners = l;
+    conf_unlock ();
+    return l->id;
+}
+
+void
+conf_unsubscribe (intptr_t subscription) {
+    conf_lock ();
+    conf_listener_t *prev = NULL;
+    conf_listener_t *l;
+    for (l = listeners; l; prev = l, l = l->next) {
+        if (l->id == subscription) {
+            if (prev) {
+                prev->next = l->next;
+            }
+            else {
+                listeners = l->next;
+            }
+            break;
+        }
+    }
+    conf_unlock ();
+    if (!l) {
+        return;
+    }
+
+    // wait for the notifications which are being delivered,
+    // unless called from a callback
+    if (!in_notification) {
+        dispatch_sync (conf_queue, ^{});
+    }
+    free (l->prefix);
+    free (l);
+}
+
+#pragma mark -
+
 void
 conf_free (void) {
+    // cancel the deferred save, and write the pending changes now
+    mutex_lock (mutex);
+    dispatch_source_t timer = save_timer;
+    save_timer = NULL;
+    if (timer) {
+        dispatch_source_cancel (timer);
+        dispatch_release (timer);
+    }
+    mutex_unlock (mutex);
+    if (timer) {
+        conf_save ();
+    }
+    // wait for the pending notifications, and for the timer handler if it has already started
+    dispatch_sync (conf_queue, ^{});
+
     mutex_lock (mutex);
     DB_conf_item_t *next = NULL;
     for (DB_conf_item_t *it = conf_items; it; it = next) {
@@ -69,10 +362,24 @@ conf_free (void) {
         conf_item_free (it);
     }
     conf_items = NULL;
-    changed = 0;
+    conf_items_tail = NULL;
+    free (conf_hash);
+    conf_hash = NULL;
+    conf_hash_size = 0;
+    conf_count = 0;
+    changed_config = 0;
+    changed_secrets = 0;
+    while (listeners) {
+        conf_listener_t *l = listeners;
+        listeners = l->next;
+        free (l->prefix);
+        free (l);
+    }
     mutex_unlock (mutex);
     mutex_free (mutex);
     mutex = 0;
+    dispatch_release (conf_queue);
+    conf_queue = NULL;
 }
 
 static void
@@ -149,9 +456,11 @@ _conf_load_file(const char *fname) {
     fp = NULL;
 
     conf_lock ();
+    loading = 1;
 
     _conf_load_buffer(buffer);
 
+    loading = 0;
     conf_unlock ();
 
     free (buffer);
@@ -169,7 +478,8 @@ conf_load (void) {
     int config_res = _conf_load_file(config);
     int secrets_res = _conf_load_file(secrets);
 
-    changed = 0;
+    changed_config = 0;
+    changed_secrets = 0;
 
     if (0 != config_res || 0 != secrets_res) {
         return -1;
@@ -196,7 +506,9 @@ _conf_save_with_secrets(int secrets) {
 
     conf_lock ();
 
-    if (!changed) {
+    // only the files which have changed are written
+    int *changed = secrets ? &changed_secrets : &changed_config;
+    if (!*changed) {
         conf_unlock ();
         return 0;
     }
@@ -211,7 +523,7 @@ _conf_save_with_secrets(int secrets) {
     writer = buffered_file_writer_new (fp, 64 * 1024);
 
     for (DB_conf_item_t *it = conf_items; it; it = it->next) {
-        int is_secret = (strstr (it->key, ".secret.") != NULL);
+        int is_secret = _is_secret (it->key);
 
         if (secrets != is_secret) {
             continue;
@@ -246,6 +558,7 @@ _conf_save_with_secrets(int secrets) {
     else {
         chmod (str, 0600);
     }
+    *changed = 0;
     conf_unlock ();
     return 0;
 error:
@@ -274,8 +587,6 @@ conf_save (void) {
     int res = _conf_save_with_secrets(0);
     int res_secrets = _conf_save_with_secrets(1);
 
-    changed = 0;
-
     if (0 != res || 0 != res_secrets) {
         return -1;
     }
@@ -283,6 +594,45 @@ conf_save (void) {
     return 0;
 }
 
+int
+conf_save_deferred (void) {
+    if (disable_saving || !mutex) {
+        return 0;
+    }
+
+    conf_lock ();
+    if (save_timer || (!changed_config && !changed_secrets)) {
+        conf_unlock ();
+        return 0;
+    }
+
+    // the changes made during the delay are saved together
+    dispatch_source_t timer = dispatch_source_create (DISPATCH_SOURCE_TYPE_TIMER, 0, 0, conf_queue);
+    if (!timer) {
+        conf_unlock ();
+        return conf_save ();
+    }
+    dispatch_source_set_timer (timer, dispatch_time (DISPATCH_TIME_NOW, CONF_SAVE_DELAY_MS * NSEC_PER_MSEC), DISPATCH_TIME_FOREVER, 0);
+    dispatch_source_set_event_handler (timer, ^{
+        conf_lock ();
+        if (save_timer != timer) {
+            // canceled by conf_free, which has already saved
+            conf_unlock ();
+            return;
+        }
+        save_timer = NULL;
+        dispatch_source_cancel (timer);
+        dispatch_release (timer);
+        conf_unlock ();
+        conf_save ();
+    });
+    save_timer = timer;
+    // resumed under the lock, so that conf_free can't release the timer first
+    dispatch_resume (timer);
+    conf_unlock ();
+    return 0;
+}
+
 void
 conf_item_free (DB_conf_item_t *it) {
     conf_lock ();
@@ -298,14 +648,15 @@ conf_item_free (DB_conf_item_t *it) {
     conf_unlock ();
 }
 
+static conf_item_t *
+_conf_find_item (const char *key) {
+    return _hash_find (key, _conf_hash (key));
+}
+
 const char *
 conf_get_str_fast (const char *key, const char *def) {
-    for (DB_conf_item_t *it = conf_items; it; it = it->next) {
-        if (!strcasecmp (key, it->key)) {
-            return it->value;
-        }
-    }
-    return def;
+    conf_item_t *item = _conf_find_item (key);
+    return item ? item->item.value : def;
 }
 
 void
@@ -327,8 +678,15 @@ conf_get_str (const char *key, const char *def, char *buffer, int buffer_size) {
 float
 conf_get_float (const char *key, float def) {
     conf_lock ();
-    const char *v = conf_get_str_fast (key, NULL);
-    float res = v ? (float)atof (v) : def;
+    conf_item_t *item = _conf_find_item (key);
+    float res = def;
+    if (item) {
+        if (!item->has_float) {
+            item->float_value = (float)atof (item->item.value);
+            item->has_float = 1;
+        }
+        res = item->float_value;
+    }
     conf_unlock ();
     return res;
 }
@@ -336,8 +694,15 @@ conf_get_float (const char *key, float def) {
 int
 conf_get_int (const char *key, int def) {
     conf_lock ();
-    const char *v = conf_get_str_fast (key, NULL);
-    int res = v ? atoi (v) : def;
+    conf_item_t *item = _conf_find_item (key);
+    int res = def;
+    if (item) {
+        if (!item->has_int) {
+            item->int_value = atoi (item->item.value);
+            item->has_int = 1;
+        }
+        res = item->int_value;
+    }
     conf_unlock ();
     return res;
 }
@@ -345,8 +710,15 @@ conf_get_int (const char *key, int def) {
 int64_t
 conf_get_int64 (const char *key, int64_t def) {
     conf_lock ();
-    const char *v = conf_get_str_fast (key, NULL);
-    int64_t res = v ? atoll (v) : def;
+    conf_item_t *item = _conf_find_item (key);
+    int64_t res = def;
+    if (item) {
+        if (!item->has_int64) {
+            item->int64_value = atoll (item->item.value);
+            item->has_int64 = 1;
+        }
+        res = item->int64_value;
+    }
     conf_unlock ();
     return res;
 }
@@ -365,55 +737,41 @@ conf_find (const char *group, DB_conf_item_t *prev) {
 void
 conf_set_str (const char *key, const char *val) {
     conf_lock ();
-    DB_conf_item_t *prev = NULL;
-    for (DB_conf_item_t *it = conf_items; it; it = it->next) {
-        int cmp = strcasecmp (key, it->key);
-        if (!cmp) {
-            if (val == NULL) {
-                if (prev != NULL) {
-                    prev->next = it->next;
-                }
-                else {
-                    conf_items = it->next;
-                }
-                conf_item_free (it);
-                conf_unlock ();
-                return;
-            }
-
-            if (!strcmp (it->value, val)) {
-                conf_unlock ();
-                return;
-            }
-            free (it->value);
-            it->value = strdup (val);
+    uint32_t hash = _conf_hash (key);
+    conf_item_t *item = _hash_find (key, hash);
+    if (item) {
+        if (val == NULL) {
+            _item_unlink (item);
+            _mark_changed (key);
+            _notify_change (key);
+            conf_item_free (&item->item);
             conf_unlock ();
-            changed = 1;
             return;
         }
-        else if (cmp < 0) {
-            break;
+
+        if (!strcmp (item->item.value, val)) {
+            conf_unlock ();
+            return;
         }
-        prev = it;
+        free (item->item.value);
+        item->item.value = strdup (val);
+        item->has_int = item->has_int64 = item->has_float = 0;
+        _mark_changed (key);
+        _notify_change (key);
+        conf_unlock ();
+        return;
     }
     if (!val) {
         conf_unlock ();
         return;
     }
-    DB_conf_item_t *it = malloc (sizeof (DB_conf_item_t));
-    memset (it, 0, sizeof (DB_conf_item_t));
-    it->key = strdup (key);
-    it->value = strdup (val);
-    changed = 1;
-    if (prev) {
-        DB_conf_item_t *next = prev->next;
-        prev->next = it;
-        it->next = next;
-    }
-    else {
-        it->next = conf_items;
-        conf_items = it;
-    }
+    item = calloc (1, sizeof (conf_item_t));
+    item->item.key = strdup (key);
+    item->item.value = strdup (val);
+    item->hash = hash;
+    _item_insert (item);
+    _mark_changed (key);
+    _notify_change (key);
     conf_unlock ();
 }
 
@@ -441,29 +799,23 @@ void
 conf_remove_items (const char *key) {
     size_t l = strlen (key);
     conf_lock ();
-    DB_conf_item_t *prev = NULL;
     DB_conf_item_t *it;
-    for (it = conf_items; it; prev = it, it = it->next) {
+    for (it = conf_items; it; it = it->next) {
         if (!strncasecmp (key, it->key, l)) {
-            changed = 1;
             break;
         }
     }
-    DB_conf_item_t *next = NULL;
     while (it) {
-        next = it->next;
+        DB_conf_item_t *next = it->next;
+        _item_unlink ((conf_item_t *)it);
+        _mark_changed (it->key);
+        _notify_change (it->key);
         conf_item_free (it);
         it = next;
         if (!it || strncasecmp (key, it->key, l)) {
             break;
         }
     }
-    if (prev) {
-        prev->next = next;
-    }
-    else {
-        conf_items = next;
-    }
     conf_unlock ();
 }
 
@@ -39,6 +39,11 @@ conf_load (void);
 int
 conf_save (void);
 
+// Schedules saving the changed config files after a short delay,
+// so that a burst of changes results in a single write.
+int
+conf_save_deferred (void);
+
 void
 conf_init (void);
 
@@ -91,6 +96,15 @@ conf_item_free (DB_conf_item_t *it);
 void
 conf_enable_saving (int enable);
 
+// Calls the callback on the config queue after each change of a key starting with prefix.
+// Returns the subscription ID to pass to conf_unsubscribe.
+intptr_t
+conf_subscribe (const char *prefix, void (*callback) (const char *key, void *user_data), void *user_data);
+
+// After this returns, the callback is not going to be called anymore.
+void
+conf_unsubscribe (intptr_t subscription);
+
 #ifdef __cplusplus
 }
 #endif
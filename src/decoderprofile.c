@@ -0,0 +1,424 @@
+/*
+  This file is part of Deadbeef Player source code
+  http://deadbeef.sourceforge.net
+
+  decoder profiling: per-plugin accounting of the decoder calls and file I/O
+
+  Copyright (C) 2009-2026 Oleksiy Yakovenko
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Oleksiy Yakovenko waker@users.sourceforge.net
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "decoderprofile.h"
+#include "logger.h"
+#include "threading.h"
+
+#define MAX_PROFILE_ROWS 128
+
+typedef struct {
+    char id[100];
+    decoder_profile_stats_t stats;
+} profile_row_t;
+
+static int _enabled;
+static uintptr_t _mutex;
+static profile_row_t _rows[MAX_PROFILE_ROWS];
+static int _num_rows;
+
+// the row which gets the I/O of the current thread
+static __thread profile_row_t *_current_row;
+
+static uint64_t
+_now (void) {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static profile_row_t *
+_row_for_id (const char *id) {
+    if (!id) {
+        id = "unknown";
+    }
+    profile_row_t *row = NULL;
+    mutex_lock (_mutex);
+    for (int i = 0; i < _num_rows; i++) {
+        if (!strcmp (_rows[i].id, id)) {
+            row = &_rows[i];
+            break;
+        }
+    }
+    if (!row && _num_rows < MAX_PROFILE_ROWS) {
+        row = &_rows[_num_rows++];
+        snprintf (row->id, sizeof (row->id), "%s", id);
+    }
+    mutex_unlock (_mutex);
+    return row;
+}
+
+static void
+_begin (decoder_profile_call_t *call, profile_row_t *row) {
+    call->row = row;
+    call->prev_row = _current_row;
+    _current_row = row;
+    call->start = _now ();
+}
+
+void
+decoder_profile_begin (decoder_profile_call_t *call, const char *id) {
+    if (!_enabled) {
+        call->row = NULL;
+        return;
+    }
+    _begin (call, _row_for_id (id));
+}
+
+void
+decoder_profile_end (decoder_profile_call_t *call, decoder_profile_op_t op) {
+    profile_row_t *row = call->row;
+    if (!row) {
+        return;
+    }
+    uint64_t elapsed = _now () - call->start;
+    _current_row = call->prev_row;
+    __atomic_fetch_add (&row->stats.calls[op], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&row->stats.nsec[op], elapsed, __ATOMIC_RELAXED);
+}
+
+void
+decoder_profile_count_read (size_t bytes) {
+    profile_row_t *row = _current_row;
+    if (row) {
+        __atomic_fetch_add (&row->stats.bytes_read, bytes, __ATOMIC_RELAXED);
+        __atomic_fetch_add (&row->stats.read_calls, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void
+decoder_profile_count_seek (void) {
+    profile_row_t *row = _current_row;
+    if (row) {
+        __atomic_fetch_add (&row->stats.seek_calls, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void
+decoder_profile_count_syscall (void) {
+    profile_row_t *row = _current_row;
+    if (row) {
+        __atomic_fetch_add (&row->stats.syscalls, 1, __ATOMIC_RELAXED);
+    }
+}
+
+#pragma mark - Decoder method wrappers
+
+// the methods without the fileinfo argument need to know which plugin is called,
+// so every wrapped decoder gets its own set of forwarding functions
+#define MAX_PROFILE_SLOTS 100
+
+typedef struct {
+    DB_decoder_t *dec;
+    profile_row_t *row;
+    DB_fileinfo_t *(*open) (uint32_t hints);
+    DB_fileinfo_t *(*open2) (uint32_t hints, DB_playItem_t *it);
+    int (*init) (DB_fileinfo_t *info, DB_playItem_t *it);
+    DB_playItem_t *(*insert) (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname);
+    int (*read_metadata) (DB_playItem_t *it);
+} profile_slot_t;
+
+static profile_slot_t _slots[MAX_PROFILE_SLOTS];
+static int _num_slots;
+
+static DB_fileinfo_t *
+_profile_open (int slot, uint32_t hints) {
+    profile_slot_t *s = &_slots[slot];
+    decoder_profile_call_t call;
+    _begin (&call, s->row);
+    DB_fileinfo_t *res = s->open (hints);
+    decoder_profile_end (&call, DECODER_PROFILE_OPEN);
+    return res;
+}
+
+static DB_fileinfo_t *
+_profile_open2 (int slot, uint32_t hints, DB_playItem_t *it) {
+    profile_slot_t *s = &_slots[slot];
+    decoder_profile_call_t call;
+    _begin (&call, s->row);
+    DB_fileinfo_t *res = s->open2 (hints, it);
+    decoder_profile_end (&call, DECODER_PROFILE_OPEN);
+    return res;
+}
+
+static int
+_profile_init (int slot, DB_fileinfo_t *info, DB_playItem_t *it) {
+    profile_slot_t *s = &_slots[slot];
+    decoder_profile_call_t call;
+    _begin (&call, s->row);
+    int res = s->init (info, it);
+    decoder_profile_end (&call, DECODER_PROFILE_INIT);
+    return res;
+}
+
+static DB_playItem_t *
+_profile_insert (int slot, ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
+    profile_slot_t *s = &_slots[slot];
+    decoder_profile_call_t call;
+    _begin (&call, s->row);
+    DB_playItem_t *res = s->insert (plt, after, fname);
+    decoder_profile_end (&call, DECODER_PROFILE_INSERT);
+    return res;
+}
+
+static int
+_profile_read_metadata (int slot, DB_playItem_t *it) {
+    profile_slot_t *s = &_slots[slot];
+    decoder_profile_call_t call;
+    _begin (&call, s->row);
+    int res = s->read_metadata (it);
+    decoder_profile_end (&call, DECODER_PROFILE_READ_METADATA);
+    return res;
+}
+
+typedef struct {
+    DB_fileinfo_t *(*open) (uint32_t hints);
+    DB_fileinfo_t *(*open2) (uint32_t hints, DB_playItem_t *it);
+    int (*init) (DB_fileinfo_t *info, DB_playItem_t *it);
+    DB_playItem_t *(*insert) (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname);
+    int (*read_metadata) (DB_playItem_t *it);
+} profile_slot_methods_t;
+
+#define PROFILE_SLOT(n)\
+static DB_fileinfo_t *_profile_open_##n (uint32_t hints) { return _profile_open (n, hints); }\
+static DB_fileinfo_t *_profile_open2_##n (uint32_t hints, DB_playItem_t *it) { return _profile_open2 (n, hints, it); }\
+static int _profile_init_##n (DB_fileinfo_t *info, DB_playItem_t *it) { return _profile_init (n, info, it); }\
+static DB_playItem_t *_profile_insert_##n (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) { return _profile_insert (n, plt, after, fname); }\
+static int _profile_read_metadata_##n (DB_playItem_t *it) { return _profile_read_metadata (n, it); }
+
+#define PROFILE_SLOT_METHODS(n) { _profile_open_##n, _profile_open2_##n, _profile_init_##n, _profile_insert_##n, _profile_read_metadata_##n },
+
+#define PROFILE_SLOTS_10(M,d) M(d##0) M(d##1) M(d##2) M(d##3) M(d##4) M(d##5) M(d##6) M(d##7) M(d##8) M(d##9)
+#define PROFILE_SLOTS(M) PROFILE_SLOTS_10(M,) PROFILE_SLOTS_10(M,1) PROFILE_SLOTS_10(M,2) PROFILE_SLOTS_10(M,3) PROFILE_SLOTS_10(M,4)\
+    PROFILE_SLOTS_10(M,5) PROFILE_SLOTS_10(M,6) PROFILE_SLOTS_10(M,7) PROFILE_SLOTS_10(M,8) PROFILE_SLOTS_10(M,9)
+
+PROFILE_SLOTS(PROFILE_SLOT)
+
+static const profile_slot_methods_t _profile_slot_methods[MAX_PROFILE_SLOTS] = {
+    PROFILE_SLOTS(PROFILE_SLOT_METHODS)
+};
+
+void
+decoder_profile_wrap (DB_decoder_t *dec) {
+    if (!_enabled) {
+        return;
+    }
+    mutex_lock (_mutex);
+    for (int i = 0; i < _num_slots; i++) {
+        if (_slots[i].dec == dec) {
+            mutex_unlock (_mutex);
+            return;
+        }
+    }
+    if (_num_slots >= MAX_PROFILE_SLOTS) {
+        mutex_unlock (_mutex);
+        return;
+    }
+    int slot = _num_slots++;
+    mutex_unlock (_mutex);
+
+    profile_slot_t *s = &_slots[slot];
+    const profile_slot_methods_t *methods = &_profile_slot_methods[slot];
+    s->dec = dec;
+    s->row = _row_for_id (dec->plugin.id);
+
+    // the missing methods stay missing
+    s->open = dec->open;
+    if (dec->open) {
+        dec->open = methods->open;
+    }
+    // open2 doesn't exist in the older plugins
+    if (dec->plugin.api_vminor >= 7) {
+        s->open2 = dec->open2;
+        if (dec->open2) {
+            dec->open2 = methods->open2;
+        }
+    }
+    s->init = dec->init;
+    if (dec->init) {
+        dec->init = methods->init;
+    }
+    s->insert = dec->insert;
+    if (dec->insert) {
+        dec->insert = methods->insert;
+    }
+    s->read_metadata = dec->read_metadata;
+    if (dec->read_metadata) {
+        dec->read_metadata = methods->read_metadata;
+    }
+}
+
+#pragma mark - Reporting
+
+void
+decoder_profile_init (int enable) {
+    _enabled = enable;
+    if (!_mutex) {
+        _mutex = mutex_create ();
+    }
+}
+
+// called after the plugins were unloaded, so that the slots can be reused by the next load
+void
+decoder_profile_free (void) {
+    _enabled = 0;
+    memset (_slots, 0, sizeof (_slots));
+    _num_slots = 0;
+    memset (_rows, 0, sizeof (_rows));
+    _num_rows = 0;
+    if (_mutex) {
+        mutex_free (_mutex);
+        _mutex = 0;
+    }
+}
+
+int
+decoder_profile_enabled (void) {
+    return _enabled;
+}
+
+int
+decoder_profile_get_stats (const char *id, decoder_profile_stats_t *stats) {
+    if (!_mutex) {
+        return -1;
+    }
+    int res = -1;
+    mutex_lock (_mutex);
+    for (int i = 0; i < _num_rows; i++) {
+        if (!strcmp (_rows[i].id, id)) {
+            *stats = _rows[i].stats;
+            res = 0;
+            break;
+        }
+    }
+    mutex_unlock (_mutex);
+    return res;
+}
+
+static uint64_t
+_total_nsec (const decoder_profile_stats_t *stats) {
+    uint64_t total = 0;
+    for (int op = 0; op < DECODER_PROFILE_OP_COUNT; op++) {
+        total += stats->nsec[op];
+    }
+    return total;
+}
+
+static int
+_row_compare (const void *a, const void *b) {
+    uint64_t ta = _total_nsec (&((const profile_row_t *)a)->stats);
+    uint64_t tb = _total_nsec (&((const profile_row_t *)b)->stats);
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+int
+decoder_profile_format (char *buffer, size_t size) {
+    if (!_mutex) {
+        return 0;
+    }
+    mutex_lock (_mutex);
+    int count = _num_rows;
+    profile_row_t *rows = malloc (sizeof (profile_row_t) * (count ? count : 1));
+    memcpy (rows, _rows, sizeof (profile_row_t) * count);
+    mutex_unlock (_mutex);
+
+    qsort (rows, count, sizeof (profile_row_t), _row_compare);
+
+    static const char *op_names[DECODER_PROFILE_OP_COUNT] = {
+        "insert", "open", "init", "read_metadata", "fileadd_filter", "cue"
+    };
+
+    size_t pos = 0;
+    int n = snprintf (buffer, size, "%-16s %-14s %8s %12s %10s %10s %10s %10s\n", "plugin", "call", "count", "total ms", "avg ms", "KB read", "vfs calls", "syscalls");
+    pos += n > 0 ? (size_t)n : 0;
+
+    int nrows = 0;
+    for (int i = 0; i < count; i++) {
+        const decoder_profile_stats_t *stats = &rows[i].stats;
+        uint64_t calls = 0;
+        for (int op = 0; op < DECODER_PROFILE_OP_COUNT; op++) {
+            calls += stats->calls[op];
+        }
+        if (!calls) {
+            continue;
+        }
+        nrows++;
+        // the I/O counters are printed once per plugin, on its first line
+        int first = 1;
+        for (int op = 0; op < DECODER_PROFILE_OP_COUNT; op++) {
+            if (!stats->calls[op]) {
+                continue;
+            }
+            double total_ms = stats->nsec[op] / 1000000.0;
+            if (pos < size) {
+                if (first) {
+                    n = snprintf (buffer + pos, size - pos, "%-16s %-14s %8llu %12.2f %10.3f %10.1f %10llu %10llu\n",
+                                  rows[i].id, op_names[op], (unsigned long long)stats->calls[op], total_ms, total_ms / stats->calls[op],
+                                  stats->bytes_read / 1024.0, (unsigned long long)(stats->read_calls + stats->seek_calls), (unsigned long long)stats->syscalls);
+                }
+                else {
+                    n = snprintf (buffer + pos, size - pos, "%-16s %-14s %8llu %12.2f %10.3f\n",
+                                  "", op_names[op], (unsigned long long)stats->calls[op], total_ms, total_ms / stats->calls[op]);
+                }
+                pos += n > 0 ? (size_t)n : 0;
+            }
+            first = 0;
+        }
+    }
+
+    free (rows);
+    return nrows;
+}
+
+void
+decoder_profile_dump (void) {
+    if (!_enabled) {
+        return;
+    }
+    size_t size = 64 * 1024;
+    char *buffer = malloc (size);
+    if (decoder_profile_format (buffer, size) > 0) {
+        ddb_log ("decoder profile:\n%s", buffer);
+    }
+    free (buffer);
+    decoder_profile_reset ();
+}
+
+void
+decoder_profile_reset (void) {
+    if (!_mutex) {
+        return;
+    }
+    mutex_lock (_mutex);
+    for (int i = 0; i < _num_rows; i++) {
+        memset (&_rows[i].stats, 0, sizeof (decoder_profile_stats_t));
+    }
+    mutex_unlock (_mutex);
+}
@@ -0,0 +1,117 @@
+/*
+  This file is part of Deadbeef Player source code
+  http://deadbeef.sourceforge.net
+
+  decoder profiling: per-plugin accounting of the decoder calls and file I/O
+
+  Copyright (C) 2009-2026 Oleksiy Yakovenko
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Oleksiy Yakovenko waker@users.sourceforge.net
+*/
+#ifndef __DECODERPROFILE_H
+#define __DECODERPROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deadbeef/deadbeef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The profiling is enabled with the "decoder_profiling" config option, which is read on startup.
+// When enabled, the decoder methods are replaced with forwarding functions which measure the calls,
+// and the table is written to the log at the end of each file import.
+
+typedef enum {
+    DECODER_PROFILE_INSERT,
+    DECODER_PROFILE_OPEN,
+    DECODER_PROFILE_INIT,
+    DECODER_PROFILE_READ_METADATA,
+    DECODER_PROFILE_FILEADD_FILTER,
+    DECODER_PROFILE_CUE,
+    DECODER_PROFILE_OP_COUNT
+} decoder_profile_op_t;
+
+typedef struct {
+    uint64_t calls[DECODER_PROFILE_OP_COUNT];
+    uint64_t nsec[DECODER_PROFILE_OP_COUNT];
+    uint64_t bytes_read; // through the VFS
+    uint64_t read_calls; // VFS read calls
+    uint64_t seek_calls; // VFS seek calls
+    uint64_t syscalls; // read/pread/lseek done by vfs_stdio
+} decoder_profile_stats_t;
+
+void
+decoder_profile_init (int enable);
+
+void
+decoder_profile_free (void);
+
+int
+decoder_profile_enabled (void);
+
+// Replaces the methods of the decoder with the measuring ones, if the profiling is enabled.
+void
+decoder_profile_wrap (DB_decoder_t *dec);
+
+typedef struct {
+    void *row;
+    void *prev_row;
+    uint64_t start;
+} decoder_profile_call_t;
+
+// Measures a call not done through a decoder method, such as the file add filters.
+// The id is the table row.
+void
+decoder_profile_begin (decoder_profile_call_t *call, const char *id);
+
+void
+decoder_profile_end (decoder_profile_call_t *call, decoder_profile_op_t op);
+
+// I/O accounting, attributed to the innermost measured call on the current thread
+void
+decoder_profile_count_read (size_t bytes);
+
+void
+decoder_profile_count_seek (void);
+
+void
+decoder_profile_count_syscall (void);
+
+// Returns -1 if nothing was recorded for the id
+int
+decoder_profile_get_stats (const char *id, decoder_profile_stats_t *stats);
+
+// Formats the table, sorted by the total time, returns the number of rows
+int
+decoder_profile_format (char *buffer, size_t size);
+
+// Writes the table to the log, and resets the counters
+void
+decoder_profile_dump (void);
+
+void
+decoder_profile_reset (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
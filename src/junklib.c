@@ -57,6 +57,12 @@ uint16_t sj_to_unicode[] = {
 #define O_LARGEFILE 0
 #endif
 #include <sys/stat.h>
+#if HAVE_ICONV
+#include <pthread.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "playlist.h"
 #include "plmeta.h"
 #include "utf8.h"
@@ -84,6 +90,40 @@ int enable_shift_jis_detection = 0;
 #define _O_BINARY 0
 #endif
 
+// Most of the tags are plain ASCII, which needs neither the charset detection nor the conversion.
+static int
+_is_ascii (const uint8_t *str, int size) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128 ((const __m128i *)(str + i));
+        if (_mm_movemask_epi8 (v)) {
+            return 0;
+        }
+    }
+#else
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy (&v, str + i, 8);
+        if (v & 0x8080808080808080ULL) {
+            return 0;
+        }
+    }
+#endif
+    for (; i < size; i++) {
+        if (str[i] & 0x80) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// shift-jis maps some of the ASCII codes to other characters
+static int
+_is_ascii_compatible (const char *charset) {
+    return strcasecmp (charset, "shift-jis") != 0;
+}
+
 // mapping between ddb metadata names and id3v2/apev2 names
 #define FRAME_MAPPINGS 5
 enum {
@@ -695,11 +735,94 @@ ddb_iconv (const char *cs_out, const char *cs_in, char *out, int outlen, const c
 }
 #endif
 
+#if HAVE_ICONV
+// Opening the conversion descriptor is much slower than converting a tag frame,
+// so the few recently used descriptors are kept per thread.
+#define ICONV_CACHE_SIZE 4
+#define ICONV_CACHE_CHARSET_MAX 32
+
+typedef struct {
+    char cs_in[ICONV_CACHE_CHARSET_MAX];
+    char cs_out[ICONV_CACHE_CHARSET_MAX];
+    iconv_t cd;
+} iconv_cache_entry_t;
+
+typedef struct {
+    iconv_cache_entry_t entries[ICONV_CACHE_SIZE];
+    int count;
+    int next; // the entry to replace
+} iconv_cache_t;
+
+static pthread_key_t _iconv_cache_key;
+static pthread_once_t _iconv_cache_once = PTHREAD_ONCE_INIT;
+
+static void
+_iconv_cache_free (void *data) {
+    iconv_cache_t *cache = data;
+    for (int i = 0; i < cache->count; i++) {
+        iconv_close (cache->entries[i].cd);
+    }
+    free (cache);
+}
+
+static void
+_iconv_cache_key_create (void) {
+    pthread_key_create (&_iconv_cache_key, _iconv_cache_free);
+}
+
+// Returns the descriptor in the initial state.
+// If *cached is 0 on return, the caller must close the descriptor.
+static iconv_t
+_iconv_open_cached (const char *cs_in, const char *cs_out, int *cached) {
+    *cached = 0;
+    pthread_once (&_iconv_cache_once, _iconv_cache_key_create);
+    iconv_cache_t *cache = pthread_getspecific (_iconv_cache_key);
+    if (!cache) {
+        cache = calloc (1, sizeof (iconv_cache_t));
+        if (pthread_setspecific (_iconv_cache_key, cache)) {
+            free (cache);
+            cache = NULL;
+        }
+    }
+
+    if (cache) {
+        for (int i = 0; i < cache->count; i++) {
+            iconv_cache_entry_t *e = &cache->entries[i];
+            if (!strcmp (e->cs_in, cs_in) && !strcmp (e->cs_out, cs_out)) {
+                iconv (e->cd, NULL, NULL, NULL, NULL);
+                *cached = 1;
+                return e->cd;
+            }
+        }
+    }
+
+    iconv_t cd = iconv_open (cs_out, cs_in);
+    if (cd == (iconv_t)-1 || !cache || strlen (cs_in) >= ICONV_CACHE_CHARSET_MAX || strlen (cs_out) >= ICONV_CACHE_CHARSET_MAX) {
+        return cd;
+    }
+
+    iconv_cache_entry_t *e = &cache->entries[cache->next];
+    if (cache->next < cache->count) {
+        iconv_close (e->cd);
+    }
+    else {
+        cache->count++;
+    }
+    cache->next = (cache->next + 1) % ICONV_CACHE_SIZE;
+    strcpy (e->cs_in, cs_in);
+    strcpy (e->cs_out, cs_out);
+    e->cd = cd;
+    *cached = 1;
+    return cd;
+}
+#endif
+
 int
 junk_iconv (const char *in, int inlen, char *out, int outlen, const char *cs_in, const char *cs_out) {
 // NOTE: this function must support utf8->utf8 conversion, used for validation
 #if HAVE_ICONV
-    iconv_t cd = iconv_open (cs_out, cs_in);
+    int cached;
+    iconv_t cd = _iconv_open_cached (cs_in, cs_out, &cached);
     if (cd == (iconv_t)-1) {
         return -1;
     }
@@ -716,7 +839,9 @@ junk_iconv (const char *in, int inlen, char *out, int outlen, const char *cs_in,
 
     size_t res = iconv (cd, &pin, &inbytesleft, &pout, &outbytesleft);
     int err = errno;
-    iconv_close (cd);
+    if (!cached) {
+        iconv_close (cd);
+    }
 
     //trace ("iconv -f %s -t %s '%s': returned %d, inbytes %d/%d, outbytes %d/%d, errno=%d\n", cs_in, cs_out, in, (int)res, inlen, (int)inbytesleft, outlen, (int)outbytesleft, err);
     if (res == -1) {
@@ -970,7 +1095,7 @@ can_be_chinese (const uint8_t *str, int sz) {
     if (!enable_cp936_detection) {
         return 0;
     }
-    size_t len = strlen (str);
+    int len = (int)strnlen ((const char *)str, sz);
     for (int i = 0; i < sz; str++, i++) {
         if (i < len-3
                 && (*str >= 0x81 && *str <= 0xFE )
@@ -1024,10 +1149,32 @@ can_be_shift_jis (const unsigned char *str, int size) {
 }
 
 
+static char *
+_trim_converted (char *out, int converted_sz, int *out_size) {
+    // trim trailing linebreaks
+    while (converted_sz > 0 && (uint8_t)out[converted_sz-1] <= 32) {
+        out[--converted_sz] = 0;
+    }
+    if (out_size) {
+        *out_size = converted_sz;
+    }
+    return out;
+}
+
 static char *
 convstr_id3v2 (const char *sb_charset, int version, uint8_t encoding, const uint8_t *str, int sz, int *out_size) {
     const char *enc = NULL;
 
+    // single-byte and utf8 text is usually ASCII, which is copied as is
+    if ((encoding == 0 && (!sb_charset || _is_ascii_compatible (sb_charset))) || (version == 4 && encoding == 3)) {
+        if (_is_ascii (str, sz) || (encoding == 3 && u8_valid ((const char *)str, sz, NULL))) {
+            char *out = malloc (sz + 1);
+            memcpy (out, str, sz);
+            out[sz] = 0;
+            return _trim_converted (out, sz, out_size);
+        }
+    }
+
     // detect encoding
     if (version == 4 && encoding == 2) {
         enc = "UTF-16BE";
@@ -1092,14 +1239,7 @@ convstr_id3v2 (const char *sb_charset, int version, uint8_t encoding, const uint
         return NULL;
     }
 
-    // trim trailing linebreaks
-    while (converted_sz > 0 && (uint8_t)out[converted_sz-1] <= 32) {
-        out[--converted_sz] = 0;
-    }
-    if (out_size) {
-        *out_size = converted_sz;
-    }
-    return out;
+    return _trim_converted (out, converted_sz, out_size);
 }
 
 static const char *
@@ -1118,6 +1258,12 @@ convstr_id3v1 (const char* str, int sz, const char *charset, char *out, int outs
         return out;
     }
 
+    if (sz < outsize && _is_ascii_compatible (charset) && _is_ascii ((const uint8_t *)str, sz)) {
+        memcpy (out, str, sz);
+        out[sz] = 0;
+        return out;
+    }
+
     int len = junk_iconv (str, sz, out, outsize, charset, UTF8_STR);
     if (len >= 0) {
         return out;
@@ -1653,33 +1799,12 @@ junk_apev2_add_frame (playItem_t *it, DB_apev2_tag_t *tag_store, DB_apev2_frame_
     return 0;
 }
 
-int
-junk_apev2_read_full_mem (playItem_t *it, DB_apev2_tag_t *tag_store, char *mem, int memsize) {
-    char *end = mem+memsize;
+// Reads the items following the APEv2 header, or preceding the footer
+static int
+_apev2_read_items_mem (playItem_t *it, DB_apev2_tag_t *tag_store, char *mem, char *end, uint32_t numitems) {
 #define STEP(x,y) {mem+=(x);if(mem+(y)>end) {trace ("fail %d\n", (x));return -1;}}
-
-    char *header = mem;
-
     DB_apev2_frame_t *tail = NULL;
 
-    // FIXME: version needs to be checked?
-    uint32_t version = extract_i32_le (&header[0]);
-    int32_t size = extract_i32_le (&header[4]);
-    uint32_t numitems = extract_i32_le (&header[8]);
-    uint32_t flags = extract_i32_le (&header[12]);
-#pragma unused(version)
-#pragma unused(size)
-#pragma unused(flags)
-
-    trace ("APEv%d, size=%d, items=%d, flags=%x\n", version, size, numitems, flags);
-    if (it) {
-        uint32_t f = pl_get_item_flags (it);
-        f |= DDB_TAG_APEV2;
-        pl_set_item_flags (it, f);
-    }
-
-    STEP(24, 8);
-
     int i;
     for (i = 0; i < numitems; i++) {
         trace ("reading item %d\n", i);
@@ -1732,6 +1857,32 @@ junk_apev2_read_full_mem (playItem_t *it, DB_apev2_tag_t *tag_store, char *mem,
     return 0;
 }
 
+int
+junk_apev2_read_full_mem (playItem_t *it, DB_apev2_tag_t *tag_store, char *mem, int memsize) {
+    char *end = mem+memsize;
+    char *header = mem;
+
+    // FIXME: version needs to be checked?
+    uint32_t version = extract_i32_le (&header[0]);
+    int32_t size = extract_i32_le (&header[4]);
+    uint32_t numitems = extract_i32_le (&header[8]);
+    uint32_t flags = extract_i32_le (&header[12]);
+#pragma unused(version)
+#pragma unused(size)
+#pragma unused(flags)
+
+    trace ("APEv%d, size=%d, items=%d, flags=%x\n", version, size, numitems, flags);
+    if (it) {
+        uint32_t f = pl_get_item_flags (it);
+        f |= DDB_TAG_APEV2;
+        pl_set_item_flags (it, f);
+    }
+
+    STEP(24, 8);
+
+    return _apev2_read_items_mem (it, tag_store, mem, end, numitems);
+}
+
 int
 junk_apev2_read_full (playItem_t *it, DB_apev2_tag_t *tag_store, DB_FILE *fp) {
     // try to read footer, position must be already at the EOF right before
@@ -1914,17 +2065,10 @@ junk_get_leading_size_stdio (FILE *fp) {
     return size + 10 + 10 * footerpresent;
 }
 
-int
-junk_get_leading_size (DB_FILE *fp) {
-    uint8_t header[10];
-    int64_t pos = deadbeef->ftell (fp);
-    if (deadbeef->fread (header, 1, 10, fp) != 10) {
-        deadbeef->fseek (fp, pos, SEEK_SET);
-        trace ("junk_get_leading_size: file is too short\n");
-        return 0; // too short
-    }
-    deadbeef->fseek (fp, pos, SEEK_SET);
-    if (strncmp (header, "ID3", 3)) {
+// Returns the size of the id3v2 tag including the header and footer, or 0
+static int
+_id3v2_leading_size (const uint8_t *header) {
+    if (strncmp ((const char *)header, "ID3", 3)) {
         trace ("junk_get_leading_size: no id3v2 found\n");
         return 0; // no tag
     }
@@ -1944,6 +2088,19 @@ junk_get_leading_size (DB_FILE *fp) {
     return size + 10 + 10 * footerpresent;
 }
 
+int
+junk_get_leading_size (DB_FILE *fp) {
+    uint8_t header[10];
+    int64_t pos = deadbeef->ftell (fp);
+    if (deadbeef->fread (header, 1, 10, fp) != 10) {
+        deadbeef->fseek (fp, pos, SEEK_SET);
+        trace ("junk_get_leading_size: file is too short\n");
+        return 0; // too short
+    }
+    deadbeef->fseek (fp, pos, SEEK_SET);
+    return _id3v2_leading_size (header);
+}
+
 int
 junk_get_tail_size (DB_FILE *fp) {
     int offs = 0;
@@ -4251,8 +4408,17 @@ junk_id3v2_set_metadata_from_frame (playItem_t *it, DB_id3v2_tag_t *id3v2_tag, D
 // Ignore unicode and non-text frames.
 static const char *
 junk_id3v2_detect_charset (DB_id3v2_tag_t *id3v2_tag) {
-    int sz = 1000*200;
-    char *buf = calloc (1, sz);
+    int sz = 0;
+    for (DB_id3v2_frame_t *frm = id3v2_tag->frames; frm; frm = frm->next) {
+        if (frm->id[0] == 'T' && frm->size > 0 && frm->data[0] == 0) {
+            sz += frm->size;
+        }
+    }
+    sz = min (sz, 1000*200);
+    if (sz == 0) {
+        return NULL;
+    }
+    char *buf = malloc (sz + 1);
     char *p = buf;
 
     for (DB_id3v2_frame_t *frm = id3v2_tag->frames; frm; frm = frm->next) {
@@ -4262,6 +4428,7 @@ junk_id3v2_detect_charset (DB_id3v2_tag_t *id3v2_tag) {
             sz -= frm->size-1;
         }
     }
+    *p = 0;
 
     const char *cs = junk_detect_charset_len (buf, (int)(p-buf));
 
@@ -4277,27 +4444,15 @@ junk_id3v2_set_metadata (playItem_t *it, DB_id3v2_tag_t *id3v2_tag, const char *
     return 0;
 }
 
-int
-junk_id3v2_read_full (playItem_t *it, DB_id3v2_tag_t *tag_store, DB_FILE *fp) {
-    int err = -1;
-    if (!tag_store) {
-        return -1;
-    }
-    DB_id3v2_frame_t *tail = NULL;
-    if (!fp) {
-        trace ("bad call to junk_id3v2_read!\n");
-        return -1;
-    }
-    deadbeef->rewind (fp);
-    uint8_t header[10];
-    if (deadbeef->fread (header, 1, 10, fp) != 10) {
-        return -1; // too short
-    }
-    if (strncmp (header, "ID3", 3)) {
+// Returns the size of the tag, excluding the header and footer, or -1 if the header is not a supported id3v2
+static int
+_id3v2_tag_size (const uint8_t *header) {
+    if (strncmp ((const char *)header, "ID3", 3)) {
         return -1; // no tag
     }
     uint8_t version_major = header[3];
     uint8_t version_minor = header[4];
+#pragma unused(version_minor)
     if (version_major > 4 || version_major < 2) {
         trace ("id3v2.%d.%d is unsupported\n", version_major, version_minor);
         return -1; // unsupported
@@ -4307,12 +4462,6 @@ junk_id3v2_read_full (playItem_t *it, DB_id3v2_tag_t *tag_store, DB_FILE *fp) {
         trace ("unrecognized flags: one of low 15 bits is set, value=0x%x\n", (int)flags);
         return -1; // unsupported
     }
-    int unsync = (flags & (1<<7)) ? 1 : 0;
-    int extheader = (flags & (1<<6)) ? 1 : 0;
-    int expindicator = (flags & (1<<5)) ? 1 : 0;
-    int footerpresent = (flags & (1<<4)) ? 1 : 0;
-#pragma unused(expindicator)
-#pragma unused(footerpresent)
     // check for bad size
     if ((header[9] & 0x80) || (header[8] & 0x80) || (header[7] & 0x80) || (header[6] & 0x80)) {
         trace ("bad header size\n");
@@ -4324,6 +4473,61 @@ junk_id3v2_read_full (playItem_t *it, DB_id3v2_tag_t *tag_store, DB_FILE *fp) {
     if (size == 0) {
         return -1;
     }
+    return (int)size;
+}
+
+int
+junk_id3v2_read_full (playItem_t *it, DB_id3v2_tag_t *tag_store, DB_FILE *fp) {
+    if (!tag_store) {
+        return -1;
+    }
+    if (!fp) {
+        trace ("bad call to junk_id3v2_read!\n");
+        return -1;
+    }
+    deadbeef->rewind (fp);
+    uint8_t header[10];
+    if (deadbeef->fread (header, 1, 10, fp) != 10) {
+        return -1; // too short
+    }
+    int size = _id3v2_tag_size (header);
+    if (size < 0) {
+        return -1;
+    }
+
+    uint8_t *mem = malloc (size + 10);
+    if (!mem) {
+        fprintf (stderr, "junklib: out of memory while reading id3v2, tried to alloc %d bytes\n", size);
+        return -1;
+    }
+    memcpy (mem, header, 10);
+    int err = -1;
+    if (deadbeef->fread (mem + 10, 1, size, fp) == size) {
+        err = junk_id3v2_read_full_mem (it, tag_store, mem, size + 10);
+    }
+    free (mem);
+    return err;
+}
+
+int
+junk_id3v2_read_full_mem (playItem_t *it, DB_id3v2_tag_t *tag_store, uint8_t *mem, int memsize) {
+    int err = -1;
+    if (!tag_store || memsize < 10) {
+        return -1;
+    }
+    DB_id3v2_frame_t *tail = NULL;
+    int tag_size = _id3v2_tag_size (mem);
+    if (tag_size < 0 || tag_size > memsize - 10) {
+        return -1;
+    }
+    uint32_t size = tag_size;
+    uint8_t version_major = mem[3];
+    uint8_t version_minor = mem[4];
+    uint8_t flags = mem[5];
+    int unsync = (flags & (1<<7)) ? 1 : 0;
+    int extheader = (flags & (1<<6)) ? 1 : 0;
+    int expindicator = (flags & (1<<5)) ? 1 : 0;
+#pragma unused(expindicator)
 
     tag_store->version[0] = version_major;
     tag_store->version[1] = version_minor;
@@ -4331,14 +4535,8 @@ junk_id3v2_read_full (playItem_t *it, DB_id3v2_tag_t *tag_store, DB_FILE *fp) {
     // remove unsync flag
     tag_store->flags &= ~ (1<<7);
 
-    uint8_t *tag = malloc (size);
-    if (!tag) {
-        fprintf (stderr, "junklib: out of memory while reading id3v2, tried to alloc %d bytes\n", size);
-        goto error;
-    }
-    if (deadbeef->fread (tag, 1, size, fp) != size) {
-        goto error; // bad size
-    }
+    // the frames are unsynchronized in place
+    uint8_t *tag = mem + 10;
     uint8_t *readptr = tag;
     trace ("version: 2.%d.%d, unsync: %d, extheader: %d, experimental: %d\n", version_major, version_minor, unsync, extheader, expindicator);
     
@@ -4611,9 +4809,6 @@ error:
         trace ("error parsing id3v2\n");
     }
 
-    if (tag) {
-        free (tag);
-    }
     if (tag_store && err != 0) {
         while (tag_store->frames) {
             DB_id3v2_frame_t *next = tag_store->frames->next;
@@ -4624,40 +4819,195 @@ error:
     return err;
 }
 
-int
-junk_id3v2_read (playItem_t *it, DB_FILE *fp) {
-    DB_id3v2_tag_t id3v2_tag;
-    memset (&id3v2_tag, 0, sizeof (id3v2_tag));
-    int res = junk_id3v2_read_full (NULL, &id3v2_tag, fp);
+static void
+_id3v2_set_metadata_and_free (playItem_t *it, DB_id3v2_tag_t *id3v2_tag, int res) {
     if (!res) {
         // detect charset on all text fields
-        const char *charset = junk_id3v2_detect_charset (&id3v2_tag);
+        const char *charset = junk_id3v2_detect_charset (id3v2_tag);
         int found_wmp_popm = 0;
-        junk_id3v2_set_metadata (it, &id3v2_tag, charset, &found_wmp_popm);
+        junk_id3v2_set_metadata (it, id3v2_tag, charset, &found_wmp_popm);
     }
-    if (id3v2_tag.version[0] == 2) {
+    if (id3v2_tag->version[0] == 2) {
         uint32_t f = pl_get_item_flags (it);
         f |= DDB_TAG_ID3V22;
         pl_set_item_flags (it, f);
     }
-    else if (id3v2_tag.version[0] == 3) {
+    else if (id3v2_tag->version[0] == 3) {
         uint32_t f = pl_get_item_flags (it);
         f |= DDB_TAG_ID3V23;
         pl_set_item_flags (it, f);
     }
-    else if (id3v2_tag.version[0] == 4) {
+    else if (id3v2_tag->version[0] == 4) {
         uint32_t f = pl_get_item_flags (it);
         f |= DDB_TAG_ID3V24;
         pl_set_item_flags (it, f);
     }
-    deadbeef->junk_id3v2_free (&id3v2_tag);
+    deadbeef->junk_id3v2_free (id3v2_tag);
+}
+
+int
+junk_id3v2_read (playItem_t *it, DB_FILE *fp) {
+    DB_id3v2_tag_t id3v2_tag;
+    memset (&id3v2_tag, 0, sizeof (id3v2_tag));
+    int res = junk_id3v2_read_full (NULL, &id3v2_tag, fp);
+    _id3v2_set_metadata_and_free (it, &id3v2_tag, res);
     return res;
 }
 
+// The head and the tail are read in one request each, which matters on network filesystems,
+// where every seek and read of the separate tag readers has the latency of a round trip.
+// The tags which don't fit take one more read.
+#define TAG_SCAN_HEAD_SIZE (64*1024)
+#define TAG_SCAN_TAIL_SIZE (16*1024)
+
+static int
+_read_at (DB_FILE *fp, int64_t offs, uint8_t *buffer, int64_t size) {
+    if (deadbeef->fseek (fp, offs, SEEK_SET) == -1) {
+        return -1;
+    }
+    return deadbeef->fread (buffer, 1, size, fp) == size ? 0 : -1;
+}
+
+static int
+_read_tags_unbuffered (playItem_t *it, DB_FILE *fp, uint32_t *head, uint32_t *tail) {
+    if (head || tail) {
+        uint32_t h, t;
+        deadbeef->rewind (fp);
+        junk_get_tag_offsets (fp, &h, &t);
+        if (head) {
+            *head = h;
+        }
+        if (tail) {
+            *tail = t;
+        }
+    }
+    int found = 0;
+    found |= junk_apev2_read (it, fp) == 0;
+    found |= junk_id3v2_read (it, fp) == 0;
+    found |= junk_id3v1_read (it, fp) == 0;
+    return found ? 0 : -1;
+}
+
+int
+junk_read_tags (playItem_t *it, DB_FILE *fp, uint32_t *head, uint32_t *tail) {
+    int64_t fsize = deadbeef->fgetlength (fp);
+    if (fsize < 0) {
+        return _read_tags_unbuffered (it, fp, head, tail);
+    }
+
+    // small files are read whole, and the head and tail overlap
+    int64_t head_len = min (fsize, TAG_SCAN_HEAD_SIZE);
+    int64_t tail_len = min (fsize, TAG_SCAN_TAIL_SIZE);
+    int whole = fsize <= TAG_SCAN_HEAD_SIZE + TAG_SCAN_TAIL_SIZE;
+    uint8_t *buffer = malloc (whole ? max (fsize, 1) : head_len + tail_len);
+    if (!buffer) {
+        return -1;
+    }
+    uint8_t *headbuf = buffer;
+    uint8_t *tailbuf;
+    if (whole) {
+        if (_read_at (fp, 0, buffer, fsize) < 0) {
+            free (buffer);
+            return -1;
+        }
+        tailbuf = buffer + fsize - tail_len;
+    }
+    else {
+        tailbuf = buffer + head_len;
+        if (_read_at (fp, 0, headbuf, head_len) < 0 || _read_at (fp, fsize - tail_len, tailbuf, tail_len) < 0) {
+            free (buffer);
+            return -1;
+        }
+    }
+
+    int found = 0;
+    uint32_t head_size = 0;
+    uint32_t tail_size = 0;
+
+    // id3v1 is copied, because unsynchronizing id3v2 in place can overwrite the tail of a small file
+    uint8_t id3v1[128];
+    int have_id3v1 = 0;
+    if (tail_len >= 128 && !memcmp (tailbuf + tail_len - 128, "TAG", 3)) {
+        memcpy (id3v1, tailbuf + tail_len - 128, 128);
+        have_id3v1 = 1;
+        tail_size = 128;
+    }
+
+    // apev2 footer, right before id3v1
+    int64_t footer_end = tail_len - tail_size;
+    if (footer_end >= 32 && !strncmp ((char *)tailbuf + footer_end - 32, "APETAGEX", 8)) {
+        uint8_t *footer = tailbuf + footer_end - 32;
+        int32_t size = extract_i32_le (&footer[12]);
+        uint32_t numitems = extract_i32_le (&footer[16]);
+        trace ("APEv2 footer, size=%d, items=%d\n", size, numitems);
+        tail_size += size;
+        // size includes the footer, but not the header
+        if (size >= 32 && size <= fsize - (tail_len - footer_end)) {
+            if (it) {
+                uint32_t f = pl_get_item_flags (it);
+                f |= DDB_TAG_APEV2;
+                pl_set_item_flags (it, f);
+            }
+            int res = -1;
+            if (size <= footer_end) {
+                uint8_t *items = tailbuf + footer_end - size;
+                res = _apev2_read_items_mem (it, NULL, (char *)items, (char *)items + size, numitems);
+            }
+            else {
+                uint8_t *items = malloc (size);
+                if (items && !_read_at (fp, fsize - (tail_len - footer_end) - size, items, size)) {
+                    res = _apev2_read_items_mem (it, NULL, (char *)items, (char *)items + size, numitems);
+                }
+                free (items);
+            }
+            found |= res == 0;
+        }
+    }
+
+    if (head_len >= 10) {
+        head_size = _id3v2_leading_size (headbuf);
+        int tag_size = _id3v2_tag_size (headbuf);
+        if (tag_size >= 0 && tag_size <= fsize - 10) {
+            DB_id3v2_tag_t id3v2_tag;
+            memset (&id3v2_tag, 0, sizeof (id3v2_tag));
+            int res = -1;
+            if (tag_size + 10 <= head_len) {
+                res = junk_id3v2_read_full_mem (NULL, &id3v2_tag, headbuf, (int)head_len);
+            }
+            else {
+                uint8_t *mem = malloc (tag_size + 10);
+                if (mem) {
+                    memcpy (mem, headbuf, head_len);
+                    if (!_read_at (fp, head_len, mem + head_len, tag_size + 10 - head_len)) {
+                        res = junk_id3v2_read_full_mem (NULL, &id3v2_tag, mem, tag_size + 10);
+                    }
+                    free (mem);
+                }
+            }
+            _id3v2_set_metadata_and_free (it, &id3v2_tag, res);
+            found |= res == 0;
+        }
+    }
+
+    if (have_id3v1) {
+        found |= junk_id3v1_read_int (it, (char *)id3v1, NULL) == 0;
+    }
+
+    free (buffer);
+
+    if (head) {
+        *head = head_size;
+    }
+    if (tail) {
+        *tail = tail_size;
+    }
+    return found ? 0 : -1;
+}
+
 const char *
 junk_detect_charset_len (const char *s, int len) {
     // check if that's already utf8
-    if (u8_valid (s, len, NULL)) {
+    if (_is_ascii ((const uint8_t *)s, len) || u8_valid (s, len, NULL)) {
         return NULL; // means no recoding required
     }
     // try shift-jis
@@ -50,6 +50,9 @@ junk_id3v2_find (DB_FILE *fp, int *psize);
 int
 junk_id3v2_read_full (struct playItem_s *it, DB_id3v2_tag_t *tag, DB_FILE *fp);
 
+int
+junk_id3v2_read_full_mem (struct playItem_s *it, DB_id3v2_tag_t *tag_store, uint8_t *mem, int memsize);
+
 int
 junk_id3v2_convert_24_to_23 (DB_id3v2_tag_t *tag24, DB_id3v2_tag_t *tag23);
 
@@ -143,6 +146,9 @@ junk_get_tail_size (DB_FILE *fp);
 void
 junk_get_tag_offsets (DB_FILE *fp, uint32_t *head, uint32_t *tail);
 
+int
+junk_read_tags (struct playItem_s *it, DB_FILE *fp, uint32_t *head, uint32_t *tail);
+
 unsigned
 junk_stars_from_popm_rating (uint8_t rating);
 
@@ -879,7 +879,7 @@ player_mainloop (void) {
                 switch (msg) {
                 case DB_EV_REINIT_SOUND:
                     plug_reinit_sound ();
-                    conf_save ();
+                    conf_save_deferred ();
                     break;
                 case DB_EV_TERMINATE: {
                     save_resume_state ();
@@ -933,7 +933,7 @@ player_mainloop (void) {
                     streamer_move_to_randomalbum (1);
                     break;
                 case DB_EV_CONFIGCHANGED:
-                    conf_save ();
+                    conf_save_deferred ();
                     streamer_configchanged ();
                     pl_configchanged ();
                     junk_configchanged ();
@@ -957,7 +957,7 @@ player_mainloop (void) {
                 case DB_EV_PAUSED:
                 case DB_EV_SONGFINISHED:
                     save_resume_state ();
-                    conf_save ();
+                    conf_save_deferred ();
                     break;
                 }
             }
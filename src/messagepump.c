@@ -28,26 +28,44 @@
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <dispatch/dispatch.h>
 #include "messagepump.h"
-#include "threading.h"
 #include "playlist.h"
 #include <deadbeef/common.h>
 
+// The messages are pushed from any thread into a lock-free intrusive MPSC queue
+// (D. Vyukov), and popped only by the player thread.
+// The popped messages are moved into a pending list, where the duplicates of
+// idempotent notifications are dropped.
+
 typedef struct message_s {
     uint32_t id;
     uintptr_t ctx;
     uint32_t p1;
     uint32_t p2;
     struct message_s *next;
+    struct message_s *coalesce_next;
 } message_t;
 
-enum { MAX_MESSAGES = 100 };
+// The messages are allocated from the pool, and from the heap when the pool is exhausted.
+enum { MAX_MESSAGES = 256 };
+#define POOL_WORDS (MAX_MESSAGES / 64)
 static message_t pool[MAX_MESSAGES];
-static message_t *mfree;
-static message_t *mqueue;
-static message_t *mqtail;
-static uintptr_t mutex;
-static uintptr_t cond;
+static uint64_t pool_used[POOL_WORDS];
+
+static message_t stub;
+static message_t *mqhead; // consumer side
+static message_t *mqtail; // producer side
+
+// pending messages, accessed only by the consumer
+static message_t *pending;
+static message_t *pending_tail;
+
+#define COALESCE_HASH_SIZE 64
+static message_t *coalesce_hash[COALESCE_HASH_SIZE];
+
+static dispatch_semaphore_t semaphore;
+static int waiting;
 
 static void
 messagepump_reset (void);
@@ -55,109 +73,284 @@ messagepump_reset (void);
 int
 messagepump_init (void) {
     messagepump_reset ();
-    mutex = mutex_create ();
-    cond = cond_create ();
+    semaphore = dispatch_semaphore_create (0);
     return 0;
 }
 
+static void
+_check_queued_events (message_t *m) {
+    // this helps catching any ref leaks caused by messages sent at exit
+    switch (m->id) {
+    case DB_EV_SONGCHANGED:
+    case DB_EV_SONGSTARTED:
+    case DB_EV_SONGFINISHED:
+    case DB_EV_TRACKINFOCHANGED:
+    case DB_EV_CURSOR_MOVED:
+    case DB_EV_SEEKED:
+        assert (0);
+    }
+}
+
 void
 messagepump_free (void) {
-    mutex_lock (mutex);
-
-    // this helps catching any ref leaks caused by messages sent at exit
-    for (message_t *m = mqueue; m; m = m->next) {
-        switch (m->id) {
-        case DB_EV_SONGCHANGED:
-        case DB_EV_SONGSTARTED:
-        case DB_EV_SONGFINISHED:
-        case DB_EV_TRACKINFOCHANGED:
-        case DB_EV_CURSOR_MOVED:
-        case DB_EV_SEEKED:
-            assert (0);
+    for (message_t *m = pending; m; m = m->next) {
+        _check_queued_events (m);
+    }
+    for (message_t *m = mqhead; m; m = m->next) {
+        if (m != &stub) {
+            _check_queued_events (m);
         }
     }
 
     messagepump_reset ();
-    mutex_unlock (mutex);
-    mutex_free (mutex);
-    cond_free (cond);
-    mutex = 0;
+    dispatch_release (semaphore);
+    semaphore = NULL;
+}
+
+static void
+_message_free (message_t *m) {
+    if (m >= pool && m < pool + MAX_MESSAGES) {
+        size_t idx = m - pool;
+        __atomic_fetch_and (&pool_used[idx / 64], ~(1ULL << (idx % 64)), __ATOMIC_RELEASE);
+    }
+    else {
+        free (m);
+    }
+}
+
+static message_t *
+_message_alloc (void) {
+    for (int w = 0; w < POOL_WORDS; w++) {
+        uint64_t used = __atomic_load_n (&pool_used[w], __ATOMIC_RELAXED);
+        while (used != UINT64_MAX) {
+            int bit = __builtin_ctzll (~used);
+            if (__atomic_compare_exchange_n (&pool_used[w], &used, used | (1ULL << bit), 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return &pool[w * 64 + bit];
+            }
+        }
+    }
+    // the pool is exhausted, e.g. during a burst of notifications
+    return malloc (sizeof (message_t));
 }
 
 static void
 messagepump_reset (void) {
-    mqueue = NULL;
-    mfree = NULL;
-    mqtail = NULL;
+    // free the remaining heap-allocated messages
+    for (message_t *m = pending, *next; m; m = next) {
+        next = m->next;
+        _message_free (m);
+    }
+    for (message_t *m = mqhead, *next; m; m = next) {
+        next = m->next;
+        if (m != &stub) {
+            _message_free (m);
+        }
+    }
+
     memset (pool, 0, sizeof (pool));
-    for (int i = 0; i < MAX_MESSAGES; i++) {
-        pool[i].next = mfree;
-        mfree = &pool[i];
+    memset (pool_used, 0, sizeof (pool_used));
+    memset (coalesce_hash, 0, sizeof (coalesce_hash));
+    memset (&stub, 0, sizeof (stub));
+    pending = NULL;
+    pending_tail = NULL;
+    mqhead = &stub;
+    mqtail = &stub;
+    waiting = 0;
+}
+
+static void
+_enqueue (message_t *msg) {
+    __atomic_store_n (&msg->next, NULL, __ATOMIC_RELAXED);
+    message_t *prev = __atomic_exchange_n (&mqtail, msg, __ATOMIC_ACQ_REL);
+    // until the next line executes, the consumer can't see this and the following messages
+    __atomic_store_n (&prev->next, msg, __ATOMIC_RELEASE);
+}
+
+// Returns NULL when the queue is empty, or a producer is in the middle of pushing
+static message_t *
+_dequeue (void) {
+    message_t *head = mqhead;
+    message_t *next = __atomic_load_n (&head->next, __ATOMIC_ACQUIRE);
+    if (head == &stub) {
+        if (!next) {
+            return NULL;
+        }
+        mqhead = head = next;
+        next = __atomic_load_n (&head->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        mqhead = next;
+        return head;
+    }
+    if (head != __atomic_load_n (&mqtail, __ATOMIC_ACQUIRE)) {
+        return NULL;
     }
+    // the last message can only be taken after putting the stub behind it
+    _enqueue (&stub);
+    next = __atomic_load_n (&head->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        mqhead = next;
+        return head;
+    }
+    return NULL;
 }
 
 int
 messagepump_push (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
-    mutex_lock (mutex);
-    if (!mfree) {
-        mutex_unlock (mutex);
-        //fprintf (stderr, "WARNING: message queue is full! message ignored (%d %p %d %d)\n", id, (void*)ctx, p1, p2);
+    message_t *msg = _message_alloc ();
+    if (!msg) {
         if (id >= DB_EV_FIRST && ctx) {
             messagepump_event_free ((ddb_event_t *)ctx);
         }
         return -1;
     }
-    message_t *msg = mfree;
-    mfree = mfree->next;
-    if (mqtail) {
-        mqtail->next = msg;
-    }
-    mqtail = msg;
-    if (!mqueue) {
-        mqueue = msg;
-    }
-
-    msg->next = NULL;
     msg->id = id;
     msg->ctx = ctx;
     msg->p1 = p1;
     msg->p2 = p2;
-    mutex_unlock (mutex);
-    cond_signal (cond);
+    msg->coalesce_next = NULL;
+    _enqueue (msg);
+
+    // wake up the consumer, if it's sleeping or about to sleep
+    if (__atomic_exchange_n (&waiting, 0, __ATOMIC_SEQ_CST)) {
+        dispatch_semaphore_signal (semaphore);
+    }
     return 0;
 }
 
+static int
+_queue_has_messages (void) {
+    message_t *head = mqhead;
+    return head != &stub || __atomic_load_n (&head->next, __ATOMIC_SEQ_CST) != NULL;
+}
+
 void
 messagepump_wait (void) {
-    cond_wait (cond, mutex);
-    mutex_unlock (mutex);
+    if (pending) {
+        return;
+    }
+    __atomic_store_n (&waiting, 1, __ATOMIC_SEQ_CST);
+    if (_queue_has_messages ()) {
+        if (__atomic_exchange_n (&waiting, 0, __ATOMIC_SEQ_CST)) {
+            return;
+        }
+        // a producer has reset the flag, and is going to signal: consume the signal
+    }
+    dispatch_semaphore_wait (semaphore, DISPATCH_TIME_FOREVER);
+}
+
+#pragma mark - Coalescing
+
+// Notifications which only mean "something has changed, re-read the state".
+// When such a message is still pending, an identical one can be dropped,
+// because the state is read after both changes have happened.
+static int
+_is_coalescable (uint32_t id) {
+    switch (id) {
+    case DB_EV_CONFIGCHANGED:
+    case DB_EV_PLAYLISTCHANGED:
+    case DB_EV_VOLUMECHANGED:
+    case DB_EV_PLAYLISTSWITCHED:
+    case DB_EV_ACTIONSCHANGED:
+    case DB_EV_DSPCHAINCHANGED:
+    case DB_EV_SELCHANGED:
+    case DB_EV_TRACKINFOCHANGED:
+        return 1;
+    }
+    return 0;
+}
+
+// The events are compared by content, since each event is a separate allocation
+static uintptr_t
+_coalesce_ctx (message_t *m) {
+    if (m->id == DB_EV_TRACKINFOCHANGED && m->ctx) {
+        return (uintptr_t)((ddb_event_track_t *)m->ctx)->track;
+    }
+    return m->ctx;
 }
 
+static uint32_t
+_coalesce_hash (message_t *m) {
+    uintptr_t ctx = _coalesce_ctx (m);
+    uint32_t h = m->id * 31 + m->p1 * 17 + m->p2;
+    h ^= (uint32_t)(ctx >> 4) ^ (uint32_t)((uint64_t)ctx >> 32);
+    return h % COALESCE_HASH_SIZE;
+}
+
+static int
+_coalesce_equal (message_t *a, message_t *b) {
+    return a->id == b->id && a->p1 == b->p1 && a->p2 == b->p2 && _coalesce_ctx (a) == _coalesce_ctx (b);
+}
+
+// Moves the messages from the queue to the pending list, dropping duplicates
+static void
+_drain_queue (void) {
+    message_t *m;
+    while ((m = _dequeue ())) {
+        if (_is_coalescable (m->id)) {
+            message_t **bucket = &coalesce_hash[_coalesce_hash (m)];
+            message_t *dup;
+            for (dup = *bucket; dup; dup = dup->coalesce_next) {
+                if (_coalesce_equal (dup, m)) {
+                    break;
+                }
+            }
+            if (dup) {
+                if (m->id >= DB_EV_FIRST && m->ctx) {
+                    messagepump_event_free ((ddb_event_t *)m->ctx);
+                }
+                _message_free (m);
+                continue;
+            }
+            m->coalesce_next = *bucket;
+            *bucket = m;
+        }
+
+        m->next = NULL;
+        if (pending_tail) {
+            pending_tail->next = m;
+        }
+        else {
+            pending = m;
+        }
+        pending_tail = m;
+    }
+}
+
+#pragma mark -
+
 int
 messagepump_pop (uint32_t *id, uintptr_t *ctx, uint32_t *p1, uint32_t *p2) {
-    mutex_lock (mutex);
-    if (!mqueue) {
-        mutex_unlock (mutex);
+    _drain_queue ();
+
+    message_t *m = pending;
+    if (!m) {
         return -1;
     }
-    *id = mqueue->id;
-    *ctx = mqueue->ctx;
-    *p1 = mqueue->p1;
-    *p2 = mqueue->p2;
-    message_t *next = mqueue->next;
-    mqueue->next = mfree;
-    mfree = mqueue;
-    mqueue = next;
-    if (!mqueue) {
-        mqtail = NULL;
-    }
-    mutex_unlock (mutex);
+    pending = m->next;
+    if (!pending) {
+        pending_tail = NULL;
+    }
+
+    if (_is_coalescable (m->id)) {
+        message_t **pp = &coalesce_hash[_coalesce_hash (m)];
+        while (*pp != m) {
+            pp = &(*pp)->coalesce_next;
+        }
+        *pp = m->coalesce_next;
+    }
+
+    *id = m->id;
+    *ctx = m->ctx;
+    *p1 = m->p1;
+    *p2 = m->p2;
+    _message_free (m);
     return 0;
 }
 
 int
 messagepump_hasmessages (void) {
-    return mqueue ? 1 : 0;
+    return pending || _queue_has_messages ();
 }
 
 ddb_event_t *
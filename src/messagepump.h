@@ -36,7 +36,12 @@ extern "C" {
 
 int messagepump_init (void);
 void messagepump_free (void);
+
+// Lock-free, can be called from any thread.
+// Identical pending notifications, like DB_EV_PLAYLISTCHANGED, are coalesced.
 int messagepump_push (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2);
+
+// messagepump_pop and messagepump_wait must only be called from a single consumer thread
 int messagepump_pop (uint32_t *id, uintptr_t *ctx, uint32_t *p1, uint32_t *p2);
 void messagepump_wait (void);
 
@@ -11,4 +11,5 @@ PLUG(xgui)
 #endif
 #ifdef GOOGLETEST_STATIC
 PLUG(mp3)
+PLUG(ffap)
 #endif
@@ -72,6 +72,7 @@
 #include "sort.h"
 #include "cueutil.h"
 #include "playmodes.h"
+#include "decoderprofile.h"
 #include "undo/undomanager.h"
 #include "undo/undo_playlist.h"
 
@@ -988,13 +989,17 @@ plt_load_int (
 
 int
 fileadd_filter_test (ddb_file_found_data_t *data) {
+    decoder_profile_call_t call;
+    decoder_profile_begin (&call, "fileadd_filter");
+    int res = 0;
     for (ddb_fileadd_filter_t *f = file_add_filters; f; f = f->next) {
-        int res = f->callback (data, f->user_data);
+        res = f->callback (data, f->user_data);
         if (res < 0) {
-            return res;
+            break;
         }
     }
-    return 0;
+    decoder_profile_end (&call, DECODER_PROFILE_FILEADD_FILTER);
+    return res < 0 ? res : 0;
 }
 
 static playItem_t *
@@ -1164,7 +1169,10 @@ plt_insert_file_int (
 
     // handle cue files
     if (!strcasecmp (eol, "cue")) {
+        decoder_profile_call_t call;
+        decoder_profile_begin (&call, "cue");
         playItem_t *inserted = plt_load_cue_file (plt, after, fname, NULL, NULL, 0);
+        decoder_profile_end (&call, DECODER_PROFILE_CUE);
         if (callback_with_result) {
             callback_with_result (
                 inserted ? DDB_INSERT_FILE_RESULT_SUCCESS : DDB_INSERT_FILE_RESULT_CUESHEET_ERROR,
@@ -1514,7 +1522,10 @@ plt_insert_dir_int (
             dirname,
             namelist[i]->d_name);
 
+        decoder_profile_call_t call;
+        decoder_profile_begin (&call, "cue");
         playItem_t *inserted = plt_load_cue_file (plt, after, fullname, fulldir, namelist, n);
+        decoder_profile_end (&call, DECODER_PROFILE_CUE);
         namelist[i]->d_name[0] = 0;
 
         if (inserted) {
@@ -4416,6 +4427,8 @@ plt_add_files_end (playlist_t *plt, int visibility) {
     background_job_decrement ();
 
     plt_autosort (plt);
+
+    decoder_profile_dump ();
 }
 
 void
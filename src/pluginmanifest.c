@@ -0,0 +1,472 @@
+/*
+  This file is part of Deadbeef Player source code
+  http://deadbeef.sourceforge.net
+
+  plugin manifest: cached plugin properties for lazy loading
+
+  Copyright (C) 2009-2026 Oleksiy Yakovenko
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Oleksiy Yakovenko waker@users.sourceforge.net
+*/
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pluginmanifest.h"
+
+#define MANIFEST_VERSION 1
+
+plugin_manifest_t *
+plugin_manifest_alloc (void) {
+    return calloc (1, sizeof (plugin_manifest_t));
+}
+
+static void
+_free_list (char **list) {
+    if (!list) {
+        return;
+    }
+    for (int i = 0; list[i]; i++) {
+        free (list[i]);
+    }
+    free (list);
+}
+
+static void
+_entry_free (plugin_manifest_entry_t *entry) {
+    free (entry->path);
+    free (entry->id);
+    free (entry->name);
+    free (entry->descr);
+    free (entry->copyright);
+    free (entry->website);
+    free (entry->configdialog);
+    _free_list (entry->exts);
+    _free_list (entry->prefixes);
+    free (entry);
+}
+
+void
+plugin_manifest_free (plugin_manifest_t *manifest) {
+    while (manifest->entries) {
+        plugin_manifest_entry_t *next = manifest->entries->next;
+        _entry_free (manifest->entries);
+        manifest->entries = next;
+    }
+    free (manifest);
+}
+
+plugin_manifest_entry_t *
+plugin_manifest_append (plugin_manifest_t *manifest, const char *path, int64_t mtime, int64_t size, int lazy) {
+    plugin_manifest_entry_t *entry = calloc (1, sizeof (plugin_manifest_entry_t));
+    entry->path = strdup (path);
+    entry->mtime = mtime;
+    entry->size = size;
+    entry->lazy = lazy;
+    if (manifest->tail) {
+        manifest->tail->next = entry;
+    }
+    else {
+        manifest->entries = entry;
+    }
+    manifest->tail = entry;
+    return entry;
+}
+
+plugin_manifest_entry_t *
+plugin_manifest_find (plugin_manifest_t *manifest, const char *path, int64_t mtime, int64_t size) {
+    for (plugin_manifest_entry_t *entry = manifest->entries; entry; entry = entry->next) {
+        if (!strcmp (entry->path, path)) {
+            if (entry->mtime == mtime && entry->size == size) {
+                return entry;
+            }
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+char **
+plugin_manifest_copy_list (const char **list) {
+    if (!list) {
+        return NULL;
+    }
+    int count = 0;
+    while (list[count]) {
+        count++;
+    }
+    char **copy = calloc (count + 1, sizeof (char *));
+    for (int i = 0; i < count; i++) {
+        copy[i] = strdup (list[i]);
+    }
+    return copy;
+}
+
+static void
+_list_append (char ***list, const char *value) {
+    int count = 0;
+    if (*list) {
+        while ((*list)[count]) {
+            count++;
+        }
+    }
+    *list = realloc (*list, (count + 2) * sizeof (char *));
+    (*list)[count] = strdup (value);
+    (*list)[count+1] = NULL;
+}
+
+#pragma mark - Saving
+
+// Strings are written in double quotes, with quotes, backslashes and line breaks escaped
+static int
+_write_string (FILE *fp, const char *key, const char *value) {
+    if (!value) {
+        return 0;
+    }
+    if (fprintf (fp, "%s \"", key) < 0) {
+        return -1;
+    }
+    for (const char *p = value; *p; p++) {
+        int res;
+        switch (*p) {
+        case '"':
+            res = fputs ("\\\"", fp);
+            break;
+        case '\\':
+            res = fputs ("\\\\", fp);
+            break;
+        case '\n':
+            res = fputs ("\\n", fp);
+            break;
+        case '\r':
+            res = fputs ("\\r", fp);
+            break;
+        default:
+            res = fputc (*p, fp);
+            break;
+        }
+        if (res < 0) {
+            return -1;
+        }
+    }
+    if (fputs ("\"\n", fp) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+_write_entry (FILE *fp, plugin_manifest_entry_t *entry) {
+    if (_write_string (fp, "plugin", entry->path) < 0) {
+        return -1;
+    }
+    if (fprintf (fp, "stat %lld %lld\n", (long long)entry->mtime, (long long)entry->size) < 0) {
+        return -1;
+    }
+    if (entry->lazy) {
+        if (fprintf (fp, "lazy %d %d %d %d %d %u %u\n",
+                     (int)entry->type,
+                     (int)entry->api_vmajor, (int)entry->api_vminor,
+                     (int)entry->version_major, (int)entry->version_minor,
+                     (unsigned)entry->flags, (unsigned)entry->methods) < 0) {
+            return -1;
+        }
+        if (_write_string (fp, "id", entry->id) < 0
+            || _write_string (fp, "name", entry->name) < 0
+            || _write_string (fp, "descr", entry->descr) < 0
+            || _write_string (fp, "copyright", entry->copyright) < 0
+            || _write_string (fp, "website", entry->website) < 0
+            || _write_string (fp, "configdialog", entry->configdialog) < 0) {
+            return -1;
+        }
+        for (int i = 0; entry->exts && entry->exts[i]; i++) {
+            if (_write_string (fp, "ext", entry->exts[i]) < 0) {
+                return -1;
+            }
+        }
+        if (entry->exts && !entry->exts[0] && fputs ("noexts\n", fp) < 0) {
+            return -1;
+        }
+        for (int i = 0; entry->prefixes && entry->prefixes[i]; i++) {
+            if (_write_string (fp, "prefix", entry->prefixes[i]) < 0) {
+                return -1;
+            }
+        }
+    }
+    if (fputs ("end\n", fp) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int
+plugin_manifest_save (plugin_manifest_t *manifest, const char *fname) {
+    char tempfile[PATH_MAX];
+    snprintf (tempfile, sizeof (tempfile), "%s.part", fname);
+    FILE *fp = fopen (tempfile, "w+b");
+    if (!fp) {
+        fprintf (stderr, "failed to open %s for writing (%s)\n", tempfile, strerror (errno));
+        return -1;
+    }
+
+    if (fprintf (fp, "# DeaDBeeF plugin manifest, regenerated automatically\nversion %d\n", MANIFEST_VERSION) < 0) {
+        goto error;
+    }
+    for (plugin_manifest_entry_t *entry = manifest->entries; entry; entry = entry->next) {
+        if (_write_entry (fp, entry) < 0) {
+            goto error;
+        }
+    }
+
+    if (fclose (fp) == EOF) {
+        fp = NULL;
+        goto error;
+    }
+    if (rename (tempfile, fname) != 0) {
+        fprintf (stderr, "plugin manifest rename %s -> %s failed: %s\n", tempfile, fname, strerror (errno));
+        unlink (tempfile);
+        return -1;
+    }
+    return 0;
+error:
+    fprintf (stderr, "write to %s failed (%s)\n", tempfile, strerror (errno));
+    if (fp) {
+        fclose (fp);
+    }
+    unlink (tempfile);
+    return -1;
+}
+
+#pragma mark - Loading
+
+// Parses a quoted string in place, returns NULL on format error
+static char *
+_parse_string (char *p) {
+    while (*p == ' ') {
+        p++;
+    }
+    if (*p != '"') {
+        return NULL;
+    }
+    p++;
+    char *value = p;
+    char *out = p;
+    for (;;) {
+        if (*p == 0) {
+            return NULL;
+        }
+        if (*p == '"') {
+            break;
+        }
+        if (*p == '\\') {
+            p++;
+            switch (*p) {
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            case '"':
+            case '\\':
+                *out++ = *p;
+                break;
+            default:
+                return NULL;
+            }
+            p++;
+            continue;
+        }
+        *out++ = *p++;
+    }
+    *out = 0;
+    return value;
+}
+
+static int
+_parse_line (plugin_manifest_t *manifest, plugin_manifest_entry_t **current, char *line) {
+    char *value = strchr (line, ' ');
+    if (value) {
+        *value++ = 0;
+    }
+    else {
+        value = line + strlen (line);
+    }
+
+    plugin_manifest_entry_t *entry = *current;
+
+    if (!strcmp (line, "plugin")) {
+        if (entry) {
+            return -1;
+        }
+        char *path = _parse_string (value);
+        if (!path) {
+            return -1;
+        }
+        *current = plugin_manifest_append (manifest, path, -1, -1, 0);
+        return 0;
+    }
+
+    if (!entry) {
+        return -1;
+    }
+
+    if (!strcmp (line, "end")) {
+        *current = NULL;
+        return 0;
+    }
+    if (!strcmp (line, "stat")) {
+        long long mtime, size;
+        if (2 != sscanf (value, "%lld %lld", &mtime, &size)) {
+            return -1;
+        }
+        entry->mtime = mtime;
+        entry->size = size;
+        return 0;
+    }
+    if (!strcmp (line, "lazy")) {
+        int type, api_vmajor, api_vminor, version_major, version_minor;
+        unsigned flags, methods;
+        if (7 != sscanf (value, "%d %d %d %d %d %u %u", &type, &api_vmajor, &api_vminor, &version_major, &version_minor, &flags, &methods)) {
+            return -1;
+        }
+        entry->lazy = 1;
+        entry->type = type;
+        entry->api_vmajor = api_vmajor;
+        entry->api_vminor = api_vminor;
+        entry->version_major = version_major;
+        entry->version_minor = version_minor;
+        entry->flags = flags;
+        entry->methods = methods;
+        return 0;
+    }
+    if (!strcmp (line, "noexts")) {
+        if (!entry->exts) {
+            entry->exts = calloc (1, sizeof (char *));
+        }
+        return 0;
+    }
+
+    char *s = _parse_string (value);
+    if (!s) {
+        return -1;
+    }
+
+    char **field = NULL;
+    if (!strcmp (line, "id")) {
+        field = &entry->id;
+    }
+    else if (!strcmp (line, "name")) {
+        field = &entry->name;
+    }
+    else if (!strcmp (line, "descr")) {
+        field = &entry->descr;
+    }
+    else if (!strcmp (line, "copyright")) {
+        field = &entry->copyright;
+    }
+    else if (!strcmp (line, "website")) {
+        field = &entry->website;
+    }
+    else if (!strcmp (line, "configdialog")) {
+        field = &entry->configdialog;
+    }
+    else if (!strcmp (line, "ext")) {
+        _list_append (&entry->exts, s);
+        return 0;
+    }
+    else if (!strcmp (line, "prefix")) {
+        _list_append (&entry->prefixes, s);
+        return 0;
+    }
+    else {
+        // unknown keys are ignored
+        return 0;
+    }
+    free (*field);
+    *field = strdup (s);
+    return 0;
+}
+
+plugin_manifest_t *
+plugin_manifest_load (const char *fname) {
+    FILE *fp = fopen (fname, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    if (fseek (fp, 0, SEEK_END)) {
+        fclose (fp);
+        return NULL;
+    }
+    long size = ftell (fp);
+    rewind (fp);
+    if (size <= 0) {
+        fclose (fp);
+        return NULL;
+    }
+    char *buffer = malloc (size + 1);
+    if (fread (buffer, 1, size, fp) != (size_t)size) {
+        free (buffer);
+        fclose (fp);
+        return NULL;
+    }
+    buffer[size] = 0;
+    fclose (fp);
+
+    plugin_manifest_t *manifest = plugin_manifest_alloc ();
+    plugin_manifest_entry_t *current = NULL;
+    int version = 0;
+    int res = 0;
+
+    char *line = buffer;
+    while (*line) {
+        char *eol = strchr (line, '\n');
+        if (eol) {
+            *eol = 0;
+        }
+
+        if (line[0] == '#' || line[0] == 0) {
+            // comment or empty line
+        }
+        else if (!version) {
+            if (1 != sscanf (line, "version %d", &version) || version != MANIFEST_VERSION) {
+                res = -1;
+                break;
+            }
+        }
+        else if (_parse_line (manifest, &current, line) < 0) {
+            res = -1;
+            break;
+        }
+
+        if (!eol) {
+            break;
+        }
+        line = eol + 1;
+    }
+    free (buffer);
+
+    if (res < 0 || current || !version) {
+        plugin_manifest_free (manifest);
+        return NULL;
+    }
+    return manifest;
+}
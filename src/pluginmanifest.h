@@ -0,0 +1,117 @@
+/*
+  This file is part of Deadbeef Player source code
+  http://deadbeef.sourceforge.net
+
+  plugin manifest: cached plugin properties for lazy loading
+
+  Copyright (C) 2009-2026 Oleksiy Yakovenko
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Oleksiy Yakovenko waker@users.sourceforge.net
+*/
+#ifndef __PLUGINMANIFEST_H
+#define __PLUGINMANIFEST_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Which optional decoder methods the plugin implements
+enum {
+    PLUGIN_MANIFEST_HAS_OPEN = 1<<0,
+    PLUGIN_MANIFEST_HAS_OPEN2 = 1<<1,
+    PLUGIN_MANIFEST_HAS_INIT = 1<<2,
+    PLUGIN_MANIFEST_HAS_FREE = 1<<3,
+    PLUGIN_MANIFEST_HAS_READ = 1<<4,
+    PLUGIN_MANIFEST_HAS_SEEK = 1<<5,
+    PLUGIN_MANIFEST_HAS_SEEK_SAMPLE = 1<<6,
+    PLUGIN_MANIFEST_HAS_INSERT = 1<<7,
+    PLUGIN_MANIFEST_HAS_NUMVOICES = 1<<8,
+    PLUGIN_MANIFEST_HAS_MUTEVOICE = 1<<9,
+    PLUGIN_MANIFEST_HAS_READ_METADATA = 1<<10,
+    PLUGIN_MANIFEST_HAS_WRITE_METADATA = 1<<11,
+    PLUGIN_MANIFEST_HAS_SEEK_SAMPLE64 = 1<<12,
+};
+
+// Properties of a plugin file, recorded the last time it was loaded.
+// Files which have not changed since then can be registered without loading them,
+// unless the entry is not lazy: such plugins are always loaded at startup.
+typedef struct plugin_manifest_entry_s {
+    struct plugin_manifest_entry_s *next;
+    char *path;
+    int64_t mtime;
+    int64_t size;
+    int lazy;
+
+    // the following is only valid for lazy entries
+    int32_t type;
+    int16_t api_vmajor;
+    int16_t api_vminor;
+    int16_t version_major;
+    int16_t version_minor;
+    uint32_t flags;
+    uint32_t methods;
+    char *id;
+    char *name;
+    char *descr;
+    char *copyright;
+    char *website;
+    char *configdialog;
+    char **exts; // NULL-terminated, or NULL
+    char **prefixes; // NULL-terminated, or NULL
+
+    int used; // set when the entry was matched during the current startup
+} plugin_manifest_entry_t;
+
+typedef struct {
+    plugin_manifest_entry_t *entries;
+    plugin_manifest_entry_t *tail;
+} plugin_manifest_t;
+
+plugin_manifest_t *
+plugin_manifest_alloc (void);
+
+void
+plugin_manifest_free (plugin_manifest_t *manifest);
+
+// Returns NULL if the file doesn't exist or has wrong format
+plugin_manifest_t *
+plugin_manifest_load (const char *fname);
+
+int
+plugin_manifest_save (plugin_manifest_t *manifest, const char *fname);
+
+// Returns the entry for the file, if its modification time and size match
+plugin_manifest_entry_t *
+plugin_manifest_find (plugin_manifest_t *manifest, const char *path, int64_t mtime, int64_t size);
+
+// Appends a new empty entry, the strings are copied from the arguments
+plugin_manifest_entry_t *
+plugin_manifest_append (plugin_manifest_t *manifest, const char *path, int64_t mtime, int64_t size, int lazy);
+
+// Returns a NULL-terminated copy of the string list, or NULL
+char **
+plugin_manifest_copy_list (const char **list);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
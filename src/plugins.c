@@ -65,6 +65,8 @@
 #include "logger.h"
 #include "replaygain.h"
 #include "playmodes.h"
+#include "pluginmanifest.h"
+#include "decoderprofile.h"
 #ifdef __APPLE__
 #include "cocoautil.h"
 #endif
@@ -95,12 +97,23 @@ const char *lowprio_plugin_ids[] = {
     NULL
 };
 
+// decoders which build their extension lists from the config,
+// so they are always loaded at startup, even when listed in the manifest
+const char *eager_plugin_ids[] = {
+    "ffmpeg",
+    "sndfile",
+    NULL
+};
+
+struct lazy_decoder_s;
+
 // internal plugin list
 typedef struct plugin_s {
     void *handle;
     char *filepath;
     DB_plugin_t *plugin;
     void (*async_deinit)(void (*completion_callback)(DB_plugin_t *plugin));
+    struct lazy_decoder_s *lazy; // set when the plugin was registered from the manifest
     struct plugin_s *next;
 } plugin_t;
 
@@ -454,7 +467,7 @@ static DB_functions_t deadbeef_api = {
     .conf_set_float = conf_set_float,
     .conf_find = conf_find,
     .conf_remove_items = conf_remove_items,
-    .conf_save = conf_save,
+    .conf_save = conf_save_deferred,
     // plugin communication
     .plug_get_decoder_list = plug_get_decoder_list,
     .plug_get_vfs_list = plug_get_vfs_list,
@@ -613,6 +626,10 @@ static DB_functions_t deadbeef_api = {
     .plt_load_from_buffer = (int (*) (ddb_playlist_t *plt, const uint8_t *buffer, size_t size))plt_load_from_buffer,
     .plt_save_to_buffer = (ssize_t (*) (ddb_playlist_t *plt, uint8_t **out_buffer))plt_save_to_buffer,
     .plug_register_for_async_deinit = _plug_register_for_async_deinit,
+    .conf_subscribe = conf_subscribe,
+    .conf_unsubscribe = conf_unsubscribe,
+    .pcm_interleave = pcm_interleave,
+    .junk_read_tags = (int (*)(DB_playItem_t *it, DB_FILE *fp, uint32_t *head, uint32_t *tail))junk_read_tags,
 };
 
 DB_functions_t *deadbeef = &deadbeef_api;
@@ -729,13 +746,466 @@ plug_playback_set_pos (float pos) {
     streamer_set_seek (t);
 }
 
-int
-plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
-    DB_plugin_t *plugin_api = loadfunc (&deadbeef_api);
-    if (!plugin_api) {
+#pragma mark - Lazy loading
+
+// Decoders which are listed in the plugin manifest, and haven't changed since,
+// are registered using a proxy built from the manifest data, without loading the plugin.
+// The plugin is loaded on the first call which needs it (open, insert, read/write metadata),
+// after which the proxy is replaced by the real plugin in the plugin lists.
+// The callers which kept the proxy pointer keep working, since the proxy forwards all the calls.
+
+#ifndef ANDROID
+#define ENABLE_LAZY_LOADING 1
+#else
+#define ENABLE_LAZY_LOADING 0
+#endif
+
+#define PLUGIN_MANIFEST_FNAME "plugins.manifest"
+
+static plugin_t *
+_plug_register (DB_plugin_t *plugin_api, void *handle);
+
+typedef struct lazy_decoder_s {
+    ddb_decoder2_t decoder; // the proxy, must be the first member
+    int slot;
+    plugin_t *plug;
+    DB_decoder_t *real;
+    int failed;
+} lazy_decoder_t;
+
+// the methods without the fileinfo argument need to know which plugin is called,
+// so every proxy gets its own set of forwarding functions
+#define MAX_LAZY_DECODERS 50
+
+static lazy_decoder_t *_lazy_decoders[MAX_LAZY_DECODERS];
+static int _num_lazy_decoders;
+static uintptr_t _lazy_mutex;
+
+// the manifest loaded at startup, owns the strings of the proxies
+static plugin_manifest_t *_manifest;
+static int _manifest_dirty;
+
+static void
+_lazy_decoder_free (lazy_decoder_t *lazy) {
+    if (!lazy) {
+        return;
+    }
+    _lazy_decoders[lazy->slot] = NULL;
+    free (lazy);
+}
+
+static void
+_replace_plugin_ptr (DB_plugin_t *from, DB_plugin_t *to) {
+    for (int i = 0; g_plugins[i]; i++) {
+        if (g_plugins[i] == from) {
+            g_plugins[i] = to;
+            break;
+        }
+    }
+    for (int i = 0; g_decoder_plugins[i]; i++) {
+        if (g_decoder_plugins[i] == (DB_decoder_t *)from) {
+            g_decoder_plugins[i] = (DB_decoder_t *)to;
+            break;
+        }
+    }
+}
+
+static void
+_lazy_load (lazy_decoder_t *lazy) {
+    plugin_t *plug = lazy->plug;
+    DB_plugin_t *proxy = &lazy->decoder.decoder.plugin;
+    trace ("loading plugin %s on first use\n", plug->filepath);
+
+    void *handle = dlopen (plug->filepath, RTLD_NOW);
+    if (!handle) {
+        trace_err ("dlopen error: %s\n", dlerror ());
+        goto error;
+    }
+
+    char loadname[256];
+    const char *fname = strrchr (plug->filepath, '/');
+    fname = fname ? fname + 1 : plug->filepath;
+    snprintf (loadname, sizeof (loadname), "%s", fname);
+    char *ext = strstr (loadname, ".fallback" PLUGINEXT);
+    if (!ext) {
+        ext = loadname + strlen (loadname) - sizeof (PLUGINEXT) + 1;
+    }
+    if (ext < loadname) {
+        dlclose (handle);
+        goto error;
+    }
+    strcpy (ext, "_load");
+
+    DB_plugin_t *(*plug_load)(DB_functions_t *api) = dlsym (handle, loadname);
+    DB_plugin_t *real = plug_load ? plug_load (&deadbeef_api) : NULL;
+    if (!real || real->type != DB_PLUGIN_DECODER || !real->id || strcmp (real->id, proxy->id)) {
+        trace_err ("plugin %s doesn't match the manifest\n", plug->filepath);
+        dlclose (handle);
+        goto error;
+    }
+
+    plug->handle = handle;
+    plug->plugin = real;
+    if (real->start && real->start () < 0) {
+        trace_err ("plugin %s failed to start, deactivated.\n", real->name);
+        if (real->stop) {
+            real->stop ();
+        }
+        plug->plugin = proxy;
+        plug->handle = NULL;
+        dlclose (handle);
+        goto error;
+    }
+
+    // from now on the plugin lists return the real plugin, and it receives the messages
+    _replace_plugin_ptr (proxy, real);
+    decoder_profile_wrap ((DB_decoder_t *)real);
+    lazy->real = (DB_decoder_t *)real;
+    return;
+error:
+    lazy->failed = 1;
+    // make sure the next start doesn't trust the manifest
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/" PLUGIN_MANIFEST_FNAME, dbcachedir);
+    unlink (path);
+}
+
+static DB_decoder_t *
+_lazy_resolve (int slot) {
+    mutex_lock (_lazy_mutex);
+    lazy_decoder_t *lazy = _lazy_decoders[slot];
+    if (lazy && !lazy->real && !lazy->failed) {
+        _lazy_load (lazy);
+    }
+    DB_decoder_t *dec = lazy ? lazy->real : NULL;
+    mutex_unlock (_lazy_mutex);
+    return dec;
+}
+
+static DB_fileinfo_t *
+_lazy_open (int slot, uint32_t hints) {
+    DB_decoder_t *dec = _lazy_resolve (slot);
+    return dec && dec->open ? dec->open (hints) : NULL;
+}
+
+static DB_fileinfo_t *
+_lazy_open2 (int slot, uint32_t hints, DB_playItem_t *it) {
+    DB_decoder_t *dec = _lazy_resolve (slot);
+    if (!dec) {
+        return NULL;
+    }
+    if (dec->plugin.api_vminor >= 7 && dec->open2) {
+        return dec->open2 (hints, it);
+    }
+    return dec->open ? dec->open (hints) : NULL;
+}
+
+static DB_playItem_t *
+_lazy_insert (int slot, ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
+    DB_decoder_t *dec = _lazy_resolve (slot);
+    return dec && dec->insert ? dec->insert (plt, after, fname) : NULL;
+}
+
+static int
+_lazy_read_metadata (int slot, DB_playItem_t *it) {
+    DB_decoder_t *dec = _lazy_resolve (slot);
+    return dec && dec->read_metadata ? dec->read_metadata (it) : -1;
+}
+
+static int
+_lazy_write_metadata (int slot, DB_playItem_t *it) {
+    DB_decoder_t *dec = _lazy_resolve (slot);
+    return dec && dec->write_metadata ? dec->write_metadata (it) : -1;
+}
+
+typedef struct {
+    DB_fileinfo_t *(*open) (uint32_t hints);
+    DB_fileinfo_t *(*open2) (uint32_t hints, DB_playItem_t *it);
+    DB_playItem_t *(*insert) (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname);
+    int (*read_metadata) (DB_playItem_t *it);
+    int (*write_metadata) (DB_playItem_t *it);
+} lazy_slot_methods_t;
+
+#define LAZY_SLOT(n)\
+static DB_fileinfo_t *_lazy_open_##n (uint32_t hints) { return _lazy_open (n, hints); }\
+static DB_fileinfo_t *_lazy_open2_##n (uint32_t hints, DB_playItem_t *it) { return _lazy_open2 (n, hints, it); }\
+static DB_playItem_t *_lazy_insert_##n (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) { return _lazy_insert (n, plt, after, fname); }\
+static int _lazy_read_metadata_##n (DB_playItem_t *it) { return _lazy_read_metadata (n, it); }\
+static int _lazy_write_metadata_##n (DB_playItem_t *it) { return _lazy_write_metadata (n, it); }
+
+#define LAZY_SLOT_METHODS(n) { _lazy_open_##n, _lazy_open2_##n, _lazy_insert_##n, _lazy_read_metadata_##n, _lazy_write_metadata_##n },
+
+#define LAZY_SLOTS_10(M,d) M(d##0) M(d##1) M(d##2) M(d##3) M(d##4) M(d##5) M(d##6) M(d##7) M(d##8) M(d##9)
+#define LAZY_SLOTS(M) LAZY_SLOTS_10(M,) LAZY_SLOTS_10(M,1) LAZY_SLOTS_10(M,2) LAZY_SLOTS_10(M,3) LAZY_SLOTS_10(M,4)
+
+LAZY_SLOTS(LAZY_SLOT)
+
+static const lazy_slot_methods_t _lazy_slot_methods[MAX_LAZY_DECODERS] = {
+    LAZY_SLOTS(LAZY_SLOT_METHODS)
+};
+
+// The methods with the fileinfo argument are called after open, which sets info->plugin to the real plugin
+
+static int
+_lazy_init (DB_fileinfo_t *info, DB_playItem_t *it) {
+    return info->plugin->init (info, it);
+}
+
+static void
+_lazy_free (DB_fileinfo_t *info) {
+    info->plugin->free (info);
+}
+
+static int
+_lazy_read (DB_fileinfo_t *info, char *buffer, int nbytes) {
+    return info->plugin->read (info, buffer, nbytes);
+}
+
+static int
+_lazy_seek (DB_fileinfo_t *info, float seconds) {
+    return info->plugin->seek (info, seconds);
+}
+
+static int
+_lazy_seek_sample (DB_fileinfo_t *info, int sample) {
+    return info->plugin->seek_sample (info, sample);
+}
+
+static int
+_lazy_seek_sample64 (DB_fileinfo_t *info, int64_t sample) {
+    return ((ddb_decoder2_t *)info->plugin)->seek_sample64 (info, sample);
+}
+
+static int
+_lazy_numvoices (DB_fileinfo_t *info) {
+    return info->plugin->numvoices (info);
+}
+
+static void
+_lazy_mutevoice (DB_fileinfo_t *info, int voice, int mute) {
+    info->plugin->mutevoice (info, voice, mute);
+}
+
+// Registers a proxy for the manifest entry. Returns -1 if the plugin needs to be loaded now.
+static int
+_lazy_register (plugin_manifest_entry_t *entry) {
+    if (_num_lazy_decoders >= MAX_LAZY_DECODERS || entry->type != DB_PLUGIN_DECODER || !entry->id) {
         return -1;
     }
 
+    lazy_decoder_t *lazy = calloc (1, sizeof (lazy_decoder_t));
+    DB_decoder_t *dec = &lazy->decoder.decoder;
+    dec->plugin.type = entry->type;
+    dec->plugin.api_vmajor = entry->api_vmajor;
+    dec->plugin.api_vminor = entry->api_vminor;
+    dec->plugin.version_major = entry->version_major;
+    dec->plugin.version_minor = entry->version_minor;
+    dec->plugin.flags = entry->flags;
+    dec->plugin.id = entry->id;
+    dec->plugin.name = entry->name;
+    dec->plugin.descr = entry->descr;
+    dec->plugin.copyright = entry->copyright;
+    dec->plugin.website = entry->website;
+    dec->plugin.configdialog = entry->configdialog;
+    dec->exts = (const char **)entry->exts;
+    dec->prefixes = (const char **)entry->prefixes;
+
+    int slot = _num_lazy_decoders;
+    const lazy_slot_methods_t *methods = &_lazy_slot_methods[slot];
+    uint32_t has = entry->methods;
+    dec->open = (has & PLUGIN_MANIFEST_HAS_OPEN) ? methods->open : NULL;
+    dec->open2 = (has & PLUGIN_MANIFEST_HAS_OPEN2) ? methods->open2 : NULL;
+    dec->insert = (has & PLUGIN_MANIFEST_HAS_INSERT) ? methods->insert : NULL;
+    dec->read_metadata = (has & PLUGIN_MANIFEST_HAS_READ_METADATA) ? methods->read_metadata : NULL;
+    dec->write_metadata = (has & PLUGIN_MANIFEST_HAS_WRITE_METADATA) ? methods->write_metadata : NULL;
+    dec->init = (has & PLUGIN_MANIFEST_HAS_INIT) ? _lazy_init : NULL;
+    dec->free = (has & PLUGIN_MANIFEST_HAS_FREE) ? _lazy_free : NULL;
+    dec->read = (has & PLUGIN_MANIFEST_HAS_READ) ? _lazy_read : NULL;
+    dec->seek = (has & PLUGIN_MANIFEST_HAS_SEEK) ? _lazy_seek : NULL;
+    dec->seek_sample = (has & PLUGIN_MANIFEST_HAS_SEEK_SAMPLE) ? _lazy_seek_sample : NULL;
+    dec->numvoices = (has & PLUGIN_MANIFEST_HAS_NUMVOICES) ? _lazy_numvoices : NULL;
+    dec->mutevoice = (has & PLUGIN_MANIFEST_HAS_MUTEVOICE) ? _lazy_mutevoice : NULL;
+    if (entry->flags & DDB_PLUGIN_FLAG_IMPLEMENTS_DECODER2) {
+        lazy->decoder.seek_sample64 = (has & PLUGIN_MANIFEST_HAS_SEEK_SAMPLE64) ? _lazy_seek_sample64 : NULL;
+    }
+
+    plugin_t *plug = _plug_register (&dec->plugin, NULL);
+    if (!plug) {
+        free (lazy);
+        // the plugin is rejected, so the proxy is as good as the real one
+        return 0;
+    }
+
+    lazy->slot = slot;
+    lazy->plug = plug;
+    _lazy_decoders[slot] = lazy;
+    _num_lazy_decoders++;
+    plug->lazy = lazy;
+    plug->filepath = strdup (entry->path);
+    trace ("registered plugin %s from the manifest\n", entry->id);
+    return 0;
+}
+
+static int
+_plugin_can_load_lazily (plugin_t *p) {
+    DB_plugin_t *plugin = p->plugin;
+    if (!p->filepath || plugin->type != DB_PLUGIN_DECODER || !plugin->id) {
+        return 0;
+    }
+    // the plugins which interact with other plugins, or provide UI actions, must be loaded at startup
+    if (plugin->command || plugin->connect || plugin->disconnect || plugin->exec_cmdline || plugin->get_actions || p->async_deinit) {
+        return 0;
+    }
+    for (int i = 0; eager_plugin_ids[i]; i++) {
+        if (!strcmp (eager_plugin_ids[i], plugin->id)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void
+_manifest_add_plugin (plugin_manifest_t *manifest, plugin_t *p, const struct stat *st) {
+    if (p->lazy && !p->lazy->real) {
+        // still not loaded, copy the old entry
+        plugin_manifest_entry_t *old = plugin_manifest_find (_manifest, p->filepath, st->st_mtime, st->st_size);
+        if (!old) {
+            return;
+        }
+        plugin_manifest_entry_t *entry = plugin_manifest_append (manifest, p->filepath, st->st_mtime, st->st_size, 1);
+        entry->type = old->type;
+        entry->api_vmajor = old->api_vmajor;
+        entry->api_vminor = old->api_vminor;
+        entry->version_major = old->version_major;
+        entry->version_minor = old->version_minor;
+        entry->flags = old->flags;
+        entry->methods = old->methods;
+        entry->id = old->id ? strdup (old->id) : NULL;
+        entry->name = old->name ? strdup (old->name) : NULL;
+        entry->descr = old->descr ? strdup (old->descr) : NULL;
+        entry->copyright = old->copyright ? strdup (old->copyright) : NULL;
+        entry->website = old->website ? strdup (old->website) : NULL;
+        entry->configdialog = old->configdialog ? strdup (old->configdialog) : NULL;
+        entry->exts = plugin_manifest_copy_list ((const char **)old->exts);
+        entry->prefixes = plugin_manifest_copy_list ((const char **)old->prefixes);
+        return;
+    }
+
+    int lazy = _plugin_can_load_lazily (p);
+    plugin_manifest_entry_t *entry = plugin_manifest_append (manifest, p->filepath, st->st_mtime, st->st_size, lazy);
+    if (!lazy) {
+        return;
+    }
+
+    DB_decoder_t *dec = (DB_decoder_t *)p->plugin;
+    entry->type = dec->plugin.type;
+    entry->api_vmajor = dec->plugin.api_vmajor;
+    entry->api_vminor = dec->plugin.api_vminor;
+    entry->version_major = dec->plugin.version_major;
+    entry->version_minor = dec->plugin.version_minor;
+    entry->flags = dec->plugin.flags;
+    entry->id = strdup (dec->plugin.id);
+    entry->name = dec->plugin.name ? strdup (dec->plugin.name) : NULL;
+    entry->descr = dec->plugin.descr ? strdup (dec->plugin.descr) : NULL;
+    entry->copyright = dec->plugin.copyright ? strdup (dec->plugin.copyright) : NULL;
+    entry->website = dec->plugin.website ? strdup (dec->plugin.website) : NULL;
+    entry->configdialog = dec->plugin.configdialog ? strdup (dec->plugin.configdialog) : NULL;
+    entry->exts = plugin_manifest_copy_list (dec->exts);
+    entry->prefixes = plugin_manifest_copy_list (dec->prefixes);
+
+    uint32_t has = 0;
+    has |= dec->open ? PLUGIN_MANIFEST_HAS_OPEN : 0;
+    has |= dec->plugin.api_vminor >= 7 && dec->open2 ? PLUGIN_MANIFEST_HAS_OPEN2 : 0;
+    has |= dec->init ? PLUGIN_MANIFEST_HAS_INIT : 0;
+    has |= dec->free ? PLUGIN_MANIFEST_HAS_FREE : 0;
+    has |= dec->read ? PLUGIN_MANIFEST_HAS_READ : 0;
+    has |= dec->seek ? PLUGIN_MANIFEST_HAS_SEEK : 0;
+    has |= dec->seek_sample ? PLUGIN_MANIFEST_HAS_SEEK_SAMPLE : 0;
+    has |= dec->insert ? PLUGIN_MANIFEST_HAS_INSERT : 0;
+    has |= dec->numvoices ? PLUGIN_MANIFEST_HAS_NUMVOICES : 0;
+    has |= dec->mutevoice ? PLUGIN_MANIFEST_HAS_MUTEVOICE : 0;
+    has |= dec->read_metadata ? PLUGIN_MANIFEST_HAS_READ_METADATA : 0;
+    has |= dec->write_metadata ? PLUGIN_MANIFEST_HAS_WRITE_METADATA : 0;
+    if ((dec->plugin.flags & DDB_PLUGIN_FLAG_IMPLEMENTS_DECODER2) && ((ddb_decoder2_t *)dec)->seek_sample64) {
+        has |= PLUGIN_MANIFEST_HAS_SEEK_SAMPLE64;
+    }
+    entry->methods = has;
+}
+
+static void
+_manifest_open (void) {
+#if ENABLE_LAZY_LOADING
+    _manifest_dirty = 0;
+    if (_manifest || !conf_get_int ("plugins.lazy_loading", 1)) {
+        return;
+    }
+    if (!_lazy_mutex) {
+        _lazy_mutex = mutex_create ();
+    }
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/" PLUGIN_MANIFEST_FNAME, dbcachedir);
+    _manifest = plugin_manifest_load (path);
+    if (!_manifest) {
+        _manifest = plugin_manifest_alloc ();
+    }
+#endif
+}
+
+// Returns 1 if the plugin file was registered from the manifest
+static int
+_manifest_register_plugin (const char *fullname, const struct stat *st) {
+    if (!_manifest) {
+        return 0;
+    }
+    plugin_manifest_entry_t *entry = plugin_manifest_find (_manifest, fullname, st->st_mtime, st->st_size);
+    if (!entry) {
+        _manifest_dirty = 1;
+        return 0;
+    }
+    entry->used = 1;
+    if (!entry->lazy) {
+        return 0;
+    }
+    return _lazy_register (entry) == 0;
+}
+
+// Rewrites the manifest after plugins were added, updated or removed
+static void
+_manifest_update (void) {
+    if (!_manifest) {
+        return;
+    }
+    for (plugin_manifest_entry_t *entry = _manifest->entries; entry; entry = entry->next) {
+        if (!entry->used) {
+            _manifest_dirty = 1;
+            break;
+        }
+    }
+    if (!_manifest_dirty) {
+        return;
+    }
+
+    plugin_manifest_t *manifest = plugin_manifest_alloc ();
+    for (plugin_t *p = plugins; p; p = p->next) {
+        struct stat st;
+        if (!p->filepath || stat (p->filepath, &st)) {
+            continue;
+        }
+        _manifest_add_plugin (manifest, p, &st);
+    }
+
+    mkdir (dbcachedir, 0755);
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/" PLUGIN_MANIFEST_FNAME, dbcachedir);
+    plugin_manifest_save (manifest, path);
+    plugin_manifest_free (manifest);
+    _manifest_dirty = 0;
+}
+
+#pragma mark -
+
+static plugin_t *
+_plug_register (DB_plugin_t *plugin_api, void *handle) {
     // check if same plugin with the same or bigger version is loaded already
     plugin_t *prev = NULL;
     for (plugin_t *p = plugins; p; prev = p, p = p->next) {
@@ -745,22 +1215,26 @@ plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
             if (plugin_api->version_major > p->plugin->version_major || (plugin_api->version_major == p->plugin->version_major && plugin_api->version_minor > p->plugin->version_minor)) {
                 trace_err ("found newer version of plugin \"%s\" (%s), replacing\n", plugin_api->id, plugin_api->name);
                 // unload older plugin before replacing
-                dlclose (p->handle);
                 if (prev) {
                     prev->next = p->next;
                 }
                 else {
                     plugins = p->next;
                 }
+                if (plugins_tail == p) {
+                    plugins_tail = prev;
+                }
                 if (p->handle) {
                     dlclose (p->handle);
                 }
+                _lazy_decoder_free (p->lazy);
+                free (p->filepath);
                 free (p);
                 break;
             }
             else {
                 trace_err ("found copy of plugin \"%s\" (%s), but newer version is already loaded\n", plugin_api->id, plugin_api->name)
-                return -1;
+                return NULL;
             }
         }
     }
@@ -771,7 +1245,7 @@ plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
         if (DB_API_VERSION_MAJOR != 9 || DB_API_VERSION_MINOR != 9) {
             if (plugin_api->api_vmajor != DB_API_VERSION_MAJOR || plugin_api->api_vminor > DB_API_VERSION_MINOR) {
                 trace_err ("WARNING: plugin \"%s\" wants API v%d.%d (got %d.%d), will not be loaded\n", plugin_api->name, plugin_api->api_vmajor, plugin_api->api_vminor, DB_API_VERSION_MAJOR, DB_API_VERSION_MINOR);
-                return -1;
+                return NULL;
             }
         }
     }
@@ -812,7 +1286,17 @@ plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
         }
     }
 
-    return 0;
+    return plug;
+}
+
+int
+plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
+    DB_plugin_t *plugin_api = loadfunc (&deadbeef_api);
+    if (!plugin_api) {
+        return -1;
+    }
+
+    return _plug_register (plugin_api, handle) ? 0 : -1;
 }
 
 static int dirent_alphasort (const struct dirent **a, const struct dirent **b) {
@@ -877,6 +1361,10 @@ load_plugin (const char *plugdir, char *d_name, int l) {
         return -1;
     }
 
+    if (_manifest_register_plugin (fullname, &s)) {
+        return 0;
+    }
+
     trace ("loading plugin %s/%s\n", plugdir, d_name);
     void *handle = dlopen (fullname, RTLD_NOW);
     if (!handle) {
@@ -918,12 +1406,14 @@ load_plugin (const char *plugdir, char *d_name, int l) {
         }
         return 0;
     }
-    if (plug_init_plugin (plug_load, handle) < 0) {
+    DB_plugin_t *plugin_api = plug_load (&deadbeef_api);
+    plugin_t *plug = plugin_api ? _plug_register (plugin_api, handle) : NULL;
+    if (!plug) {
         d_name[l-sizeof (PLUGINEXT)+1] = 0;
         dlclose (handle);
         return -1;
     }
-    plugins_tail->filepath = strdup (fullname);
+    plug->filepath = strdup (fullname);
     return 0;
 }
 
@@ -1099,6 +1589,9 @@ plug_load_all (void) {
     // remember how many plugins to skip if called Nth time
     plugin_t *prev_plugins_tail = plugins_tail;
 
+    _manifest_open ();
+    decoder_profile_init (conf_get_int ("decoder_profiling", 0));
+
 #ifdef OSX_APPBUNDLE
     char libpath[PATH_MAX];
     int res = cocoautil_get_application_support_path (libpath, sizeof (libpath));
@@ -1253,6 +1746,10 @@ plug_load_all (void) {
                 break;
             }
             g_decoder_plugins[numdecoders++] = (DB_decoder_t *)plug->plugin;
+            // the proxies are wrapped after loading the real plugin
+            if (!plug->lazy || plug->plugin != &plug->lazy->decoder.decoder.plugin) {
+                decoder_profile_wrap ((DB_decoder_t *)plug->plugin);
+            }
         }
         else if (plug->plugin->type == DB_PLUGIN_VFS) {
 //            trace ("found vfs plugin %s\n", plug->plugin->name);
@@ -1320,6 +1817,8 @@ plug_load_all (void) {
     g_dsp_plugins[numdsp] = NULL;
     g_playlist_plugins[numplaylist] = NULL;
 
+    _manifest_update ();
+
     // select output plugin
 #ifndef XCTEST
     if (plug_reinit_sound () < 0) {
@@ -1423,10 +1922,21 @@ _plug_unload_stop_complete (void) {
         if (plugins->handle) {
             dlclose (plugins->handle);
         }
+        _lazy_decoder_free (plugins->lazy);
         free (plugins->filepath);
         free (plugins);
         plugins = next;
     }
+    _num_lazy_decoders = 0;
+    decoder_profile_free ();
+    if (_manifest) {
+        plugin_manifest_free (_manifest);
+        _manifest = NULL;
+    }
+    if (_lazy_mutex) {
+        mutex_free (_lazy_mutex);
+        _lazy_mutex = 0;
+    }
     for (int i = 0; g_gui_names[i]; i++) {
         free (g_gui_names[i]);
         g_gui_names[i] = NULL;
@@ -1731,7 +2241,7 @@ const char *
 plug_get_path_for_plugin_ptr (DB_plugin_t *plugin_ptr) {
     plugin_t *p;
     for (p = plugins; p; p = p->next) {
-        if (p->plugin == plugin_ptr) {
+        if (p->plugin == plugin_ptr || (p->lazy && &p->lazy->decoder.decoder.plugin == plugin_ptr)) {
             return p->filepath;
         }
     }
@@ -31,6 +31,9 @@
 #include <deadbeef/deadbeef.h>
 #include <deadbeef/fastftoi.h>
 #include "premix.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define trace(...) { fprintf(stderr, __VA_ARGS__); }
 //#define trace(fmt,...)
@@ -592,3 +595,228 @@ pcm_convert (const ddb_waveformat_t * restrict inputfmt, const char * restrict i
     return nsamples * outputsamplesize;
 }
 
+
+// Generic interleavers, for any number of channels and stride.
+// The samples are converted to unsigned before shifting, to avoid overflowing the signed type.
+
+static void
+pcm_interleave_int32_to_8 (int channels, const int32_t * const * restrict input, int stride, int shift, char * restrict output, int nframes) {
+    for (int i = 0; i < nframes; i++) {
+        for (int c = 0; c < channels; c++) {
+            *output++ = (char)((uint32_t)input[c][i * stride] << shift);
+        }
+    }
+}
+
+static void
+pcm_interleave_int32_to_16 (int channels, const int32_t * const * restrict input, int stride, int shift, char * restrict output, int nframes) {
+    int16_t *out = (int16_t *)output;
+    for (int i = 0; i < nframes; i++) {
+        for (int c = 0; c < channels; c++) {
+            *out++ = (int16_t)((uint32_t)input[c][i * stride] << shift);
+        }
+    }
+}
+
+static void
+pcm_interleave_int32_to_24 (int channels, const int32_t * const * restrict input, int stride, int shift, char * restrict output, int nframes) {
+    for (int i = 0; i < nframes; i++) {
+        for (int c = 0; c < channels; c++) {
+            uint32_t sample = (uint32_t)input[c][i * stride] << shift;
+            output[0] = (char)sample;
+            output[1] = (char)(sample >> 8);
+            output[2] = (char)(sample >> 16);
+            output += 3;
+        }
+    }
+}
+
+static void
+pcm_interleave_int32_to_32 (int channels, const int32_t * const * restrict input, int stride, int shift, char * restrict output, int nframes) {
+    int32_t *out = (int32_t *)output;
+    for (int i = 0; i < nframes; i++) {
+        for (int c = 0; c < channels; c++) {
+            *out++ = (int32_t)((uint32_t)input[c][i * stride] << shift);
+        }
+    }
+}
+
+static void
+pcm_interleave_float (int channels, const float * const * restrict input, int stride, float * restrict output, int nframes) {
+    for (int i = 0; i < nframes; i++) {
+        for (int c = 0; c < channels; c++) {
+            *output++ = input[c][i * stride];
+        }
+    }
+}
+
+#if defined(__SSE2__)
+// Stereo planar fast paths, 8 frames per iteration.
+// Return the number of processed frames, the remainder is done by the generic functions.
+
+static int
+pcm_interleave_stereo_int32_to_16_sse2 (const int32_t * restrict l, const int32_t * restrict r, int shift, char * restrict output, int nframes) {
+    __m128i count = _mm_cvtsi32_si128 (shift + 16);
+    int i = 0;
+    for (; i + 8 <= nframes; i += 8) {
+        // shift the low 16 bits to the top, and back with sign extension, so that packs doesn't saturate
+        __m128i l0 = _mm_srai_epi32 (_mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(l + i)), count), 16);
+        __m128i l1 = _mm_srai_epi32 (_mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(l + i + 4)), count), 16);
+        __m128i r0 = _mm_srai_epi32 (_mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(r + i)), count), 16);
+        __m128i r1 = _mm_srai_epi32 (_mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(r + i + 4)), count), 16);
+        __m128i lw = _mm_packs_epi32 (l0, l1);
+        __m128i rw = _mm_packs_epi32 (r0, r1);
+        _mm_storeu_si128 ((__m128i *)(output + i * 4), _mm_unpacklo_epi16 (lw, rw));
+        _mm_storeu_si128 ((__m128i *)(output + i * 4 + 16), _mm_unpackhi_epi16 (lw, rw));
+    }
+    return i;
+}
+
+// Packs the low 3 bytes of each of the 4 32-bit lanes into the low 12 bytes, the upper 4 bytes are zero
+static inline __m128i
+pcm_pack_4x24_sse2 (__m128i v) {
+    // a | b<<24 in the low 6 bytes of each 64-bit half
+    __m128i lo = _mm_and_si128 (v, _mm_set_epi32 (0, 0x00ffffff, 0, 0x00ffffff));
+    __m128i hi = _mm_and_si128 (v, _mm_set_epi32 (0x00ffffff, 0, 0x00ffffff, 0));
+    __m128i t = _mm_or_si128 (lo, _mm_srli_epi64 (hi, 8));
+    // move the upper 6 bytes next to the lower 6
+    return _mm_or_si128 (_mm_and_si128 (t, _mm_set_epi32 (0, 0, -1, -1)),
+                         _mm_and_si128 (_mm_srli_si128 (t, 2), _mm_set_epi32 (0, -1, (int)0xffff0000, 0)));
+}
+
+static int
+pcm_interleave_stereo_int32_to_24_sse2 (const int32_t * restrict l, const int32_t * restrict r, int shift, char * restrict output, int nframes) {
+    __m128i count = _mm_cvtsi32_si128 (shift);
+    int i = 0;
+    for (; i + 8 <= nframes; i += 8) {
+        __m128i l0 = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(l + i)), count);
+        __m128i l1 = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(l + i + 4)), count);
+        __m128i r0 = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(r + i)), count);
+        __m128i r1 = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(r + i + 4)), count);
+        __m128i p0 = pcm_pack_4x24_sse2 (_mm_unpacklo_epi32 (l0, r0));
+        __m128i p1 = pcm_pack_4x24_sse2 (_mm_unpackhi_epi32 (l0, r0));
+        __m128i p2 = pcm_pack_4x24_sse2 (_mm_unpacklo_epi32 (l1, r1));
+        __m128i p3 = pcm_pack_4x24_sse2 (_mm_unpackhi_epi32 (l1, r1));
+        // 4 x 12 bytes -> 3 x 16 bytes
+        char *out = output + i * 6;
+        _mm_storeu_si128 ((__m128i *)out, _mm_or_si128 (p0, _mm_slli_si128 (p1, 12)));
+        _mm_storeu_si128 ((__m128i *)(out + 16), _mm_or_si128 (_mm_srli_si128 (p1, 4), _mm_slli_si128 (p2, 8)));
+        _mm_storeu_si128 ((__m128i *)(out + 32), _mm_or_si128 (_mm_srli_si128 (p2, 8), _mm_slli_si128 (p3, 4)));
+    }
+    return i;
+}
+
+static int
+pcm_interleave_stereo_int32_to_32_sse2 (const int32_t * restrict l, const int32_t * restrict r, int shift, char * restrict output, int nframes) {
+    __m128i count = _mm_cvtsi32_si128 (shift);
+    int i = 0;
+    for (; i + 8 <= nframes; i += 8) {
+        __m128i l0 = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(l + i)), count);
+        __m128i l1 = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(l + i + 4)), count);
+        __m128i r0 = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(r + i)), count);
+        __m128i r1 = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(r + i + 4)), count);
+        char *out = output + i * 8;
+        _mm_storeu_si128 ((__m128i *)out, _mm_unpacklo_epi32 (l0, r0));
+        _mm_storeu_si128 ((__m128i *)(out + 16), _mm_unpackhi_epi32 (l0, r0));
+        _mm_storeu_si128 ((__m128i *)(out + 32), _mm_unpacklo_epi32 (l1, r1));
+        _mm_storeu_si128 ((__m128i *)(out + 48), _mm_unpackhi_epi32 (l1, r1));
+    }
+    return i;
+}
+
+static int
+pcm_interleave_stereo_float_sse2 (const float * restrict l, const float * restrict r, float * restrict output, int nframes) {
+    int i = 0;
+    for (; i + 8 <= nframes; i += 8) {
+        __m128 l0 = _mm_loadu_ps (l + i);
+        __m128 l1 = _mm_loadu_ps (l + i + 4);
+        __m128 r0 = _mm_loadu_ps (r + i);
+        __m128 r1 = _mm_loadu_ps (r + i + 4);
+        float *out = output + i * 2;
+        _mm_storeu_ps (out, _mm_unpacklo_ps (l0, r0));
+        _mm_storeu_ps (out + 4, _mm_unpackhi_ps (l0, r0));
+        _mm_storeu_ps (out + 8, _mm_unpacklo_ps (l1, r1));
+        _mm_storeu_ps (out + 12, _mm_unpackhi_ps (l1, r1));
+    }
+    return i;
+}
+#endif
+
+int
+pcm_interleave (const ddb_waveformat_t * restrict fmt, const void * const * restrict input, int stride, int shift, char * restrict output, int nframes) {
+    int channels = fmt->channels;
+    if (channels <= 0 || channels > 32 || nframes <= 0) {
+        return 0;
+    }
+
+    int samplesize = fmt->bps >> 3;
+    int done = 0;
+
+    if (fmt->is_float) {
+        if (fmt->bps != 32) {
+            return -1;
+        }
+        const float * const *in = (const float * const *)input;
+#if defined(__SSE2__)
+        if (channels == 2 && stride == 1) {
+            done = pcm_interleave_stereo_float_sse2 (in[0], in[1], (float *)output, nframes);
+        }
+#endif
+        if (done < nframes) {
+            const float *ptrs[32];
+            for (int c = 0; c < channels; c++) {
+                ptrs[c] = in[c] + done * stride;
+            }
+            pcm_interleave_float (channels, ptrs, stride, (float *)output + done * channels, nframes - done);
+        }
+        return nframes * channels * samplesize;
+    }
+
+    if (shift < 0 || shift >= 32) {
+        return -1;
+    }
+
+    const int32_t * const *in = (const int32_t * const *)input;
+    void (*interleave) (int channels, const int32_t * const * restrict input, int stride, int shift, char * restrict output, int nframes);
+
+    switch (fmt->bps) {
+    case 8:
+        interleave = pcm_interleave_int32_to_8;
+        break;
+    case 16:
+        interleave = pcm_interleave_int32_to_16;
+#if defined(__SSE2__)
+        if (channels == 2 && stride == 1) {
+            done = pcm_interleave_stereo_int32_to_16_sse2 (in[0], in[1], shift, output, nframes);
+        }
+#endif
+        break;
+    case 24:
+        interleave = pcm_interleave_int32_to_24;
+#if defined(__SSE2__)
+        if (channels == 2 && stride == 1) {
+            done = pcm_interleave_stereo_int32_to_24_sse2 (in[0], in[1], shift, output, nframes);
+        }
+#endif
+        break;
+    case 32:
+        interleave = pcm_interleave_int32_to_32;
+#if defined(__SSE2__)
+        if (channels == 2 && stride == 1) {
+            done = pcm_interleave_stereo_int32_to_32_sse2 (in[0], in[1], shift, output, nframes);
+        }
+#endif
+        break;
+    default:
+        return -1;
+    }
+
+    if (done < nframes) {
+        const int32_t *ptrs[32];
+        for (int c = 0; c < channels; c++) {
+            ptrs[c] = in[c] + done * stride;
+        }
+        interleave (channels, ptrs, stride, shift, output + done * channels * samplesize, nframes - done);
+    }
+    return nframes * channels * samplesize;
+}
@@ -39,6 +39,12 @@ extern "C" {
 int
 pcm_convert (const ddb_waveformat_t * restrict inputfmt, const char * restrict input, const ddb_waveformat_t * restrict outputfmt, char * restrict output, int inputsize);
 
+// Interleaves separate channels into the output buffer, in the format described by fmt.
+// See DB_functions_t.pcm_interleave.
+// @returns number of output bytes, or -1 if the format is not supported
+int
+pcm_interleave (const ddb_waveformat_t * restrict fmt, const void * const * restrict input, int stride, int shift, char * restrict output, int nframes);
+
 #ifdef __cplusplus
 }
 #endif
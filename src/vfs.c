@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include "vfs.h"
 #include "plugins.h"
+#include "decoderprofile.h"
 
 //#define trace(...) { fprintf(stderr, __VA_ARGS__); }
 #define trace(fmt,...)
@@ -116,7 +117,9 @@ vfs_fread (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
     if (!can_use_file (stream)) {
         return 0;
     }
-    return stream->vfs->read (ptr, size, nmemb, stream);
+    size_t res = stream->vfs->read (ptr, size, nmemb, stream);
+    decoder_profile_count_read (res * size);
+    return res;
 }
 
 int
@@ -124,6 +127,7 @@ vfs_fseek (DB_FILE *stream, int64_t offset, int whence) {
     if (!can_use_file (stream)) {
         return -1;
     }
+    decoder_profile_count_seek ();
     return stream->vfs->seek (stream, offset, whence);
 }
 
@@ -31,8 +31,12 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 #include <fcntl.h>
 #include <unistd.h>
+#include "decoderprofile.h"
 
 #if !defined(__linux__)
 #define O_LARGEFILE 0
@@ -40,193 +44,346 @@
 
 #if !defined(__linux__) || !defined(__GLIBC__)
 #define off64_t off_t
+#define pread64 pread
 #define lseek64 lseek
+#define fstat64 fstat
+#define stat64 stat
 #endif
 
-//#define USE_STDIO
-#define USE_BUFFERING
+// Adaptive read buffer size limits for the non-mmap path.
+// The buffer starts small, to keep random probing (tag readers) cheap,
+// and grows while the file is being read sequentially.
+#define MIN_BUFSIZE 4096
+#define MAX_BUFSIZE (256*1024)
+
+// How many bytes need to be read sequentially before the kernel is told to read ahead aggressively
+#define SEQUENTIAL_THRESHOLD (256*1024)
 
-#ifndef USE_STDIO
-#define BUFSIZE 1024
+#if UINTPTR_MAX > 0xffffffff
+#define DEFAULT_MMAP_MAX_SIZE_MB 512
+#define DEFAULT_MMAP_MAX_SIZE_MB_STR "512"
+#else
+#define DEFAULT_MMAP_MAX_SIZE_MB 64
+#define DEFAULT_MMAP_MAX_SIZE_MB_STR "64"
 #endif
 
+enum {
+    ADVICE_NORMAL,
+    ADVICE_SEQUENTIAL,
+    ADVICE_RANDOM,
+};
+
 static DB_functions_t *deadbeef;
 typedef struct {
     DB_vfs_t *vfs;
-#ifdef USE_STDIO
-    FILE *stream;
-#else
     int stream;
     int64_t offs;
-#ifdef USE_BUFFERING
-    uint8_t buffer[BUFSIZE];
-    uint8_t *bufptr;
-    int bufremaining;
-#endif
+
+    // Regular files are read with pread, so seeking needs no syscalls.
+    // Other file types (pipes, devices) use read/lseek.
+    int is_regular;
+
+    // Non-NULL when the whole file is mapped into memory
+    const uint8_t *map;
+
+    // Buffered mode: buffer holds buflen bytes starting at the file offset bufoffs
+    uint8_t *buffer;
+    size_t bufsize;
+    int64_t bufoffs;
+    size_t buflen;
+
+    // Bytes read sequentially since the last seek, used for access pattern hints
+    int64_t seq_bytes;
+    int advice;
+
     int have_size;
-    size_t size;
-#endif
+    int64_t size;
 } STDIO_FILE;
 
 static DB_vfs_t plugin;
 
+// Off by default: a mapped file which gets truncated by another process,
+// or fails to read on a network mount, kills the player with SIGBUS.
+static int _mmap_enabled = 0;
+static int64_t _mmap_max_size = (int64_t)DEFAULT_MMAP_MAX_SIZE_MB * 1024 * 1024;
+
+static void
+_set_advice (STDIO_FILE *f, int advice) {
+    if (f->advice == advice) {
+        return;
+    }
+    f->advice = advice;
+
+#ifndef _WIN32
+    if (f->map) {
+        int madv = advice == ADVICE_SEQUENTIAL ? MADV_SEQUENTIAL : advice == ADVICE_RANDOM ? MADV_RANDOM : MADV_NORMAL;
+        (void)madvise ((void *)f->map, (size_t)f->size, madv);
+        return;
+    }
+#endif
+#ifdef POSIX_FADV_SEQUENTIAL
+    {
+        int fadv = advice == ADVICE_SEQUENTIAL ? POSIX_FADV_SEQUENTIAL : advice == ADVICE_RANDOM ? POSIX_FADV_RANDOM : POSIX_FADV_NORMAL;
+        (void)posix_fadvise (f->stream, 0, 0, fadv);
+    }
+#endif
+}
+
 static DB_FILE *
 stdio_open (const char *fname) {
     if (!memcmp (fname, "file://", 7)) {
         fname += 7;
     }
-#ifdef USE_STDIO
-    FILE *file = fopen (fname, "rb");
-    if (!file) {
-        return NULL;
-    }
-#else
-    int file = open (fname, O_LARGEFILE);
+    int file = open (fname, O_RDONLY|O_LARGEFILE);
     if (file == -1) {
         return NULL;
     }
-#endif
     STDIO_FILE *fp = malloc (sizeof (STDIO_FILE));
     memset (fp, 0, sizeof (STDIO_FILE));
     fp->vfs = &plugin;
     fp->stream = file;
+
+    struct stat64 st;
+    if (!fstat64 (file, &st) && S_ISREG (st.st_mode)) {
+        fp->is_regular = 1;
+        fp->have_size = 1;
+        fp->size = st.st_size;
+
+#ifndef _WIN32
+        // Map regular files below the size threshold; fall back to buffered reads on failure
+        if (_mmap_enabled && fp->size > 0 && fp->size <= _mmap_max_size) {
+            void *map = mmap (NULL, (size_t)fp->size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (map != MAP_FAILED) {
+                fp->map = map;
+            }
+        }
+#endif
+    }
     return (DB_FILE*)fp;
 }
 
 static void
 stdio_close (DB_FILE *stream) {
     assert (stream);
-#ifdef USE_STDIO
-    fclose (((STDIO_FILE *)stream)->stream);
-#else
-    close (((STDIO_FILE *)stream)->stream);
+    STDIO_FILE *f = (STDIO_FILE *)stream;
+#ifndef _WIN32
+    if (f->map) {
+        munmap ((void *)f->map, (size_t)f->size);
+    }
 #endif
+    close (f->stream);
+    free (f->buffer);
     free (stream);
 }
 
-#ifndef USE_STDIO
-#ifdef USE_BUFFERING
+static void
+_update_access_pattern (STDIO_FILE *f, size_t nb) {
+    f->seq_bytes += nb;
+    if (f->seq_bytes >= SEQUENTIAL_THRESHOLD) {
+        _set_advice (f, ADVICE_SEQUENTIAL);
+    }
+}
+
+static size_t
+_read_mapped (STDIO_FILE *f, uint8_t *ptr, size_t nb) {
+    if (f->offs >= f->size) {
+        return 0;
+    }
+    int64_t remaining = f->size - f->offs;
+    if ((int64_t)nb > remaining) {
+        nb = (size_t)remaining;
+    }
+    memcpy (ptr, f->map + f->offs, nb);
+    f->offs += nb;
+    return nb;
+}
+
+static ssize_t
+_pread (STDIO_FILE *f, void *buffer, size_t size) {
+    decoder_profile_count_syscall ();
+#ifndef _WIN32
+    if (f->is_regular) {
+        return pread64 (f->stream, buffer, size, f->offs);
+    }
+#else
+    // no pread on windows
+    if (f->is_regular && lseek64 (f->stream, f->offs, SEEK_SET) == -1) {
+        return -1;
+    }
+#endif
+    return read (f->stream, buffer, size);
+}
+
 static int
 fillbuffer (STDIO_FILE *f) {
-    assert (f->bufremaining >= 0);
-    if (f->bufremaining == 0) {
-        f->bufremaining = (int)read (f->stream, f->buffer, BUFSIZE);
-        if (f->bufremaining < 0) {
-            f->bufremaining = 0;
+    // grow the buffer while reading sequentially, shrink back on random access
+    size_t bufsize = f->bufsize;
+    if (f->buflen > 0 && f->offs == f->bufoffs + (int64_t)f->buflen) {
+        if (bufsize < MAX_BUFSIZE) {
+            bufsize *= 2;
+        }
+    }
+    else {
+        bufsize = MIN_BUFSIZE;
+    }
+
+    if (bufsize != f->bufsize || !f->buffer) {
+        uint8_t *buffer = realloc (f->buffer, bufsize);
+        if (!buffer) {
             return -1;
         }
-        f->bufptr = f->buffer;
+        f->buffer = buffer;
+        f->bufsize = bufsize;
+    }
+
+    ssize_t rb = _pread (f, f->buffer, f->bufsize);
+    if (rb < 0) {
+        f->buflen = 0;
+        return -1;
     }
-    return f->bufremaining;
+    f->bufoffs = f->offs;
+    f->buflen = (size_t)rb;
+    return (int)rb;
+}
+
+static size_t
+_read_buffered (STDIO_FILE *f, uint8_t *ptr, size_t nb) {
+    size_t total = 0;
+    while (nb > 0) {
+        // serve from the buffer, if the current position is inside of it
+        if (f->buflen > 0 && f->offs >= f->bufoffs && f->offs < f->bufoffs + (int64_t)f->buflen) {
+            size_t pos = (size_t)(f->offs - f->bufoffs);
+            size_t r = f->buflen - pos;
+            if (r > nb) {
+                r = nb;
+            }
+            memcpy (ptr, f->buffer + pos, r);
+            ptr += r;
+            f->offs += r;
+            nb -= r;
+            total += r;
+            continue;
+        }
+
+        // large reads bypass the buffer
+        if (nb >= MAX_BUFSIZE) {
+            ssize_t rb = _pread (f, ptr, nb);
+            if (rb <= 0) {
+                break;
+            }
+            ptr += rb;
+            f->offs += rb;
+            nb -= rb;
+            total += rb;
+            continue;
+        }
+
+        if (fillbuffer (f) <= 0) {
+            break;
+        }
+    }
+    return total;
 }
-#endif
-#endif
 
 static size_t
 stdio_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
     assert (stream);
     assert (ptr);
-#ifdef USE_STDIO
-    return fread (ptr, size, nmemb, ((STDIO_FILE*)stream)->stream);
-#else
     STDIO_FILE *f = (STDIO_FILE*)stream;
 
+    if (size == 0 || nmemb == 0) {
+        return 0;
+    }
+
     size_t nb = size * nmemb;
-#ifdef USE_BUFFERING
-    while (nb > 0) {
-        if (fillbuffer (f) <= 0) {
-            break;
-        }
-        int r = f->bufremaining;
-        if (r > nb) {
-            r = (int)nb;
-        }
-        memcpy (ptr, f->bufptr, r);
-        f->bufremaining -= r;
-        f->bufptr += r;
-        ptr += r;
-        f->offs += r;
-        nb -= r;
+    size_t rb;
+    if (f->map) {
+        rb = _read_mapped (f, ptr, nb);
     }
-    size_t ret = ((size * nmemb) - nb) / size;
-#else
-    ssize_t ret = read (f->stream, ptr, nb);
-    if (ret < 0) {
-        return -1;
+    else {
+        rb = _read_buffered (f, ptr, nb);
     }
-    f->offs += ret;
-    ret = ret / size;
-#endif
-    return ret;
-#endif
+    _update_access_pattern (f, rb);
+    return rb / size;
 }
 
+static int64_t
+stdio_getlength (DB_FILE *stream);
+
 static int
 stdio_seek (DB_FILE *stream, int64_t offset, int whence) {
     assert (stream);
-#ifdef USE_STDIO
-    return fseek (((STDIO_FILE *)stream)->stream, offset, whence);
-#else
-    // convert offset to absolute
+    STDIO_FILE *f = (STDIO_FILE*)stream;
+
+    // convert offset to absolute; no syscalls are needed, since reads use the absolute position
     if (whence == SEEK_CUR) {
-        whence = SEEK_SET;
-        offset = ((STDIO_FILE*)stream)->offs + offset;
+        offset = f->offs + offset;
+    }
+    else if (whence == SEEK_END) {
+        int64_t size = stdio_getlength (stream);
+        if (size < 0) {
+            return -1;
+        }
+        offset = size + offset;
     }
-    off64_t res = lseek64 (((STDIO_FILE *)stream)->stream, offset, whence);
-    if (res == -1) {
+    else if (whence != SEEK_SET) {
         return -1;
     }
-//    printf ("lseek res: %lld (%lld, %d, prev=%lld)\n", res, offset, whence,  ((STDIO_FILE*)stream)->offs);
-    ((STDIO_FILE*)stream)->offs = res;
-#ifdef USE_BUFFERING
-    ((STDIO_FILE*)stream)->bufremaining = 0;
-#endif
-#endif
+
+    if (offset < 0) {
+        return -1;
+    }
+
+    if (!f->is_regular) {
+        decoder_profile_count_syscall ();
+        off64_t res = lseek64 (f->stream, offset, SEEK_SET);
+        if (res == -1) {
+            return -1;
+        }
+        f->buflen = 0;
+    }
+
+    if (offset != f->offs) {
+        // Jumping to the tail before reading much of the file is what the tag readers do,
+        // so treat this as random access; any other seek resets the hint to normal.
+        if (whence == SEEK_END && f->seq_bytes < SEQUENTIAL_THRESHOLD) {
+            _set_advice (f, ADVICE_RANDOM);
+        }
+        else if (f->advice == ADVICE_SEQUENTIAL) {
+            _set_advice (f, ADVICE_NORMAL);
+        }
+        f->seq_bytes = 0;
+    }
+
+    f->offs = offset;
     return 0;
 }
 
 static int64_t
 stdio_tell (DB_FILE *stream) {
     assert (stream);
-#ifdef USE_STDIO
-    return ftell (((STDIO_FILE*)stream)->stream);
-#else
     return ((STDIO_FILE*)stream)->offs;
-#endif
 }
 
 static void
 stdio_rewind (DB_FILE *stream) {
     assert (stream);
-#ifdef USE_STDIO
-    rewind (((STDIO_FILE*)stream)->stream);
-#else
     stdio_seek (stream, 0, SEEK_SET);
-#endif
 }
 
 static int64_t
 stdio_getlength (DB_FILE *stream) {
     assert (stream);
     STDIO_FILE *f = (STDIO_FILE *)stream;
-#ifdef USE_STDIO
-    size_t offs = ftell (f->stream);
-    fseek (f->stream, 0, SEEK_END);
-    size_t l = ftell (f->stream);
-    fseek (f->stream, offs, SEEK_SET);
-    return l;
-#else
     if (!f->have_size) {
-        off64_t size = lseek64 (f->stream, 0, SEEK_END);
-        lseek64 (f->stream, f->offs, SEEK_SET);
-#ifdef USE_BUFFERING
-        f->bufremaining = 0;
-#endif
+        struct stat64 st;
+        if (fstat64 (f->stream, &st)) {
+            return -1;
+        }
         f->have_size = 1;
-        f->size = size;
+        f->size = st.st_size;
     }
     return f->size;
-#endif
 }
 
 const char *
@@ -239,11 +396,36 @@ stdio_is_streaming (void) {
     return 0;
 }
 
+static void
+_read_config (void) {
+    _mmap_enabled = deadbeef->conf_get_int ("vfs_stdio.mmap", 0);
+    _mmap_max_size = deadbeef->conf_get_int64 ("vfs_stdio.mmap_max_size_mb", DEFAULT_MMAP_MAX_SIZE_MB) * 1024 * 1024;
+}
+
+static int
+stdio_start (void) {
+    _read_config ();
+    return 0;
+}
+
+static int
+stdio_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
+    if (id == DB_EV_CONFIGCHANGED) {
+        _read_config ();
+    }
+    return 0;
+}
+
+static const char settings_dlg[] =
+    "property \"Use memory mapping for local files\" checkbox vfs_stdio.mmap 0;\n"
+    "property \"Max size of memory mapped files (MB)\" entry vfs_stdio.mmap_max_size_mb " DEFAULT_MMAP_MAX_SIZE_MB_STR ";\n"
+;
+
 // standard stdio vfs
 static DB_vfs_t plugin = {
     DB_PLUGIN_SET_API_VERSION
     .plugin.version_major = 1,
-    .plugin.version_minor = 0,
+    .plugin.version_minor = 1,
     .plugin.type = DB_PLUGIN_VFS,
     .plugin.name = "stdio vfs",
     .plugin.id = "vfs_stdio",
@@ -272,6 +454,9 @@ static DB_vfs_t plugin = {
         "Oleksiy Yakovenko waker@users.sourceforge.net\n"
     ,
     .plugin.website = "http://deadbeef.sf.net",
+    .plugin.start = stdio_start,
+    .plugin.message = stdio_message,
+    .plugin.configdialog = settings_dlg,
     .open = stdio_open,
     .close = stdio_close,
     .read = stdio_read,